@@ -16,11 +16,14 @@ limitations under the License.
 #include "tensorflow/lite/core/subgraph.h"
 
 #include <iostream>
+#include <map>
+#include <set>
 #include <algorithm>
 #include <cstdint>
 
 #include "tensorflow/lite/arena_planner.h"
 #include "tensorflow/lite/builtin_ops.h"
+#include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/context_util.h"
 #include "tensorflow/lite/core/api/tensor_utils.h"
@@ -249,6 +252,7 @@ Subgraph::~Subgraph() {
     }
     TfLiteTensorFree(tensor);
   }
+  for (void* buffer : channel_partitioned_buffers) free(buffer);
 }
 
 void Subgraph::CleanupNode(int node_index) {
@@ -732,93 +736,446 @@ TfLiteStatus Subgraph::AllocateTensors() {
   return kTfLiteOk;
 }
 
-// TODO : Consider better logic for choosing hight, channel partitioning. (CPU)
-// if i use multi delegate, when execute xnnpack weight(30), bias(29) have to be 200 channels (current 1001)
+namespace {
+
+// Nodes which work on each channel independently and keep the channel
+// count, so channel partitioned input gives channel partitioned output.
+bool IsChannelwiseOp(int builtin_code) {
+  switch (builtin_code) {
+    case kTfLiteBuiltinAveragePool2d:
+    case kTfLiteBuiltinMaxPool2d:
+    case kTfLiteBuiltinRelu:
+    case kTfLiteBuiltinRelu6:
+    case kTfLiteBuiltinReluN1To1:
+    case kTfLiteBuiltinLogistic:
+    case kTfLiteBuiltinTanh:
+    case kTfLiteBuiltinHardSwish:
+    case kTfLiteBuiltinLeakyRelu:
+    case kTfLiteBuiltinQuantize:
+    case kTfLiteBuiltinDequantize:
+      return true;
+    default:
+      return false;
+  }
+}
+
+int NumElementsOf(const TfLiteTensor& tensor) {
+  int elements = 1;
+  for (int i = 0; i < tensor.dims->size; ++i) elements *= tensor.dims->data[i];
+  return elements;
+}
+
+}  // namespace
+
+TfLiteStatus Subgraph::SliceTensorChannels(int tensor_index, int axis,
+                                           int skip, int keep) {
+  TfLiteTensor& tensor = context_.tensors[tensor_index];
+  if (axis >= tensor.dims->size || tensor.dims->data[axis] < skip + keep ||
+      NumElementsOf(tensor) == 0) {
+    std::cout << "Tensor " << tensor_index << " can't be sliced in axis "
+              << axis << "\n";
+    return kTfLiteError;
+  }
+  const int channels = tensor.dims->data[axis];
+  const size_t element_size = tensor.bytes / NumElementsOf(tensor);
+  size_t outer = 1, inner = element_size;
+  for (int i = 0; i < axis; ++i) outer *= tensor.dims->data[i];
+  for (int i = axis + 1; i < tensor.dims->size; ++i)
+    inner *= tensor.dims->data[i];
+  const size_t bytes = outer * keep * inner;
+  if (tensor.allocation_type == kTfLiteMmapRo && tensor.data.raw != nullptr) {
+    // Contiguous and aligned copy of the constant slice, so kernels and
+    // delegates can prepack it like a weight of the model. Activations get
+    // the new shape from the arena.
+    const size_t aligned_bytes =
+        (bytes + kDefaultTensorAlignment - 1) / kDefaultTensorAlignment *
+        kDefaultTensorAlignment;
+    char* buffer = static_cast<char*>(
+        aligned_alloc(kDefaultTensorAlignment, aligned_bytes));
+    if (buffer == nullptr) return kTfLiteError;
+    for (size_t o = 0; o < outer; ++o) {
+      memcpy(buffer + o * keep * inner,
+             tensor.data.raw + (o * channels + skip) * inner, keep * inner);
+    }
+    tensor.data.raw = buffer;
+    channel_partitioned_buffers.push_back(buffer);
+  }
+  tensor.dims->data[axis] = keep;
+  tensor.bytes = bytes;
+  // Per-channel quantization params follow the slice.
+  if (tensor.quantization.type == kTfLiteAffineQuantization &&
+      tensor.quantization.params != nullptr) {
+    auto* params =
+        static_cast<TfLiteAffineQuantization*>(tensor.quantization.params);
+    if (params->quantized_dimension == axis && params->scale != nullptr &&
+        params->scale->size == channels) {
+      TfLiteFloatArray* scale = TfLiteFloatArrayCreate(keep);
+      TfLiteIntArray* zero_point = TfLiteIntArrayCreate(keep);
+      for (int c = 0; c < keep; ++c) {
+        scale->data[c] = params->scale->data[skip + c];
+        zero_point->data[c] = params->zero_point->data[skip + c];
+      }
+      TfLiteFloatArrayFree(params->scale);
+      TfLiteIntArrayFree(params->zero_point);
+      params->scale = scale;
+      params->zero_point = zero_point;
+    }
+  }
+  return kTfLiteOk;
+}
+
+std::vector<int> Subgraph::PlanChannelBlocks() {
+  std::vector<int> block_of_node(execution_plan_.size(), -1);
+  // Block of each partitioned activation, and whether the block holds.
+  std::map<int, int> block_of_tensor;
+  std::vector<bool> valid;
+  auto block_of = [&](int tensor_index) {
+    auto it = block_of_tensor.find(tensor_index);
+    return it == block_of_tensor.end() ? -1 : it->second;
+  };
+  // Blocks read by a node which needs all of their channels.
+  auto end_blocks = [&](int node_index, const TfLiteNode& node,
+                        const TfLiteRegistration& registration) {
+    for (int i = 0; i < node.inputs->size; ++i) {
+      const int block = block_of(node.inputs->data[i]);
+      if (block == -1 || !valid[block]) continue;
+      valid[block] = false;
+      std::cout << "[" << node_index << "] " << GetOpName(registration)
+                << " needs all channels, block " << block
+                << " is not partitioned" << "\n";
+    }
+  };
+  for (int execution_plan_index = 0;
+       execution_plan_index < execution_plan_.size(); execution_plan_index++) {
+    int node_index = execution_plan_[execution_plan_index];
+    const TfLiteNode& node = nodes_and_registration_[node_index].first;
+    const TfLiteRegistration& registration =
+        nodes_and_registration_[node_index].second;
+    if (node.inputs->size < 1 || node.outputs->size < 1) continue;
+    const int output = node.outputs->data[0];
+    bool follows = false;
+    switch (registration.builtin_code) {
+      case kTfLiteBuiltinConv2d:
+      case kTfLiteBuiltinFullyConnected: {
+        // Reads all input channels and starts a block of its own.
+        end_blocks(node_index, node, registration);
+        const TfLiteTensor& weight = context_.tensors[node.inputs->data[1]];
+        const int channels = weight.dims->size > 0 ? weight.dims->data[0] : 0;
+        const int front = FrontChannels(channels,
+                                        GetNodePartitioningRatio(node_index));
+        if (front < 1 || front >= channels) continue;
+        block_of_tensor[output] = valid.size();
+        block_of_node[execution_plan_index] = valid.size();
+        valid.push_back(true);
+        continue;
+      }
+      case kTfLiteBuiltinDepthwiseConv2d: {
+        auto* params =
+            reinterpret_cast<TfLiteDepthwiseConvParams*>(node.builtin_data);
+        follows = params->depth_multiplier == 1;
+        break;
+      }
+      default:
+        follows = IsChannelwiseOp(registration.builtin_code);
+        break;
+    }
+    const int input_block = block_of(node.inputs->data[0]);
+    if (follows && input_block != -1) {
+      block_of_tensor[output] = input_block;
+      block_of_node[execution_plan_index] = input_block;
+    } else {
+      end_blocks(node_index, node, registration);
+    }
+  }
+  for (int& block : block_of_node) {
+    if (block != -1 && !valid[block]) block = -1;
+  }
+  return block_of_node;
+}
+
+int Subgraph::FrontChannels(int channels, int ratio) {
+  if (ratio <= 0) return 0;
+  // Integer split, so both sides agree on it.
+  return channels - channels * (10 - ratio) / 10;
+}
+
+// TODO : Consider better logic for choosing hight, channel partitioning.
+// Partitions output channels of CONV_2D and FULLY_CONNECTED nodes with the
+// ratio of each node, and the DEPTHWISE_CONV_2D, pooling and activation
+// nodes which follow them(see PlanChannelBlocks). CO_GPU side takes the
+// front channels and the other side the back ones.
 TfLiteStatus Subgraph::PartitionChannel(){
-	std::vector<int> partitioning_plan;
-	std::vector<float> ratios;
-  if(partitioning_ratios.empty())
+  if(partitioning_ratios.empty() || channel_partitioned)
     return kTfLiteOk;
   else{
-    if(partitioning_ratios[0] >= 10) // this subgraph is hw
+    if(partitioning_ratios[0] > 10) // height partitioned, as in the builder
       return kTfLiteOk;
   }
-  std::cout << "execution plan size : " <<execution_plan_.size() << "\n";
-	for (int execution_plan_index = 0;
-			execution_plan_index < execution_plan_.size(); execution_plan_index++) {
-		int node_index = execution_plan_[execution_plan_index];
-		
-		TfLiteNode& node = nodes_and_registration_[node_index].first;
-		const TfLiteRegistration& registration = nodes_and_registration_[node_index].second;
-		if (strcmp(GetOpName(registration), "CONV_2D") == 0) {
-			partitioning_plan.push_back(execution_plan_index);
-      if(!partitioning_ratios.empty())
-			  ratios.push_back(1.0 - partitioning_ratios[0] / 10.0);
-      else
-        return kTfLiteError;
-		}
-	}
-  for (int partitioning_plan_index = 0;
-		 	partitioning_plan_index < partitioning_plan.size(); partitioning_plan_index++) {
-		int node_index = partitioning_plan[partitioning_plan_index];
-		if (!(node_index < nodes_and_registration_.size())) {
-			std::cerr << "[" << node_index << "] layer is not exist." << "\n";
-			continue;
-		}
-		TfLiteNode& node = nodes_and_registration_[node_index].first;
-		const TfLiteRegistration& registration = nodes_and_registration_[node_index].second;
-
-		if (strcmp(GetOpName(registration), "CONV_2D") == 0) {
-			for (int n = 1; n < node.inputs->size; ++n) { //change weight tensor
-				int tensor_index = node.inputs->data[n];
-				TfLiteTensor& tensor = context_.tensors[tensor_index];
-				void** data = &tensor.data.data;
-				size_t bytes = tensor.bytes;
-				int* dims = (int*)tensor.dims;
-				if (n == 1) {
-					int o = *(dims + 1);
-					int w = *(dims + 2);
-					int h = *(dims + 3);
-					int i = *(dims + 4);
-					int next_filter = w * h * i * ((int)bytes / (o * w * h * i));
-          std::cout << "partitioning " << ratios[partitioning_plan_index] << "\n";
-					next_filter = (int)next_filter * ceil(o * (1 - ratios[partitioning_plan_index]));
-         	*data += next_filter; 
-				}
-				if (n == 2) {							//change bias tensor
-					int o = *(dims + 1);
-					int next_bias = (int)bytes / o;
-					next_bias = (int)next_bias * ceil(o * (1 - ratios[partitioning_plan_index]));
-					*data += next_bias;
-				}
-				*(dims + 1) *= ratios[partitioning_plan_index]; //change dim of weight & bias
-				int bytes_ = 1;
-				for(int i=0; i<tensor.dims->size; i++){ //change bytes of tensor
-					bytes_ *= tensor.dims->data[i];
-				}
-				tensor.bytes = bytes_*sizeof(float);
-			}
-			for (int n = 0; n < node.outputs->size; ++n) { //change output tensor
-				int tensor_index = node.outputs->data[n];
-				TfLiteTensor& tensor = context_.tensors[tensor_index];
-				int* dims = (int*)tensor.dims;
-				int partitioning_dims = (int)floor(*(dims + 4) * ratios[partitioning_plan_index]);
-				*(dims + 4) = partitioning_dims;
-				int bytes_ = 1;
-				for(int i=0; i<tensor.dims->size; i++){ //change bytes of tensor
-					bytes_ *= tensor.dims->data[i];
-				}
-				tensor.bytes = bytes_*sizeof(float);
-			}
-		}
-		else {
-			std::cerr << "[" << node_index << "] layer must be CONV_2D" << std::endl;
-			continue;
-		}
-	}
+  channel_partitioned = true;
+  const bool front = resource_type == ResourceType::CO_GPU;
+  const std::vector<int> block_of_node = PlanChannelBlocks();
+  // Ratio of each block, from its CONV_2D or FULLY_CONNECTED node.
+  std::map<int, int> block_ratio;
+  std::set<int> sliced;
+  auto slice = [&](int tensor_index, int axis, int ratio) {
+    if (!sliced.insert(tensor_index).second) return kTfLiteOk;
+    const int channels = context_.tensors[tensor_index].dims->data[axis];
+    const int front_channels = FrontChannels(channels, ratio);
+    if (front)
+      return SliceTensorChannels(tensor_index, axis, 0, front_channels);
+    return SliceTensorChannels(tensor_index, axis, front_channels,
+                               channels - front_channels);
+  };
+  for (int execution_plan_index = 0;
+       execution_plan_index < execution_plan_.size(); execution_plan_index++) {
+    const int block = block_of_node[execution_plan_index];
+    if (block == -1) continue;
+    int node_index = execution_plan_[execution_plan_index];
+    TfLiteNode& node = nodes_and_registration_[node_index].first;
+    const TfLiteRegistration& registration =
+        nodes_and_registration_[node_index].second;
+    const int output = node.outputs->data[0];
+    const int last_axis = context_.tensors[output].dims->size - 1;
+    if (!block_ratio.count(block))
+      block_ratio[block] = GetNodePartitioningRatio(node_index);
+    const int ratio = block_ratio[block];
+    TfLiteStatus status = kTfLiteOk;
+    switch (registration.builtin_code) {
+      case kTfLiteBuiltinConv2d:
+      case kTfLiteBuiltinFullyConnected:
+        // Weight [O, ...], bias [O], output [..., O].
+        status = slice(node.inputs->data[1], 0, ratio);
+        if (status == kTfLiteOk && node.inputs->size > 2 &&
+            node.inputs->data[2] >= 0)
+          status = slice(node.inputs->data[2], 0, ratio);
+        break;
+      case kTfLiteBuiltinDepthwiseConv2d:
+        // Weight [1, H, W, C], bias [C].
+        status = slice(node.inputs->data[1], 3, ratio);
+        if (status == kTfLiteOk && node.inputs->size > 2 &&
+            node.inputs->data[2] >= 0)
+          status = slice(node.inputs->data[2], 0, ratio);
+        break;
+      default:
+        break;
+    }
+    if (status == kTfLiteOk) status = slice(output, last_axis, ratio);
+    if (status != kTfLiteOk) {
+      std::cout << "[" << node_index << "] " << GetOpName(registration)
+                << " channel partitioning failed" << "\n";
+      return kTfLiteError;
+    }
+  }
   return kTfLiteOk;
 }
 
+namespace {
+
+// Height geometry of a node. Nodes without a window keep the height.
+struct HeightWindow {
+  bool is_window = false;
+  bool same_padding = false;
+  int kernel = 1;
+  int stride = 1;
+  int dilation = 1;
+  int pad_top = 0;   // of the full tensor
+  int input_height = 0;
+  int output_height = 0;
+};
+
+// Rows of the full tensor held by a partitioned tensor, [lo, hi).
+// Rows in [exact_lo, exact_hi) have the same values as the full tensor.
+// The rest are computed from the virtual padding of the partition.
+struct RowSlice {
+  int lo;
+  int hi;
+  int exact_lo;
+  int exact_hi;
+};
+
+int FloorDiv(int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+// Returns false if the node changes height in a way other than conv/pool.
+bool GetHeightWindow(const TfLiteNode& node,
+                     const TfLiteRegistration& registration,
+                     TfLiteTensor* tensors, HeightWindow* window) {
+  const TfLiteTensor& input = tensors[node.inputs->data[0]];
+  const TfLiteTensor& output = tensors[node.outputs->data[0]];
+  window->input_height = input.dims->data[1];
+  window->output_height = output.dims->data[1];
+  TfLitePadding padding = kTfLitePaddingUnknown;
+  switch (registration.builtin_code) {
+    case kTfLiteBuiltinConv2d:
+    case kTfLiteBuiltinDepthwiseConv2d: {
+      // Both are [x, kernel_h, kernel_w, x], conv and depthwise params share
+      // the layout of padding, stride and dilation.
+      const TfLiteTensor& filter = tensors[node.inputs->data[1]];
+      window->kernel = filter.dims->data[1];
+      if (registration.builtin_code == kTfLiteBuiltinConv2d) {
+        auto* params = reinterpret_cast<TfLiteConvParams*>(node.builtin_data);
+        padding = params->padding;
+        window->stride = params->stride_height;
+        window->dilation = params->dilation_height_factor;
+      } else {
+        auto* params =
+            reinterpret_cast<TfLiteDepthwiseConvParams*>(node.builtin_data);
+        padding = params->padding;
+        window->stride = params->stride_height;
+        window->dilation = params->dilation_height_factor;
+      }
+      break;
+    }
+    case kTfLiteBuiltinAveragePool2d:
+    case kTfLiteBuiltinMaxPool2d: {
+      auto* params = reinterpret_cast<TfLitePoolParams*>(node.builtin_data);
+      padding = params->padding;
+      window->kernel = params->filter_height;
+      window->stride = params->stride_height;
+      break;
+    }
+    default:
+      return window->input_height == window->output_height;
+  }
+  if (padding != kTfLitePaddingSame && padding != kTfLitePaddingValid)
+    return false;
+  window->is_window = true;
+  window->same_padding = padding == kTfLitePaddingSame;
+  const int effective_kernel = (window->kernel - 1) * window->dilation + 1;
+  if (window->same_padding) {
+    window->pad_top = std::max((window->output_height - 1) * window->stride +
+                                   effective_kernel - window->input_height,
+                               0) / 2;
+  }
+  return true;
+}
+
+// Propagates 'in' through a window node the way the kernel computes on a
+// partitioned input, i.e. with padding computed from the partition height.
+// Returns false if no output row lines up with the full tensor.
+bool PropagateRowSlice(const HeightWindow& window, const RowSlice& in,
+                       RowSlice* out) {
+  const int s = window.stride;
+  const int effective_kernel = (window.kernel - 1) * window.dilation + 1;
+  const int rows = in.hi - in.lo;
+  int out_rows, pad_top = 0;
+  if (window.same_padding) {
+    out_rows = (rows + s - 1) / s;
+    pad_top = std::max((out_rows - 1) * s + effective_kernel - rows, 0) / 2;
+  } else {
+    if (rows < effective_kernel) return false;
+    out_rows = (rows - effective_kernel) / s + 1;
+  }
+  // Output row j of the partition reads from full row
+  // lo + j * s - pad_top, full output row r reads from r * s - pad_top.
+  const int shift = in.lo - pad_top + window.pad_top;
+  if (shift % s != 0) return false;
+  out->lo = shift / s;
+  out->hi = out->lo + out_rows;
+  if (out->lo < 0 || out->hi > window.output_height) return false;
+  // Rows whose window(clamped to the full tensor) is in the exact range.
+  int exact_lo = 0;
+  if (in.exact_lo > 0)
+    exact_lo = -FloorDiv(-(in.exact_lo + window.pad_top), s);
+  int exact_hi = window.output_height;
+  if (in.exact_hi < window.input_height)
+    exact_hi = FloorDiv(in.exact_hi - effective_kernel + window.pad_top, s) + 1;
+  out->exact_lo = std::max(exact_lo, out->lo);
+  out->exact_hi = std::min(exact_hi, out->hi);
+  return out->exact_lo < out->exact_hi;
+}
+
+}  // namespace
+
+bool Subgraph::SimulateHeightPartition(int input_lo, int input_hi,
+                                       int* output_lo, int* output_hi,
+                                       int* exact_lo, int* exact_hi) {
+  std::map<int, RowSlice> slices;
+  int input_idx = inputs_[0];
+  slices[input_idx] = {input_lo, input_hi, input_lo, input_hi};
+  for (int execution_plan_index = 0;
+       execution_plan_index < execution_plan_.size(); execution_plan_index++) {
+    int node_index = execution_plan_[execution_plan_index];
+    const TfLiteNode& node = nodes_and_registration_[node_index].first;
+    const TfLiteRegistration& registration =
+        nodes_and_registration_[node_index].second;
+    // Partitioned inputs of the node.
+    std::vector<RowSlice> inputs;
+    for (int i = 0; i < node.inputs->size; ++i) {
+      auto it = slices.find(node.inputs->data[i]);
+      if (it != slices.end()) inputs.push_back(it->second);
+    }
+    if (inputs.empty()) continue;
+    if (node.outputs->size < 1 ||
+        context_.tensors[node.outputs->data[0]].dims->size < 4)
+      return false;
+    HeightWindow window;
+    if (!GetHeightWindow(node, registration, context_.tensors, &window))
+      return false;
+    RowSlice out;
+    if (window.is_window) {
+      auto it = slices.find(node.inputs->data[0]);
+      if (it == slices.end() || !PropagateRowSlice(window, it->second, &out))
+        return false;
+    } else {
+      // Elementwise and channel-wise ops need the inputs lined up.
+      out = inputs[0];
+      for (const RowSlice& in : inputs) {
+        if (in.lo != out.lo || in.hi != out.hi) return false;
+        out.exact_lo = std::max(out.exact_lo, in.exact_lo);
+        out.exact_hi = std::min(out.exact_hi, in.exact_hi);
+      }
+    }
+    slices[node.outputs->data[0]] = out;
+  }
+  auto it = slices.find(outputs_[0]);
+  if (it == slices.end()) return false;
+  *output_lo = it->second.lo;
+  *output_hi = it->second.hi;
+  *exact_lo = it->second.exact_lo;
+  *exact_hi = it->second.exact_hi;
+  return true;
+}
+
+bool Subgraph::ComputeHeightPartitionRows(int ratio, int* input_rows) {
+  if (inputs_.empty() || outputs_.empty()) return false;
+  TfLiteTensor* input_tensor = tensor(inputs_[0]);
+  TfLiteTensor* output_tensor = tensor(outputs_[0]);
+  if (input_tensor->dims->size < 4 || output_tensor->dims->size < 4)
+    return false;
+  const int input_height = input_tensor->dims->data[1];
+  const int output_height = output_tensor->dims->data[1];
+  if (output_height < 2) return false;
+  // Output rows [0, split) are computed by CO_GPU, the rest by CO_CPU.
+  int split = static_cast<int>(output_height * 0.1 * (ratio - 10) + 0.5);
+  split = std::min(std::max(split, 1), output_height - 1);
+  int lo, hi, exact_lo, exact_hi;
+  if (resource_type == ResourceType::CO_CPU) {
+    // Bottom rows, aligned to the bottom of the full tensor. Take the
+    // fewest rows which give exact output rows from 'split'.
+    for (int rows = 1; rows <= input_height; ++rows) {
+      if (SimulateHeightPartition(input_height - rows, input_height, &lo, &hi,
+                                  &exact_lo, &exact_hi) &&
+          hi == output_height && exact_lo <= split &&
+          exact_hi == output_height) {
+        *input_rows = rows;
+        height_partition_split = split;
+        return true;
+      }
+    }
+  } else {
+    // Top rows, aligned to the top of the full tensor.
+    for (int rows = 1; rows <= input_height; ++rows) {
+      if (SimulateHeightPartition(0, rows, &lo, &hi, &exact_lo, &exact_hi) &&
+          lo == 0 && exact_lo == 0 && exact_hi >= split) {
+        *input_rows = rows;
+        height_partition_split = split;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 TfLiteStatus Subgraph::PartitionHeightTest(){
   
   auto stub_method = [&](int padding, std::vector<std::pair<int, int>>& tensor_pair){
@@ -944,10 +1301,32 @@ TfLiteStatus Subgraph::PartitionHeightTest(){
     }
     tensor_pair.push_back(std::pair<int, int>(input_tensor, output_tensor));
   }
-  std::vector<int> partitioning_plan = GetPartitioningRatio();
+  // The split is on the output of subgraph, the rows of other nodes follow
+  // from the receptive field. (builder splits subgraphs where height ratio
+  // changes, so every node has the same ratio)
+  const int ratio = GetNodePartitioningRatio(execution_plan_.back());
   
-
-  stub_method_p(partitioning_plan[0], tensor_pair);
+  // Exact rows(with halo) from the receptive field of each side's output.
+  int input_rows = 0;
+  if(ComputeHeightPartitionRows(ratio, &input_rows)){
+    std::vector<int> new_dims;
+    TfLiteTensor* input_tensor = tensor(inputs_[0]);
+    for(int i=0; i<input_tensor->dims->size; ++i){
+      new_dims.push_back(input_tensor->dims->data[i]);
+    }
+    new_dims[1] = input_rows;
+    std::cout << "changed height for tensor " << inputs_[0] << " to "
+              << input_rows << ", output split " << height_partition_split
+              << "\n";
+    ResizeInputTensor(inputs_[0], new_dims);
+    std::cout << "Height partitioning done" << "\n";
+    return kTfLiteOk;
+  }
+  // Fall back to the fixed overlap if a node has no known height geometry.
+  std::cout << "Exact height partitioning not available for subgraph "
+            << GetGraphid() << ", use fixed overlap" << "\n";
+  height_partition_split = -1;
+  stub_method_p(ratio, tensor_pair);
   // stub_method(225, tensor_pair);  // for efficient l4
   // stub_method(144, tensor_pair);  // for ultra lane net
   // stub_method(240, tensor_pair);  // for ultra lane net
@@ -1882,38 +2261,9 @@ TfLiteStatus Subgraph::ModifyGraphWithDelegate(TfLiteDelegate* delegate) {
   if (!(delegate->flags & kTfLiteDelegateFlagsAllowDynamicTensors)) {
     int last_execution_plan_index_prepared;
     if(resource_type == ResourceType::CO_GPU){
-      // Runtime filter modification for co-execution
-      std::vector<int> partitioning_ratio = GetPartitioningRatio();
-      if(partitioning_ratio[0] < 10){  
-        // channel-wise partitioning(GPU)
-        int conv_filter_before_modification = 0;
-        int partitioning_plan = partitioning_ratio[0];
-        for (int node_index = 0;
-          node_index < nodes_and_registration_.size(); node_index++) {
-          TfLiteNode& node = nodes_and_registration_[node_index].first;
-          const TfLiteRegistration& registration =
-              nodes_and_registration_[node_index].second;
-          int tensor_filter = 0;
-          int tensor_bias = 0;
-          if(!strcmp(GetOpName(registration), "CONV_2D")){
-            std::cout << "Layer " << node_index << " is CONV_2D" << "\n";
-            tensor_filter = node.inputs->data[1];
-            tensor_bias = node.inputs->data[2];
-            conv_filter_before_modification =
-                  context_.tensors[tensor_filter].dims->data[0];
-            int modified_value = 
-                  ceil(conv_filter_before_modification*((float)partitioning_plan/10));
-            context_.tensors[tensor_filter].dims->data[0] = modified_value;
-            context_.tensors[tensor_bias].dims->data[0] = modified_value;
-            int modified_bytes = 1 * sizeof(float);
-            for(int i=0; i<4; i++){
-              modified_bytes *= context_.tensors[tensor_filter].dims->data[i];
-            }
-            context_.tensors[tensor_filter].bytes = modified_bytes;
-            context_.tensors[tensor_bias].bytes = modified_value * sizeof(float);
-          }
-        }
-      }
+      // Channel partitioning of the GPU side, the same blocks and ratios as
+      // the CPU side(see PartitionChannel).
+      TF_LITE_ENSURE_STATUS(PartitionChannel());
     }
     state_ = kStateInvokable;
     TF_LITE_ENSURE_OK(
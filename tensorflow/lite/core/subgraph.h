@@ -192,6 +192,15 @@ class Subgraph {
   // Returns partitioning ratio vector of current subgraph.
   std::vector<int>& GetPartitioningRatio() { return partitioning_ratios; }
 
+  // Returns partitioning ratio of given node. A subgraph with a single ratio
+  // applies it to every node.
+  int GetNodePartitioningRatio(int node_index) {
+    if (partitioning_ratios.empty()) return 0;
+    if (node_index < 0 || node_index >= partitioning_ratios.size())
+      return partitioning_ratios[0];
+    return partitioning_ratios[node_index];
+  }
+
   // Minsung
   // Sets partitioning type of current subgraph.
   void SetPartitioningType(PartitioningType type) { partitioning_type = type; }
@@ -549,17 +558,49 @@ class Subgraph {
   bool input_refreshed = false;
 
 
-  // Channel partitioning for CPU-side subgraph.
+  // Channel partitioning of a co-execution subgraph, CO_GPU side keeps the
+  // front channels and CPU side the back ones. Done once.
   TfLiteStatus PartitionChannel();
 
+  // Block of each node in execution plan, -1 if not partitioned. A block is
+  // a CONV_2D or FULLY_CONNECTED node whose output channels are split and the
+  // DEPTHWISE_CONV_2D(depth multiplier 1), pooling and activation nodes that
+  // follow it. A block read by a node which needs all channels(ADD,
+  // CONCATENATION, ...) is not partitioned, both sides compute it in full.
+  std::vector<int> PlanChannelBlocks();
+
+  // Channels the CO_GPU side keeps of 'channels' with 'ratio'.
+  static int FrontChannels(int channels, int ratio);
+
+  // Keeps channels [skip, skip + keep) of 'axis' in the tensor. Constant
+  // data is repacked to an owned aligned buffer.
+  TfLiteStatus SliceTensorChannels(int tensor_index, int axis, int skip,
+                                   int keep);
+
   // Height partitioning for subgraph.
   TfLiteStatus PartitionHeightTest();
 
+  // First output row computed by CO_CPU side of height partitioning.
+  // Rows before it come from CO_GPU side. -1 if not known.
+  int GetHeightPartitionSplit() { return height_partition_split; }
+
   // Replaces destination tensor's data pointer(buffer arena) with source tensor.
   // The dimension must match between two tensors.
   TfLiteStatus ReplaceBufferofSameDims(TfLiteTensor* source, TfLiteTensor* dest);
 
  private:
+  // Finds the fewest input rows(halo included) with which this side of
+  // height partitioning computes exact output rows. CO_GPU takes the top
+  // rows, CO_CPU the bottom rows. Kernel, stride, dilation and padding of
+  // every conv/pool node are propagated. Returns false if a node changes
+  // height in another way.
+  bool ComputeHeightPartitionRows(int ratio, int* input_rows);
+
+  // Runs the input rows [input_lo, input_hi) through the height geometry of
+  // nodes and gets the full tensor rows of output and its exact part.
+  bool SimulateHeightPartition(int input_lo, int input_hi, int* output_lo,
+                               int* output_hi, int* exact_lo, int* exact_hi);
+
   // SubgraphAwareProfiler wraps an actual TFLite profiler, such as a
   // BufferedProfiler instance, and takes care of event profiling/tracing in a
   // certain subgraph.
@@ -981,6 +1022,10 @@ class Subgraph {
   // Flag for co-execution of cpu/gpu (layer partitioning)
   tflite::Subgraph* co_subgraph = nullptr;
   std::vector<int> partitioning_ratios;
+  int height_partition_split = -1;
+  // Repacked weights of channel partitioning, freed with subgraph.
+  std::vector<void*> channel_partitioned_buffers;
+  bool channel_partitioned = false;
 
   // Minsung
   // Flag for profiling
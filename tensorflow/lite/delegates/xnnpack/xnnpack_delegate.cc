@@ -281,12 +281,23 @@ class Subgraph {
   TfLiteStatus Prepare(TfLiteContext* context) { return kTfLiteOk; }
 
   TfLiteStatus Invoke(TfLiteContext* context) {
-    if (first_run_) {
+    bool any_pointers_changed = false;
+    for (std::pair<const int, void*>& io_info : externals_) {
+      void* data_pointer = context->tensors[io_info.first].data.raw;
+      if (data_pointer != io_info.second) {
+        io_info.second = data_pointer;
+        any_pointers_changed = true;
+      }
+    }
+
+    // Set up again if any input or output was rebound to another buffer,
+    // for example by the rotating frame buffers of pipelined execution.
+    if (first_run_ || any_pointers_changed) {
       std::vector<xnn_external_value> external_values;
-      for (int t : externals_) {
+      for (const std::pair<const int, void*>& io_info : externals_) {
         xnn_external_value value = {0};
-        value.id = static_cast<uint32_t>(t);
-        value.data = context->tensors[t].data.raw;
+        value.id = static_cast<uint32_t>(io_info.first);
+        value.data = io_info.second;
         external_values.push_back(value);
       }
 
@@ -2786,15 +2797,19 @@ class Subgraph {
 
  private:
   Subgraph(xnn_runtime_t runtime, std::unordered_set<int>&& externals)
-      : runtime_(runtime, &xnn_delete_runtime), externals_(externals) {}
+      : runtime_(runtime, &xnn_delete_runtime) {
+    for (int t : externals) {
+      externals_[t] = nullptr;
+    }
+  }
 
   // XNNPACK Runtime (subgraph + workspace) with smart-pointer for lifetime
   // management.
   std::unique_ptr<xnn_runtime, decltype(&xnn_delete_runtime)> runtime_{
       nullptr, &xnn_delete_runtime};
   // TFLite Tensor IDs == XNNPACK Value IDs of input/output tensors for the
-  // delegated subgraph.
-  std::unordered_set<int> externals_;
+  // delegated subgraph, with the data pointer of the last setup.
+  std::unordered_map<int, void*> externals_;
   bool first_run_{true};
 };
 
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/kernels/register.h"
+#include "tensorflow/lite/lite_runtime.h"
+#include "tensorflow/lite/model.h"
+#include "tensorflow/lite/tf_affinity.h"
+#include "tensorflow/lite/tf_scheduler.h"
+
+// Latency of a model on TfLiteRuntime co-executing between two CPU clusters,
+// each with its own XNNPACK pool pinned to its cores, against the model on
+// a single XNNPACK pool of the same number of threads over both clusters
+// and on cluster A alone.
+//
+// Usage : cluster_benchmark <model> <cpus of A> <threads of A> <cpus of B>
+//                           <threads of B> [iterations]
+//   ex) cluster_benchmark yolo.tflite 4-7 4 0-3 4   (big.LITTLE, big is A)
+//       cluster_benchmark yolo.tflite 0-3 4 4-7 4   (x86, two halves)
+//
+// The scheduler runs on a thread of the benchmark and plans the runtime from
+// its profile, so the split is the one the scheduler gives in deployment.
+// The model needs a NHWC 3 channel input, it is fed a gray frame by
+// FeedFrameToModel before every Invoke. Only Invoke is timed.
+
+using namespace tflite;
+
+namespace {
+
+const char kSchedulerSocket[] = "/tmp/cluster_benchmark_scheduler";
+const char kRuntimeSocket[] = "/tmp/cluster_benchmark_runtime";
+
+double ElapsedUs(struct timespec& begin, struct timespec& end){
+  return (end.tv_sec - begin.tv_sec) * 1e6 +
+         (end.tv_nsec - begin.tv_nsec) / 1e3;
+}
+
+// "0-3,6" to {0, 1, 2, 3, 6}.
+std::vector<int> ParseCpus(const char* list){
+  std::vector<int> cpus;
+  const char* p = list;
+  while(*p != '\0'){
+    char* end;
+    const long first = strtol(p, &end, 10);
+    if(end == p){
+      p++;
+      continue;
+    }
+    long last = first;
+    if(*end == '-')
+      last = strtol(end + 1, &end, 10);
+    for(long cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+    p = end;
+  }
+  return cpus;
+}
+
+double Median(std::vector<double> samples){
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+// Median latency(us) of 'run' after a warm up, -1 if 'run' failed.
+double Measure(int iterations, const std::function<bool()>& prepare,
+               const std::function<bool()>& run){
+  std::vector<double> samples;
+  struct timespec begin, end;
+  if(!prepare() || !run())
+    return -1;
+  for(int i=0; i<iterations; ++i){
+    if(!prepare())
+      return -1;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    if(!run())
+      return -1;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    samples.push_back(ElapsedUs(begin, end));
+  }
+  return Median(samples);
+}
+
+// Model on a plain interpreter with one XNNPACK pool of 'threads' created in
+// the affinity of 'cpus'.
+double MeasureSinglePool(const FlatBufferModel& model,
+                         const std::vector<int>& cpus, int threads,
+                         int iterations){
+  TfAffinityScope scope(cpus);
+  ops::builtin::BuiltinOpResolver resolver;
+  InterpreterBuilder builder(model, resolver);
+  std::unique_ptr<Interpreter> interpreter;
+  if(builder(&interpreter) != kTfLiteOk || interpreter == nullptr)
+    return -1;
+  TfLiteXNNPackDelegateOptions options = TfLiteXNNPackDelegateOptionsDefault();
+  options.num_threads = threads;
+  TfLiteDelegate* delegate = TfLiteXNNPackDelegateCreate(&options);
+  double us = -1;
+  if(interpreter->ModifyGraphWithDelegate(delegate) == kTfLiteOk &&
+      interpreter->AllocateTensors() == kTfLiteOk){
+    us = Measure(iterations, [](){ return true; },
+                 [&](){ return interpreter->Invoke() == kTfLiteOk; });
+  }
+  interpreter.reset();
+  TfLiteXNNPackDelegateDelete(delegate);
+  return us;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+  if(argc < 6){
+    printf("Usage : %s <model> <cpus of A> <threads of A> <cpus of B> "
+           "<threads of B> [iterations]\n", argv[0]);
+    return 1;
+  }
+  const char* model_path = argv[1];
+  CpuClusterOptions cluster_a, cluster_b;
+  cluster_a.cpus = ParseCpus(argv[2]);
+  cluster_a.num_threads = std::max(1, atoi(argv[3]));
+  cluster_b.cpus = ParseCpus(argv[4]);
+  cluster_b.num_threads = std::max(1, atoi(argv[5]));
+  const int iterations = argc > 6 ? std::max(1, atoi(argv[6])) : 20;
+  std::vector<int> cpus_all = cluster_a.cpus;
+  cpus_all.insert(cpus_all.end(), cluster_b.cpus.begin(),
+                  cluster_b.cpus.end());
+
+  std::unique_ptr<FlatBufferModel> model =
+      FlatBufferModel::BuildFromFile(model_path);
+  if(model == nullptr){
+    printf("Cannot load %s\n", model_path);
+    return 1;
+  }
+  const double single_us = MeasureSinglePool(
+      *model, cpus_all, cluster_a.num_threads + cluster_b.num_threads,
+      iterations);
+  const double a_only_us = MeasureSinglePool(
+      *model, cluster_a.cpus, cluster_a.num_threads, iterations);
+
+  // Scheduler loop never returns, it ends with the process.
+  std::thread scheduler_thread([](){
+    TfScheduler scheduler(kSchedulerSocket);
+    scheduler.Work();
+  });
+  scheduler_thread.detach();
+  while(access(kSchedulerSocket, F_OK) != 0)
+    usleep(1000);
+
+  std::string runtime_socket = kRuntimeSocket;
+  std::string scheduler_socket = kSchedulerSocket;
+  TfLiteRuntime runtime(&runtime_socket[0], &scheduler_socket[0], model_path,
+                        cluster_a, cluster_b, INPUT_TYPE::USER);
+  // Gray frame, the runtime resizes it to its input.
+  std::vector<uint8_t> pixels(640 * 480 * 3, 128);
+  TfFrame frame;
+  frame.format = TF_PIXEL_BGR8;
+  frame.width = 640;
+  frame.height = 480;
+  frame.data = pixels.data();
+  frame.stride = frame.width * 3;
+  TfNormalization normalization;
+  const double split_us = Measure(iterations,
+      [&](){
+        return runtime.FeedFrameToModel(frame, normalization) == kTfLiteOk;
+      },
+      [&](){ return runtime.Invoke() == kTfLiteOk; });
+
+  printf("%s, A %s x%d, B %s x%d, %d iterations, median us\n", model_path,
+         argv[2], cluster_a.num_threads, argv[4], cluster_b.num_threads,
+         iterations);
+  printf("%9s %9s %9s\n", "single", "A only", "split");
+  printf("%9.0f %9.0f %9.0f\n", single_us, a_only_us, split_us);
+  return split_us < 0 ? 1 : 0;
+}
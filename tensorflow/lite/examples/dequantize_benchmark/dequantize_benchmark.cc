@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <vector>
+#include "tensorflow/lite/tf_dequantize.h"
+
+// Latency of merging the quantized co-execution output into the float input
+// of the next subgraph(TfLiteRuntime::MergeCoExecutionData).
+//
+// Usage : dequantize_benchmark [iterations]
+//
+// 'copy' is the merge before DequantizeInterleave. It dequantizes to a
+// temporary buffer and interleaves channels by per-pixel memcpy.
+// 'fused' dequantizes straight into the destination.
+
+using namespace tflite;
+
+namespace {
+
+struct Shape{
+  const char* name;
+  int height;
+  int width;
+  int channels;
+};
+
+// Typical output shapes of partitioned layers.
+const Shape kShapes[] = {
+  {"mobilenet 112x112x64", 112, 112, 64},
+  {"mobilenet 28x28x256", 28, 28, 256},
+  {"mobilenet 14x14x512", 14, 14, 512},
+  {"yolo 52x52x128", 52, 52, 128},
+  {"yolo 26x26x256", 26, 26, 256},
+  {"yolo 13x13x512", 13, 13, 512},
+};
+
+constexpr float kScale = 0.0235f;
+constexpr int kZeroPoint = 3;
+
+double ElapsedUs(struct timespec& begin, struct timespec& end){
+  return (end.tv_sec - begin.tv_sec) * 1e6 +
+         (end.tv_nsec - begin.tv_nsec) / 1e3;
+}
+
+// Merge before DequantizeInterleave.
+void CopyMerge(const uint8_t* source, float* dest, int pixels, int channels,
+               int dest_stride){
+  const int size = pixels * channels;
+  float* dequantized = (float*)malloc(size * sizeof(float));
+  for(int i=0; i<size; ++i){
+    dequantized[i] = (static_cast<int>(source[i]) - kZeroPoint) * kScale;
+  }
+  if(channels == dest_stride){
+    memcpy(dest, dequantized, size * sizeof(float));
+  }else{
+    for(int i=0; i<pixels; ++i){
+      memcpy(dest + dest_stride * i, dequantized + channels * i,
+             channels * sizeof(float));
+    }
+  }
+  free(dequantized);
+}
+
+template <typename F>
+double MedianUs(int iterations, F merge){
+  std::vector<double> latency;
+  for(int i=0; i<iterations; ++i){
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    merge();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    latency.push_back(ElapsedUs(begin, end));
+  }
+  std::sort(latency.begin(), latency.end());
+  return latency[latency.size() / 2];
+}
+
+// Returns false if fused output differs from the reference.
+bool Verify(const uint8_t* source, int pixels, int channels, int dest_stride){
+  std::vector<float> expected(pixels * dest_stride, 0);
+  std::vector<float> fused(pixels * dest_stride, 0);
+  CopyMerge(source, expected.data(), pixels, channels, dest_stride);
+  DequantizeInterleave(source, fused.data(), pixels, channels, dest_stride,
+                       kScale, kZeroPoint);
+  if(expected != fused)
+    return false;
+  // int8 values are the uint8 ones shifted by 128.
+  std::vector<int8_t> signed_source(pixels * channels);
+  for(size_t i=0; i<signed_source.size(); ++i)
+    signed_source[i] = static_cast<int8_t>(source[i] - 128);
+  std::fill(fused.begin(), fused.end(), 0);
+  DequantizeInterleave(signed_source.data(), fused.data(), pixels, channels,
+                       dest_stride, kScale, kZeroPoint - 128);
+  return expected == fused;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+  int iterations = 200;
+  if(argc > 1)
+    iterations = atoi(argv[1]);
+  if(iterations < 1){
+    std::cout << "Usage : dequantize_benchmark [iterations]" << "\n";
+    return 1;
+  }
+  printf("%-24s %-8s %10s %10s %8s\n", "shape", "split", "copy(us)",
+         "fused(us)", "speedup");
+  for(const Shape& shape : kShapes){
+    const int pixels = shape.height * shape.width;
+    std::vector<float> dest(pixels * shape.channels);
+    std::vector<uint8_t> source(pixels * shape.channels);
+    for(size_t i=0; i<source.size(); ++i)
+      source[i] = static_cast<uint8_t>(rand());
+
+    // Channel split in half, cpu side writes the back channels.
+    const int min_ch = shape.channels / 2;
+    float* cw_dest = dest.data() + (shape.channels - min_ch);
+    // Height split in half, cpu side writes the bottom rows.
+    const int min_size = (shape.height / 2) * shape.width * shape.channels;
+    float* hw_dest = dest.data() + (dest.size() - min_size);
+
+    if(!Verify(source.data(), pixels, min_ch, shape.channels) ||
+        !Verify(source.data(), 1, min_size, min_size)){
+      std::cout << "Fused output mismatch on " << shape.name << "\n";
+      return 1;
+    }
+    double copy_us = MedianUs(iterations, [&](){
+      CopyMerge(source.data(), cw_dest, pixels, min_ch, shape.channels);
+    });
+    double fused_us = MedianUs(iterations, [&](){
+      DequantizeInterleave(source.data(), cw_dest, pixels, min_ch,
+                           shape.channels, kScale, kZeroPoint);
+    });
+    printf("%-24s %-8s %10.2f %10.2f %7.2fx\n", shape.name, "channel",
+           copy_us, fused_us, copy_us / fused_us);
+    copy_us = MedianUs(iterations, [&](){
+      CopyMerge(source.data(), hw_dest, 1, min_size, min_size);
+    });
+    fused_us = MedianUs(iterations, [&](){
+      DequantizeInterleave(source.data(), hw_dest, 1, min_size, min_size,
+                           kScale, kZeroPoint);
+    });
+    printf("%-24s %-8s %10.2f %10.2f %7.2fx\n", shape.name, "height",
+           copy_us, fused_us, copy_us / fused_us);
+  }
+  return 0;
+}
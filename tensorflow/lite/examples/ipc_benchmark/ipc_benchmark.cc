@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "tensorflow/lite/tf_channel.h"
+#include "tensorflow/lite/tf_protocol.h"
+
+// Round trip latency of an invoke request between a runtime and scheduler
+// over UDS and over the shared-memory channel.
+//
+// Usage : ipc_benchmark [iterations]
+//
+// The parent process plays the scheduler and replies to every request with a
+// grant like TfScheduler does on the hot path. The child process plays
+// the runtime and measures the round trips.
+
+using namespace tflite;
+
+namespace {
+
+const char* kSchedulerSock = "/tmp/tf_ipc_bench_scheduler";
+const char* kRuntimeSock = "/tmp/tf_ipc_bench_runtime";
+const char* kShmName = "/tf_ipc_bench";
+constexpr int kWarmupRuns = 1000;
+// cur_subgraph of the request which stops the echo loop.
+constexpr int kStopRequest = -1;
+
+double ElapsedUs(struct timespec& begin, struct timespec& end){
+  return (end.tv_sec - begin.tv_sec) * 1e6 +
+         (end.tv_nsec - begin.tv_nsec) / 1e3;
+}
+
+void PrintLatency(const char* name, std::vector<double>& latency){
+  std::sort(latency.begin(), latency.end());
+  double sum = 0;
+  for(double l : latency)
+    sum += l;
+  printf("%-6s avg %8.2f us  p50 %8.2f us  p99 %8.2f us  max %8.2f us\n",
+         name, sum / latency.size(), latency[latency.size() / 2],
+         latency[latency.size() * 99 / 100], latency.back());
+}
+
+int BindSocket(const char* path, struct sockaddr_un& addr){
+  if(access(path, F_OK) == 0)
+    unlink(path);
+  int fd = socket(PF_FILE, SOCK_DGRAM, 0);
+  if(fd == -1)
+    return -1;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1){
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void FillRequest(tf_invoke_msg& msg, int subgraph){
+  SetMsgHeader(msg.header, TF_MSG_INVOKE, 0, RuntimeState::INVOKE_,
+               RuntimeState::INVOKE_);
+  msg.cur_subgraph = subgraph;
+  msg.cur_graph_resource = 0;
+  msg.lease_resources = 0;
+  msg.priority = 0;
+  msg.period_us = 0;
+  msg.weight = 1;
+  msg.request_id = 0;
+  msg.deadline_us = 0;
+}
+
+void FillGrant(tf_lease_msg& msg, int runtime_id){
+  SetMsgHeader(msg.header, TF_MSG_GRANT, runtime_id, RuntimeState::INVOKE_,
+               RuntimeState::INVOKE_);
+  msg.lease_id = -1;
+  msg.lease_resources = 0;
+  msg.lease_us = 0;
+  msg.variant = -1;
+  msg.request_id = 0;
+}
+
+//// Scheduler side
+void ServeUDS(int fd){
+  tf_invoke_msg rx_msg;
+  struct sockaddr_un runtime_addr;
+  while(1){
+    socklen_t addr_size = sizeof(runtime_addr);
+    int received = recvfrom(fd, &rx_msg, sizeof(rx_msg), 0,
+                            (struct sockaddr*)&runtime_addr, &addr_size);
+    if(received == -1 || !IsValidMsg(rx_msg.header, received))
+      continue;
+    tf_lease_msg tx_grant;
+    FillGrant(tx_grant, 0);
+    sendto(fd, &tx_grant, sizeof(tx_grant), 0,
+           (struct sockaddr*)&runtime_addr, addr_size);
+    if(rx_msg.cur_subgraph == kStopRequest)
+      return;
+  }
+}
+
+void ServeShm(TfShmChannel* channel){
+  tf_invoke_msg rx_msg;
+  size_t received;
+  while(1){
+    int runtime_id = channel->PollRequest(&rx_msg, sizeof(rx_msg), &received);
+    if(runtime_id == -1){
+      channel->WaitRequest(5000);
+      continue;
+    }
+    if(!IsValidMsg(rx_msg.header, received))
+      continue;
+    tf_lease_msg tx_grant;
+    FillGrant(tx_grant, runtime_id);
+    channel->SendReply(runtime_id, &tx_grant, sizeof(tx_grant));
+    if(rx_msg.cur_subgraph == kStopRequest)
+      return;
+  }
+}
+////
+
+//// Runtime side
+int BenchmarkUDS(int iterations){
+  struct sockaddr_un runtime_addr, scheduler_addr;
+  int fd = BindSocket(kRuntimeSock, runtime_addr);
+  if(fd == -1){
+    std::cout << "Runtime socket ERROR" << "\n";
+    return -1;
+  }
+  memset(&scheduler_addr, 0, sizeof(scheduler_addr));
+  scheduler_addr.sun_family = AF_UNIX;
+  strcpy(scheduler_addr.sun_path, kSchedulerSock);
+
+  std::vector<double> latency;
+  tf_invoke_msg tx_msg;
+  tf_lease_msg rx_grant;
+  for(int i=0; i<kWarmupRuns + iterations; ++i){
+    const bool last = i == kWarmupRuns + iterations - 1;
+    FillRequest(tx_msg, last ? kStopRequest : i);
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    sendto(fd, &tx_msg, sizeof(tx_msg), 0,
+           (struct sockaddr*)&scheduler_addr, sizeof(scheduler_addr));
+    int received = recvfrom(fd, &rx_grant, sizeof(rx_grant), 0, NULL, 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if(received == -1 || !IsValidMsg(rx_grant.header, received)){
+      std::cout << "UDS round trip failed" << "\n";
+      close(fd);
+      return -1;
+    }
+    if(i >= kWarmupRuns)
+      latency.push_back(ElapsedUs(begin, end));
+  }
+  close(fd);
+  unlink(kRuntimeSock);
+  PrintLatency("UDS", latency);
+  return 0;
+}
+
+int BenchmarkShm(int iterations){
+  TfShmChannel* channel = TfShmChannel::Attach(kShmName, 0);
+  if(channel == nullptr){
+    std::cout << "Shared-memory channel attach ERROR" << "\n";
+    return -1;
+  }
+  std::vector<double> latency;
+  tf_invoke_msg tx_msg;
+  tf_lease_msg rx_grant;
+  for(int i=0; i<kWarmupRuns + iterations; ++i){
+    const bool last = i == kWarmupRuns + iterations - 1;
+    FillRequest(tx_msg, last ? kStopRequest : i);
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    channel->SendRequest(&tx_msg, sizeof(tx_msg));
+    int received = channel->ReceiveReply(&rx_grant, sizeof(rx_grant));
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if(received == -1 || !IsValidMsg(rx_grant.header, received)){
+      std::cout << "Shared-memory round trip failed" << "\n";
+      delete channel;
+      return -1;
+    }
+    if(i >= kWarmupRuns)
+      latency.push_back(ElapsedUs(begin, end));
+  }
+  delete channel;
+  PrintLatency("SHM", latency);
+  return 0;
+}
+////
+
+} // namespace
+
+int main(int argc, char* argv[]){
+  int iterations = 100000;
+  if(argc > 1)
+    iterations = atoi(argv[1]);
+  if(iterations < 1){
+    std::cout << "Usage : ipc_benchmark [iterations]" << "\n";
+    return 1;
+  }
+
+  // Both transports are set up before fork, so the runtime never races
+  // against the scheduler's setup.
+  struct sockaddr_un scheduler_addr;
+  int scheduler_fd = BindSocket(kSchedulerSock, scheduler_addr);
+  if(scheduler_fd == -1){
+    std::cout << "Scheduler socket ERROR" << "\n";
+    return 1;
+  }
+  TfShmChannel* channel = TfShmChannel::Create(kShmName);
+  if(channel == nullptr){
+    std::cout << "Shared-memory channel create ERROR" << "\n";
+    return 1;
+  }
+
+  // Flush before fork so the child doesn't print the buffered line again.
+  std::cout << "Invoke request round trip, " << iterations << " iterations"
+            << std::endl;
+  pid_t pid = fork();
+  if(pid == -1){
+    std::cout << "fork ERROR" << "\n";
+    return 1;
+  }
+  if(pid == 0){ // runtime
+    close(scheduler_fd);
+    int ret = BenchmarkUDS(iterations);
+    if(ret == 0)
+      ret = BenchmarkShm(iterations);
+    // _exit skips the destructor of inherited channel(owned by parent) and
+    // stdio flush.
+    fflush(stdout);
+    std::cout.flush();
+    _exit(ret == 0 ? 0 : 1);
+  }
+  ServeUDS(scheduler_fd);
+  ServeShm(channel);
+
+  int status;
+  waitpid(pid, &status, 0);
+  close(scheduler_fd);
+  unlink(kSchedulerSock);
+  delete channel;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+#include <vector>
+#include "tensorflow/lite/tf_pipeline.h"
+
+// Throughput of a chain of stages run sequentially, as TfLiteRuntime::Invoke
+// does, against TfPipeline of each depth. (pipelined execution of
+// TfLiteRuntime)
+//
+// Usage : pipeline_benchmark <frames> <stage> [stage ...]
+//   stage is c<us>(CPU stage, computes for us) or a<us>(accelerator stage,
+//   the calling thread waits for us while the device works).
+//   ex) pipeline_benchmark 200 c3000 a5000 c2000
+//
+// Each stage also transforms the buffer of its frame, which is checked at
+// the output so that a frame mixed with another fails the run. Pipelined
+// throughput approaches the slowest stage when the stages do not contend.
+// CPU stages contend on a machine with fewer cores than CPU stages.
+
+using namespace tflite;
+
+namespace {
+
+const int kValues = 1024;
+
+struct Stage{
+  bool accelerator;
+  int us;
+};
+
+double NowUs(){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+void RunStage(const Stage& stage, int index, const std::vector<int32_t>& in,
+              std::vector<int32_t>& out){
+  const double end = NowUs() + stage.us;
+  if(stage.accelerator){
+    usleep(stage.us);
+  }else{
+    while(NowUs() < end){} // busy as a CPU kernel.
+  }
+  for(int i=0; i<kValues; ++i)
+    out[i] = in[i] * 3 + index + 1;
+}
+
+// Value i of the output of 'frame' after 'stages' stages.
+int32_t Expected(int frame, int i, int stages){
+  int32_t value = frame + i;
+  for(int s=0; s<stages; ++s)
+    value = value * 3 + s + 1;
+  return value;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+  if(argc < 3){
+    printf("Usage : %s <frames> <stage> [stage ...]\n", argv[0]);
+    printf("  stage : c<us> for CPU, a<us> for accelerator\n");
+    return 1;
+  }
+  const int frames = std::max(1, atoi(argv[1]));
+  std::vector<Stage> stages;
+  int sum_us = 0, max_us = 0;
+  for(int i=2; i<argc; ++i){
+    if((argv[i][0] != 'c' && argv[i][0] != 'a') || atoi(argv[i] + 1) <= 0){
+      printf("Invalid stage %s\n", argv[i]);
+      return 1;
+    }
+    stages.push_back({argv[i][0] == 'a', atoi(argv[i] + 1)});
+    sum_us += stages.back().us;
+    max_us = std::max(max_us, stages.back().us);
+  }
+  const int n = stages.size();
+
+  printf("%d frames, %d stages, bound of sequential %.1f fps, of pipeline "
+         "%.1f fps\n", frames, n, 1e6 / sum_us, 1e6 / max_us);
+  printf("%-12s %10s %10s\n", "mode", "fps", "speedup");
+
+  // Sequential, one frame through every stage at a time.
+  double sequential_fps;
+  {
+    std::vector<std::vector<int32_t>> buffers(n + 1,
+                                              std::vector<int32_t>(kValues));
+    const double begin = NowUs();
+    for(int f=0; f<frames; ++f){
+      for(int i=0; i<kValues; ++i)
+        buffers[0][i] = f + i;
+      for(int s=0; s<n; ++s)
+        RunStage(stages[s], s, buffers[s], buffers[s + 1]);
+      if(buffers[n][kValues - 1] != Expected(f, kValues - 1, n)){
+        printf("sequential : frame %d is wrong\n", f);
+        return 1;
+      }
+    }
+    sequential_fps = frames * 1e6 / (NowUs() - begin);
+    printf("%-12s %10.1f %10.2f\n", "sequential", sequential_fps, 1.0);
+  }
+
+  for(int depth=1; depth<=3; ++depth){
+    // buffers[slot][boundary], boundary 0 is the input and n is the output.
+    std::vector<std::vector<std::vector<int32_t>>> buffers(depth,
+        std::vector<std::vector<int32_t>>(n + 1, std::vector<int32_t>(kValues)));
+    TfPipeline pipeline(n, depth, [&](int stage, int slot){
+      RunStage(stages[stage], stage, buffers[slot][stage],
+               buffers[slot][stage + 1]);
+      return true;
+    });
+    int submitted = 0, done = 0;
+    const double begin = NowUs();
+    while(done < frames){
+      // Keep the pipeline full, collect a frame when it is.
+      if(submitted < frames && pipeline.InFlight() < depth){
+        const int slot = pipeline.BeginFrame();
+        for(int i=0; i<kValues; ++i)
+          buffers[slot][0][i] = submitted + i;
+        pipeline.SubmitFrame();
+        submitted++;
+        continue;
+      }
+      bool ok;
+      const int slot = pipeline.WaitFrame(ok);
+      for(int i=0; i<kValues; ++i){
+        if(!ok || buffers[slot][n][i] != Expected(done, i, n)){
+          printf("depth %d : frame %d is wrong\n", depth, done);
+          return 1;
+        }
+      }
+      pipeline.ReleaseFrame();
+      done++;
+    }
+    const double fps = frames * 1e6 / (NowUs() - begin);
+    char mode[16];
+    snprintf(mode, sizeof(mode), "depth %d", depth);
+    printf("%-12s %10.1f %10.2f\n", mode, fps, fps / sequential_fps);
+  }
+  return 0;
+}
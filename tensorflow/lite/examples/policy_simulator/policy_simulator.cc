@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "tensorflow/lite/tf_policy.h"
+
+// Replays recorded per-subgraph latencies of runtimes under each scheduling
+// policy of TfScheduler and compares their deadline-miss rates.
+//
+// Usage : policy_simulator <trace> [duration_s] [lease_ms]
+//
+// Trace is a text file of lines below, '#' starts a comment.
+//   resource <cpu|gpu> <slots>
+//   runtime <name> <period_ms> <deadline_ms> <priority> <weight>
+//   subgraph <runtime name> <cpu|gpu> <latency_ms> [latency_ms ...]
+// A resource runs as many subgraphs at once as its slots, 1 by default.
+// Subgraphs of a runtime are invoked in the order of lines. A subgraph with
+// several latencies uses them in turn, one per frame. Period 0 releases the
+// next frame when the last one is done, deadline 0 has no deadline.
+//
+// Resources are arbitrated with the rules of TfScheduler. A runtime leases
+// a slot of every resource left in its frame if all of them have one free
+// and nobody waits, otherwise it asks per subgraph. A lease ends at the end
+// of frame, after 'lease_ms' or when a waiter preempts it, always at a
+// subgraph boundary.
+
+using namespace tflite;
+
+namespace {
+
+constexpr int kResources = 2; // cpu, gpu
+const char* kPolicies[] = {"priority", "edf", "fair"};
+
+typedef struct SimSubgraph{
+  int resource;
+  std::vector<int64_t> latency_us;
+}SimSubgraph;
+
+typedef struct SimPool{
+  int capacity = 1;
+  std::vector<tf_request> owners;
+  std::vector<tf_request> waiting;
+}SimPool;
+
+typedef struct SimRuntime{
+  // Trace
+  std::string name;
+  int64_t period_us = 0;
+  int64_t deadline_us = 0;
+  int priority = 0;
+  int weight = 1;
+  std::vector<SimSubgraph> subgraphs;
+
+  // State
+  std::deque<int64_t> released; // release time of frames not started.
+  bool running = false;
+  int frame = 0;
+  int64_t frame_release = 0;
+  int cur_subgraph = 0;
+  int lease_resources = 0;
+  int64_t lease_end = 0;
+  bool lease_revoked = false;
+
+  // Result
+  int misses = 0;
+  std::vector<int64_t> response_us;
+}SimRuntime;
+
+typedef struct SimEvent{
+  int64_t time;
+  int64_t seq; // keeps the order of events at the same time.
+  int runtime;
+  bool frame_release; // otherwise a subgraph is done.
+  bool operator>(const SimEvent& other) const {
+    return time != other.time ? time > other.time : seq > other.seq;
+  }
+}SimEvent;
+
+class Simulator{
+  public:
+    Simulator(const std::vector<SimRuntime>& trace, const int* capacity,
+              TfSchedulingPolicy* policy, int64_t lease_us)
+        : runtimes(trace), policy(policy), lease_us(lease_us) {
+      for(int r=0; r<kResources; ++r)
+        pools[r].capacity = capacity[r];
+    }
+
+    void Run(int64_t duration_us){
+      for(size_t i=0; i<runtimes.size(); ++i)
+        Push(0, i, true);
+      while(!events.empty() && events.top().time < duration_us){
+        SimEvent event = events.top();
+        events.pop();
+        now = event.time;
+        if(event.frame_release)
+          ReleaseFrame(event.runtime);
+        else
+          FinishSubgraph(event.runtime);
+      }
+    }
+
+    const std::vector<SimRuntime>& Result() const { return runtimes; }
+
+  private:
+    void Push(int64_t time, int runtime, bool frame_release){
+      events.push({time, seq++, runtime, frame_release});
+    }
+
+    void ReleaseFrame(int id){
+      SimRuntime& runtime = runtimes[id];
+      runtime.released.push_back(now);
+      if(runtime.period_us > 0)
+        Push(now + runtime.period_us, id, true);
+      if(!runtime.running)
+        StartFrame(id);
+    }
+
+    void StartFrame(int id){
+      SimRuntime& runtime = runtimes[id];
+      runtime.running = true;
+      runtime.frame_release = runtime.released.front();
+      runtime.released.pop_front();
+      runtime.cur_subgraph = 0;
+      StartSubgraph(id);
+    }
+
+    tf_request Request(int id){
+      const SimRuntime& runtime = runtimes[id];
+      tf_request request;
+      request.runtime_id = id;
+      request.priority = runtime.priority;
+      request.weight = runtime.weight;
+      request.arrival_us = now;
+      request.deadline_us = runtime.deadline_us > 0 ?
+          runtime.frame_release + runtime.deadline_us : 0;
+      return request;
+    }
+
+    void StartSubgraph(int id){
+      SimRuntime& runtime = runtimes[id];
+      const int resource = runtime.subgraphs[runtime.cur_subgraph].resource;
+      if(runtime.lease_resources != 0){
+        if((runtime.lease_resources & (1 << resource)) &&
+            !runtime.lease_revoked && now < runtime.lease_end){
+          Execute(id);
+          return;
+        }
+        EndLease(id);
+      }
+      tf_request request = Request(id);
+      int lease_resources = 0;
+      for(size_t i=runtime.cur_subgraph; i<runtime.subgraphs.size(); ++i)
+        lease_resources |= 1 << runtime.subgraphs[i].resource;
+      if(TryLease(request, lease_resources)){
+        runtime.lease_resources = lease_resources;
+        runtime.lease_end = now + lease_us;
+        runtime.lease_revoked = false;
+        Execute(id);
+      }else if(HasFreeSlot(resource) && pools[resource].waiting.empty()){
+        Grant(resource, request);
+      }else{
+        pools[resource].waiting.push_back(request);
+        // Revoke one lease on the resource.
+        for(const tf_request& owner : pools[resource].owners){
+          SimRuntime& holder = runtimes[owner.runtime_id];
+          if((holder.lease_resources & (1 << resource)) &&
+              !holder.lease_revoked && policy->ShouldPreempt(request, owner)){
+            holder.lease_revoked = true;
+            break;
+          }
+        }
+      }
+    }
+
+    bool HasFreeSlot(int resource){
+      return static_cast<int>(pools[resource].owners.size()) <
+             pools[resource].capacity;
+    }
+
+    bool TryLease(const tf_request& request, int lease_resources){
+      for(int r=0; r<kResources; ++r){
+        if((lease_resources & (1 << r)) &&
+            (!HasFreeSlot(r) || !pools[r].waiting.empty()))
+          return false;
+      }
+      for(int r=0; r<kResources; ++r){
+        if(!(lease_resources & (1 << r)))
+          continue;
+        pools[r].owners.push_back(request);
+        pools[r].owners.back().granted_us = now;
+      }
+      return true;
+    }
+
+    void Grant(int resource, const tf_request& request){
+      pools[resource].owners.push_back(request);
+      pools[resource].owners.back().granted_us = now;
+      Execute(request.runtime_id);
+    }
+
+    void Execute(int id){
+      SimRuntime& runtime = runtimes[id];
+      const std::vector<int64_t>& latency =
+          runtime.subgraphs[runtime.cur_subgraph].latency_us;
+      Push(now + latency[runtime.frame % latency.size()], id, false);
+    }
+
+    void Release(int resource, int id){
+      std::vector<tf_request>& owners = pools[resource].owners;
+      for(auto it = owners.begin(); it != owners.end(); ++it){
+        if(it->runtime_id == id){
+          policy->OnRelease(*it, now - it->granted_us);
+          owners.erase(it);
+          return;
+        }
+      }
+    }
+
+    void EndLease(int id){
+      SimRuntime& runtime = runtimes[id];
+      for(int r=0; r<kResources; ++r){
+        if(runtime.lease_resources & (1 << r))
+          Release(r, id);
+      }
+      runtime.lease_resources = 0;
+      GrantWaiting();
+    }
+
+    void GrantWaiting(){
+      for(int r=0; r<kResources; ++r){
+        std::vector<tf_request>& waiting = pools[r].waiting;
+        while(HasFreeSlot(r) && !waiting.empty()){
+          const int next = policy->PickNext(waiting);
+          tf_request request = waiting[next];
+          waiting.erase(waiting.begin() + next);
+          Grant(r, request);
+        }
+      }
+    }
+
+    void FinishSubgraph(int id){
+      SimRuntime& runtime = runtimes[id];
+      if(runtime.lease_resources == 0){
+        Release(runtime.subgraphs[runtime.cur_subgraph].resource, id);
+        GrantWaiting();
+      }
+      if(++runtime.cur_subgraph < static_cast<int>(runtime.subgraphs.size())){
+        StartSubgraph(id);
+        return;
+      }
+      // End of frame
+      if(runtime.lease_resources != 0)
+        EndLease(id);
+      const int64_t response = now - runtime.frame_release;
+      runtime.response_us.push_back(response);
+      if(runtime.deadline_us > 0 && response > runtime.deadline_us)
+        runtime.misses++;
+      runtime.frame++;
+      runtime.running = false;
+      if(runtime.period_us == 0)
+        Push(now, id, true);
+      else if(!runtime.released.empty())
+        StartFrame(id);
+    }
+
+    std::vector<SimRuntime> runtimes;
+    TfSchedulingPolicy* policy;
+    int64_t lease_us;
+
+    std::priority_queue<SimEvent, std::vector<SimEvent>,
+                        std::greater<SimEvent>> events;
+    int64_t seq = 0;
+    int64_t now = 0;
+
+    SimPool pools[kResources];
+};
+
+int64_t MsToUs(double ms){
+  return static_cast<int64_t>(ms * 1000);
+}
+
+bool ReadTrace(const char* path, std::vector<SimRuntime>& runtimes,
+               int* capacity){
+  std::ifstream file(path);
+  if(!file.is_open()){
+    std::cout << "Cannot open trace " << path << "\n";
+    return false;
+  }
+  std::map<std::string, int> index;
+  std::string line;
+  for(int line_number=1; std::getline(file, line); ++line_number){
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    std::string kind, name;
+    if(!(fields >> kind))
+      continue;
+    if(!(fields >> name)){
+      std::cout << "Missing name at line " << line_number << "\n";
+      return false;
+    }
+    if(kind == "resource"){
+      int slots;
+      if((name != "cpu" && name != "gpu") || !(fields >> slots) || slots < 1){
+        std::cout << "Bad resource at line " << line_number << "\n";
+        return false;
+      }
+      capacity[name == "gpu" ? 1 : 0] = slots;
+    }else if(kind == "runtime"){
+      SimRuntime runtime;
+      double period_ms, deadline_ms;
+      if(!(fields >> period_ms >> deadline_ms >> runtime.priority
+                  >> runtime.weight) || index.count(name) != 0){
+        std::cout << "Bad runtime at line " << line_number << "\n";
+        return false;
+      }
+      runtime.name = name;
+      runtime.period_us = MsToUs(period_ms);
+      runtime.deadline_us = MsToUs(deadline_ms);
+      index[name] = runtimes.size();
+      runtimes.push_back(runtime);
+    }else if(kind == "subgraph"){
+      SimSubgraph subgraph;
+      std::string resource;
+      fields >> resource;
+      subgraph.resource = resource == "gpu" ? 1 : 0;
+      double latency_ms;
+      while(fields >> latency_ms)
+        subgraph.latency_us.push_back(MsToUs(latency_ms));
+      if(index.count(name) == 0 || (resource != "cpu" && resource != "gpu") ||
+          subgraph.latency_us.empty()){
+        std::cout << "Bad subgraph at line " << line_number << "\n";
+        return false;
+      }
+      runtimes[index[name]].subgraphs.push_back(subgraph);
+    }else{
+      std::cout << "Unknown line " << kind << " at " << line_number << "\n";
+      return false;
+    }
+  }
+  for(const SimRuntime& runtime : runtimes){
+    if(runtime.subgraphs.empty()){
+      std::cout << "Runtime " << runtime.name << " has no subgraph" << "\n";
+      return false;
+    }
+  }
+  return !runtimes.empty();
+}
+
+void PrintResult(const char* policy, const std::vector<SimRuntime>& runtimes){
+  for(const SimRuntime& runtime : runtimes){
+    std::vector<int64_t> response = runtime.response_us;
+    std::sort(response.begin(), response.end());
+    double sum = 0;
+    for(int64_t r : response)
+      sum += r;
+    const int frames = response.size();
+    printf("%-8s %-12s frames %6d  miss %6d (%5.1f%%)  avg %8.2f ms  "
+           "p99 %8.2f ms\n",
+           policy, runtime.name.c_str(), frames, runtime.misses,
+           frames == 0 ? 0.0 : runtime.misses * 100.0 / frames,
+           frames == 0 ? 0.0 : sum / frames / 1000,
+           frames == 0 ? 0.0 : response[frames * 99 / 100] / 1000.0);
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+  if(argc < 2){
+    std::cout << "Usage : policy_simulator <trace> [duration_s] [lease_ms]"
+              << "\n";
+    return 1;
+  }
+  double duration_s = argc > 2 ? atof(argv[2]) : 10;
+  double lease_ms = argc > 3 ? atof(argv[3]) : 50;
+  std::vector<SimRuntime> trace;
+  int capacity[kResources] = {1, 1};
+  if(!ReadTrace(argv[1], trace, capacity))
+    return 1;
+  for(const char* name : kPolicies){
+    TfSchedulingPolicy* policy = CreateSchedulingPolicy(name);
+    Simulator simulator(trace, capacity, policy, MsToUs(lease_ms));
+    simulator.Run(MsToUs(duration_s * 1000));
+    PrintResult(name, simulator.Result());
+    delete policy;
+  }
+  return 0;
+}
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include "tensorflow/lite/tf_preprocess.h"
+
+// Latency of converting a camera frame into the float input of a model and
+// the uint8 input of its quantized pair(co-execution).
+//
+// Usage : preprocess_benchmark [iterations] [threads]
+//
+// 'scalar' converts, resizes, normalizes and quantizes pixel by pixel, as the
+// input path before TfPreprocessor. 'tf N' is TfPreprocessor with N threads,
+// its outputs are checked against the scalar ones.
+
+using namespace tflite;
+
+namespace {
+
+struct Case{
+  const char* name;
+  TfPixelFormat format;
+  int frame_width;
+  int frame_height;
+  int width;
+  int height;
+};
+
+const Case kCases[] = {
+  {"bgr8 640x480 -> 224", TF_PIXEL_BGR8, 640, 480, 224, 224},
+  {"nv12 1280x720 -> 224", TF_PIXEL_NV12, 1280, 720, 224, 224},
+  {"yuyv 1280x720 -> 224", TF_PIXEL_YUYV, 1280, 720, 224, 224},
+  {"nv12 1920x1080 -> 300", TF_PIXEL_NV12, 1920, 1080, 300, 300},
+  {"bgr8 160x120 -> 224", TF_PIXEL_BGR8, 160, 120, 224, 224},
+};
+
+// MobileNet, [-1, 1] in float and uint8 of scale 1/128, zero point 128.
+const float kQuantScale = 1.0f / 128;
+const int kQuantZeroPoint = 128;
+
+double ElapsedUs(struct timespec& begin, struct timespec& end){
+  return (end.tv_sec - begin.tv_sec) * 1e6 +
+         (end.tv_nsec - begin.tv_nsec) / 1e3;
+}
+
+double Median(std::vector<double> samples){
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+void ScalarRgb(const TfFrame& frame, int x, int y, float rgb[3]){
+  auto clamp = [](int value){ return std::min(std::max(value, 0), 255); };
+  auto yuv = [&](int Y, int U, int V){
+    const int c = 298 * (Y - 16) + 128;
+    rgb[0] = clamp((c + 409 * (V - 128)) >> 8);
+    rgb[1] = clamp((c - 100 * (U - 128) - 208 * (V - 128)) >> 8);
+    rgb[2] = clamp((c + 516 * (U - 128)) >> 8);
+  };
+  const uint8_t* row = frame.data + y * frame.stride;
+  switch(frame.format){
+    case TF_PIXEL_BGR8:
+      rgb[0] = row[x * 3 + 2];
+      rgb[1] = row[x * 3 + 1];
+      rgb[2] = row[x * 3];
+      break;
+    case TF_PIXEL_NV12:{
+      const uint8_t* uv = frame.uv + (y / 2) * frame.uv_stride + (x / 2) * 2;
+      yuv(row[x], uv[0], uv[1]);
+      break;
+    }
+    case TF_PIXEL_YUYV:
+      yuv(row[x * 2], row[(x / 2) * 4 + 1], row[(x / 2) * 4 + 3]);
+      break;
+  }
+}
+
+void ScalarPreprocess(const TfFrame& frame, const TfNormalization& norm,
+                      int width, int height, float* out, uint8_t* quant){
+  for(int y=0; y<height; ++y){
+    float sy = std::max((y + 0.5f) * frame.height / height - 0.5f, 0.0f);
+    const int y0 = std::min(static_cast<int>(sy), frame.height - 1);
+    const int y1 = std::min(y0 + 1, frame.height - 1);
+    const float fy = sy - y0;
+    for(int x=0; x<width; ++x){
+      float sx = std::max((x + 0.5f) * frame.width / width - 0.5f, 0.0f);
+      const int x0 = std::min(static_cast<int>(sx), frame.width - 1);
+      const int x1 = std::min(x0 + 1, frame.width - 1);
+      const float fx = sx - x0;
+      float p00[3], p01[3], p10[3], p11[3];
+      ScalarRgb(frame, x0, y0, p00);
+      ScalarRgb(frame, x1, y0, p01);
+      ScalarRgb(frame, x0, y1, p10);
+      ScalarRgb(frame, x1, y1, p11);
+      for(int c=0; c<3; ++c){
+        const float top = p00[c] + (p01[c] - p00[c]) * fx;
+        const float bottom = p10[c] + (p11[c] - p10[c]) * fx;
+        const float value = ((top + (bottom - top) * fy) - norm.mean[c]) /
+                            norm.std[c];
+        const int i = (y * width + x) * 3 + c;
+        out[i] = value;
+        quant[i] = std::min(255, std::max(0,
+            static_cast<int>(std::round(value / kQuantScale)) +
+            kQuantZeroPoint));
+      }
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+  const int iterations = argc > 1 ? std::max(1, atoi(argv[1])) : 50;
+  const int max_threads = argc > 2 ? std::max(1, atoi(argv[2])) : 4;
+  TfNormalization norm;
+  for(int c=0; c<3; ++c){
+    norm.mean[c] = 127.5f;
+    norm.std[c] = 127.5f;
+  }
+
+  printf("float32 + uint8 output, %d iterations, median us\n", iterations);
+  printf("%-24s %9s", "case", "scalar");
+  for(int threads=1; threads<=max_threads; threads *= 2)
+    printf("   tf %-3d", threads);
+  printf("\n");
+  for(const Case& test : kCases){
+    // Frame of random pixels, packed rows with some padding.
+    std::vector<uint8_t> pixels, uv;
+    TfFrame frame;
+    frame.format = test.format;
+    frame.width = test.frame_width;
+    frame.height = test.frame_height;
+    const int bytes_per_pixel = test.format == TF_PIXEL_BGR8 ? 3 :
+                                test.format == TF_PIXEL_YUYV ? 2 : 1;
+    frame.stride = test.frame_width * bytes_per_pixel + 32;
+    pixels.resize(frame.stride * frame.height);
+    srand(1);
+    for(uint8_t& v : pixels)
+      v = rand() % 256;
+    frame.data = pixels.data();
+    if(test.format == TF_PIXEL_NV12){
+      frame.uv_stride = test.frame_width + 32;
+      uv.resize(frame.uv_stride * ((frame.height + 1) / 2));
+      for(uint8_t& v : uv)
+        v = rand() % 256;
+      frame.uv = uv.data();
+    }
+    const int size = test.width * test.height * 3;
+    std::vector<float> reference(size), out(size);
+    std::vector<uint8_t> reference_quant(size), quant(size);
+
+    std::vector<double> samples;
+    struct timespec begin, end;
+    for(int i=0; i<iterations; ++i){
+      clock_gettime(CLOCK_MONOTONIC, &begin);
+      ScalarPreprocess(frame, norm, test.width, test.height, reference.data(),
+                       reference_quant.data());
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      samples.push_back(ElapsedUs(begin, end));
+    }
+    printf("%-24s %9.0f", test.name, Median(samples));
+
+    std::vector<TfPreprocessTarget> targets(2);
+    targets[0].type = TF_PREPROCESS_FLOAT32;
+    targets[0].data = out.data();
+    targets[1].type = TF_PREPROCESS_UINT8;
+    targets[1].data = quant.data();
+    targets[1].scale = kQuantScale;
+    targets[1].zero_point = kQuantZeroPoint;
+    for(int threads=1; threads<=max_threads; threads *= 2){
+      TfPreprocessor preprocessor(threads);
+      samples.clear();
+      for(int i=0; i<iterations; ++i){
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        if(!preprocessor.Run(frame, norm, test.width, test.height, targets)){
+          printf("\n%s : invalid frame\n", test.name);
+          return 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        samples.push_back(ElapsedUs(begin, end));
+      }
+      for(int i=0; i<size; ++i){
+        // Rounding of a value on .5 may differ by the order of operations.
+        if(std::fabs(out[i] - reference[i]) > 1e-4f ||
+            std::abs(quant[i] - reference_quant[i]) > 1){
+          printf("\n%s : output %d differs, %f(%d) vs %f(%d)\n", test.name, i,
+                 out[i], quant[i], reference[i], reference_quant[i]);
+          return 1;
+        }
+      }
+      printf(" %8.0f", Median(samples));
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "tensorflow/lite/tf_policy.h"
+#include "tensorflow/lite/tf_stats.h"
+
+// Prints the telemetry of a running TfScheduler from its stats file, without
+// a message to the scheduler. Start the scheduler with TF_SCHEDULER_STATS set
+// to the file.
+//
+// Usage : scheduler_stats <stats file> [interval_s]
+//
+// Prints once, or every 'interval_s' until interrupted. Latencies are in us,
+// p50 and p99 are the upper bounds of their histogram buckets.
+
+using namespace tflite;
+
+namespace {
+
+const char* kResourceNames[TF_STATS_RESOURCES] = {"cpu", "gpu", "cpu_b"};
+
+void PrintLatency(const char* name, const tf_histogram& histogram){
+  if(histogram.count == 0)
+    return;
+  printf("  %-12s n %-9llu avg %-7llu p50 %-7llu p99 %-7llu max %llu\n", name,
+         (unsigned long long)histogram.count,
+         (unsigned long long)(histogram.sum / histogram.count),
+         (unsigned long long)LatencyPercentile(histogram, 0.5),
+         (unsigned long long)LatencyPercentile(histogram, 0.99),
+         (unsigned long long)histogram.max);
+}
+
+void PrintStats(TfStatsReader* reader){
+  // Copies are large, keep them off the stack.
+  static tf_resource_stats resource;
+  static tf_runtime_stats runtime;
+  const double uptime_us = PolicyNowUs() - reader->StartUs();
+  printf("==== uptime %.1f s\n", uptime_us / 1000000);
+  for(int i=0; i<TF_STATS_RESOURCES; ++i){
+    reader->ReadResource(i, resource);
+    printf("resource %s slots %d grants %llu blocked %llu max waiting %d "
+           "busy %.1f%%\n", kResourceNames[i], resource.capacity,
+           (unsigned long long)resource.grants,
+           (unsigned long long)resource.blocked, resource.max_waiting,
+           uptime_us > 0 ? 100.0 * resource.busy_us /
+                           (uptime_us * resource.capacity) : 0.0);
+    PrintLatency("grant wait", resource.grant_wait);
+    PrintLatency("hold", resource.hold);
+  }
+  for(int i=0; i<TF_STATS_MAX_RUNTIMES; ++i){
+    reader->ReadRuntime(i, runtime);
+    if(runtime.runtime_id == -1)
+      continue;
+    printf("runtime %d%s requests %llu grants %llu blocked %llu leases %llu "
+           "revokes %llu deadline misses %llu\n", runtime.runtime_id,
+           runtime.active ? "" : " (left)",
+           (unsigned long long)runtime.requests,
+           (unsigned long long)runtime.grants,
+           (unsigned long long)runtime.blocked,
+           (unsigned long long)runtime.leases,
+           (unsigned long long)runtime.revokes,
+           (unsigned long long)runtime.deadline_misses);
+    PrintLatency("grant wait", runtime.grant_wait);
+    PrintLatency("exec", runtime.exec);
+    PrintLatency("lease hold", runtime.lease_hold);
+    for(int j=0; j<TF_STATS_MAX_SUBGRAPHS; ++j){
+      char name[16];
+      snprintf(name, sizeof(name), "subgraph %d", j);
+      PrintLatency(name, runtime.subgraph_exec[j]);
+    }
+  }
+  fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+  if(argc < 2){
+    printf("Usage : %s <stats file> [interval_s]\n", argv[0]);
+    return 1;
+  }
+  TfStatsReader* reader = TfStatsReader::Open(argv[1]);
+  if(reader == nullptr)
+    return 1;
+  const int interval_s = argc > 2 ? atoi(argv[2]) : 0;
+  PrintStats(reader);
+  while(interval_s > 0){
+    sleep(interval_s);
+    PrintStats(reader);
+  }
+  delete reader;
+  return 0;
+}
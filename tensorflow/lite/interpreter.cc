@@ -659,83 +659,64 @@ TfLiteStatus Interpreter::ModifyGraphWithDelegate(TfLiteDelegate* delegate) {
 }
 
 TfLiteStatus Interpreter::ModifyGraphWithDelegateImpl(int graph_id){
-  TfLiteStatus status = kTfLiteOk;
-  std::cout << "graph_id : " << graph_id <<"\n";
-  // for main_interpreter
-  if(!delegate_provided_v.empty() && delegate_provided_v.size() == 2){
-    std::cout << "resource type : " << subgraph_id(graph_id)->GetResourceType() <<"\n";
-    switch(graph_id){
-      case 1:
-        if(subgraph_id(graph_id)->GetResourceType() == ResourceType::GPU ||
-            subgraph_id(graph_id)->GetResourceType() == ResourceType::CO_GPU)
-          status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_v.at(0));
-        break;
-      case 2:
-        if(subgraph_id(graph_id)->GetResourceType() == ResourceType::GPU ||
-            subgraph_id(graph_id)->GetResourceType() == ResourceType::CO_GPU)
-          status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_v.at(0));
-      case 3:
-        if(subgraph_id(graph_id)->GetResourceType() == ResourceType::GPU ||
-            subgraph_id(graph_id)->GetResourceType() == ResourceType::CO_GPU)
-          status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_v.at(0));
-      case 4:
-        if(subgraph_id(graph_id)->GetResourceType() == ResourceType::GPU ||
-            subgraph_id(graph_id)->GetResourceType() == ResourceType::CO_GPU)
-          status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_v.at(0));
-      case 5:
-        if(subgraph_id(graph_id)->GetResourceType() == ResourceType::GPU ||
-            subgraph_id(graph_id)->GetResourceType() == ResourceType::CO_GPU)
-          status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_v.at(0));
-        break;
-      case 6:
-        if(subgraph_id(graph_id)->GetResourceType() == ResourceType::GPU ||
-            subgraph_id(graph_id)->GetResourceType() == ResourceType::CO_GPU)
-          status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_v.at(0));
-      case 7:
-        if(subgraph_id(graph_id)->GetResourceType() == ResourceType::GPU ||
-            subgraph_id(graph_id)->GetResourceType() == ResourceType::CO_GPU)
-          status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_v.at(0));
-      case 8:
-        if(subgraph_id(graph_id)->GetResourceType() == ResourceType::GPU ||
-            subgraph_id(graph_id)->GetResourceType() == ResourceType::CO_GPU)
-          status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_v.at(0));
-      default:
-        break;
-    } 
-  }
-  // for quantized_interpreter
-  else if(!delegate_provided_v.empty() && delegate_provided_v.size() == 1){
-    std::cout << "resource type : " << subgraph_id(graph_id)->GetResourceType() <<"\n";
-    switch(graph_id){
-      case 1:
-        if(subgraph_id(graph_id)->GetResourceType() == ResourceType::CO_CPU)
-          status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_v.at(0));
-        break;
-      case 2:
-        if(subgraph_id(graph_id)->GetResourceType() == ResourceType::CO_CPU)
-          status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_v.at(0));
-        break;
-      case 3:
-        if(subgraph_id(graph_id)->GetResourceType() == ResourceType::CO_CPU)
-          status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_v.at(0));
-        break;
-      default:
-        break;
-    } 
-  }
-  else if(delegate_provided_ != nullptr){
-    status = subgraph_id(graph_id)->ModifyGraphWithDelegate(delegate_provided_);
-  }
-  else{
+  Subgraph* subgraph = subgraph_id(graph_id);
+  if(subgraph == nullptr)
+    return kTfLiteError;
+  const ResourceType type = subgraph->GetResourceType();
+  std::cout << "graph_id : " << graph_id << " resource type : " << type
+            << "\n";
+  // Delegate of the subgraph by its resource, nullptr if it runs on the
+  // builtin kernels.
+  TfLiteDelegate* delegate = nullptr;
+  if(type == ResourceType::CPU){
+    delegate = cpu_delegate_;
+  }else if(delegate_provided_v.size() == 2){ // for main_interpreter
+    if(type == ResourceType::GPU || type == ResourceType::CO_GPU)
+      delegate = delegate_provided_v.at(0);
+    // CPU cluster B, second delegate of CPU-cluster co-execution.
+    else if(type == ResourceType::CPU_B)
+      delegate = delegate_provided_v.at(1);
+  }else if(delegate_provided_v.size() == 1){ // for quantized_interpreter
+    if(type == ResourceType::CO_CPU)
+      delegate = delegate_provided_v.at(0);
+  }else if(delegate_provided_ != nullptr){
+    delegate = delegate_provided_;
+  }else{
     std::cout << "No delegate exists in this interpreter" << "\n";
     return kTfLiteError;
   }
-  if(status != kTfLiteOk)
-    return status;
-  return status;
+  if(delegate == nullptr)
+    return kTfLiteOk;
+  return subgraph->ModifyGraphWithDelegate(delegate);
 }
 
 // Minsung
+TfLiteStatus Interpreter::ModifySubgraphWithDelegate(int graph_id,
+                                                     TfLiteDelegate* delegate){
+  Subgraph* subgraph = subgraph_id(graph_id);
+  if(subgraph == nullptr || delegate == nullptr)
+    return kTfLiteError;
+  if(subgraph->ModifyGraphWithDelegate(delegate) != kTfLiteOk)
+    return kTfLiteError;
+  return subgraph->AllocateTensors();
+}
+
+TfLiteStatus Interpreter::RemoveDelegatesOfSubgraph(int graph_id){
+  Subgraph* subgraph = subgraph_id(graph_id);
+  if(subgraph == nullptr)
+    return kTfLiteError;
+  TF_LITE_ENSURE_STATUS(subgraph->RemoveAllDelegates());
+  // Delegate kernels leave their mark on output tensors, which blocks
+  // delegating them again with another delegate.
+  for(int i=0; i<subgraph->tensors_size(); ++i){
+    TfLiteTensor* tensor = subgraph->tensor(i);
+    tensor->delegate = nullptr;
+    tensor->buffer_handle = kTfLiteNullBufferHandle;
+    tensor->data_is_stale = false;
+  }
+  return subgraph->AllocateTensors();
+}
+
 TfLiteStatus Interpreter::RegisterDelegate(TfLiteDelegate* delegate){
   delegate_provided_  = delegate;
   is_gpu_delegate_prepared = true;
@@ -750,6 +731,19 @@ TfLiteStatus Interpreter::RegisterDelegate(std::vector<TfLiteDelegate*> delegate
   return kTfLiteOk;
 }
 
+TfLiteStatus Interpreter::RegisterCpuDelegate(TfLiteDelegate* delegate){
+  cpu_delegate_ = delegate;
+  return kTfLiteOk;
+}
+
+TfLiteStatus Interpreter::RegisterDelegatesOf(const Interpreter& other){
+  delegate_provided_ = other.delegate_provided_;
+  delegate_provided_v = other.delegate_provided_v;
+  cpu_delegate_ = other.cpu_delegate_;
+  is_gpu_delegate_prepared = other.is_gpu_delegate_prepared;
+  return kTfLiteOk;
+}
+
 TfLiteStatus Interpreter::RemoveAllDelegates() {
   for (auto& subgraph : subgraphs_) {
     TF_LITE_ENSURE_STATUS(subgraph->RemoveAllDelegates());
@@ -826,16 +820,6 @@ tflite::Subgraph* Interpreter::CreateSubgraph(){
 TfLiteStatus Interpreter::CreateWorker(ResourceType wType, int cpu_num){
 }
 
-// thread_safety
-void Interpreter::FeedInputToWorkerI(){
-  if(!mnist_input.empty()){
-    workers[0]->inputs = imagenet_input;
-  }
-  if(!mnist_input.empty()){
-    workers[1]->inputs = imagenet_input;
-  }
-}
-
 TfLiteTensor* Interpreter::input_tensor_of_model(int model_id){
   for(auto subgraph_subset : subgraph_subsets){
     if(subgraph_subset.first == model_id){
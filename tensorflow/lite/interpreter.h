@@ -481,9 +481,19 @@ class Interpreter {
   TfLiteStatus DelegateSubsetofSubgraphs();
 
   // Minsung
-  // Modifies specific subgraphs with given ids with given delegate.
+  // Modifies the subgraph of given id with the registered delegate of its
+  // resource type, if any.
   TfLiteStatus ModifyGraphWithDelegateImpl(int graph_id);
 
+  // Modifies a subgraph of given id with given delegate.
+  // Used to profile the original subgraph on delegated resources.
+  TfLiteStatus ModifySubgraphWithDelegate(int graph_id,
+                                          TfLiteDelegate* delegate);
+
+  // Removes all delegates applied to a subgraph of given id and makes it
+  // invokable again.
+  TfLiteStatus RemoveDelegatesOfSubgraph(int graph_id);
+
   // Minsung
   // Register given delegate object to this interpreter.
   // Currently only one deldegate.
@@ -496,6 +506,14 @@ class Interpreter {
   // sj
   std::vector<TfLiteDelegate*> delegate_provided_v;
 
+  // Registers the delegate of CPU subgraphs. They run on the builtin
+  // kernels if none.
+  TfLiteStatus RegisterCpuDelegate(TfLiteDelegate* delegate);
+
+  // Registers the delegates of 'other' to this interpreter, so that
+  // an interpreter of same model is delegated the same way.
+  TfLiteStatus RegisterDelegatesOf(const Interpreter& other);
+
   // Owning handle to a TfLiteDelegate instance.
   using TfLiteDelegatePtr =
       std::unique_ptr<TfLiteDelegate, void (*)(TfLiteDelegate*)>;
@@ -760,8 +778,6 @@ class Interpreter {
   // Creates a new worker of given type
   TfLiteStatus CreateWorker(ResourceType wType, int cpu_num);
 
-  void FeedInputToWorkerI();
-
   // Do invoke
   TfLiteStatus DoInvoke();
 
@@ -786,9 +802,6 @@ class Interpreter {
   int GetJobNum();
 
   Job* GetJob();
-
-  std::vector<cv::Mat> mnist_input;
-  std::vector<cv::Mat> imagenet_input;
   
 #endif  // DOXYGEN_SKIP
 
@@ -910,6 +923,7 @@ class Interpreter {
   // Minsung
   // Delegate
   TfLiteDelegate* delegate_provided_ = nullptr;
+  TfLiteDelegate* cpu_delegate_ = nullptr;
 
   int test_value = 0;
   // Minsung
@@ -117,6 +117,43 @@ TfLiteStatus ParseSparseIndexVector(const DimensionMetadata* src,
   return kTfLiteError;
 }
 
+bool IsHeightPartitioningRatio(int ratio) { return ratio > 10; }
+
+// Layer split with GPU, or between CPU clusters.
+bool IsCoExecutionPlan(int resource) {
+  return resource == TF_P_PLAN_CO_E || resource == TF_P_PLAN_CO_CPU;
+}
+
+// Splits co-execution subsets where the per-layer partitioning ratio changes.
+// A height partitioned subgraph can't change its split without exchanging
+// rows, so each run of the same height ratio becomes a co-execution pair of
+// its own. Channel partitioned layers keep their ratio in a single subgraph.
+void SplitCoExecutionSubsets(ProfileData* profile) {
+  ProfileData split;
+  for (int i = 0; i < profile->layer_subsets.size(); ++i) {
+    const std::vector<int>& layers = profile->layer_subsets[i];
+    const std::vector<int>& ratios = profile->partitioning_ratios[i];
+    for (int j = 0; j < layers.size(); ++j) {
+      bool new_subset = j == 0;
+      if (!new_subset && IsCoExecutionPlan(profile->subset_resource[i]) &&
+          ratios[j] != ratios[j - 1]) {
+        new_subset = IsHeightPartitioningRatio(ratios[j]) ||
+                     IsHeightPartitioningRatio(ratios[j - 1]);
+      }
+      if (new_subset) {
+        split.layer_subsets.push_back(std::vector<int>());
+        split.partitioning_ratios.push_back(std::vector<int>());
+        split.subset_resource.push_back(profile->subset_resource[i]);
+      }
+      split.layer_subsets.back().push_back(layers[j]);
+      split.partitioning_ratios.back().push_back(ratios[j]);
+    }
+  }
+  profile->layer_subsets = std::move(split.layer_subsets);
+  profile->partitioning_ratios = std::move(split.partitioning_ratios);
+  profile->subset_resource = std::move(split.subset_resource);
+}
+
 }  // namespace
 
 const char* kEmptyTensorName = "";
@@ -211,24 +248,42 @@ void InterpreterBuilder::CopyRawPartitioningPlan(
                                     std::vector<std::vector<int>>& raw_plan){
   ProfileData* dummy_profile = new ProfileData;
   for(int i=0; i<raw_plan.size(); ++i){
-    if(raw_plan[i][TF_P_IDX_START] != TF_P_END_PLAN){
-      dummy_profile->layer_subsets.push_back(std::vector<int>());
-      dummy_profile->partitioning_ratios.push_back(std::vector<int>());
-      for(int j=raw_plan[i][TF_P_IDX_START]; j<raw_plan[i][TF_P_IDX_END]; ++j){
-        dummy_profile->layer_subsets[i].push_back(j);
+    if(raw_plan[i][TF_P_IDX_START] == TF_P_END_PLAN)
+      break;
+    const int start = raw_plan[i][TF_P_IDX_START];
+    const int end = raw_plan[i][TF_P_IDX_END];
+    const int ratio = raw_plan[i][TF_P_IDX_RATIO];
+    if(raw_plan[i][TF_P_IDX_RESOURCE] == TF_P_PLAN_LAYER_RATIO){
+      // Per-layer ratio of the co-execution subset above.
+      if(dummy_profile->subset_resource.empty() ||
+          !IsCoExecutionPlan(dummy_profile->subset_resource.back())){
+        std::cout << "Layer ratio [" << start << ", " << end 
+                  << ") has no co-execution subset, ignored" << "\n";
+        continue;
       }
-      // MUST FIX TO SUPPORT CO_EXECUTION CPU AND GPU
-      dummy_profile->subset_resource.push_back(
-                              static_cast<ResourceType>(raw_plan[i][TF_P_IDX_RESOURCE]));
-      if(raw_plan[i][TF_P_IDX_RESOURCE] == TF_P_PLAN_CO_E){ // if subset is co-exetution subset
-        dummy_profile->partitioning_ratios[i].push_back(raw_plan[i][TF_P_IDX_RATIO]);
-      }else{
-        dummy_profile->partitioning_ratios[i].push_back(0);
+      const std::vector<int>& layers = dummy_profile->layer_subsets.back();
+      std::vector<int>& ratios = dummy_profile->partitioning_ratios.back();
+      for(int j=0; j<layers.size(); ++j){
+        if(layers[j] >= start && layers[j] < end)
+          ratios[j] = ratio;
       }
-    }else{
-      break;
+      continue;
+    }
+    dummy_profile->layer_subsets.push_back(std::vector<int>());
+    dummy_profile->partitioning_ratios.push_back(std::vector<int>());
+    // MUST FIX TO SUPPORT CO_EXECUTION CPU AND GPU
+    dummy_profile->subset_resource.push_back(
+                            static_cast<ResourceType>(raw_plan[i][TF_P_IDX_RESOURCE]));
+    for(int j=start; j<end; ++j){
+      dummy_profile->layer_subsets.back().push_back(j);
+      // if subset is co-exetution subset, every layer starts with its ratio.
+      if(IsCoExecutionPlan(raw_plan[i][TF_P_IDX_RESOURCE]))
+        dummy_profile->partitioning_ratios.back().push_back(ratio);
+      else
+        dummy_profile->partitioning_ratios.back().push_back(0);
     }
   }
+  SplitCoExecutionSubsets(dummy_profile);
   // Minsung : for multiple partitioning plans
   dummy_profiles_.push_back(dummy_profile);
 }
@@ -568,7 +623,17 @@ TfLiteStatus InterpreterBuilder::CreateSubgraphsFromProfiling(
             }
             new_plan->resource_type = ResourceType::GPU;
             break;
+          case TF_P_PLAN_CPU_B:
+            if(is_sub_interpreter){
+              new_plan->resource_type = ResourceType::NONE;
+              break;
+            }
+            new_plan->resource_type = ResourceType::CPU_B;
+            break;
           case TF_P_PLAN_CO_E:
+          case TF_P_PLAN_CO_CPU:
+            // Same subgraphs, the runtime gives the max precision side to
+            // cluster A instead of GPU.
             if(is_sub_interpreter){
               new_plan->resource_type = ResourceType::CO_CPU;
               break;
@@ -582,11 +647,7 @@ TfLiteStatus InterpreterBuilder::CreateSubgraphsFromProfiling(
           for(int j=0; j<profile[k]->layer_subsets[i].size(); ++j){ //layers 
             new_plan->nodes[j] = profile[k]->layer_subsets[i][j]; 
             std::cout << "Pushed node " << new_plan->nodes[j] << "\n"; 
-            // TODO : Consider better implementation for partitioning ratio per layer. 
-            //        This code applies same partitiong ratio in a whole single subgraph. 
-            if(profile[k]->partitioning_ratios[i][j] != 0){
-              new_plan->partitioning_ratios[j] = profile[k]->partitioning_ratios[i][j];
-            }
+            new_plan->partitioning_ratios[j] = profile[k]->partitioning_ratios[i][j];
           }
           // if(new_plan->resource_type == ResourceType::CO_CPU){
           //   SubgraphPartitioningPlan* new_plan_ = new SubgraphPartitioningPlan;          
@@ -654,22 +715,16 @@ TfLiteStatus InterpreterBuilder::CreateSubgraphsFromProfiling(
         break;
       case ResourceType::CO_CPU:
         new_subgraph->SetResourceType(ResourceType::CO_CPU);
-        new_subgraph->PushPartitioningRatio(
-        master_partitioning_plan[partition_itr]->partitioning_ratios[0]);  
-        if(master_partitioning_plan[partition_itr]->partitioning_ratios[0] > 10)
-          new_subgraph->SetPartitioningType(PartitioningType::HEIGHT_PARTITIONING);
-        else
-          new_subgraph->SetPartitioningType(PartitioningType::CHANNEL_PARTITIONING);
+        PushPartitioningRatios(new_subgraph, master_partitioning_plan[partition_itr]);
         new_subgraph->context()->recommended_num_threads = 6;
         break;
       case ResourceType::CO_GPU:
         new_subgraph->SetResourceType(ResourceType::CO_GPU);
-        new_subgraph->PushPartitioningRatio(
-        master_partitioning_plan[partition_itr]->partitioning_ratios[0]);
-        if(master_partitioning_plan[partition_itr]->partitioning_ratios[0] > 10)
-          new_subgraph->SetPartitioningType(PartitioningType::HEIGHT_PARTITIONING);
-        else
-          new_subgraph->SetPartitioningType(PartitioningType::CHANNEL_PARTITIONING);        
+        PushPartitioningRatios(new_subgraph, master_partitioning_plan[partition_itr]);
+        break;
+      case ResourceType::CPU_B:
+        // Threads of the cluster B delegate.
+        new_subgraph->SetResourceType(ResourceType::CPU_B);
         break;
       default:
         break;
@@ -830,8 +885,8 @@ TfLiteStatus InterpreterBuilder::DelegateSubgraphs(
   for(auto new_subgraph : new_subgraphs){
     if(new_subgraph->GetResourceType() == ResourceType::GPU ||
         new_subgraph->GetResourceType() == ResourceType::CO_GPU ||
-        // sj, consider for subgraph's resource type
-        // new_subgraph->GetResourceType() == ResourceType::CPU ||
+        new_subgraph->GetResourceType() == ResourceType::CPU_B ||
+        new_subgraph->GetResourceType() == ResourceType::CPU ||
         new_subgraph->GetResourceType() == ResourceType::CO_CPU){
       if(interpreter_->ModifyGraphWithDelegateImpl(new_subgraph->GetGraphid())
         != kTfLiteOk){
@@ -843,6 +898,17 @@ TfLiteStatus InterpreterBuilder::DelegateSubgraphs(
   return kTfLiteOk;
 }
 
+void InterpreterBuilder::PushPartitioningRatios(tflite::Subgraph* new_subgraph,
+                                    const SubgraphPartitioningPlan* plan){
+  // One ratio per node, in the order of nodes in subgraph.
+  for(int j=0; j<plan->size; ++j)
+    new_subgraph->PushPartitioningRatio(plan->partitioning_ratios[j]);
+  if(IsHeightPartitioningRatio(plan->partitioning_ratios[0]))
+    new_subgraph->SetPartitioningType(PartitioningType::HEIGHT_PARTITIONING);
+  else
+    new_subgraph->SetPartitioningType(PartitioningType::CHANNEL_PARTITIONING);
+}
+
 TfLiteStatus InterpreterBuilder::PartitionChannels(
                     std::vector<tflite::Subgraph*>& new_subgraphs){
   for(auto new_subgraph : new_subgraphs){
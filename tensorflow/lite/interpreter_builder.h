@@ -128,6 +128,10 @@ class InterpreterBuilder {
 
   void CopyRawPartitioningPlan(std::vector<std::vector<int>>& raw_plan);
 
+  // Pushes per-node partitioning ratios of 'plan' to a co-execution subgraph.
+  void PushPartitioningRatios(tflite::Subgraph* new_subgraph,
+                              const SubgraphPartitioningPlan* plan);
+
   TfLiteStatus PartitionChannels(std::vector<tflite::Subgraph*>& new_subgraphs);
   
  private:
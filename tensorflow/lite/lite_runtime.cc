@@ -1,6 +1,10 @@
 #include "tensorflow/lite/lite_runtime.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "tensorflow/lite/lite_scheduler.h"
+#include "tensorflow/lite/tf_affinity.h"
 
 // #define cpu
 // #define gpu
@@ -60,11 +64,105 @@ std::ostream& operator<<(std::ostream& out, const tflite::RuntimeState value){
 
 namespace tflite {
 
+namespace {
+
+// Returns p-th percentile(0 ~ 1) of given samples, -1 if empty.
+float Percentile(std::vector<float> samples, float p){
+  if(samples.empty())
+    return -1;
+  std::sort(samples.begin(), samples.end());
+  int idx = static_cast<int>(std::ceil(p * samples.size())) - 1;
+  idx = std::min(std::max(idx, 0), static_cast<int>(samples.size()) - 1);
+  return samples[idx];
+}
+
+double ElapsedMs(struct timespec& begin, struct timespec& end){
+  return (end.tv_sec - begin.tv_sec) * 1000.0 +
+         (end.tv_nsec - begin.tv_nsec) / 1000000.0;
+}
+
+// Hashes op codes and tensor types/shapes of 'subgraph' in node order.
+uint64_t HashOpSignature(Subgraph* subgraph, uint64_t seed){
+  uint64_t hash = seed;
+  auto hash_tensors = [&](const TfLiteIntArray* tensors){
+    for(int i=0; i<tensors->size; ++i){
+      const TfLiteTensor* tensor = tensors->data[i] < 0 ?
+                                   nullptr : subgraph->tensor(tensors->data[i]);
+      if(tensor == nullptr){ // optional tensor
+        const int none = -1;
+        hash = HashBytes(&none, sizeof(none), hash);
+        continue;
+      }
+      hash = HashBytes(&tensor->type, sizeof(tensor->type), hash);
+      if(tensor->dims != nullptr)
+        hash = HashBytes(tensor->dims->data, sizeof(int) * tensor->dims->size,
+                         hash);
+    }
+  };
+  for(int i=0; i<subgraph->nodes_size(); ++i){
+    const auto* node_and_registration = subgraph->node_and_registration(i);
+    const TfLiteRegistration& registration = node_and_registration->second;
+    hash = HashBytes(&registration.builtin_code,
+                     sizeof(registration.builtin_code), hash);
+    if(registration.custom_name != nullptr)
+      hash = HashBytes(registration.custom_name,
+                       strlen(registration.custom_name), hash);
+    hash_tensors(node_and_registration->first.inputs);
+    hash_tensors(node_and_registration->first.outputs);
+  }
+  return hash;
+}
+
+// Resource of subgraph in invoke request. CPU, GPU or CPU_B.
+int InvokeResourceOf(Subgraph* subgraph){
+  if(subgraph != nullptr && subgraph->GetResourceType() == ResourceType::GPU)
+    return ResourceType::GPU;
+  if(subgraph != nullptr && subgraph->GetResourceType() == ResourceType::CPU_B)
+    return ResourceType::CPU_B;
+  // Subject to change. (impl CPUGPU Co-execution)
+  return ResourceType::CPU;
+}
+
+// Options which change the latency of a delegate, for the cache key.
+void AddDelegateOptions(std::vector<int>& key,
+                        const TfLiteGpuDelegateOptionsV2& options){
+  key.insert(key.end(), {TF_P_PLAN_GPU, options.is_precision_loss_allowed,
+                         options.inference_preference,
+                         options.inference_priority1,
+                         options.inference_priority2,
+                         options.inference_priority3,
+                         static_cast<int>(options.experimental_flags),
+                         options.max_delegated_partitions});
+}
+
+void AddDelegateOptions(std::vector<int>& key,
+                        const TfLiteXNNPackDelegateOptions& options,
+                        const std::vector<int>& cpus = {}){
+  key.insert(key.end(), {TF_P_PLAN_CPU, options.num_threads,
+                         static_cast<int>(cpus.size())});
+  key.insert(key.end(), cpus.begin(), cpus.end());
+}
+
+// XNNPACK delegate of a CPU cluster. Its pthreadpool threads are created
+// on the cores of the cluster and stay there.
+TfLiteDelegate* CreateClusterDelegate(const CpuClusterOptions& cluster,
+                                      std::vector<int>& key){
+  TfAffinityScope scope(cluster.cpus);
+  TfLiteXNNPackDelegateOptions xnnpack_options =
+      TfLiteXNNPackDelegateOptionsDefault();
+  xnnpack_options.num_threads = cluster.num_threads;
+  AddDelegateOptions(key, xnnpack_options, cluster.cpus);
+  return TfLiteXNNPackDelegateCreate(&xnnpack_options);
+}
+
+} // namespace
+
 TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
                                      const char* model, INPUT_TYPE type) {
   interpreter = new tflite::Interpreter(true);
   quantized_interpreter = nullptr;
   quantized_builder = nullptr;
+  input_type = type;
   interpreter->SetInputType(type);
   state = RuntimeState::INITIALIZE;
   uds_runtime_filename = uds_runtime;
@@ -83,7 +181,9 @@ TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
       .max_delegated_partitions = 1000,
   };
   MyDelegate = TfLiteGpuDelegateV2Create(&options);
+  AddDelegateOptions(delegate_options, options);
   interpreter->RegisterDelegate(MyDelegate);
+  delegate.push_back(MyDelegate); // for profiling
   if(InitializeUDS() != kTfLiteOk){
     std::cout << "UDS socker init ERROR" << "\n";
     exit(-1);
@@ -92,6 +192,8 @@ TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
     std::cout << "Model registration to runtime ERROR" << "\n";
     exit(-1);
   }
+  IdentifyModel(model_id);
+  InitializeCache();
   if(RegisterModeltoScheduler() != kTfLiteOk){
     std::cout << "Model registration to scheduler ERROR" << "\n";
     exit(-1);
@@ -100,7 +202,9 @@ TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
     std::cout << "Model partitioning ERROR" << "\n";
     exit(-1);
   }
-  
+  if(BuildPartitionVariants() != kTfLiteOk)
+    std::cout << "Partition variants incomplete, " << variants.size()
+              << " built" << "\n";
 };
 
 TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
@@ -109,6 +213,7 @@ TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
   interpreter = new tflite::Interpreter(true);
   quantized_interpreter = new tflite::Interpreter(true);
   quantized_builder = nullptr;
+  input_type = type;
   interpreter->SetInputType(type);
   quantized_interpreter->SetInputType(type);
   state = RuntimeState::INITIALIZE;
@@ -132,6 +237,7 @@ TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
       .max_delegated_partitions = 1000,
   };
   MyDelegate = TfLiteGpuDelegateV2Create(&options);
+  AddDelegateOptions(delegate_options, options);
   interpreter->RegisterDelegate(MyDelegate);
   #endif
   
@@ -144,6 +250,7 @@ TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
 		TfLiteXNNPackDelegateOptionsDefault();
 	xnnpack_options.num_threads = num_threads;
 	xnn_delegate = TfLiteXNNPackDelegateCreate(&xnnpack_options);
+  AddDelegateOptions(delegate_options, xnnpack_options);
   interpreter->RegisterDelegate(xnn_delegate);
   #endif
 
@@ -161,6 +268,7 @@ TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
       .max_delegated_partitions = 1000,
   };
   MyDelegate = TfLiteGpuDelegateV2Create(&options);
+  AddDelegateOptions(delegate_options, options);
   delegate.push_back(MyDelegate);
 
   num_threads = 6;
@@ -168,10 +276,15 @@ TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
 		TfLiteXNNPackDelegateOptionsDefault();
 	xnnpack_options.num_threads = num_threads;
   xnn_delegate = TfLiteXNNPackDelegateCreate(&xnnpack_options);
+  AddDelegateOptions(delegate_options, xnnpack_options);
   delegate.push_back(xnn_delegate);
-  quantized_delegate.push_back(xnn_delegate);
+  // The minimal precision side runs on the co-execution worker at the same
+  // time, it gets a thread pool of its own.
+  quantized_delegate.push_back(TfLiteXNNPackDelegateCreate(&xnnpack_options));
+  AddDelegateOptions(delegate_options, xnnpack_options);
 
   interpreter->RegisterDelegate(delegate);
+  interpreter->RegisterCpuDelegate(xnn_delegate);
   quantized_interpreter->RegisterDelegate(quantized_delegate);
   #endif
 
@@ -183,6 +296,8 @@ TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
     std::cout << "Model registration to runtime ERROR" << "\n";
     exit(-1);
   }
+  IdentifyModel(model_id);
+  InitializeCache();
   if(RegisterModeltoScheduler() != kTfLiteOk){
     std::cout << "Model registration to scheduler ERROR" << "\n";
     exit(-1);
@@ -191,11 +306,87 @@ TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
     std::cout << "Model partitioning ERROR" << "\n";
     exit(-1);
   }
+  if(BuildPartitionVariants() != kTfLiteOk)
+    std::cout << "Partition variants incomplete, " << variants.size()
+              << " built" << "\n";
   
   InitLogFile();
 };
 
+TfLiteRuntime::TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
+                             const char* model,
+                             const CpuClusterOptions& cluster_a,
+                             const CpuClusterOptions& cluster_b,
+                             INPUT_TYPE type) {
+  co_execution = true;
+  cpu_clusters = true;
+  interpreter = new tflite::Interpreter(true);
+  quantized_interpreter = new tflite::Interpreter(true);
+  quantized_builder = nullptr;
+  input_type = type;
+  interpreter->SetInputType(type);
+  quantized_interpreter->SetInputType(type);
+  state = RuntimeState::INITIALIZE;
+  uds_runtime_filename = uds_runtime;
+  uds_scheduler_filename = uds_scheduler;
+  // Profiling runs cluster A's side on the caller, restored at return.
+  cluster_a_cpus = cluster_a.cpus;
+  TfAffinityScope scope(cluster_a_cpus);
+  co_execution_cpus = cluster_b.cpus;
+  TfLiteDelegate* cluster_a_delegate = CreateClusterDelegate(cluster_a,
+                                                              delegate_options);
+  TfLiteDelegate* cluster_b_delegate = CreateClusterDelegate(cluster_b,
+                                                              delegate_options);
+  // No GPU to profile. Cluster B is profiled as the minimal precision side.
+  delegate.push_back(nullptr);
+  delegate.push_back(cluster_a_delegate);
+  quantized_delegate.push_back(cluster_b_delegate);
+  interpreter->RegisterDelegate(
+      std::vector<TfLiteDelegate*>{cluster_a_delegate, cluster_b_delegate});
+  // Whole subgraphs on cluster A run on its delegate as well.
+  interpreter->RegisterCpuDelegate(cluster_a_delegate);
+  quantized_interpreter->RegisterDelegate(quantized_delegate);
+
+  if(InitializeUDS() != kTfLiteOk){
+    std::cout << "UDS socker init ERROR" << "\n";
+    exit(-1);
+  }
+  if(AddModelToRuntime(model, model) != kTfLiteOk){
+    std::cout << "Model registration to runtime ERROR" << "\n";
+    exit(-1);
+  }
+  IdentifyModel(model_id);
+  InitializeCache();
+  if(RegisterModeltoScheduler() != kTfLiteOk){
+    std::cout << "Model registration to scheduler ERROR" << "\n";
+    exit(-1);
+  }
+  if(PartitionCoSubgraphs() != kTfLiteOk){
+    std::cout << "Model partitioning ERROR" << "\n";
+    exit(-1);
+  }
+  if(BuildPartitionVariants() != kTfLiteOk)
+    std::cout << "Partition variants incomplete, " << variants.size()
+              << " built" << "\n";
+};
+
 TfLiteRuntime::~TfLiteRuntime() {
+  StopPipeline();
+  if(runtime_id != -1){ // Let scheduler give our resources and id to others.
+    ReleaseLeaseToScheduler();
+    tf_msg_header tx_header;
+    SetMsgHeader(tx_header, TF_MSG_LEAVE, runtime_id, state, state);
+    SendMsgToScheduler(&tx_header, sizeof(tx_header));
+  }
+  ReleasePartitionVariants();
+  if(co_executor != nullptr)
+    delete co_executor;
+  if(shm_channel != nullptr)
+    delete shm_channel;
+  if(cache != nullptr)
+    delete cache;
+  if(preprocessor != nullptr)
+    delete preprocessor;
   std::cout << "TfLiteRuntime destructor called"
             << "\n";
 };
@@ -251,35 +442,48 @@ TfLiteStatus TfLiteRuntime::InitializeUDS(){
     std::cout << "Socket bind ERROR" << "\n";
     return kTfLiteError;
   }
-  tf_packet new_packet;
-  memset(&new_packet, 0, sizeof(tf_packet));
-  new_packet.runtime_current_state = 0;
-  new_packet.runtime_id = -1;
-
+  tf_msg_header tx_header;
+  SetMsgHeader(tx_header, TF_MSG_STATE, -1, RuntimeState::INITIALIZE,
+               RuntimeState::INITIALIZE);
 
-  if(SendPacketToScheduler(new_packet) != kTfLiteOk){
+  if(SendMsgToScheduler(&tx_header, sizeof(tx_header)) != kTfLiteOk){
     std::cout << "Sending Hello to scheduler FAILED" << "\n";
     return kTfLiteError;
   }
   std::cout << "Send runtime register request to scheduler" << "\n";
 
-  tf_packet recv_packet;
-  if(ReceivePacketFromScheduler(recv_packet) != kTfLiteOk){
+  tf_msg rx_msg;
+  if(ReceiveMsgFromScheduler(&rx_msg, sizeof(rx_msg)) != kTfLiteOk){
     std::cout << "Receiving packet from scheduler FAILED" << "\n";
     return kTfLiteError;
   }
+  tf_msg_header& rx_header = rx_msg.header;
 
-  runtime_id = recv_packet.runtime_id;
+  runtime_id = rx_header.runtime_id;
   std::cout << "Got runtime ID " << runtime_id << " from scheduler" << "\n";
+
+  // Scheduler offers a shared-memory channel for invoke requests.
+  // Keep using UDS if it can't be attached.
+  if(rx_header.type == TF_MSG_CHANNEL && rx_header.payload_size > 0 &&
+      rx_header.payload_size <= TF_SHM_NAME_LENGTH){
+    char shm_name[TF_SHM_NAME_LENGTH];
+    memcpy(shm_name, rx_msg.payload, rx_header.payload_size);
+    shm_name[rx_header.payload_size - 1] = '\0';
+    shm_channel = TfShmChannel::Attach(shm_name, runtime_id);
+    if(shm_channel != nullptr)
+      std::cout << "Attached to shared-memory channel " << shm_name << "\n";
+    else
+      std::cout << "Shared-memory channel unavailable, use UDS" << "\n";
+  }
   
-  if(ChangeStatewithPacket(recv_packet) != kTfLiteOk){
+  if(ChangeStatewithMsg(rx_header) != kTfLiteOk){
     return kTfLiteError;
   }
   return kTfLiteOk;
 }
 
-TfLiteStatus TfLiteRuntime::SendPacketToScheduler(tf_packet& tx_p){
-  if(sendto(runtime_sock, (void *)&tx_p, sizeof(tf_packet), 0,
+TfLiteStatus TfLiteRuntime::SendMsgToScheduler(const void* msg, size_t size){
+  if(sendto(runtime_sock, msg, size, 0,
             (struct sockaddr*)&scheduler_addr, sizeof(scheduler_addr)) == -1){
     std::cout << "Sending packet to scheduler FAILED" << "\n";
     return kTfLiteError;
@@ -287,19 +491,179 @@ TfLiteStatus TfLiteRuntime::SendPacketToScheduler(tf_packet& tx_p){
   return kTfLiteOk; 
 }
 
-TfLiteStatus TfLiteRuntime::ReceivePacketFromScheduler(tf_packet& rx_p){
-  if(recvfrom(runtime_sock, &rx_p, sizeof(tf_packet), 0 , NULL, 0) == -1){
+TfLiteStatus TfLiteRuntime::ReceiveMsgFromScheduler(void* msg, size_t size){
+  ssize_t received = recvfrom(runtime_sock, msg, size, 0 , NULL, 0);
+  if(received == -1){
     std::cout << "Receiving packet from scheduler FAILED" << "\n";
     return kTfLiteError;
   }
+  if(!IsValidMsg(*static_cast<tf_msg_header*>(msg), received)){
+    std::cout << "Received an invalid message from scheduler" << "\n";
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus TfLiteRuntime::SendInvokeMsgToScheduler(tf_invoke_msg& tx_msg){
+  std::lock_guard<std::mutex> lock(ipc_send_mutex);
+  if(shm_channel == nullptr)
+    return SendMsgToScheduler(&tx_msg, sizeof(tx_msg));
+  if(!shm_channel->SendRequest(&tx_msg, sizeof(tx_msg))){
+    std::cout << "Sending request to shared-memory channel FAILED" << "\n";
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+bool TfLiteRuntime::TryReceiveFromScheduler(tf_lease_msg& rx_msg){
+  int received;
+  if(shm_channel != nullptr)
+    received = shm_channel->TryReceiveReply(&rx_msg, sizeof(rx_msg));
+  else
+    received = recvfrom(runtime_sock, &rx_msg, sizeof(rx_msg), MSG_DONTWAIT,
+                        NULL, 0);
+  return received != -1 && IsValidMsg(rx_msg.header, received);
+}
+
+TfLiteStatus TfLiteRuntime::ReceiveReplyFromScheduler(tf_lease_msg& rx_msg){
+  if(shm_channel == nullptr)
+    return ReceiveMsgFromScheduler(&rx_msg, sizeof(rx_msg));
+  int received = shm_channel->ReceiveReply(&rx_msg, sizeof(rx_msg));
+  if(received == -1 || !IsValidMsg(rx_msg.header, received)){
+    std::cout << "Received an invalid message from scheduler" << "\n";
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus TfLiteRuntime::RequestInvokeToScheduler(tf_invoke_msg& tx_msg,
+                                                    tf_lease_msg& rx_grant){
+  std::unique_lock<std::mutex> lock(ipc_reply_mutex);
+  const int request_id = next_request_id;
+  next_request_id = next_request_id == INT32_MAX ? 0 : next_request_id + 1;
+  lock.unlock();
+  tx_msg.request_id = request_id;
+  if(SendInvokeMsgToScheduler(tx_msg) != kTfLiteOk)
+    return kTfLiteError;
+  lock.lock();
+  while(1){
+    auto reply = ipc_replies.find(request_id);
+    if(reply != ipc_replies.end()){
+      rx_grant = reply->second;
+      ipc_replies.erase(reply);
+      return kTfLiteOk;
+    }
+    if(ipc_receiving){ // another request receives, wait for its hand over.
+      ipc_reply_cv.wait(lock);
+      continue;
+    }
+    ipc_receiving = true;
+    lock.unlock();
+    tf_lease_msg rx_msg;
+    const TfLiteStatus status = ReceiveReplyFromScheduler(rx_msg);
+    lock.lock();
+    ipc_receiving = false;
+    // Wakes the owner of the reply, or the next receiver on failure.
+    ipc_reply_cv.notify_all();
+    if(status != kTfLiteOk)
+      return kTfLiteError;
+    // Skip a revoke of the lease released before this request.
+    if(rx_msg.header.type != TF_MSG_REVOKE)
+      ipc_replies[rx_msg.request_id] = rx_msg;
+  }
+}
+
+TfLiteStatus TfLiteRuntime::AcquireResourceFromScheduler(tf_invoke_msg& tx_msg,
+                                                        tf_msg_header& rx_header,
+                                                        int subgraph_idx){
+  if(lease_id != -1){
+    // Fast path, invoke under the lease without asking scheduler.
+    if(IsLeaseValid(tx_msg.cur_graph_resource)){
+      SetMsgHeader(rx_header, TF_MSG_GRANT, runtime_id, state,
+                   RuntimeState::INVOKE_);
+      return kTfLiteOk;
+    }
+    if(ReleaseLeaseToScheduler() != kTfLiteOk)
+      return kTfLiteError;
+  }
+  tx_msg.lease_resources = 0;
+  FillSchedulingParams(tx_msg);
+  if(use_lease){ // Ask a lease on every resource left in this inference.
+    for(int i=subgraph_idx; i<interpreter->subgraphs_size(); ++i)
+      tx_msg.lease_resources |=
+          TF_LEASE_BIT(InvokeResourceOf(interpreter->subgraph(i)));
+  }
+  tf_lease_msg rx_grant;
+  if(RequestInvokeToScheduler(tx_msg, rx_grant) != kTfLiteOk)
+    return kTfLiteError;
+  rx_header = rx_grant.header;
+  if(rx_grant.header.type == TF_MSG_GRANT && rx_grant.variant >= 0 &&
+      rx_grant.variant < variants.size())
+    next_variant = rx_grant.variant;
+  if(rx_grant.header.type == TF_MSG_GRANT && rx_grant.lease_id != -1){
+    lease_id = rx_grant.lease_id;
+    lease_resources = rx_grant.lease_resources;
+    clock_gettime(CLOCK_MONOTONIC, &lease_deadline);
+    lease_deadline.tv_sec += rx_grant.lease_us / 1000000;
+    lease_deadline.tv_nsec += (rx_grant.lease_us % 1000000) * 1000;
+    if(lease_deadline.tv_nsec >= 1000000000){
+      lease_deadline.tv_sec++;
+      lease_deadline.tv_nsec -= 1000000000;
+    }
+  }
   return kTfLiteOk;
 }
 
-TfLiteStatus TfLiteRuntime::ChangeStatewithPacket(tf_packet& rx_p){
+bool TfLiteRuntime::IsLeaseValid(int resource){
+  if(!(lease_resources & TF_LEASE_BIT(resource)))
+    return false;
+  tf_lease_msg rx_msg;
+  while(TryReceiveFromScheduler(rx_msg)){
+    if(rx_msg.header.type == TF_MSG_REVOKE && rx_msg.lease_id == lease_id){
+      std::cout << "Lease " << lease_id << " revoked" << "\n";
+      return false;
+    }
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec < lease_deadline.tv_sec ||
+         (now.tv_sec == lease_deadline.tv_sec &&
+          now.tv_nsec < lease_deadline.tv_nsec);
+}
+
+TfLiteStatus TfLiteRuntime::ReleaseLeaseToScheduler(){
+  if(lease_id == -1)
+    return kTfLiteOk;
+  tf_invoke_msg tx_msg;
+  SetMsgHeader(tx_msg.header, TF_MSG_RELEASE, runtime_id, state, state);
+  tx_msg.cur_subgraph = -1;
+  tx_msg.cur_graph_resource = 0;
+  tx_msg.lease_resources = lease_resources;
+  FillSchedulingParams(tx_msg);
+  tx_msg.request_id = -1;
+  lease_id = -1;
+  lease_resources = 0;
+  return SendInvokeMsgToScheduler(tx_msg);
+}
+
+void TfLiteRuntime::FillSchedulingParams(tf_invoke_msg& tx_msg){
+  tx_msg.priority = priority;
+  tx_msg.period_us = period_us;
+  tx_msg.weight = share_weight;
+  tx_msg.deadline_us = frame_deadline_us;
+}
+
+TfLiteStatus TfLiteRuntime::ReleaseResourceToScheduler(tf_invoke_msg& tx_msg){
+  SetMsgHeader(tx_msg.header, TF_MSG_RELEASE, runtime_id, state, state);
+  tx_msg.lease_resources = 0;
+  return SendInvokeMsgToScheduler(tx_msg);
+}
+
+TfLiteStatus TfLiteRuntime::ChangeStatewithMsg(tf_msg_header& rx_header){
   std::cout << "================================================" << "\n";
-  if(rx_p.runtime_next_state != state){
-    std::cout << "runtime_next_state : " << rx_p.runtime_next_state << "\n";
-    state = static_cast<RuntimeState>(rx_p.runtime_next_state);
+  if(rx_header.runtime_next_state != state){
+    std::cout << "runtime_next_state : " << rx_header.runtime_next_state << "\n";
+    state = static_cast<RuntimeState>(rx_header.runtime_next_state);
     std::cout << "Runtime " << runtime_id << " state changed to " << state << "\n";
     std::cout << "================================================" << "\n";
     return kTfLiteOk;
@@ -321,6 +685,9 @@ TfLiteStatus TfLiteRuntime::AddModelToRuntime(const char* model) {
 
   interpreter_builder = new tflite::InterpreterBuilder(
       **model_, *resolver, interpreter, model, 0, false);
+  float_model = model_->get();
+  float_resolver = resolver;
+  float_model_name = model;
 
   // Now creates an invokable origin subgraph from new model.
   if (interpreter_builder->CreateSubgraphFromFlatBuffer() != kTfLiteOk) {
@@ -359,6 +726,13 @@ TfLiteStatus TfLiteRuntime::AddModelToRuntime(const char* f_model,
   // Build IntpertereBuilder for int model
   quantized_builder = new tflite::InterpreterBuilder(
       **int_model, *int_resolver, quantized_interpreter, i_model, 0, true);
+  // Locals shadow the members kept for partition variants.
+  this->float_model = float_model->get();
+  this->float_resolver = float_resolver;
+  this->quantized_model = int_model->get();
+  this->quantized_resolver = int_resolver;
+  float_model_name = f_model;
+  quantized_model_name = i_model;
 
   // Now creates an invokable (float)origin subgraph from new model.
   if (interpreter_builder->CreateSubgraphFromFlatBuffer() != kTfLiteOk) {
@@ -390,156 +764,380 @@ TfLiteStatus TfLiteRuntime::RegisterModeltoScheduler(){
              << RuntimeState::NEED_PROFILE << "\n";
     return kTfLiteError;
   }
-  tf_packet tx_packet;
-  memset(&tx_packet, 0, sizeof(tf_packet));
-  tx_packet.runtime_current_state = state;
-  tx_packet.runtime_id = runtime_id;
-
-  //////////////////////////////////////
-  // Some profiling logic here. later. //
-  //////////////////////////////////////
-
-  int layers = interpreter->nodes_size(0);
-  for(int i=0; i<layers; ++i){
-    tx_packet.latency[i] = -1.0; // means that this is a dummy latency profile.
-  }
-  if(SendPacketToScheduler(tx_packet) != kTfLiteOk){
+  tf_profile profile;
+  profile.is_dummy = false;
+  // Scheduler asks a profile again only if the last one is stale, so the
+  // cached profile is used at start only.
+  if(!registered_once && cache != nullptr && cache->LoadProfile(profile)){
+    std::cout << "Use cached profile of " << profile.layers << " nodes"
+              << "\n";
+  }else if(ProfileOriginalSubgraph(profile) != kTfLiteOk){
+    std::cout << "Profiling failed, send a dummy profile" << "\n";
+    // means that this is a dummy latency profile.
+    profile.is_dummy = true;
+    profile.layers = std::min<int>(model_id.nodes, TF_P_PLAN_LENGTH);
+  }else if(cache != nullptr && !cache->StoreProfile(profile)){
+    std::cout << "Cannot cache profile" << "\n";
+  }
+  registered_once = true;
+  profile.model = model_id;
+  profile.co_resource = cpu_clusters ? TF_P_PLAN_CPU_B : TF_P_PLAN_GPU;
+  tf_msg tx_msg;
+  SetMsgHeader(tx_msg.header, TF_MSG_PROFILE, runtime_id, state, state);
+  size_t tx_size = EncodeProfileMsg(profile, tx_msg);
+  if(SendMsgToScheduler(&tx_msg, tx_size) != kTfLiteOk){
     std::cout << "Sending profile packet to scheduler failed" << "\n";
     return kTfLiteError;
   }
 
-  tf_packet rx_packet;
-  if(ReceivePacketFromScheduler(rx_packet) != kTfLiteOk){
+  tf_msg rx_msg;
+  if(ReceiveMsgFromScheduler(&rx_msg, sizeof(rx_msg)) != kTfLiteOk){
     std::cout << "Receiving partitioning plan packet from scheduler Failed" << "\n";
     return kTfLiteError;
   }
 
   // copy the partitioning plan from scheduler.
-  memcpy(partitioning_plan, rx_packet.partitioning_plan, sizeof(int)*1000*4);
+  if(!DecodePlanMsg(rx_msg, partitioning_plan)){
+    std::cout << "Broken partitioning plan from scheduler" << "\n";
+    return kTfLiteError;
+  }
+  // Partition variants follow the primary plan.
+  const int plans = std::min(CountPlansInMsg(rx_msg), TF_P_MAX_VARIANTS);
+  variant_plans_received = 1;
+  while(variant_plans_received < plans &&
+        DecodePlanMsg(rx_msg, variant_plans[variant_plans_received - 1],
+                      variant_plans_received)){
+    variant_plans_received++;
+  }
 
-  if(ChangeStatewithPacket(rx_packet) != kTfLiteOk){
+  if(ChangeStatewithMsg(rx_msg.header) != kTfLiteOk){
     return kTfLiteError;
   }
   std::cout << "Successfully registered model to scheduler" << "\n";
   return kTfLiteOk;
 }
 
-TfLiteStatus TfLiteRuntime::PartitionSubgraphs(){
-  std::vector<std::vector<int>> raw_plan;
-  for(int i=0; i<TF_P_PLAN_LENGTH; ++i){
-    while(partitioning_plan[i][TF_P_IDX_START] != TF_P_END_MASTER){
-      raw_plan.push_back(std::vector<int>());
-      if(partitioning_plan[i][TF_P_IDX_START] == TF_P_END_PLAN){
-        raw_plan[i].push_back(TF_P_END_PLAN);
-        break;
-      }
-      for(int j=0; j<TF_P_PLAN_SIZE; ++j){ // third idx means processor.
-        raw_plan[i].push_back(partitioning_plan[i][j]);
-      }
-    }
-    interpreter_builder->CopyRawPartitioningPlan(raw_plan);
-    std::cout << "Runtime : CopyRawPartitioningPlan" << "\n";
-    raw_plan.clear();
-  } 
-  Subgraph* origin_subgraph = interpreter->returnProfiledOriginalSubgraph(0);
+void TfLiteRuntime::IdentifyModel(tf_model_id& model){
+  model.content_hash = HashModelContent(*float_model);
+  if(quantized_model != nullptr){
+    const uint64_t quantized_hash = HashModelContent(*quantized_model);
+    model.content_hash = HashBytes(&quantized_hash, sizeof(quantized_hash),
+                                   model.content_hash);
+  }
+  model.op_signature = HashBytes(nullptr, 0);
+  model.nodes = 0;
+  model.tensors = 0;
+  model.tensor_bytes = 0;
+  Subgraph* origin_subgraph = interpreter->subgraph_id(0);
+  if(origin_subgraph == nullptr)
+    return;
+  model.op_signature = HashOpSignature(origin_subgraph, model.op_signature);
+  if(quantized_interpreter != nullptr &&
+      quantized_interpreter->subgraph_id(0) != nullptr)
+    model.op_signature = HashOpSignature(quantized_interpreter->subgraph_id(0),
+                                         model.op_signature);
+  // A model split between CPU clusters is planned apart from the GPU one.
+  if(cpu_clusters){
+    const int co_resource = TF_P_PLAN_CPU_B;
+    model.op_signature = HashBytes(&co_resource, sizeof(co_resource),
+                                   model.op_signature);
+  }
+  // So is a model run with other delegates or delegate options, which
+  // change its profile.
+  const int delegates[2] = {static_cast<int>(delegate.size()),
+                            static_cast<int>(quantized_delegate.size())};
+  model.op_signature = HashBytes(delegates, sizeof(delegates),
+                                 model.op_signature);
+  model.op_signature = HashBytes(delegate_options.data(),
+                                 delegate_options.size() * sizeof(int),
+                                 model.op_signature);
+  model.nodes = origin_subgraph->nodes_size();
+  model.tensors = origin_subgraph->tensors_size();
+  for(int i=0; i<model.tensors; ++i)
+    model.tensor_bytes += origin_subgraph->tensor(i)->bytes;
+  printf("Model %016llx:%016llx, %d nodes, %d tensors(%lld bytes) \n",
+         (unsigned long long)model.content_hash,
+         (unsigned long long)model.op_signature, model.nodes, model.tensors,
+         (long long)model.tensor_bytes);
+}
+
+void TfLiteRuntime::InitializeCache(){
+  cache = TfRuntimeCache::Create(getenv(TF_CACHE_DIR_ENV));
+  if(cache == nullptr)
+    return;
+  // The identity covers the delegates and their options.
+  cache->AddKey(&model_id, sizeof(model_id));
+  cache->AddKey(profile_warmup_runs);
+  cache->AddKey(profile_runs);
+  std::cout << "Runtime cache in " << getenv(TF_CACHE_DIR_ENV) << "\n";
+}
+
+TfLiteStatus TfLiteRuntime::ProfileOriginalSubgraph(tf_profile& profile){
+  Subgraph* origin_subgraph = interpreter->subgraph_id(0);
   if(origin_subgraph == nullptr){
-    std::cout << "Model id " << interpreter_builder->GetModelid() << " no subgraph. \n"; 
+    std::cout << "No original subgraph to profile" << "\n";
     return kTfLiteError;
   }
-  if(interpreter_builder->CreateSubgraphsFromProfiling(origin_subgraph)
-      != kTfLiteOk){
-    std::cout << "CreateSubgraphsFromProfiling returned ERROR" << "\n";
+  const int layers = origin_subgraph->nodes_size();
+  if(layers > TF_P_PLAN_LENGTH){
+    std::cout << "Too many nodes to profile : " << layers << "\n";
     return kTfLiteError;
   }
-  
-  tf_packet tx_packet;
-  memset(&tx_packet, 0, sizeof(tf_packet));
-  tx_packet.runtime_id = runtime_id;
-  
-  tx_packet.runtime_current_state = state;
-  if(SendPacketToScheduler(tx_packet) != kTfLiteOk){
+  std::vector<std::vector<float>> samples;
+  std::vector<bool> delegated;
+
+  // 1. CPU builtin kernels.
+  std::vector<float> cpu_latency(layers, 1);
+  if(ProfileSubgraphNodes(origin_subgraph, cpu_latency, samples, delegated)
+      != kTfLiteOk)
     return kTfLiteError;
+  for(int i=0; i<layers; ++i){
+    // Nodes without a sample are not in the execution plan.
+    cpu_latency[i] = std::max(Percentile(samples[i], 0.5), 0.0f);
+    profile.latency[i] = cpu_latency[i];
+    profile.latency_p90[i] = std::max(Percentile(samples[i], 0.9), 0.0f);
+    profile.xnn_latency[i] = cpu_latency[i];
+    profile.gpu_latency[i] = -1;
+    profile.gpu_latency_p90[i] = -1;
+    profile.co_cpu_latency[i] = -1;
+  }
+
+  // 2. CPU with XNNPACK.
+  // Nodes which XNNPACK does not support keep the builtin latency.
+  TfLiteDelegate* gpu_delegate = delegate.size() > 0 ? delegate[0] : nullptr;
+  TfLiteDelegate* xnn_delegate = delegate.size() > 1 ? delegate[1] : nullptr;
+  if(xnn_delegate != nullptr){
+    if(ProfileSubgraphNodesWithDelegate(interpreter, origin_subgraph,
+                  xnn_delegate, cpu_latency, samples, delegated) != kTfLiteOk)
+      return kTfLiteError;
+    for(int i=0; i<layers; ++i){
+      if(!samples[i].empty())
+        profile.xnn_latency[i] = Percentile(samples[i], 0.5);
+    }
   }
 
-  tf_packet rx_packet;
-  if(ReceivePacketFromScheduler(rx_packet) != kTfLiteOk){
-    return kTfLiteError;
+  // 3. GPU.
+  // Nodes which stay on CPU are not supported by GPU delegate.
+  if(gpu_delegate != nullptr){
+    if(ProfileSubgraphNodesWithDelegate(interpreter, origin_subgraph,
+                  gpu_delegate, cpu_latency, samples, delegated) != kTfLiteOk)
+      return kTfLiteError;
+    for(int i=0; i<layers; ++i){
+      if(!delegated[i])
+        continue;
+      profile.gpu_latency[i] = Percentile(samples[i], 0.5);
+      profile.gpu_latency_p90[i] = Percentile(samples[i], 0.9);
+    }
   }
-  // At this point, scheduler will send INVOKE state.
-  if(ChangeStatewithPacket(rx_packet) != kTfLiteOk){
-    return kTfLiteError;
+
+  // 4. Minimal precision side of co-execution.
+  // Partitioning ratios are applied by the scheduler on the full node
+  // latency, since partitioning weights of the original subgraph for each
+  // ratio can't be undone.
+  // Cluster B is measured from its own cores, the caller is a thread of the
+  // pool.
+  if(co_execution && quantized_interpreter != nullptr){
+    TfAffinityScope scope(cpu_clusters ? co_execution_cpus
+                                       : std::vector<int>());
+    Subgraph* origin_quantized_subgraph = quantized_interpreter->subgraph_id(0);
+    if(origin_quantized_subgraph != nullptr &&
+        origin_quantized_subgraph->nodes_size() == layers){
+      TfLiteDelegate* co_delegate = quantized_delegate.empty() ?
+                                      nullptr : quantized_delegate[0];
+      TfLiteStatus status;
+      if(co_delegate != nullptr)
+        status = ProfileSubgraphNodesWithDelegate(quantized_interpreter,
+                            origin_quantized_subgraph, co_delegate,
+                            cpu_latency, samples, delegated);
+      else
+        status = ProfileSubgraphNodes(origin_quantized_subgraph, cpu_latency,
+                                      samples, delegated);
+      if(status != kTfLiteOk)
+        return kTfLiteError;
+      for(int i=0; i<layers; ++i)
+        profile.co_cpu_latency[i] = Percentile(samples[i], 0.5);
+    }else{
+      std::cout << "Minimal precision subgraph does not match, "
+                << "skip co-execution profile" << "\n";
+    }
   }
-  interpreter->PrintSubgraphInfo();
-  PrintInterpreterStateV3(interpreter);
-  std::cout << "Successfully partitioned subgraph" << "\n";
-  std::cout << "Ready to invoke" << "\n";
+
+  // 5. Hand over and quantization cost of each node's output.
+  std::vector<char> copy_buffer;
+  std::vector<int8_t> quantize_buffer;
+  struct timespec begin, end;
+  for(int i=0; i<layers; ++i){
+    const TfLiteNode& node =
+                  origin_subgraph->node_and_registration(i)->first;
+    std::vector<float> copy_samples, quantize_samples;
+    for(int run=0; run<profile_runs; ++run){
+      double copy_latency = 0;
+      double quantize_latency = 0;
+      for(int j=0; j<node.outputs->size; ++j){
+        TfLiteTensor* tensor = origin_subgraph->tensor(node.outputs->data[j]);
+        if(tensor == nullptr || tensor->data.raw == nullptr)
+          continue;
+        if(copy_buffer.size() < tensor->bytes)
+          copy_buffer.resize(tensor->bytes);
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        memcpy(copy_buffer.data(), tensor->data.raw, tensor->bytes);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        copy_latency += ElapsedMs(begin, end);
+        if(tensor->type != kTfLiteFloat32)
+          continue;
+        const int elements = tensor->bytes / sizeof(float);
+        if(quantize_buffer.size() < elements)
+          quantize_buffer.resize(elements);
+        float scaling_factor = 0;
+        int32_t zero_point = 0;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        QuantizeFloats(tensor->data.f, 1, elements, quantize_buffer.data(),
+                       &scaling_factor, &zero_point, false);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        quantize_latency += ElapsedMs(begin, end);
+      }
+      copy_samples.push_back(copy_latency);
+      quantize_samples.push_back(quantize_latency);
+    }
+    profile.transfer_latency[i] = Percentile(copy_samples, 0.5);
+    profile.quantize_latency[i] = Percentile(quantize_samples, 0.5);
+  }
+  profile.layers = layers;
+
+  std::cout << "Profiled " << layers << " nodes" << "\n";
   return kTfLiteOk;
 }
 
-TfLiteStatus TfLiteRuntime::PartitionCoSubgraphs(){
-  std::vector<std::vector<int>> raw_plan;
-  int inner_plan_idx = 0;
-
-  for(int i=0; i<TF_P_PLAN_LENGTH; ++i){
-    raw_plan.push_back(std::vector<int>());
-    inner_plan_idx = raw_plan.size() - 1;
-    if(partitioning_plan[i][TF_P_IDX_START] == TF_P_END_PLAN){
-      raw_plan[inner_plan_idx].push_back(TF_P_END_PLAN);
-      interpreter_builder->CopyRawPartitioningPlan(raw_plan);
-      quantized_builder->CopyRawPartitioningPlan(raw_plan);
-      raw_plan.clear();
-      inner_plan_idx = 0;
-      raw_plan.push_back(std::vector<int>());
-      i++;
+TfLiteStatus TfLiteRuntime::ProfileSubgraphNodes(Subgraph* subgraph,
+                                  const std::vector<float>& weights,
+                                  std::vector<std::vector<float>>& samples,
+                                  std::vector<bool>& delegated){
+  const int layers = weights.size();
+  samples.assign(layers, std::vector<float>());
+  delegated.assign(layers, false);
+  profiling::BufferedProfiler profiler(subgraph->nodes_size() * 2 + 64);
+  subgraph->SetProfiler(&profiler, subgraph->GetGraphid());
+
+  TfLiteStatus status = kTfLiteOk;
+  for(int run=0; run<profile_warmup_runs + profile_runs; ++run){
+    const bool measure = run >= profile_warmup_runs;
+    if(measure){
+      profiler.Reset();
+      profiler.StartProfiling();
     }
-    if(partitioning_plan[i][TF_P_IDX_START] == TF_P_END_MASTER)
+    status = subgraph->Invoke();
+    if(!measure)
+      continue;
+    profiler.StopProfiling();
+    if(status != kTfLiteOk)
       break;
-    for(int j=0; j<TF_P_PLAN_SIZE; ++j){ // third idx means processor.
-      raw_plan[inner_plan_idx].push_back(partitioning_plan[i][j]);
+    for(const profiling::ProfileEvent* event : profiler.GetProfileEvents()){
+      if(event->event_type != Profiler::EventType::OPERATOR_INVOKE_EVENT)
+        continue;
+      const int node_index = event->event_metadata;
+      const float latency =
+          (event->end_timestamp_us - event->begin_timestamp_us) / 1000.0f;
+      auto* node_and_registration = subgraph->node_and_registration(node_index);
+      if(node_and_registration == nullptr)
+        continue;
+      const TfLiteNode& node = node_and_registration->first;
+      if(node.delegate == nullptr){
+        if(node_index < layers)
+          samples[node_index].push_back(latency);
+        continue;
+      }
+      // Delegate kernel, builtin_data holds the nodes it replaced.
+      auto* params = static_cast<TfLiteDelegateParams*>(node.builtin_data);
+      const TfLiteIntArray* replaced = params->nodes_to_replace;
+      float weight_sum = 0;
+      for(int i=0; i<replaced->size; ++i){
+        if(replaced->data[i] < layers)
+          weight_sum += std::max(weights[replaced->data[i]], 0.0f);
+      }
+      for(int i=0; i<replaced->size; ++i){
+        const int replaced_node = replaced->data[i];
+        if(replaced_node >= layers)
+          continue;
+        const float share = weight_sum > 0 ?
+            std::max(weights[replaced_node], 0.0f) / weight_sum :
+            1.0f / replaced->size;
+        samples[replaced_node].push_back(latency * share);
+        delegated[replaced_node] = true;
+      }
     }
   }
+  subgraph->SetProfiler(nullptr, 0);
+  if(status != kTfLiteOk)
+    std::cout << "Invoke failed while profiling subgraph "
+              << subgraph->GetGraphid() << "\n";
+  return status;
+}
 
-  Subgraph* origin_subgraph = interpreter->returnProfiledOriginalSubgraph(0);
-  if(origin_subgraph == nullptr){
-    std::cout << "Model id " << interpreter_builder->GetModelid() << " no subgraph. \n"; 
+TfLiteStatus TfLiteRuntime::ProfileSubgraphNodesWithDelegate(
+                                  Interpreter* owner, Subgraph* subgraph,
+                                  TfLiteDelegate* delegate,
+                                  const std::vector<float>& weights,
+                                  std::vector<std::vector<float>>& samples,
+                                  std::vector<bool>& delegated){
+  const int graph_id = subgraph->GetGraphid();
+  TfLiteStatus status = kTfLiteOk;
+  if(owner->ModifySubgraphWithDelegate(graph_id, delegate) != kTfLiteOk){
+    std::cout << "Delegation failed while profiling" << "\n";
+    status = kTfLiteError;
+  }else{
+    status = ProfileSubgraphNodes(subgraph, weights, samples, delegated);
+  }
+  if(owner->RemoveDelegatesOfSubgraph(graph_id) != kTfLiteOk){
+    std::cout << "Cannot restore subgraph after profiling" << "\n";
     return kTfLiteError;
   }
-  if(interpreter_builder->CreateSubgraphsFromProfiling(origin_subgraph)
-      != kTfLiteOk){
-    std::cout << "CreateSubgraphsFromProfiling returned ERROR" << "\n";
+  return status;
+}
+
+TfLiteStatus TfLiteRuntime::PartitionSubgraphs(){
+  PartitionVariant primary = {interpreter, interpreter_builder, nullptr,
+                              nullptr};
+  if(CreateSubgraphsFromPlan(partitioning_plan, primary) != kTfLiteOk)
+    return kTfLiteError;
+  
+  tf_msg_header tx_header;
+  SetMsgHeader(tx_header, TF_MSG_STATE, runtime_id, state, state);
+  if(SendMsgToScheduler(&tx_header, sizeof(tx_header)) != kTfLiteOk){
     return kTfLiteError;
   }
-  std::cout << "===============================" << "\n";
-  std::cout << "Full precision subgraph created" << "\n";
-  std::cout << "===============================" << "\n";
-  // Create subgraphs of quantized model
-  Subgraph* origin_quantized_subgraph = quantized_interpreter->returnProfiledOriginalSubgraph(0);
-  if(origin_quantized_subgraph == nullptr){
-    std::cout << "Model id " << interpreter_builder->GetModelid() << " no subgraph. \n"; 
+
+  tf_msg_header rx_header;
+  if(ReceiveMsgFromScheduler(&rx_header, sizeof(rx_header)) != kTfLiteOk){
     return kTfLiteError;
   }
-  if(quantized_builder->CreateSubgraphsFromProfiling(origin_quantized_subgraph)
-      != kTfLiteOk){
-    std::cout << "CreateSubgraphsFromProfiling returned ERROR" << "\n";
+  // At this point, scheduler will send INVOKE state.
+  if(ChangeStatewithMsg(rx_header) != kTfLiteOk){
     return kTfLiteError;
   }
-  std::cout << "===============================" << "\n";
-  std::cout << "Minimal precision subgraph created" << "\n";
-  std::cout << "===============================" << "\n";
-  tf_packet tx_packet;
-  memset(&tx_packet, 0, sizeof(tf_packet));
-  tx_packet.runtime_id = runtime_id;
-  tx_packet.runtime_current_state = state;
-  if(SendPacketToScheduler(tx_packet) != kTfLiteOk){
+  interpreter->PrintSubgraphInfo();
+  PrintInterpreterStateV3(interpreter);
+  std::cout << "Successfully partitioned subgraph" << "\n";
+  std::cout << "Ready to invoke" << "\n";
+  return kTfLiteOk;
+}
+
+TfLiteStatus TfLiteRuntime::PartitionCoSubgraphs(){
+  PartitionVariant primary = {interpreter, interpreter_builder,
+                              quantized_interpreter, quantized_builder};
+  if(CreateSubgraphsFromPlan(partitioning_plan, primary) != kTfLiteOk)
+    return kTfLiteError;
+  tf_msg_header tx_header;
+  SetMsgHeader(tx_header, TF_MSG_STATE, runtime_id, state, state);
+  if(SendMsgToScheduler(&tx_header, sizeof(tx_header)) != kTfLiteOk){
     return kTfLiteError;
   }
 
-  tf_packet rx_packet;
-  if(ReceivePacketFromScheduler(rx_packet) != kTfLiteOk){
+  tf_msg_header rx_header;
+  if(ReceiveMsgFromScheduler(&rx_header, sizeof(rx_header)) != kTfLiteOk){
     return kTfLiteError;
   }
   // At this point, scheduler will send INVOKE state.
-  if(ChangeStatewithPacket(rx_packet) != kTfLiteOk){
+  if(ChangeStatewithMsg(rx_header) != kTfLiteOk){
     return kTfLiteError;
   }
   //interpreter->PrintSubgraphInfo();
@@ -559,22 +1157,30 @@ TfLiteStatus TfLiteRuntime::PartitionCoSubgraphs(){
 }
 
 TfLiteStatus TfLiteRuntime::PrepareCoExecution(){
-  if(quantized_interpreter == nullptr){
+  return PrepareCoExecution(interpreter, quantized_interpreter);
+}
+
+TfLiteStatus TfLiteRuntime::PrepareCoExecution(
+                            Interpreter* max_precision_interpreter,
+                            Interpreter* min_precision_interpreter){
+  if(min_precision_interpreter == nullptr){
     std::cout << "PrepareCoExecution ERROR" << "\n";
     std::cout << "minimal precision interpreter nullptr" << "\n";
     return kTfLiteError;
   }
   int co_subgraph_idx = 0;
-  for(int subgraph_idx=0; subgraph_idx < interpreter->subgraphs_size();
+  for(int subgraph_idx=0;
+        subgraph_idx < max_precision_interpreter->subgraphs_size();
         subgraph_idx++){
-    Subgraph* subgraph = interpreter->subgraph(subgraph_idx);
+    Subgraph* subgraph = max_precision_interpreter->subgraph(subgraph_idx);
     if(subgraph->GetResourceType() == ResourceType::CO_GPU){
-      if(quantized_interpreter->subgraphs_size() < 1){
+      if(min_precision_interpreter->subgraphs_size() < 1){
         std::cout << "PrepareCoExecution ERROR" << "\n";
         std::cout << "minimal precision interpreter has no subgraph" << "\n";
         return kTfLiteError;
       }
-      Subgraph* co_subgraph = quantized_interpreter->subgraph(co_subgraph_idx);
+      Subgraph* co_subgraph =
+                  min_precision_interpreter->subgraph(co_subgraph_idx);
       std::vector<int> inputs = subgraph->inputs();
       std::vector<int> outputs = subgraph->outputs();
       for(int i=0; i<inputs.size(); ++i){
@@ -589,14 +1195,130 @@ TfLiteStatus TfLiteRuntime::PrepareCoExecution(){
   return kTfLiteOk;
 }
 
-void TfLiteRuntime::FeedInputToInterpreter(std::vector<cv::Mat>& mnist,
-                                           std::vector<cv::Mat>& imagenet) {
-  interpreter->mnist_input = mnist;
-  interpreter->imagenet_input = imagenet;
-  if(quantized_interpreter != nullptr){
-    quantized_interpreter->mnist_input = mnist;
-    quantized_interpreter->imagenet_input = imagenet;
+TfLiteStatus TfLiteRuntime::CreateSubgraphsFromPlan(
+                      int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE],
+                      PartitionVariant& variant){
+  // Each plan ends with TF_P_END_PLAN, the last one with TF_P_END_MASTER.
+  std::vector<std::vector<int>> raw_plan;
+  for(int i=0; i<TF_P_PLAN_LENGTH; ++i){
+    if(plan[i][TF_P_IDX_START] == TF_P_END_MASTER)
+      break;
+    if(plan[i][TF_P_IDX_START] == TF_P_END_PLAN){
+      raw_plan.push_back(std::vector<int>(1, TF_P_END_PLAN));
+      variant.builder->CopyRawPartitioningPlan(raw_plan);
+      if(variant.quantized_builder != nullptr)
+        variant.quantized_builder->CopyRawPartitioningPlan(raw_plan);
+      raw_plan.clear();
+      continue;
+    }
+    raw_plan.push_back(std::vector<int>(plan[i], plan[i] + TF_P_PLAN_SIZE));
   }
+  Subgraph* origin_subgraph =
+              variant.interpreter->returnProfiledOriginalSubgraph(0);
+  if(origin_subgraph == nullptr){
+    std::cout << "Model id " << variant.builder->GetModelid() << " no subgraph. \n"; 
+    return kTfLiteError;
+  }
+  if(variant.builder->CreateSubgraphsFromProfiling(origin_subgraph)
+      != kTfLiteOk){
+    std::cout << "CreateSubgraphsFromProfiling returned ERROR" << "\n";
+    return kTfLiteError;
+  }
+  if(variant.quantized_builder == nullptr)
+    return kTfLiteOk;
+  std::cout << "===============================" << "\n";
+  std::cout << "Full precision subgraph created" << "\n";
+  std::cout << "===============================" << "\n";
+  // Create subgraphs of quantized model
+  Subgraph* origin_quantized_subgraph =
+              variant.quantized_interpreter->returnProfiledOriginalSubgraph(0);
+  if(origin_quantized_subgraph == nullptr){
+    std::cout << "Model id " << variant.quantized_builder->GetModelid() << " no subgraph. \n"; 
+    return kTfLiteError;
+  }
+  if(variant.quantized_builder->CreateSubgraphsFromProfiling(
+        origin_quantized_subgraph) != kTfLiteOk){
+    std::cout << "CreateSubgraphsFromProfiling returned ERROR" << "\n";
+    return kTfLiteError;
+  }
+  std::cout << "===============================" << "\n";
+  std::cout << "Minimal precision subgraph created" << "\n";
+  std::cout << "===============================" << "\n";
+  return kTfLiteOk;
+}
+
+TfLiteStatus TfLiteRuntime::BuildPartitionVariants(){
+  // Variants of a stale plan are released before a re-partition.
+  if(!variants.empty())
+    return kTfLiteOk;
+  variants.push_back({interpreter, interpreter_builder, quantized_interpreter,
+                      quantized_builder});
+  for(int i=1; i<variant_plans_received; ++i){
+    PartitionVariant variant = {nullptr, nullptr, nullptr, nullptr};
+    variant.interpreter = new tflite::Interpreter(true);
+    variant.interpreter->SetInputType(input_type);
+    variant.interpreter->RegisterDelegatesOf(*interpreter);
+    variant.builder = new tflite::InterpreterBuilder(*float_model,
+        *float_resolver, variant.interpreter, float_model_name.c_str(), 0,
+        false);
+    if(variant.builder->CreateSubgraphFromFlatBuffer() != kTfLiteOk){
+      std::cout << "CreateSubgraphFromFlatBuffer returned Error" << "\n";
+      return kTfLiteError;
+    }
+    if(co_execution){
+      variant.quantized_interpreter = new tflite::Interpreter(true);
+      variant.quantized_interpreter->SetInputType(input_type);
+      variant.quantized_interpreter->RegisterDelegatesOf(*quantized_interpreter);
+      variant.quantized_builder = new tflite::InterpreterBuilder(
+          *quantized_model, *quantized_resolver, variant.quantized_interpreter,
+          quantized_model_name.c_str(), 0, true);
+      if(variant.quantized_builder->CreateSubgraphFromFlatBuffer()
+          != kTfLiteOk){
+        std::cout << "CreateSubgraphFromFlatBuffer returned Error" << "\n";
+        return kTfLiteError;
+      }
+    }
+    if(CreateSubgraphsFromPlan(variant_plans[i - 1], variant) != kTfLiteOk)
+      return kTfLiteError;
+    if(co_execution && PrepareCoExecution(variant.interpreter,
+                          variant.quantized_interpreter) != kTfLiteOk){
+      std::cout << "PrepareCoExecution returned ERROR" << "\n";
+      return kTfLiteError;
+    }
+    variants.push_back(variant);
+    std::cout << "Partition variant " << i << " built" << "\n";
+  }
+  return kTfLiteOk;
+}
+
+void TfLiteRuntime::ReleasePartitionVariants(){
+  if(variants.empty())
+    return;
+  SwitchPartitionVariant(0);
+  // [0] is the primary variant, owned by the runtime itself.
+  for(size_t i=1; i<variants.size(); ++i){
+    delete variants[i].builder;
+    delete variants[i].interpreter;
+    if(variants[i].quantized_builder != nullptr)
+      delete variants[i].quantized_builder;
+    if(variants[i].quantized_interpreter != nullptr)
+      delete variants[i].quantized_interpreter;
+  }
+  variants.clear();
+}
+
+TfLiteStatus TfLiteRuntime::SwitchPartitionVariant(int variant){
+  if(variant < 0 || variant >= variants.size()){
+    std::cout << "No partition variant " << variant << "\n";
+    return kTfLiteError;
+  }
+  interpreter = variants[variant].interpreter;
+  interpreter_builder = variants[variant].builder;
+  quantized_interpreter = variants[variant].quantized_interpreter;
+  quantized_builder = variants[variant].quantized_builder;
+  active_variant = variant;
+  next_variant = variant;
+  return kTfLiteOk;
 }
 
 void TfLiteRuntime::FeedInputToModel(const char* model,
@@ -899,6 +1621,142 @@ void TfLiteRuntime::FeedInputToModel(const char* model,
   // PrintTensor(*input_tensor);
 }
 
+TfLiteStatus TfLiteRuntime::RegisterInputBuffers(
+                  const std::vector<TfLiteCustomAllocation>& buffers,
+                  const std::vector<TfLiteCustomAllocation>& quantized_buffers){
+  if(buffers.empty() ||
+      (!quantized_buffers.empty() && quantized_buffers.size() != buffers.size())){
+    std::cout << "Input frames need a quantized buffer each or none" << "\n";
+    return kTfLiteError;
+  }
+  if(pipeline != nullptr){
+    std::cout << "Cannot register input frames while pipelined" << "\n";
+    return kTfLiteError;
+  }
+  // Same checks as SetCustomAllocationForTensor, before any is bound.
+  auto check = [](Interpreter* owner,
+                  const std::vector<TfLiteCustomAllocation>& frames){
+    if(owner == nullptr || owner->subgraphs_size() == 0)
+      return true;
+    Subgraph* subgraph = owner->subgraph(0);
+    const TfLiteTensor* tensor =
+        subgraph->tensor(subgraph->GetInputTensorIndex());
+    for(const TfLiteCustomAllocation& frame : frames){
+      if(frame.data == nullptr || frame.bytes < tensor->bytes ||
+          reinterpret_cast<uintptr_t>(frame.data) % kDefaultTensorAlignment != 0)
+        return false;
+    }
+    return true;
+  };
+  if(!check(interpreter, buffers) ||
+      !check(quantized_interpreter, quantized_buffers)){
+    std::cout << "Input frame is smaller than the input tensor or not "
+              << "aligned to " << kDefaultTensorAlignment << "\n";
+    return kTfLiteError;
+  }
+  input_buffers = buffers;
+  quantized_input_buffers = quantized_buffers;
+  bound_input_frame = -1;
+  return kTfLiteOk;
+}
+
+TfLiteStatus TfLiteRuntime::BindInputBuffer(int frame){
+  if(frame < 0 || frame >= input_buffers.size()){
+    std::cout << "Input frame " << frame << " is not registered" << "\n";
+    return kTfLiteError;
+  }
+  bound_input_frame = frame;
+  return ApplyInputBinding();
+}
+
+TfLiteStatus TfLiteRuntime::ApplyInputBinding(){
+  if(bound_input_frame == -1)
+    return kTfLiteOk;
+  auto bind = [](Interpreter* owner, const TfLiteCustomAllocation& frame){
+    if(owner == nullptr || owner->subgraphs_size() == 0)
+      return kTfLiteOk;
+    Subgraph* subgraph = owner->subgraph(0);
+    return subgraph->SetCustomAllocationForTensor(
+                                  subgraph->GetInputTensorIndex(), frame);
+  };
+  if(bind(interpreter, input_buffers[bound_input_frame]) != kTfLiteOk ||
+      (!quantized_input_buffers.empty() &&
+       bind(quantized_interpreter,
+            quantized_input_buffers[bound_input_frame]) != kTfLiteOk)){
+    std::cout << "Binding input frame " << bound_input_frame << " FAILED"
+              << "\n";
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus TfLiteRuntime::FeedFrameToModel(
+                                  const TfFrame& frame,
+                                  const TfNormalization& normalization){
+  // Input tensors of both interpreters, which must agree on NHWC size.
+  std::vector<TfLiteTensor*> tensors;
+  tensors.push_back(interpreter->input_tensor_of_model(0));
+  if(quantized_interpreter != nullptr &&
+      quantized_interpreter->subgraphs_size() > 0)
+    tensors.push_back(quantized_interpreter->input_tensor_of_model(0));
+  std::vector<TfPreprocessTarget> targets;
+  int height = 0, width = 0;
+  for(TfLiteTensor* tensor : tensors){
+    if(tensor == nullptr || tensor->data.data == nullptr ||
+        tensor->dims->size != 4 || tensor->dims->data[3] != 3){
+      std::cout << "Input tensor is not a NHWC 3 channel image" << "\n";
+      return kTfLiteError;
+    }
+    if(height == 0){
+      height = tensor->dims->data[1];
+      width = tensor->dims->data[2];
+    }else if(tensor->dims->data[1] != height ||
+              tensor->dims->data[2] != width){
+      std::cout << "Input tensors of interpreters differ in size" << "\n";
+      return kTfLiteError;
+    }
+    TfPreprocessTarget target;
+    target.data = tensor->data.data;
+    switch(tensor->type){
+      case kTfLiteFloat32:
+        target.type = TF_PREPROCESS_FLOAT32;
+        break;
+      case kTfLiteUInt8:
+        target.type = TF_PREPROCESS_UINT8;
+        break;
+      case kTfLiteInt8:
+        target.type = TF_PREPROCESS_INT8;
+        break;
+      default:
+        std::cout << "Input type " << TfLiteTypeGetName(tensor->type)
+                  << " is not supported by preprocessing" << "\n";
+        return kTfLiteError;
+    }
+    if(target.type != TF_PREPROCESS_FLOAT32 && tensor->params.scale != 0){
+      target.scale = tensor->params.scale;
+      target.zero_point = tensor->params.zero_point;
+    }
+    targets.push_back(target);
+  }
+  if(preprocessor == nullptr)
+    preprocessor = new TfPreprocessor(preprocess_threads);
+  if(!preprocessor->Run(frame, normalization, width, height, targets)){
+    std::cout << "Preprocessing frame " << frame.width << "x" << frame.height
+              << " FAILED" << "\n";
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+void TfLiteRuntime::SetPreprocessThreads(int threads){
+  preprocess_threads = threads > 0 ? threads : 1;
+  // Workers are created again on the next frame.
+  if(preprocessor != nullptr){
+    delete preprocessor;
+    preprocessor = nullptr;
+  }
+}
+
 void TfLiteRuntime::WakeScheduler() {
   interpreter->WakeScheduler();
   std::this_thread::sleep_for(std::chrono::seconds(3));
@@ -906,105 +1764,97 @@ void TfLiteRuntime::WakeScheduler() {
 
 void TfLiteRuntime::JoinScheduler() { interpreter->JoinScheduler(); }
 
-TfLiteStatus TfLiteRuntime::DebugCoInvoke(){
-  c_thread = std::thread(&TfLiteRuntime::DebugSyncInvoke, this, 
-                          PrecisionType::MINIMAL_PRECISION);
-  DebugSyncInvoke(PrecisionType::MAX_PRECISION);
-  c_thread.join();
+void TfLiteRuntime::SetCoExecutionCpus(const std::vector<int>& cpus){
+  co_execution_cpus = cpus;
+  // Pinned on the next co-execution.
+  if(co_executor != nullptr){
+    delete co_executor;
+    co_executor = nullptr;
+  }
 }
 
-void TfLiteRuntime::DebugSyncInvoke(PrecisionType type){
-  // For prototye, invoke first layer only with HW-partitioning and merge them.
+TfLiteStatus TfLiteRuntime::DebugCoInvoke(){
   Subgraph* subgraph;
   int subgraph_idx = 0;
-  double response_time = 0; 
+  int co_subgraph_idx = 0;
   std::vector<double> latency;
   struct timespec begin, end;
-  while(true){
-    if(type == PrecisionType::MINIMAL_PRECISION){
-      if(quantized_interpreter->subgraphs_size() < 1){
-        // std::cout << "No invokable subgraph for cpu" << "\n";
-        break;
-      }
-      // sync with gpu here (notified by gpu)
-      std::unique_lock<std::mutex> lock_invoke(invoke_sync_mtx);
-      invoke_sync_cv.wait(lock_invoke, [&]{ return invoke_cpu; });
-      invoke_cpu = false;
-      subgraph = quantized_interpreter->subgraph(subgraph_idx);
-      if(main_execution_graph != nullptr)
-        CopyIntermediateDataIfNeeded(subgraph, main_execution_graph);
-      // std::cout << "[Minimal precision] Invoke subgraph " << subgraph->GetGraphid() << "\n";
-      clock_gettime(CLOCK_MONOTONIC, &begin);
-      if(subgraph->Invoke() != kTfLiteOk){
-        std::cout << "ERROR on invoking CPU subgraph " << subgraph->GetGraphid() << "\n";
-        return;
-      }
-      clock_gettime(CLOCK_MONOTONIC, &end);
-      response_time =  (end.tv_sec - begin.tv_sec) + ((end.tv_nsec - begin.tv_nsec) / 1000000000.0);
-      latency.push_back(response_time);
-      // sync with gpu here (wake gpu)
-      std::unique_lock<std::mutex> lock_data(data_sync_mtx);
-      is_execution_done = true;
-      co_execution_graph = subgraph;
-      data_sync_cv.notify_one();
-      if(subgraph->GetNextSubgraph() != nullptr)
-        subgraph_idx++;
-      else{
-        WriteVectorLog(latency, 1);
-        // std::cout << "Minimal precision graph invoke done" << "\n";
-        break;
-      }
-    }else if(type == PrecisionType::MAX_PRECISION){
-      subgraph = interpreter->subgraph(subgraph_idx);
-      if(subgraph->GetResourceType() == CO_GPU){
-        // wake cpu thread here
-        std::unique_lock<std::mutex> lock_invoke(invoke_sync_mtx);
-        invoke_cpu = true;
-        if(subgraph->GetPrevSubgraph() != nullptr)
-          main_execution_graph = subgraph;
-        invoke_sync_cv.notify_one();
-      }else{ // if not co-execution, it needs additional imtermediate data copy.
-        if(subgraph->GetPrevSubgraph() != nullptr &&
-            subgraph->GetPrevSubgraph()->GetResourceType() != ResourceType::CO_GPU){
-          CopyIntermediateDataIfNeeded(subgraph);
-        }
-      }
-      // std::cout << "[Max precision] Invoke subgraph " << subgraph->GetGraphid() << "\n";
-      clock_gettime(CLOCK_MONOTONIC, &begin);
-      if(subgraph->Invoke() != kTfLiteOk){
-        std::cout << "ERROR on invoking subgraph id " << subgraph->GetGraphid() << "\n";
-        return;
-      }
-      clock_gettime(CLOCK_MONOTONIC, &end);
-      response_time =  (end.tv_sec - begin.tv_sec) + ((end.tv_nsec - begin.tv_nsec) / 1000000000.0);
-      latency.push_back(response_time);
-      if(subgraph->GetResourceType() == ResourceType::CO_GPU){
-        // sync with cpu here
-        std::unique_lock<std::mutex> lock_data(data_sync_mtx);
-        data_sync_cv.wait(lock_data, [&]{ return is_execution_done; });
-        is_execution_done = false;
-        // data merge here
-        if(co_execution_graph != nullptr){
-          MergeCoExecutionData(co_execution_graph, subgraph);
-          co_execution_graph = nullptr;
-          // int input_tensor = subgraph->GetNextSubgraph()->GetInputTensorIndex();
-          // PrintTensorSerial(*(subgraph->GetNextSubgraph()->tensor(input_tensor)));
-        }
-      }
-      if(subgraph->GetNextSubgraph() != nullptr){
-        subgraph_idx++;
-      }
-      else{
-        main_execution_graph = nullptr;
-        WriteVectorLog(latency, 0);
-        // std::cout << "Max precision graph invoke done" << "\n";
-        // PrintyoloOutput(*(subgraph->tensor(109)));
-        global_output_tensor = subgraph->tensor(subgraph->GetFirstOutputTensorIndex());
-        break;
-      }
+  while(subgraph_idx < interpreter->subgraphs_size()){
+    subgraph = interpreter->subgraph(subgraph_idx);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    if(InvokeSubgraph(subgraph, co_subgraph_idx) != kTfLiteOk){
+      return kTfLiteError;
     }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    latency.push_back((end.tv_sec - begin.tv_sec) +
+                      ((end.tv_nsec - begin.tv_nsec) / 1000000000.0));
+    subgraph_idx++;
   }
-  return;
+  WriteVectorLog(latency, 0);
+  global_output_tensor = subgraph->tensor(subgraph->GetFirstOutputTensorIndex());
+  return kTfLiteOk;
+}
+
+TfLiteStatus TfLiteRuntime::InvokeSubgraph(Subgraph* subgraph,
+                                           int& co_subgraph_idx){
+  if(subgraph->GetResourceType() != ResourceType::CO_GPU){
+    // Input of the subgraph after co-execution is written by merge.
+    if(subgraph->GetPrevSubgraph() != nullptr &&
+        subgraph->GetPrevSubgraph()->GetResourceType() != ResourceType::CO_GPU){
+      CopyIntermediateDataIfNeeded(subgraph);
+    }
+    TfLiteStatus status;
+    if(subgraph->GetResourceType() == ResourceType::CPU_B){
+      // The caller is a thread of the cluster B pool, run it from there.
+      if(co_executor == nullptr)
+        co_executor = new TfCoExecutor(co_execution_cpus);
+      co_executor->Post([subgraph, &status](){ status = subgraph->Invoke(); });
+      co_executor->Wait();
+    }else{
+      status = subgraph->Invoke();
+    }
+    if(status != kTfLiteOk){
+      std::cout << "ERROR on invoking subgraph id " << subgraph->GetGraphid() << "\n";
+      return kTfLiteError;
+    }
+    return kTfLiteOk;
+  }
+  // Co-execution
+  if(quantized_interpreter == nullptr ||
+      co_subgraph_idx >= quantized_interpreter->subgraphs_size()){
+    std::cout << "No minimal precision subgraph for co-execution of subgraph "
+              << subgraph->GetGraphid() << "\n";
+    return kTfLiteError;
+  }
+  if(co_executor == nullptr){
+    co_executor = new TfCoExecutor(co_execution_cpus);
+  }
+  if(subgraph->GetPrevSubgraph() != nullptr &&
+      subgraph->GetPrevSubgraph()->GetResourceType() != ResourceType::CO_GPU){
+    CopyIntermediateDataIfNeeded(subgraph);
+  }
+  Subgraph* min_precision_subgraph =
+                          quantized_interpreter->subgraph(co_subgraph_idx++);
+  Subgraph* input_graph =
+                      subgraph->GetPrevSubgraph() != nullptr ? subgraph : nullptr;
+  co_execution_status = kTfLiteOk;
+  co_executor->Post([this, min_precision_subgraph, input_graph](){
+    if(input_graph != nullptr)
+      CopyIntermediateDataIfNeeded(min_precision_subgraph, input_graph);
+    co_execution_status = min_precision_subgraph->Invoke();
+  });
+  // Let HW-partitioned output land in the next subgraph's input.
+  BindCoExecutionOutput(subgraph);
+  TfLiteStatus status = subgraph->Invoke();
+  co_executor->Wait();
+  if(status != kTfLiteOk || co_execution_status != kTfLiteOk){
+    std::cout << "ERROR on co-execution of subgraph " << subgraph->GetGraphid()
+              << "\n";
+    return kTfLiteError;
+  }
+  if(subgraph->GetNextSubgraph() != nullptr)
+    MergeCoExecutionData(min_precision_subgraph, subgraph);
+  return kTfLiteOk;
 }
 
 TfLiteStatus TfLiteRuntime::DebugInvoke() {
@@ -1040,12 +1890,29 @@ TfLiteStatus TfLiteRuntime::DebugInvoke() {
 };
 
 TfLiteStatus TfLiteRuntime::Invoke(){
+  if(pipeline != nullptr){
+    std::cout << "ERROR cannot invoke runtime [" << runtime_id
+              << "] while pipelined" << "\n";
+    return kTfLiteError;
+  }
+  // Subgraphs may be new since the frame was bound.
+  if(ApplyInputBinding() != kTfLiteOk)
+    return kTfLiteError;
   TfLiteStatus state;
+  frame_deadline_us = deadline_us > 0 ? PolicyNowUs() + deadline_us : 0;
+  // The caller runs cluster A's side. It is pinned on its first inference
+  // and stays pinned, so frames don't pay for the affinity syscalls.
+  if(!cluster_a_cpus.empty() &&
+      cluster_a_thread != std::this_thread::get_id() &&
+      SetThreadAffinity(pthread_self(), cluster_a_cpus))
+    cluster_a_thread = std::this_thread::get_id();
   if(co_execution){
     state = InvokeCoExecution();
   }else{
     state = InvokeSingleExecution();
   }
+  if(frame_deadline_us != 0 && PolicyNowUs() > frame_deadline_us)
+    deadline_misses++;
   return state;
 }
 
@@ -1057,38 +1924,35 @@ TfLiteStatus TfLiteRuntime::InvokeCoExecution(){
   }
   Subgraph* subgraph;
   int subgraph_idx = 0;
+  // Index of the next minimal precision subgraph.
+  int co_subgraph_idx = 0;
   while(subgraph_idx < interpreter->subgraphs_size()){ // subgraph iteration
     subgraph = interpreter->subgraph(subgraph_idx);
-    tf_packet tx_packet;
-    memset(&tx_packet, 0, sizeof(tf_packet));
-    tx_packet.runtime_id = runtime_id;
-    tx_packet.runtime_current_state = state;
-
-    if(subgraph != nullptr){
-      if(subgraph->GetResourceType() == ResourceType::CPU)
-        tx_packet.cur_graph_resource = 0;
-      else if(subgraph->GetResourceType() == ResourceType::GPU)
-        tx_packet.cur_graph_resource = 1;
-      else // Subject to change. (impl CPUGPU Co-execution)
-        tx_packet.cur_graph_resource = 0;
-    }
+    tf_invoke_msg tx_msg;
+    SetMsgHeader(tx_msg.header, TF_MSG_INVOKE, runtime_id, state, state);
+    tx_msg.cur_subgraph = subgraph_idx;
+    tx_msg.cur_graph_resource = InvokeResourceOf(subgraph);
     
-    if(SendPacketToScheduler(tx_packet) != kTfLiteOk){ // Request invoke permission to scheduler
+    // Request invoke permission to scheduler
+    tf_msg_header rx_header;
+    if(AcquireResourceFromScheduler(tx_msg, rx_header, subgraph_idx)
+          != kTfLiteOk){
       return kTfLiteError;
     }
-    tf_packet rx_packet;
-    if(ReceivePacketFromScheduler(rx_packet) != kTfLiteOk){
-      return kTfLiteError;
-    }
-    switch (rx_packet.runtime_next_state)
+    switch (rx_header.runtime_next_state)
     {
     case RuntimeState::INVOKE_ :{
       // Invoke next subgraph in subgraph order.
-      if(subgraph->GetPrevSubgraph() != nullptr){
-        CopyIntermediateDataIfNeeded(subgraph);
+      // CO_GPU subgraph runs with its minimal precision pair on worker.
+      TfLiteStatus invoke_status = InvokeSubgraph(subgraph, co_subgraph_idx);
+      // Release even on failure, other runtimes may wait for the resource.
+      // A subgraph under a lease is released with the lease.
+      if(lease_id == -1 && ReleaseResourceToScheduler(tx_msg) != kTfLiteOk){
+        return kTfLiteError;
       }
-      if(subgraph->Invoke() != kTfLiteOk){
+      if(invoke_status != kTfLiteOk){
         std::cout << "ERROR on invoking subgraph " << subgraph->GetGraphid() << "\n";
+        ReleaseLeaseToScheduler();
         return kTfLiteError;
       }
       if(subgraph->GetNextSubgraph() == nullptr){
@@ -1103,7 +1967,8 @@ TfLiteStatus TfLiteRuntime::InvokeCoExecution(){
       break;
     }
     case RuntimeState::BLOCKED_ : {
-      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      // Scheduler holds a blocked request and replies when the resource is
+      // released, so this is not expected. Request again.
       break;
     }
     case RuntimeState::NEED_PROFILE :{
@@ -1117,17 +1982,31 @@ TfLiteStatus TfLiteRuntime::InvokeCoExecution(){
     case RuntimeState::SUBGRAPH_CREATE :{
       // Need subgraph partitioning.
       // this will delete the existing subgraphs and partition from original model.
-      if(PartitionSubgraphs() != kTfLiteOk){
+      // Other variants hold subgraphs of the stale plans, build them again.
+      ReleasePartitionVariants();
+      if(PartitionSubgraphs() != kTfLiteOk ||
+          ApplyInputBinding() != kTfLiteOk){
         std::cout << "PartitionSubgraphs ERROR" << "\n";
         return kTfLiteError;
       }
+      if(BuildPartitionVariants() != kTfLiteOk)
+        std::cout << "Partition variants incomplete, " << variants.size()
+                  << " built" << "\n";
       subgraph_idx = 0;
+      co_subgraph_idx = 0;
       break;
     }
     default:
       break;
     }
   } // end of subgraph interation
+  // Inference is done, give back the lease if any.
+  if(ReleaseLeaseToScheduler() != kTfLiteOk){
+    return kTfLiteError;
+  }
+  // Frame boundary, the next input is fed to the variant scheduler chose.
+  if(next_variant != active_variant)
+    SwitchPartitionVariant(next_variant);
   return kTfLiteOk;
 }
 
@@ -1142,36 +2021,33 @@ TfLiteStatus TfLiteRuntime::InvokeSingleExecution() {
   int subgraph_idx = 0;
   while(subgraph_idx < interpreter->subgraphs_size()){ // subgraph iteration
     subgraph = interpreter->subgraph(subgraph_idx);
-    tf_packet tx_packet;
-    memset(&tx_packet, 0, sizeof(tf_packet));
-    tx_packet.runtime_id = runtime_id;
-    tx_packet.runtime_current_state = state;
-
-    if(subgraph != nullptr){
-      if(subgraph->GetResourceType() == ResourceType::CPU)
-        tx_packet.cur_graph_resource = 0;
-      else if(subgraph->GetResourceType() == ResourceType::GPU)
-        tx_packet.cur_graph_resource = 1;
-      else // Subject to change. (impl CPUGPU Co-execution)
-        tx_packet.cur_graph_resource = 0;
-    }
-
-    if(SendPacketToScheduler(tx_packet) != kTfLiteOk){ // Request invoke permission to scheduler
-      return kTfLiteError;
-    }
-    tf_packet rx_packet;
-    if(ReceivePacketFromScheduler(rx_packet) != kTfLiteOk){
+    tf_invoke_msg tx_msg;
+    SetMsgHeader(tx_msg.header, TF_MSG_INVOKE, runtime_id, state, state);
+    tx_msg.cur_subgraph = subgraph_idx;
+    tx_msg.cur_graph_resource = InvokeResourceOf(subgraph);
+
+    // Request invoke permission to scheduler
+    tf_msg_header rx_header;
+    if(AcquireResourceFromScheduler(tx_msg, rx_header, subgraph_idx)
+          != kTfLiteOk){
       return kTfLiteError;
     }
-    switch (rx_packet.runtime_next_state)
+    switch (rx_header.runtime_next_state)
     {
     case RuntimeState::INVOKE_ :{
       // Invoke next subgraph in subgraph order.
       if(subgraph->GetPrevSubgraph() != nullptr){
         CopyIntermediateDataIfNeeded(subgraph);
       }
-      if(subgraph->Invoke() != kTfLiteOk){
+      TfLiteStatus invoke_status = subgraph->Invoke();
+      // Release even on failure, other runtimes may wait for the resource.
+      // A subgraph under a lease is released with the lease.
+      if(lease_id == -1 && ReleaseResourceToScheduler(tx_msg) != kTfLiteOk){
+        return kTfLiteError;
+      }
+      if(invoke_status != kTfLiteOk){
         std::cout << "ERROR on invoking subgraph " << subgraph->GetGraphid() << "\n";
+        ReleaseLeaseToScheduler();
         return kTfLiteError;
       }
       if(subgraph->GetNextSubgraph() == nullptr){
@@ -1186,7 +2062,8 @@ TfLiteStatus TfLiteRuntime::InvokeSingleExecution() {
       break;
     }
     case RuntimeState::BLOCKED_ : {
-      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      // Scheduler holds a blocked request and replies when the resource is
+      // released, so this is not expected. Request again.
       break;
     }
     case RuntimeState::NEED_PROFILE :{
@@ -1200,10 +2077,16 @@ TfLiteStatus TfLiteRuntime::InvokeSingleExecution() {
     case RuntimeState::SUBGRAPH_CREATE :{
       // Need subgraph partitioning.
       // this will delete the existing subgraphs and partition from original model.
-      if(PartitionSubgraphs() != kTfLiteOk){
+      // Other variants hold subgraphs of the stale plans, build them again.
+      ReleasePartitionVariants();
+      if(PartitionSubgraphs() != kTfLiteOk ||
+          ApplyInputBinding() != kTfLiteOk){
         std::cout << "PartitionSubgraphs ERROR" << "\n";
         return kTfLiteError;
       }
+      if(BuildPartitionVariants() != kTfLiteOk)
+        std::cout << "Partition variants incomplete, " << variants.size()
+                  << " built" << "\n";
       subgraph_idx = 0;
       break;
     }
@@ -1211,6 +2094,254 @@ TfLiteStatus TfLiteRuntime::InvokeSingleExecution() {
       break;
     }
   } // end of subgraph interation
+  // Inference is done, give back the lease if any.
+  if(ReleaseLeaseToScheduler() != kTfLiteOk){
+    return kTfLiteError;
+  }
+  // Frame boundary, the next input is fed to the variant scheduler chose.
+  if(next_variant != active_variant)
+    SwitchPartitionVariant(next_variant);
+  return kTfLiteOk;
+}
+
+TfLiteStatus TfLiteRuntime::StartPipeline(int depth){
+  if(pipeline != nullptr)
+    return kTfLiteOk;
+  if(state != RuntimeState::INVOKE_ || interpreter->subgraphs_size() == 0){
+    std::cout << "ERROR cannot pipeline runtime [" << runtime_id << "]\n";
+    std::cout << "State is not INVOKE. cur state is " << state << "\n";
+    return kTfLiteError;
+  }
+  if(depth < 1)
+    depth = 1;
+  pipeline_stages.clear();
+  for(int i=0; i<interpreter->subgraphs_size(); ++i){
+    Subgraph* subgraph = interpreter->subgraph(i);
+    if(subgraph->GetResourceType() == ResourceType::CO_GPU){
+      std::cout << "Co-execution subgraph " << subgraph->GetGraphid()
+                << " cannot be pipelined" << "\n";
+      return kTfLiteError;
+    }
+    const int resource = InvokeResourceOf(subgraph);
+    if(pipeline_stages.empty() || pipeline_stages.back().resource != resource)
+      pipeline_stages.push_back({i, i, resource});
+    else
+      pipeline_stages.back().last = i;
+  }
+  // Boundary tensors, matched like CopyIntermediateDataIfNeeded does.
+  const int stages = pipeline_stages.size();
+  pipeline_boundaries.assign(stages + 1, PipelineBoundary());
+  auto fail = [this](){
+    FreePipelineBuffers();
+    return kTfLiteError;
+  };
+  for(int b=0; b<=stages; ++b){
+    PipelineBoundary& boundary = pipeline_boundaries[b];
+    Subgraph* source = b > 0 ?
+        interpreter->subgraph(pipeline_stages[b - 1].last) : nullptr;
+    Subgraph* dest = b < stages ?
+        interpreter->subgraph(pipeline_stages[b].first) : nullptr;
+    TfLiteIntArray* candidates = dest != nullptr ?
+        dest->GetInputTensorIndices() : source->GetOutputTensorIndices();
+    for(int i=0; i<candidates->size; ++i){
+      const int tensor_idx = candidates->data[i];
+      if(std::find(boundary.tensors.begin(), boundary.tensors.end(),
+                   tensor_idx) != boundary.tensors.end())
+        continue;
+      if(source != nullptr && dest != nullptr){
+        TfLiteIntArray* outputs = source->GetOutputTensorIndices();
+        if(std::find(outputs->data, outputs->data + outputs->size,
+                     tensor_idx) == outputs->data + outputs->size)
+          continue;
+      }
+      TfLiteTensor* tensor = (dest != nullptr ? dest : source)->tensor(tensor_idx);
+      // Constant inputs are not carried between stages.
+      if(tensor == nullptr || tensor->allocation_type == kTfLiteMmapRo)
+        continue;
+      boundary.tensors.push_back(tensor_idx);
+      boundary.bytes.push_back(tensor->bytes);
+    }
+    boundary.buffers.assign(depth, std::vector<void*>());
+    for(int slot=0; slot<depth; ++slot){
+      for(size_t bytes : boundary.bytes){
+        const size_t aligned = (bytes + kDefaultTensorAlignment - 1) /
+                               kDefaultTensorAlignment * kDefaultTensorAlignment;
+        void* buffer = aligned_alloc(kDefaultTensorAlignment,
+                                     aligned > 0 ? aligned : kDefaultTensorAlignment);
+        if(buffer == nullptr){
+          std::cout << "Allocating pipeline buffers FAILED" << "\n";
+          return fail();
+        }
+        boundary.buffers[slot].push_back(buffer);
+      }
+    }
+    if(b > 0 && b < stages && boundary.tensors.empty()){
+      std::cout << "Stage " << b << " has no input from stage " << b - 1 << "\n";
+      return fail();
+    }
+  }
+  // Keep arena data of bound tensors to restore sequential Invoke.
+  pipeline_arena_data.clear();
+  for(int b=0; b<=stages; ++b){
+    std::vector<Subgraph*> subgraphs;
+    if(b > 0)
+      subgraphs.push_back(interpreter->subgraph(pipeline_stages[b - 1].last));
+    if(b < stages)
+      subgraphs.push_back(interpreter->subgraph(pipeline_stages[b].first));
+    for(Subgraph* subgraph : subgraphs){
+      for(int tensor_idx : pipeline_boundaries[b].tensors){
+        TfLiteTensor* tensor = subgraph->tensor(tensor_idx);
+        pipeline_arena_data.push_back({tensor, tensor->data.data});
+      }
+    }
+  }
+  // Stage workers share the IPC of runtime, a lease would be taken by
+  // whichever stage asks first.
+  if(ReleaseLeaseToScheduler() != kTfLiteOk)
+    return fail();
+  use_lease_before_pipeline = use_lease;
+  use_lease = false;
+  pipeline_deadline_us.assign(depth, 0);
+  pipeline_input_frame.assign(depth, -1);
+  // Stages on cluster B stay on it and the others on cluster A. Without
+  // clusters stages inherit the caller's affinity.
+  std::vector<std::vector<int>> cpus(stages);
+  for(int i=0; i<stages; ++i){
+    if(pipeline_stages[i].resource == ResourceType::CPU_B)
+      cpus[i] = co_execution_cpus;
+    else
+      cpus[i] = cluster_a_cpus;
+  }
+  pipeline = new TfPipeline(stages, depth, [this](int stage, int slot){
+    return InvokePipelineStage(stage, slot) == kTfLiteOk;
+  }, cpus);
+  std::cout << "Runtime " << runtime_id << " pipelined in " << stages
+            << " stages, depth " << depth << "\n";
+  return kTfLiteOk;
+}
+
+void TfLiteRuntime::StopPipeline(){
+  if(pipeline == nullptr)
+    return;
+  // Frames in flight are finished by the destructor.
+  delete pipeline;
+  pipeline = nullptr;
+  for(const auto& arena_data : pipeline_arena_data)
+    arena_data.first->data.data = arena_data.second;
+  pipeline_arena_data.clear();
+  FreePipelineBuffers();
+  use_lease = use_lease_before_pipeline;
+}
+
+void TfLiteRuntime::FreePipelineBuffers(){
+  for(PipelineBoundary& boundary : pipeline_boundaries){
+    for(std::vector<void*>& buffers : boundary.buffers){
+      for(void* buffer : buffers)
+        free(buffer);
+    }
+  }
+  pipeline_boundaries.clear();
+  pipeline_stages.clear();
+}
+
+TfLiteStatus TfLiteRuntime::BeginPipelineFrame(std::vector<void*>& inputs){
+  if(pipeline == nullptr)
+    return kTfLiteError;
+  pipeline_slot = pipeline->BeginFrame();
+  inputs = pipeline_boundaries.front().buffers[pipeline_slot];
+  return kTfLiteOk;
+}
+
+TfLiteStatus TfLiteRuntime::SubmitPipelineFrame(int frame){
+  if(pipeline == nullptr || pipeline_slot == -1)
+    return kTfLiteError;
+  if(frame >= static_cast<int>(input_buffers.size())){
+    std::cout << "Input frame " << frame << " is not registered" << "\n";
+    return kTfLiteError;
+  }
+  pipeline_input_frame[pipeline_slot] = frame;
+  pipeline_deadline_us[pipeline_slot] =
+      deadline_us > 0 ? PolicyNowUs() + deadline_us : 0;
+  pipeline_slot = -1;
+  pipeline->SubmitFrame();
+  return kTfLiteOk;
+}
+
+TfLiteStatus TfLiteRuntime::WaitPipelineFrame(
+                                          std::vector<const void*>& outputs){
+  if(pipeline == nullptr)
+    return kTfLiteError;
+  bool ok;
+  const int slot = pipeline->WaitFrame(ok);
+  if(slot == -1)
+    return kTfLiteError;
+  if(pipeline_deadline_us[slot] != 0 &&
+      PolicyNowUs() > pipeline_deadline_us[slot])
+    deadline_misses++;
+  const std::vector<void*>& buffers = pipeline_boundaries.back().buffers[slot];
+  outputs.assign(buffers.begin(), buffers.end());
+  return ok ? kTfLiteOk : kTfLiteError;
+}
+
+void TfLiteRuntime::ReleasePipelineFrame(){
+  if(pipeline != nullptr)
+    pipeline->ReleaseFrame();
+}
+
+void TfLiteRuntime::BindPipelineBoundary(Subgraph* subgraph, int boundary,
+                                         int slot){
+  const PipelineBoundary& bound = pipeline_boundaries[boundary];
+  for(int i=0; i<bound.tensors.size(); ++i)
+    subgraph->tensor(bound.tensors[i])->data.data = bound.buffers[slot][i];
+}
+
+TfLiteStatus TfLiteRuntime::InvokePipelineStage(int stage, int slot){
+  const PipelineStage& pipeline_stage = pipeline_stages[stage];
+  std::mutex& invoke_mutex = pipeline_stage.resource == ResourceType::GPU ?
+                             gpu_invoke_mutex : host_invoke_mutex;
+  for(int i=pipeline_stage.first; i<=pipeline_stage.last; ++i){
+    Subgraph* subgraph = interpreter->subgraph(i);
+    // Inside a stage, subgraphs are connected on the arena as usual.
+    if(i == pipeline_stage.first)
+      BindPipelineBoundary(subgraph, stage, slot);
+    else
+      CopyIntermediateDataIfNeeded(subgraph);
+    // A registered input frame is read in place.
+    if(i == 0 && pipeline_input_frame[slot] != -1)
+      subgraph->tensor(subgraph->GetInputTensorIndex())->data.data =
+          input_buffers[pipeline_input_frame[slot]].data;
+    if(i == pipeline_stage.last)
+      BindPipelineBoundary(subgraph, stage + 1, slot);
+    tf_invoke_msg tx_msg;
+    SetMsgHeader(tx_msg.header, TF_MSG_INVOKE, runtime_id, state, state);
+    tx_msg.cur_subgraph = i;
+    tx_msg.cur_graph_resource = pipeline_stage.resource;
+    tx_msg.lease_resources = 0;
+    FillSchedulingParams(tx_msg);
+    tx_msg.deadline_us = pipeline_deadline_us[slot];
+    tf_lease_msg rx_grant;
+    if(RequestInvokeToScheduler(tx_msg, rx_grant) != kTfLiteOk)
+      return kTfLiteError;
+    if(rx_grant.header.runtime_next_state != RuntimeState::INVOKE_){
+      // Not granted. Partitioning changes only in sequential Invoke().
+      std::cout << "Runtime " << runtime_id << " re-planned while pipelined,"
+                << " stop the pipeline" << "\n";
+      return kTfLiteError;
+    }
+    TfLiteStatus status;
+    {
+      std::lock_guard<std::mutex> lock(invoke_mutex);
+      status = subgraph->Invoke();
+    }
+    // Release even on failure, other runtimes may wait for the resource.
+    if(ReleaseResourceToScheduler(tx_msg) != kTfLiteOk)
+      return kTfLiteError;
+    if(status != kTfLiteOk){
+      std::cout << "ERROR on invoking subgraph " << subgraph->GetGraphid()
+                << " in pipeline" << "\n";
+      return kTfLiteError;
+    }
+  }
   return kTfLiteOk;
 }
 
@@ -1274,33 +2405,33 @@ void TfLiteRuntime::MergeCoExecutionData(Subgraph* min_precision_subgraph
     std::cout << "Tensor rank must 4" << "\n";
     return;
   }
-  // This flag means that the tensor is de-quantized temporary for merge.
-  // Restore to the original buffer after merge.
-  float* dequantized_buffer = nullptr;
-
-  if(min_precision_tensor->type == kTfLiteUInt8 || 
-      min_precision_tensor->type == kTfLiteInt8 ){
-    dequantized_buffer = (float*)DequantizeGivenTensorWithReference(
-                                  min_precision_tensor, 
-                                  dequant_reference_tensor);
-    if(dequantized_buffer == nullptr){
-      std::cout << "DeQuantizeGivenTensor returned nullptr ERROR" << "\n";
-      return;
-    }
-  }
-  // minimum precision side data buffer.
-  float* data_min; 
-  if(dequantized_buffer != nullptr){
-    data_min = dequantized_buffer;
-  }else{
-    data_min = (float*)min_precision_tensor->data.data;
+  const bool quantized_min = min_precision_tensor->type == kTfLiteUInt8 ||
+                            min_precision_tensor->type == kTfLiteInt8;
+  float scale = 0;
+  int zero_point = 0;
+  if(quantized_min &&
+      !GetDequantizationParams(dequant_reference_tensor, &scale, &zero_point)){
+    std::cout << "Dequantization parameter ERROR" << "\n";
+    return;
   }
   // max precision side data buffer.
+  // Same as destination if it was bound by BindCoExecutionOutput.
   float* data_max = (float*)max_precision_tensor->data.data;
   
   // destination buffer.
   float* data_dest = (float*)dest_tensor->data.data;
 
+  // A channel block which is not partitioned(see PlanChannelBlocks) is
+  // computed in full by both sides, max precision side is the output.
+  if(max_precision_subgraph->GetPartitioningType() ==
+        PartitioningType::CHANNEL_PARTITIONING &&
+      max_precision_tensor->bytes == dest_tensor->bytes &&
+      max_precision_tensor->dims->data[3] == dest_tensor->dims->data[3]){
+    if(data_max != data_dest)
+      memcpy(data_dest, data_max, dest_tensor->bytes);
+    return;
+  }
+
   // check dims 
   if(dest_tensor->dims->data[3] == 
       min_precision_tensor->dims->data[3] + max_precision_tensor->dims->data[3]){
@@ -1309,30 +2440,34 @@ void TfLiteRuntime::MergeCoExecutionData(Subgraph* min_precision_subgraph
     dest_ch = dest_tensor->dims->data[3];
     min_tensor_ch = min_precision_tensor->dims->data[3];
     max_tensor_ch = max_precision_tensor->dims->data[3];
-    // std::cout << "min_tensor_ch " << min_tensor_ch << " max_tensor_ch " << max_tensor_ch << "\n";
-    if((min_tensor_ch + max_tensor_ch) != dest_ch){
-      std::cout << "Tensor dim [OCH] min_prec + max_prec != dest ERROR" << "\n";
-      return;
-    }
     int tensor_data_size = 1;
     for(int i=0; i<dest_tensor->dims->size; ++i){
       tensor_data_size *= dest_tensor->dims->data[i];
     }
-    // WRONG MERGE
-    // WRONG MERGE
-    // WRONG MERGE
     // Note : max pricision side is front channel.
+    // Kernels write dense outputs, so max precision side can't be bound to
+    // the strided channels of destination and is copied per pixel.
     int tensor_data_per_ch = tensor_data_size / dest_ch;
-    for(int i=0; i<tensor_data_per_ch; ++i){ //copy minimum precision side data
+    for(int i=0; i<tensor_data_per_ch; ++i){
       memcpy(data_dest + (dest_ch * i), data_max + (max_tensor_ch * i),
               max_tensor_ch * sizeof(float));
     }
-    
-    for(int i=0; i<tensor_data_per_ch; ++i){ //copy minimum precision side data
-      memcpy(data_dest + max_tensor_ch + (dest_ch * i), data_min + (min_tensor_ch * i),
-              min_tensor_ch * sizeof(float));
+    // Minimum precision side is dequantized straight into its channels.
+    if(min_precision_tensor->type == kTfLiteInt8){
+      DequantizeInterleave((int8_t*)min_precision_tensor->data.data,
+                           data_dest + max_tensor_ch, tensor_data_per_ch,
+                           min_tensor_ch, dest_ch, scale, zero_point);
+    }else if(quantized_min){
+      DequantizeInterleave((uint8_t*)min_precision_tensor->data.data,
+                           data_dest + max_tensor_ch, tensor_data_per_ch,
+                           min_tensor_ch, dest_ch, scale, zero_point);
+    }else{
+      auto data_min = (float*)min_precision_tensor->data.data;
+      for(int i=0; i<tensor_data_per_ch; ++i){
+        memcpy(data_dest + max_tensor_ch + (dest_ch * i),
+               data_min + (min_tensor_ch * i), min_tensor_ch * sizeof(float));
+      }
     }
-    
   }else{ // Merge HW-partitioned data
     int dest_ht = dest_tensor->dims->data[1];
     int min_tensor_ht = min_precision_tensor->dims->data[1];
@@ -1351,30 +2486,134 @@ void TfLiteRuntime::MergeCoExecutionData(Subgraph* min_precision_subgraph
     for(int i=0; i<min_precision_tensor->dims->size; ++i){
       min_precision_data_size *= min_precision_tensor->dims->data[i];
     }
+    if(max_precision_data_size > tensor_dest_data_size){
+      std::cout << "Wrong HW merging ERROR, max precision side exceeds dest"
+                << "\n";
+      return;
+    }
+    // Start of minimum precision side rows in destination.
+    // Exact height partitioning gives the split row. Max precision rows
+    // after it are halo and overwritten by minimum precision side.
+    int split_size = max_precision_data_size;
+    const int split = max_precision_subgraph->GetHeightPartitionSplit();
+    if(split > 0 && split <= max_tensor_ht && split < dest_ht){
+      split_size = split * (tensor_dest_data_size / dest_ht);
+    }
+    // Rows of minimum precision side to fill after the split.
+    int min_copy_size = tensor_dest_data_size - split_size;
     // Need to drop padding data before merge if it's not fit with destination tensor.
     // Drop minimum precision data because it is dequantized and might drop accuracy.
-    if((min_tensor_ht + max_tensor_ht) != dest_ht){
-      float drop_height = (dest_ht - (min_tensor_ht + max_tensor_ht))/(-2);
-      if(drop_height < 0){
-        std::cout << "Wrong drop in HW merging ERROR on graph" << "\n";
-        std::cout << "min sub: " << min_precision_subgraph->GetGraphid() <<
-              " h: " << min_tensor_ht << 
-              " max sub: " << max_precision_subgraph->GetGraphid() << 
-              " h: " << max_tensor_ht << " dest: " << dest_ht << "\n";
-        return;
-      }
-      memcpy(data_dest, data_max, sizeof(float)*max_precision_data_size);
-      memcpy(data_dest+max_precision_data_size, data_min, 
-              sizeof(float)*(tensor_dest_data_size - min_precision_data_size));
-    }else{  // No need to drop (fits with destination tensor).
+    // Minimum precision side got the bottom rows of input, so its padding
+    // rows are on top.
+    if(min_copy_size > min_precision_data_size){
+      std::cout << "Wrong drop in HW merging ERROR on graph" << "\n";
+      std::cout << "min sub: " << min_precision_subgraph->GetGraphid() <<
+            " h: " << min_tensor_ht << 
+            " max sub: " << max_precision_subgraph->GetGraphid() << 
+            " h: " << max_tensor_ht << " dest: " << dest_ht << "\n";
+      return;
+    }
+    int min_offset = min_precision_data_size - min_copy_size;
+    if(data_max != data_dest){ // not bound to destination
       memcpy(data_dest, data_max, sizeof(float)*max_precision_data_size);
-      memcpy(data_dest+max_precision_data_size, data_min, 
-              sizeof(float)*min_precision_data_size);
+    }
+    if(min_precision_tensor->type == kTfLiteInt8){
+      DequantizeInterleave((int8_t*)min_precision_tensor->data.data + min_offset,
+                           data_dest + split_size, 1,
+                           min_copy_size, min_copy_size, scale, zero_point);
+    }else if(quantized_min){
+      DequantizeInterleave((uint8_t*)min_precision_tensor->data.data + min_offset,
+                           data_dest + split_size, 1,
+                           min_copy_size, min_copy_size, scale, zero_point);
+    }else{
+      memcpy(data_dest + split_size,
+             (float*)min_precision_tensor->data.data + min_offset,
+             sizeof(float)*min_copy_size);
     }
   }
   return; 
 }
 
+void TfLiteRuntime::BindCoExecutionOutput(Subgraph* max_precision_subgraph){
+  Subgraph* dest_subgraph = max_precision_subgraph->GetNextSubgraph();
+  if(dest_subgraph == nullptr)
+    return;
+  TfLiteTensor* dest_tensor =
+      dest_subgraph->tensor(dest_subgraph->GetInputTensorIndex());
+  TfLiteTensor* max_precision_tensor = max_precision_subgraph->tensor(
+      max_precision_subgraph->GetFirstOutputTensorIndex());
+  if(dest_tensor == nullptr || max_precision_tensor == nullptr)
+    return;
+  if(dest_tensor->type != kTfLiteFloat32 ||
+      max_precision_tensor->type != kTfLiteFloat32 ||
+      dest_tensor->dims->size < 4 || max_precision_tensor->dims->size < 4)
+    return;
+  // Only HW-partitioned output is a dense prefix(top rows) of destination.
+  // CW-partitioned output is strided in destination and merged by copy.
+  for(int i=0; i<4; ++i){
+    if(i != 1 &&
+        dest_tensor->dims->data[i] != max_precision_tensor->dims->data[i])
+      return;
+  }
+  if(max_precision_tensor->bytes > dest_tensor->bytes)
+    return;
+  max_precision_tensor->data.data = dest_tensor->data.data;
+}
+
+bool TfLiteRuntime::GetDequantizationParams(TfLiteTensor* ref_tensor,
+                                            float* scale, int* zero_point){
+  if(ref_tensor == nullptr){
+    std::cout << "Got reference tensor nullptr ERROR" << "\n";
+    return false;
+  }
+  if(ref_tensor->quantization.params != nullptr){
+    TfLiteAffineQuantization* params =
+      (TfLiteAffineQuantization*)ref_tensor->quantization.params;
+    *scale = params->scale->data[0];
+    *zero_point = params->zero_point->data[0];
+    if(*zero_point == 128)
+      *zero_point = 0;
+    return true;
+  }
+  if(ref_tensor->type != kTfLiteFloat32)
+    return false;
+  // Same as CalcQuantizationParamsFromTensor without allocation.
+  int tensor_data_size = 1;
+  for(int i=0; i<ref_tensor->dims->size; ++i){
+    tensor_data_size *= ref_tensor->dims->data[i];
+  }
+  float min_value, max_value;
+  MinMaxFloats((float*)ref_tensor->data.data, tensor_data_size, &min_value,
+               &max_value);
+  const float range = std::max(std::abs(min_value), std::abs(max_value));
+  *scale = range / 255;
+  *zero_point = std::round(((max_value * 0) - (min_value * 255))/
+                           (max_value - min_value));
+  return true;
+}
+
+TfLiteAffineQuantization* TfLiteRuntime::GetHandoffQuantParams(
+                                                    TfLiteTensor* tensor){
+  auto it = handoff_quant_params.find(tensor);
+  if(it != handoff_quant_params.end() &&
+      tensor->quantization.params == it->second)
+    return it->second;
+  // Replaces params of the model, which are not used for co-execution input.
+  if(tensor->quantization.params != nullptr)
+    TfLiteQuantizationFree(&tensor->quantization);
+  TfLiteAffineQuantization* params = (TfLiteAffineQuantization*)malloc(
+                                          sizeof(TfLiteAffineQuantization));
+  params->scale = TfLiteFloatArrayCreate(1);
+  params->zero_point = TfLiteIntArrayCreate(1);
+  params->scale->data[0] = 1;
+  params->zero_point->data[0] = 0;
+  params->quantized_dimension = 1;
+  tensor->quantization.type = kTfLiteAffineQuantization;
+  tensor->quantization.params = params;
+  handoff_quant_params[tensor] = params;
+  return params;
+}
+
 void TfLiteRuntime::CopyIntermediateDataIfNeeded(Subgraph* subgraph) {
   // use source_graph_id, dest_graph_id
   auto connect = [&](int source_subgraph, int dest_subgraph) {
@@ -1453,7 +2692,6 @@ void TfLiteRuntime::CopyIntermediateDataIfNeeded(Subgraph* min_precision_subgrap
     TfLiteTensor* dest_tensor = dest_subgraph->tensor(input_tensor_idx);
     // std::cout << "source_tensor : " << source_tensor_idx << "\n";
     // std::cout << "dest_tensor : " << input_tensor_idx << "\n";
-    void* data_source = nullptr;
     int source_data_size = 1;
     int dest_data_size = 1;
     for(int i=0; i<source_tensor->dims->size; ++i){
@@ -1465,22 +2703,21 @@ void TfLiteRuntime::CopyIntermediateDataIfNeeded(Subgraph* min_precision_subgrap
     // Match tensor precision (quantize)
     if(source_tensor->type == kTfLiteFloat32 &&
           dest_tensor->type == kTfLiteUInt8){
-      // std::cout << "quant int" << "\n";
+      // Parameters come from the whole source, but only the slice of
+      // destination is quantized, straight into it.
+      auto data_source = (float*)source_tensor->data.data;
       auto data_dest = (uint8_t*)dest_tensor->data.data;
-      TfLiteAffineQuantization* new_quantization_params = new TfLiteAffineQuantization;
-      data_source = QuantizeGivenTensorandReturnBuffer(source_tensor,
-                                                       new_quantization_params);
       int offset = source_data_size - dest_data_size;
-      memcpy(data_dest, data_source + offset, dest_data_size*(sizeof(uint8_t)));
-      free(data_source);           
-      // std::cout << "Copied intermediate data from main graph" << "\n";
-      dest_tensor->quantization.params = reinterpret_cast<void*>(new_quantization_params);
-      // printf("%p \n", new_quantization_params);
-      // std::cout << "Asdfa" << "\n";
-      dest_tensor->quantization.type = kTfLiteAffineQuantization;
-      // printf("set scale %.6f, zp %d \n",
-      //   new_quantization_params->scale->data[0],
-      //   new_quantization_params->zero_point->data[0]);
+      float min_value, max_value;
+      float scaling_factor = 0;
+      int32_t zero_point = 0;
+      MinMaxFloats(data_source, source_data_size, &min_value, &max_value);
+      QuantizeSymFloatsMain(data_source + offset, dest_data_size,
+                            (int8_t*)data_dest, min_value, max_value,
+                            &scaling_factor, &zero_point);
+      TfLiteAffineQuantization* params = GetHandoffQuantParams(dest_tensor);
+      params->scale->data[0] = scaling_factor;
+      params->zero_point->data[0] = zero_point;
     }else{ 
       // std::cout << "no quant int" << "\n";
       // Maybe consider memory footprint.
@@ -1528,11 +2765,7 @@ void TfLiteRuntime::QuantizeFloats(const float* float_data_ptr, int n_batch,
 void TfLiteRuntime::QuantizeSymFloats(const float* values, const int size,
                                 int8_t* quantized_values, float* min_value,
               float* max_value, float* scaling_factor, int32_t* zero_points){
-  auto minmax = std::minmax_element(values, values + size);
-  *min_value = *minmax.first;
-  *max_value = *minmax.second;
-  const int zero_point = 
-    std::round(((*max_value * 0) - (*min_value * 255))/(*max_value - *min_value));
+  MinMaxFloats(values, size, min_value, max_value);
   QuantizeSymFloatsMain(values, size, quantized_values, *min_value,
                             *max_value, scaling_factor, zero_points);
 }
@@ -1550,14 +2783,9 @@ void TfLiteRuntime::QuantizeSymFloatsMain(const float* values, const int size,
     return;
   }
   *scaling_factor = range / kScale;
-  //zero_points =  
-  for (int i = 0; i < size; ++i) {
-    const int32_t quantized_value =
-        static_cast<int32_t>(TfLiteRound(values[i] * *scaling_factor) + *zero_points);
-    // Clamp: just in case some odd numeric offset.
-    quantized_values[i] = static_cast<int8_t>(
-        std::min(kScale, std::max(0, quantized_value)));
-  }
+  // Clamps to [0, kScale] like uint8.
+  QuantizeFloatsToUint8(values, size, *scaling_factor, *zero_points,
+                        reinterpret_cast<uint8_t*>(quantized_values));
 }
 
 TfLiteAffineQuantization* TfLiteRuntime::CalcQuantizationParamsFromTensor(
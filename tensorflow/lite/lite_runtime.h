@@ -7,11 +7,13 @@
 #include <vector>
 #include <utility>
 #include <queue>
+#include <unordered_map>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include <functional>
+#include <mutex>
 
 #include "condition_variable"
 #include "opencv2/opencv.hpp"
@@ -24,6 +26,16 @@
 #include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/cppmath.h"
+#include "tensorflow/lite/profiling/buffered_profiler.h"
+#include "tensorflow/lite/tf_protocol.h"
+#include "tensorflow/lite/tf_channel.h"
+#include "tensorflow/lite/tf_dequantize.h"
+#include "tensorflow/lite/tf_quantize.h"
+#include "tensorflow/lite/tf_coexecutor.h"
+#include "tensorflow/lite/tf_cache.h"
+#include "tensorflow/lite/tf_policy.h"
+#include "tensorflow/lite/tf_pipeline.h"
+#include "tensorflow/lite/tf_preprocess.h"
 #include "thread"
 #include "future"
 
@@ -38,12 +50,30 @@ namespace tflite{
 
 class LiteScheduler;
 
+// Interpreters of a partitioning plan.
+// quantized_* are nullptr if not co-execution.
+typedef struct PartitionVariant{
+  tflite::Interpreter* interpreter;
+  tflite::InterpreterBuilder* builder;
+  tflite::Interpreter* quantized_interpreter;
+  tflite::InterpreterBuilder* quantized_builder;
+}PartitionVariant;
+
 class TfLiteRuntime{
   public:
     TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
                       const char* model, INPUT_TYPE type);
     TfLiteRuntime(char* uds_runtime, char* uds_scheduler,
                       const char* f_model, const char* i_model, INPUT_TYPE type);
+    // CPU-cluster co-execution without GPU. Layers are split between two
+    // CPU clusters, each with its own XNNPACK delegate whose threads stay on
+    // the cores of the cluster. The calling thread invokes cluster A's side.
+    // It is pinned to cluster A during the constructor, and from its first
+    // Invoke() on(the affinity is not restored). The co-execution worker
+    // invokes cluster B's. Both sides run the float 'model'.
+    TfLiteRuntime(char* uds_runtime, char* uds_scheduler, const char* model,
+                  const CpuClusterOptions& cluster_a,
+                  const CpuClusterOptions& cluster_b, INPUT_TYPE type);
 
     ~TfLiteRuntime();
 
@@ -53,6 +83,13 @@ class TfLiteRuntime{
     TfLiteStatus AddModelToRuntime(const char* f_model, const char* i_model);
     
     TfLiteStatus RegisterModeltoScheduler();
+
+    // Profiles per-node latency of the original subgraph on each resource
+    // (CPU builtin, XNNPACK, GPU and the minimal precision side of
+    // co-execution) and fills the given profile.
+    // Must be called before partitioning, in NEED_PROFILE state.
+    TfLiteStatus ProfileOriginalSubgraph(tf_profile& profile);
+
     TfLiteStatus PartitionSubgraphs();
 
     // Partitions subgraph in both Float & Int.
@@ -61,11 +98,55 @@ class TfLiteRuntime{
     // Prepares co-execution for intermediate & shared tensors between interpreters.
     TfLiteStatus PrepareCoExecution();
 
+    // Builds the partition variants received with the plan, after the
+    // primary plan is partitioned. Variants share the model buffers(weights)
+    // of the primary one, but have their own subgraphs and arenas so that a
+    // switch doesn't re-allocate. Built again after every re-partition.
+    // Stops at a variant which fails to build, the ones before are kept.
+    TfLiteStatus BuildPartitionVariants();
+
+    // Switches back to the primary variant and deletes the others.
+    void ReleasePartitionVariants();
+
+    // Invokes 'variant' from the next inference. Call between inferences.
+    // Scheduler picks the variant with every grant and the runtime switches
+    // at the end of inference.
+    TfLiteStatus SwitchPartitionVariant(int variant);
+    int GetPartitionVariant() { return active_variant; }
+
     void FeedInputToModel(const char* model, std::vector<cv::Mat>& input,
                           INPUT_TYPE input_type);
     void FeedInputToModel(const char* model, cv::Mat& input,
                           INPUT_TYPE input_type);
 
+    //// Zero-copy input
+    // Registers frame buffers of the caller(ex. a V4L2 or decoder ring) as
+    // the storage of model input, so that a frame is bound instead of
+    // copied. Frame i is buffers[i] for interpreter and quantized_buffers[i]
+    // for the quantized interpreter of co-execution, empty if not needed.
+    // Each must be aligned to kDefaultTensorAlignment and hold the input
+    // tensor of its interpreter. Buffers are not owned, keep them alive
+    // while the runtime may read them. Registering again replaces frames.
+    TfLiteStatus RegisterInputBuffers(
+        const std::vector<TfLiteCustomAllocation>& buffers,
+        const std::vector<TfLiteCustomAllocation>& quantized_buffers = {});
+    // Makes registered frame 'frame' the input of the next Invoke(), with
+    // SetCustomAllocationForTensor. It stays bound over re-partitioning
+    // until another frame is bound.
+    TfLiteStatus BindInputBuffer(int frame);
+    //////
+
+    //// Native preprocessing
+    // Resizes, normalizes and quantizes a camera frame into the model input
+    // of interpreter and, for co-execution, of quantized interpreter in one
+    // pass(see TfPreprocessor). Size and type follow each input tensor, a
+    // quantized input uses the scale and zero point of its tensor.
+    TfLiteStatus FeedFrameToModel(const TfFrame& frame,
+                                  const TfNormalization& normalization);
+    // Threads which split the rows of FeedFrameToModel, 1 by default.
+    void SetPreprocessThreads(int threads);
+    //////
+
     
     /// For debugging only ==
     void InitLogFile();
@@ -73,19 +154,13 @@ class TfLiteRuntime{
     std::ofstream logFile; 
     std::ofstream logFile_; 
 
-    void FeedInputToInterpreter(std::vector<cv::Mat>& mnist, 
-                                  std::vector<cv::Mat>& imagetnet);
-
     // Debug invoke (for single interpreter invoke test) 
     TfLiteStatus DebugInvoke();
 
-    // Debug invoke (for co-execution invoke test api) 
+    // Debug invoke (for co-execution invoke test api without scheduler)
+    // Use InvokeCoExecution() with scheduler.
     TfLiteStatus DebugCoInvoke();
 
-    // Debug invoke (for co-execution invoke synchronization test)
-    // Call after DebugCoInvoke()
-    void DebugSyncInvoke(PrecisionType type);
-
     void FeedInputToModelDebug(const char* model, cv::Mat& input,
                                cv::Mat& input_quant, INPUT_TYPE input_type);
     void PrintOutput(Subgraph* subgraph);
@@ -100,9 +175,47 @@ class TfLiteRuntime{
     void JoinScheduler();
 
     TfLiteStatus Invoke();
+    // Invokes subgraphs in order with scheduler. CO_GPU subgraphs run
+    // together with their minimal precision pair on a persistent worker.
     TfLiteStatus InvokeCoExecution();
     TfLiteStatus InvokeSingleExecution();
 
+    //// Pipelined execution
+    // Runs each run of consecutive subgraphs of the same resource as a
+    // stage on its own worker, so that the next frame enters the first
+    // stage while the previous one is in a later stage. At most 'depth'
+    // frames are in flight and tensors between stages are buffered per
+    // frame('depth' buffers each).
+    // Call in INVOKE state, with a plan without co-execution subgraphs.
+    // Leases are not used and Invoke() is refused until StopPipeline.
+    TfLiteStatus StartPipeline(int depth);
+    // Finishes the frames in flight and restores sequential Invoke().
+    // If scheduler re-planned meanwhile, frames fail and Invoke() partitions
+    // again.
+    void StopPipeline();
+    // Blocks until a frame can enter and gives the buffers of the model
+    // inputs for it, in the order of inputs of the first subgraph.
+    TfLiteStatus BeginPipelineFrame(std::vector<void*>& inputs);
+    // Registered input frame 'frame'(see RegisterInputBuffers) is the input
+    // of the frame instead of the buffers from BeginPipelineFrame if given.
+    // Keep it unchanged until the frame is waited.
+    TfLiteStatus SubmitPipelineFrame(int frame = -1);
+    // Blocks until the oldest frame is done and gives the buffers of its
+    // outputs, in the order of outputs of the last subgraph. They are valid
+    // until ReleasePipelineFrame. Fails if a stage failed on the frame.
+    TfLiteStatus WaitPipelineFrame(std::vector<const void*>& outputs);
+    void ReleasePipelineFrame();
+    //////
+
+    // Pins the co-execution worker to given cores.
+    void SetCoExecutionCpus(const std::vector<int>& cpus);
+
+    // Invokes a subgraph, or co-executes it if it is CO_GPU and merges the
+    // result. A CPU_B subgraph runs on the co-execution worker.
+    // 'co_subgraph_idx' is the next minimal precision subgraph and advances
+    // on co-execution.
+    TfLiteStatus InvokeSubgraph(Subgraph* subgraph, int& co_subgraph_idx);
+
     // Merge output(which is intermediate in the view of whole task)
     // data from previous subgraph.
     void CopyIntermediateDataIfNeeded(Subgraph* subgraph);
@@ -117,6 +230,20 @@ class TfLiteRuntime{
     void MergeCoExecutionData(Subgraph* min_precision_subgraph
                             , Subgraph* max_precision_subgraph);
 
+    // Points output of HW-partitioned max precision subgraph to the top rows
+    // of next subgraph's input, so merge doesn't copy it.
+    // Call before every invoke since allocation resets the pointer.
+    void BindCoExecutionOutput(Subgraph* max_precision_subgraph);
+
+    // Returns per-tensor quantization params of co-execution input 'tensor'.
+    // Installed on first call, reused afterwards.
+    TfLiteAffineQuantization* GetHandoffQuantParams(TfLiteTensor* tensor);
+
+    // Per-tensor dequantization parameters of co-execution output.
+    // Calculated from 'ref_tensor' values if it has no quantization params.
+    bool GetDequantizationParams(TfLiteTensor* ref_tensor, float* scale,
+                                 int* zero_point);
+
     // Quantize given tensor
     // (This function changes the entire metadata to uint8)
     TfLiteStatus QuantizeGivenTensor(TfLiteTensor* tensor);
@@ -169,12 +296,102 @@ class TfLiteRuntime{
     //// IPC functions
     // Initialize UDS and check communication with scheduler.
     TfLiteStatus InitializeUDS();
-    TfLiteStatus ChangeStatewithPacket(tf_packet& rx_p);
-    TfLiteStatus SendPacketToScheduler(tf_packet& tx_p);
-    TfLiteStatus ReceivePacketFromScheduler(tf_packet& rx_p);
+    TfLiteStatus ChangeStatewithMsg(tf_msg_header& rx_header);
+    TfLiteStatus SendMsgToScheduler(const void* msg, size_t size);
+    // Receives a message of at most 'size' bytes and validates its header.
+    TfLiteStatus ReceiveMsgFromScheduler(void* msg, size_t size);
+    // Sends an invoke request or release. Uses the shared-memory channel if
+    // attached, UDS otherwise.
+    TfLiteStatus SendInvokeMsgToScheduler(tf_invoke_msg& tx_msg);
+    // Blocks until a grant or revoke arrives.
+    TfLiteStatus ReceiveReplyFromScheduler(tf_lease_msg& rx_msg);
+    // Requests invoke permission and blocks until granted. Tags the request
+    // with a new request id, safe to call from several threads at once.
+    TfLiteStatus RequestInvokeToScheduler(tf_invoke_msg& tx_msg,
+                                          tf_lease_msg& rx_grant);
+    // Returns true if a message from scheduler was pending. Doesn't block.
+    bool TryReceiveFromScheduler(tf_lease_msg& rx_msg);
+    // Gets invoke permission of subgraph 'subgraph_idx', from the lease if
+    // it covers the subgraph's resource, otherwise from scheduler.
+    TfLiteStatus AcquireResourceFromScheduler(tf_invoke_msg& tx_msg,
+                                              tf_msg_header& rx_header,
+                                              int subgraph_idx);
+    // Tells scheduler that the invoke of granted subgraph is done, so the
+    // resource can be granted to a waiting runtime. Doesn't wait a reply.
+    TfLiteStatus ReleaseResourceToScheduler(tf_invoke_msg& tx_msg);
+    // Gives back the lease if any. (completion or early release)
+    TfLiteStatus ReleaseLeaseToScheduler();
+    // Fills priority, period, weight and frame deadline of a request.
+    void FillSchedulingParams(tf_invoke_msg& tx_msg);
+
+    // Scheduling priority sent with invoke requests. A runtime of higher
+    // priority revokes the leases of lower ones.
+    void SetSchedulingPriority(int priority_) { priority = priority_; }
+    // Period and relative deadline of a frame(Invoke) in us, 0 if none.
+    // Each request carries the absolute deadline of its frame, which the
+    // "edf" policy of scheduler orders by.
+    void SetTiming(int period_us_, int deadline_us_) {
+      period_us = period_us_;
+      deadline_us = deadline_us_;
+    }
+    // Share of resources under the "fair" policy, relative to the others.
+    void SetShareWeight(int weight) { share_weight = weight > 0 ? weight : 1; }
+    // Number of frames finished after their deadline.
+    int GetDeadlineMisses() const { return deadline_misses; }
     //////
 
   private:
+    // Fills the identity of the model(s) from the original subgraphs and
+    // the delegate options. Call after creating the delegates and before
+    // partitioning.
+    void IdentifyModel(tf_model_id& model);
+
+    // Opens the cache in TF_CACHE_DIR_ENV directory, keyed by the models
+    // and how they are profiled. No cache if the variable is not set.
+    void InitializeCache();
+
+    // Invokes given subgraph with a profiler attached and collects per-node
+    // latency(ms) of each measured run in samples[node].
+    // Latency of a delegate kernel is distributed to the nodes it replaced
+    // in proportion to 'weights'. Those nodes are marked in 'delegated'.
+    TfLiteStatus ProfileSubgraphNodes(Subgraph* subgraph,
+                                      const std::vector<float>& weights,
+                                      std::vector<std::vector<float>>& samples,
+                                      std::vector<bool>& delegated);
+
+    // Applies given delegate to subgraph and profiles it.
+    // Restores the undelegated subgraph after profiling.
+    TfLiteStatus ProfileSubgraphNodesWithDelegate(Interpreter* owner,
+                                      Subgraph* subgraph,
+                                      TfLiteDelegate* delegate,
+                                      const std::vector<float>& weights,
+                                      std::vector<std::vector<float>>& samples,
+                                      std::vector<bool>& delegated);
+
+    // Returns false if the lease doesn't cover 'resource', is expired or is
+    // revoked. Checked at each subgraph boundary.
+    bool IsLeaseValid(int resource);
+
+    // Copies the plan to builders of 'variant' and creates its subgraphs
+    // from the original ones.
+    TfLiteStatus CreateSubgraphsFromPlan(
+                      int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE],
+                      PartitionVariant& variant);
+
+    TfLiteStatus PrepareCoExecution(Interpreter* max_precision_interpreter,
+                                    Interpreter* min_precision_interpreter);
+
+    // Invokes subgraphs of pipeline stage 'stage' on the frame in 'slot'.
+    TfLiteStatus InvokePipelineStage(int stage, int slot);
+
+    // Points tensors of 'boundary' in 'subgraph' to the buffers of 'slot'.
+    void BindPipelineBoundary(Subgraph* subgraph, int boundary, int slot);
+    void FreePipelineBuffers();
+
+    // Binds the bound input frame to the input of first subgraphs, which
+    // are new after partitioning.
+    TfLiteStatus ApplyInputBinding();
+
     RuntimeState state;
     int runtime_id = -1;
     tflite::Interpreter* interpreter;
@@ -186,27 +403,116 @@ class TfLiteRuntime{
 
     //// Co-execution
     bool co_execution = false;
-    
-    std::thread c_thread;
-    std::thread g_thread;
+    // Co-execution between CPU clusters. CO_GPU subgraphs run on cluster A
+    // and CO_CPU, CPU_B subgraphs on cluster B(co_execution_cpus).
+    bool cpu_clusters = false;
+
+    // Runs minimal precision subgraphs, created on first co-execution.
+    TfCoExecutor* co_executor = nullptr;
+    // Cores for the co-execution worker, not pinned if empty.
+    std::vector<int> co_execution_cpus;
+    // Cores of cluster A. Empty if not cpu_clusters.
+    std::vector<int> cluster_a_cpus;
+    // Thread pinned to cluster A by Invoke(), pinned once, not every frame.
+    std::thread::id cluster_a_thread;
+    // Status of the last minimal precision invoke on worker.
+    TfLiteStatus co_execution_status = kTfLiteOk;
+
+    // Quantization params installed on the input of min precision subgraphs.
+    // Owned by the tensor and updated in place on every invoke.
+    std::unordered_map<TfLiteTensor*, TfLiteAffineQuantization*>
+                                                    handoff_quant_params;
+    ////
+
+    //// Pipelined execution
+    // Subgraphs [first, last] of a stage, all on 'resource'.
+    typedef struct PipelineStage{
+      int first;
+      int last;
+      int resource;
+    }PipelineStage;
+    // Tensors between stage i - 1 and i in [i], model inputs in [0] and
+    // model outputs in [stages]. Each tensor has a buffer per slot.
+    typedef struct PipelineBoundary{
+      std::vector<int> tensors;
+      std::vector<size_t> bytes;
+      // buffers[slot][j] is the buffer of tensors[j].
+      std::vector<std::vector<void*>> buffers;
+    }PipelineBoundary;
+
+    TfPipeline* pipeline = nullptr;
+    std::vector<PipelineStage> pipeline_stages;
+    std::vector<PipelineBoundary> pipeline_boundaries;
+    // Arena data of tensors bound to boundaries, restored on stop.
+    std::vector<std::pair<TfLiteTensor*, void*>> pipeline_arena_data;
+    // Slot of the frame being fed, -1 if none.
+    int pipeline_slot = -1;
+    // Registered input frame of each slot, -1 if it uses its own buffer.
+    std::vector<int> pipeline_input_frame;
+    // Absolute deadline of the frame in each slot, 0 if none.
+    std::vector<int64_t> pipeline_deadline_us;
+    bool use_lease_before_pipeline = true;
+    // Stages on the host(CPU, CPU_B) share the CPU backend context of
+    // interpreter for kernels not delegated, so they invoke one at a time.
+    std::mutex host_invoke_mutex;
+    std::mutex gpu_invoke_mutex;
+    // Stage workers talk to scheduler at once. Every send holds
+    // 'ipc_send_mutex'. One waiting request at a time receives replies and
+    // hands each grant to its request by id, the others wait on
+    // 'ipc_reply_cv'.
+    std::mutex ipc_send_mutex;
+    std::mutex ipc_reply_mutex;
+    std::condition_variable ipc_reply_cv;
+    std::unordered_map<int, tf_lease_msg> ipc_replies;
+    bool ipc_receiving = false;
+    int next_request_id = 0;
+    ////
 
-    std::condition_variable invoke_sync_cv;
-    std::condition_variable data_sync_cv;
-    std::mutex data_sync_mtx;
-    std::mutex invoke_sync_mtx;
-    bool is_execution_done = false;
-    bool invoke_cpu = false;
+    // Registered input frames and the bound one, -1 if none bound.
+    std::vector<TfLiteCustomAllocation> input_buffers;
+    std::vector<TfLiteCustomAllocation> quantized_input_buffers;
+    int bound_input_frame = -1;
 
-    // must do readonly works on this object.
-    Subgraph* co_execution_graph = nullptr;
+    // Created on the first FeedFrameToModel.
+    TfPreprocessor* preprocessor = nullptr;
+    int preprocess_threads = 1;
 
-    // must do readonly works on this object.
-    Subgraph* main_execution_graph = nullptr;
-    ////
+    // Identity of the model(s) sent with every profile.
+    tf_model_id model_id;
 
     // Subgraph partitioning
     int partitioning_plan[1000][4];
 
+    // Models kept to build partition variants.
+    tflite::FlatBufferModel* float_model = nullptr;
+    tflite::FlatBufferModel* quantized_model = nullptr;
+    tflite::ops::builtin::BuiltinOpResolver* float_resolver = nullptr;
+    tflite::ops::builtin::BuiltinOpResolver* quantized_resolver = nullptr;
+    std::string float_model_name;
+    std::string quantized_model_name;
+    INPUT_TYPE input_type;
+
+    // Partition variants, [0] is the primary plan. Empty until built.
+    std::vector<PartitionVariant> variants;
+    // Plans of variants 1 ~ variant_plans_received - 1, in [variant - 1].
+    int variant_plans[TF_P_MAX_VARIANTS - 1][TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE];
+    int variant_plans_received = 1;
+    int active_variant = 0;
+    // Variant of the last grant, switched to at the end of inference.
+    int next_variant = 0;
+
+    // Profiling
+    int profile_warmup_runs = 3;
+    int profile_runs = 10;
+
+    // Profile of the last start is reused at registration if cached.
+    // nullptr if not cached.
+    TfRuntimeCache* cache = nullptr;
+    bool registered_once = false;
+    // Options of the delegates created by the constructor, in the order of
+    // creation. Part of the cache key.
+    std::vector<int> delegate_options;
+
     // sj
     std::vector<TfLiteDelegate*> delegate;
     std::vector<TfLiteDelegate*> quantized_delegate;
@@ -217,6 +523,21 @@ class TfLiteRuntime{
     size_t addr_size;
     struct sockaddr_un runtime_addr;
     struct sockaddr_un scheduler_addr;
+    // Shared-memory channel for invoke requests. nullptr if not offered.
+    TfShmChannel* shm_channel = nullptr;
+
+    // Lease of resources from scheduler, -1 if none.
+    bool use_lease = true;
+    int priority = 0;
+    int period_us = 0;
+    int deadline_us = 0;
+    int share_weight = 1;
+    // Absolute deadline(CLOCK_MONOTONIC us) of the frame being invoked.
+    int64_t frame_deadline_us = 0;
+    int deadline_misses = 0;
+    int lease_id = -1;
+    int lease_resources = 0;
+    struct timespec lease_deadline;
 
     bool output_correct = false;
 
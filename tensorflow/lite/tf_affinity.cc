@@ -0,0 +1,34 @@
+#include "tensorflow/lite/tf_affinity.h"
+
+#include <iostream>
+
+namespace tflite{
+
+bool SetThreadAffinity(pthread_t thread, const std::vector<int>& cpus){
+  if(cpus.empty())
+    return false;
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for(int cpu : cpus)
+    CPU_SET(cpu, &cpu_set);
+  int ret = pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set);
+  if(ret != 0){
+    std::cout << "Setting thread affinity failed, errno " << ret << "\n";
+    return false;
+  }
+  return true;
+}
+
+TfAffinityScope::TfAffinityScope(const std::vector<int>& cpus){
+  if(cpus.empty() ||
+      pthread_getaffinity_np(pthread_self(), sizeof(saved_), &saved_) != 0)
+    return;
+  pinned_ = SetThreadAffinity(pthread_self(), cpus);
+}
+
+TfAffinityScope::~TfAffinityScope(){
+  if(pinned_)
+    pthread_setaffinity_np(pthread_self(), sizeof(saved_), &saved_);
+}
+
+} // namespace tflite
@@ -0,0 +1,25 @@
+#pragma once
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
+
+namespace tflite{
+
+// Pins 'thread' to 'cpus'. Returns false if failed or 'cpus' is empty.
+bool SetThreadAffinity(pthread_t thread, const std::vector<int>& cpus);
+
+// Pins the calling thread to 'cpus' and restores its affinity when the scope
+// ends. Threads created in the scope inherit the affinity, so a thread pool
+// created in it (ex. pthreadpool of XNNPACK delegate) stays on 'cpus'.
+// Does nothing if 'cpus' is empty.
+class TfAffinityScope{
+  public:
+    explicit TfAffinityScope(const std::vector<int>& cpus);
+    ~TfAffinityScope();
+
+  private:
+    cpu_set_t saved_;
+    bool pinned_ = false;
+};
+
+} // namespace tflite
@@ -0,0 +1,126 @@
+#include "tensorflow/lite/tf_cache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "tensorflow/lite/allocation.h"
+#include "tensorflow/lite/model_builder.h"
+
+namespace tflite{
+
+namespace {
+
+typedef struct tf_cache_header{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint64_t size; // of the entry after this header.
+}tf_cache_header;
+
+// Creates every missing directory of 'dir'.
+bool MakeDirectories(const std::string& dir){
+  for(size_t pos = dir.find('/', 1); ; pos = dir.find('/', pos + 1)){
+    const std::string path = dir.substr(0, pos);
+    if(mkdir(path.c_str(), 0755) == -1 && errno != EEXIST)
+      return false;
+    if(pos == std::string::npos)
+      return true;
+  }
+}
+
+} // namespace
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed){
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t hash = seed;
+  for(size_t i=0; i<size; ++i){
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+uint64_t HashModelContent(const FlatBufferModel& model){
+  const Allocation* allocation = model.allocation();
+  if(allocation == nullptr || allocation->base() == nullptr)
+    return 0;
+  return HashBytes(allocation->base(), allocation->bytes());
+}
+
+TfRuntimeCache* TfRuntimeCache::Create(const char* dir){
+  if(dir == nullptr || dir[0] == '\0')
+    return nullptr;
+  std::string path(dir);
+  while(path.size() > 1 && path.back() == '/')
+    path.pop_back();
+  if(!MakeDirectories(path)){
+    std::cout << "Cannot create cache directory " << path << "\n";
+    return nullptr;
+  }
+  return new TfRuntimeCache(path);
+}
+
+void TfRuntimeCache::AddKey(const void* data, size_t size){
+  key_ = HashBytes(data, size, key_);
+}
+
+std::string TfRuntimeCache::EntryPath(const char* kind){
+  char name[64];
+  snprintf(name, sizeof(name), "/%016llx.%s", (unsigned long long)key_, kind);
+  return dir_ + name;
+}
+
+bool TfRuntimeCache::LoadMsg(const char* kind, tf_msg& msg){
+  const std::string path = EntryPath(kind);
+  FILE* file = fopen(path.c_str(), "rb");
+  if(file == nullptr)
+    return false;
+  tf_cache_header header;
+  bool loaded = fread(&header, sizeof(header), 1, file) == 1 &&
+                header.magic == TF_CACHE_MAGIC &&
+                header.version == TF_CACHE_VERSION &&
+                header.key == key_ && header.size <= sizeof(tf_msg) &&
+                fread(&msg, 1, header.size, file) == header.size &&
+                IsValidMsg(msg.header, header.size);
+  fclose(file);
+  if(!loaded)
+    std::cout << "Ignored a broken cache entry " << path << "\n";
+  return loaded;
+}
+
+bool TfRuntimeCache::StoreMsg(const char* kind, const tf_msg& msg,
+                              size_t size){
+  const std::string path = EntryPath(kind);
+  const std::string temp_path = path + "." + std::to_string(getpid());
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if(file == nullptr)
+    return false;
+  tf_cache_header header = {TF_CACHE_MAGIC, TF_CACHE_VERSION, key_, size};
+  bool stored = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                fwrite(&msg, 1, size, file) == size;
+  stored = fclose(file) == 0 && stored;
+  if(!stored || rename(temp_path.c_str(), path.c_str()) == -1){
+    std::cout << "Cannot write cache entry " << path << "\n";
+    unlink(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool TfRuntimeCache::LoadProfile(tf_profile& profile){
+  tf_msg msg;
+  return LoadMsg("profile", msg) && DecodeProfileMsg(msg, profile);
+}
+
+bool TfRuntimeCache::StoreProfile(const tf_profile& profile){
+  tf_msg msg;
+  SetMsgHeader(msg.header, TF_MSG_PROFILE, -1, 0, 0);
+  const size_t size = EncodeProfileMsg(profile, msg);
+  return StoreMsg("profile", msg, size);
+}
+
+} // namespace tflite
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "tensorflow/lite/tf_protocol.h"
+
+/*
+On-disk cache of per-model data which is expensive to recreate at start.
+
+An entry is keyed by the content hash of the model(s) and everything else
+which changes the cached data (delegate options, profile runs). A changed
+model or configuration gets a new entry, a stale one is never read.
+Entries are written to a temporary file and renamed, so a reader sees
+either a whole entry or none.
+*/
+
+#define TF_CACHE_MAGIC        0x54464341 // "TFCA"
+#define TF_CACHE_VERSION      2
+
+// Environment variable of the cache directory, cache is off if not set.
+#define TF_CACHE_DIR_ENV      "TF_RUNTIME_CACHE_DIR"
+
+namespace tflite{
+
+class FlatBufferModel;
+
+// 64bit FNV-1a of 'size' bytes, chained from 'seed'.
+uint64_t HashBytes(const void* data, size_t size,
+                   uint64_t seed = 0xcbf29ce484222325ULL);
+
+// Hash of the whole flatbuffer of 'model'. 0 if it has no buffer.
+uint64_t HashModelContent(const FlatBufferModel& model);
+
+class TfRuntimeCache{
+  public:
+    // Cache in directory 'dir', created if not exists.
+    // Returns nullptr if 'dir' is empty or can't be created.
+    static TfRuntimeCache* Create(const char* dir);
+
+    // Adds to the key of entries. Add every input before Load/Store.
+    void AddKey(const void* data, size_t size);
+    void AddKey(int value) { AddKey(&value, sizeof(value)); }
+
+    // Returns false if there is no valid profile for the key.
+    bool LoadProfile(tf_profile& profile);
+    bool StoreProfile(const tf_profile& profile);
+
+  private:
+    TfRuntimeCache(const std::string& dir) : dir_(dir) {}
+
+    std::string EntryPath(const char* kind);
+
+    // Reads a message entry of 'kind' to 'msg'. Returns false if missing,
+    // broken or of another key.
+    bool LoadMsg(const char* kind, tf_msg& msg);
+    bool StoreMsg(const char* kind, const tf_msg& msg, size_t size);
+
+    std::string dir_;
+    uint64_t key_ = HashBytes(nullptr, 0);
+};
+
+} // namespace tflite
@@ -0,0 +1,266 @@
+#include "tensorflow/lite/tf_channel.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <new>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace tflite{
+
+namespace {
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "Shared-memory channel needs lock-free 32bit atomics.");
+static_assert((TF_SHM_RING_SLOTS & (TF_SHM_RING_SLOTS - 1)) == 0,
+              "TF_SHM_RING_SLOTS must be power of 2.");
+
+// Polls before parking on futex. (about a few microseconds)
+constexpr int kSpinCount = 2000;
+
+// Spinning only steals the time slice of the peer on a single core.
+int SpinCount(){
+  static const int spin_count =
+      sysconf(_SC_NPROCESSORS_ONLN) > 1 ? kSpinCount : 0;
+  return spin_count;
+}
+
+inline void CpuRelax(){
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Futex words live in shared memory, so process-private futex ops can't
+// be used here.
+int FutexWait(std::atomic<uint32_t>* addr, uint32_t expected,
+              const struct timespec* timeout){
+  return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT,
+                 expected, timeout, nullptr, 0);
+}
+
+int FutexWake(std::atomic<uint32_t>* addr){
+  return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE,
+                 INT_MAX, nullptr, nullptr, 0);
+}
+
+bool PushRing(tf_shm_ring& ring, const void* msg, size_t size){
+  if(size > sizeof(ring.slots[0].data))
+    return false;
+  const uint32_t head = ring.head.load(std::memory_order_relaxed);
+  const uint32_t tail = ring.tail.load(std::memory_order_acquire);
+  if(head - tail >= TF_SHM_RING_SLOTS) // full
+    return false;
+  tf_shm_slot& slot = ring.slots[head & (TF_SHM_RING_SLOTS - 1)];
+  memcpy(slot.data, msg, size);
+  slot.size = size;
+  ring.head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+// Returns the size of popped message, -1 if the ring is empty.
+// Copies at most 'size' bytes to 'msg'.
+int PopRing(tf_shm_ring& ring, void* msg, size_t size){
+  const uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+  const uint32_t head = ring.head.load(std::memory_order_acquire);
+  if(head == tail) // empty
+    return -1;
+  const tf_shm_slot& slot = ring.slots[tail & (TF_SHM_RING_SLOTS - 1)];
+  const int received = slot.size;
+  memcpy(msg, slot.data, std::min<size_t>(slot.size, size));
+  ring.tail.store(tail + 1, std::memory_order_release);
+  return received;
+}
+
+bool IsRingEmpty(tf_shm_ring& ring){
+  return ring.head.load(std::memory_order_acquire) ==
+         ring.tail.load(std::memory_order_relaxed);
+}
+
+// Bumps the wake sequence and wakes the consumer only if it is parked.
+void Notify(std::atomic<uint32_t>& futex, std::atomic<uint32_t>& waiting){
+  futex.fetch_add(1);
+  if(waiting.load())
+    FutexWake(&futex);
+}
+
+} // namespace
+
+TfShmChannel::TfShmChannel(tf_shm_region* region, const char* name,
+                           bool owner, int runtime_id)
+    : region_(region), owner_(owner), runtime_id_(runtime_id) {
+  strncpy(name_, name, TF_SHM_NAME_LENGTH - 1);
+  name_[TF_SHM_NAME_LENGTH - 1] = '\0';
+}
+
+TfShmChannel* TfShmChannel::Create(const char* name){
+  if(strlen(name) >= TF_SHM_NAME_LENGTH)
+    return nullptr;
+  // Remove a stale region of dead scheduler.
+  shm_unlink(name);
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+  if(fd == -1){
+    std::cout << "shm_open " << name << " failed, errno " << errno << "\n";
+    return nullptr;
+  }
+  if(ftruncate(fd, sizeof(tf_shm_region)) == -1){
+    std::cout << "ftruncate " << name << " failed, errno " << errno << "\n";
+    close(fd);
+    shm_unlink(name);
+    return nullptr;
+  }
+  void* addr = mmap(nullptr, sizeof(tf_shm_region), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  close(fd);
+  if(addr == MAP_FAILED){
+    std::cout << "mmap " << name << " failed, errno " << errno << "\n";
+    shm_unlink(name);
+    return nullptr;
+  }
+  tf_shm_region* region = new (addr) tf_shm_region();
+  region->magic = TF_SHM_MAGIC;
+  region->version = TF_SHM_VERSION;
+  return new TfShmChannel(region, name, true, -1);
+}
+
+TfShmChannel* TfShmChannel::Attach(const char* name, int runtime_id){
+  if(runtime_id < 0 || runtime_id >= TF_SHM_MAX_RUNTIMES)
+    return nullptr;
+  int fd = shm_open(name, O_RDWR, 0);
+  if(fd == -1){
+    std::cout << "shm_open " << name << " failed, errno " << errno << "\n";
+    return nullptr;
+  }
+  void* addr = mmap(nullptr, sizeof(tf_shm_region), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  close(fd);
+  if(addr == MAP_FAILED){
+    std::cout << "mmap " << name << " failed, errno " << errno << "\n";
+    return nullptr;
+  }
+  tf_shm_region* region = static_cast<tf_shm_region*>(addr);
+  if(region->magic != TF_SHM_MAGIC || region->version != TF_SHM_VERSION){
+    std::cout << "Shared-memory channel version mismatch" << "\n";
+    munmap(addr, sizeof(tf_shm_region));
+    return nullptr;
+  }
+  // Drop the replies a left runtime of the same id did not receive.
+  tf_shm_ring& reply = region->reply[runtime_id];
+  reply.tail.store(reply.head.load());
+  region->attached[runtime_id].store(1);
+  return new TfShmChannel(region, name, false, runtime_id);
+}
+
+TfShmChannel::~TfShmChannel(){
+  if(!owner_)
+    region_->attached[runtime_id_].store(0);
+  munmap(region_, sizeof(tf_shm_region));
+  if(owner_)
+    shm_unlink(name_);
+}
+
+bool TfShmChannel::SendRequest(const void* msg, size_t size){
+  if(!PushRing(region_->request[runtime_id_], msg, size))
+    return false;
+  Notify(region_->scheduler_futex, region_->scheduler_waiting);
+  return true;
+}
+
+int TfShmChannel::ReceiveReply(void* msg, size_t size){
+  tf_shm_ring& ring = region_->reply[runtime_id_];
+  while(1){
+    for(int i=0; i<SpinCount(); ++i){
+      int received = PopRing(ring, msg, size);
+      if(received >= 0)
+        return received;
+      CpuRelax();
+    }
+    // Park. Check the ring again after announcing, so a reply pushed in
+    // between is not missed.
+    ring.waiting.store(1);
+    const uint32_t seq = ring.futex.load();
+    int received = PopRing(ring, msg, size);
+    if(received >= 0){
+      ring.waiting.store(0);
+      return received;
+    }
+    if(FutexWait(&ring.futex, seq, nullptr) == -1 &&
+        errno != EAGAIN && errno != EINTR){
+      ring.waiting.store(0);
+      return -1;
+    }
+    ring.waiting.store(0);
+  }
+}
+
+int TfShmChannel::TryReceiveReply(void* msg, size_t size){
+  return PopRing(region_->reply[runtime_id_], msg, size);
+}
+
+int TfShmChannel::PollRequest(void* msg, size_t size, size_t* received){
+  for(int i=0; i<TF_SHM_MAX_RUNTIMES; ++i){
+    const int runtime_id = (poll_start_ + i) % TF_SHM_MAX_RUNTIMES;
+    if(!region_->attached[runtime_id].load(std::memory_order_relaxed))
+      continue;
+    int popped = PopRing(region_->request[runtime_id], msg, size);
+    if(popped < 0)
+      continue;
+    *received = popped;
+    poll_start_ = (runtime_id + 1) % TF_SHM_MAX_RUNTIMES;
+    return runtime_id;
+  }
+  return -1;
+}
+
+bool TfShmChannel::SendReply(int runtime_id, const void* msg, size_t size){
+  if(runtime_id < 0 || runtime_id >= TF_SHM_MAX_RUNTIMES)
+    return false;
+  tf_shm_ring& ring = region_->reply[runtime_id];
+  if(!PushRing(ring, msg, size))
+    return false;
+  Notify(ring.futex, ring.waiting);
+  return true;
+}
+
+void TfShmChannel::WaitRequest(int timeout_us){
+  auto has_request = [this](){
+    for(int i=0; i<TF_SHM_MAX_RUNTIMES; ++i){
+      if(region_->attached[i].load(std::memory_order_relaxed) &&
+          !IsRingEmpty(region_->request[i]))
+        return true;
+    }
+    return false;
+  };
+  const uint32_t seq = region_->scheduler_futex.load();
+  for(int i=0; i<SpinCount(); ++i){
+    if(region_->scheduler_futex.load(std::memory_order_relaxed) != seq)
+      return;
+    CpuRelax();
+  }
+  region_->scheduler_waiting.store(1);
+  if(region_->scheduler_futex.load() == seq && !has_request()){
+    struct timespec timeout;
+    timeout.tv_sec = timeout_us / 1000000;
+    timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+    FutexWait(&region_->scheduler_futex, seq, &timeout);
+  }
+  region_->scheduler_waiting.store(0);
+}
+
+bool TfShmChannel::IsAttached(int runtime_id){
+  if(runtime_id < 0 || runtime_id >= TF_SHM_MAX_RUNTIMES)
+    return false;
+  return region_->attached[runtime_id].load() != 0;
+}
+
+} // namespace tflite
@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+Shared-memory control channel between TfScheduler and TfLiteRuntimes.
+
+The scheduler creates a region with a pair of single-producer/single-consumer
+rings per runtime slot(request : runtime -> scheduler, reply : scheduler ->
+runtime). Only small messages of the invoke hot path go through the rings,
+registration, profile and plan are still exchanged over UDS.
+
+A consumer spins on its ring for a while and then parks on a futex. A producer
+issues FUTEX_WAKE only when the consumer is parked, so a busy scheduler serves
+many runtimes without a syscall per grant.
+*/
+
+#define TF_SHM_MAGIC          0x54465348 // "TFSH"
+#define TF_SHM_VERSION        1
+#define TF_SHM_MAX_RUNTIMES   16
+#define TF_SHM_RING_SLOTS     16 // must be power of 2
+#define TF_SHM_SLOT_SIZE      64
+#define TF_SHM_NAME_LENGTH    64
+
+namespace tflite{
+
+typedef struct tf_shm_slot{
+  uint32_t size;
+  char data[TF_SHM_SLOT_SIZE - sizeof(uint32_t)];
+}tf_shm_slot;
+
+// Producer and consumer indices are kept on separate cache lines.
+typedef struct alignas(64) tf_shm_ring{
+  alignas(64) std::atomic<uint32_t> head; // written by producer
+  alignas(64) std::atomic<uint32_t> tail; // written by consumer
+  // Wake sequence of consumer and whether the consumer is parked on it.
+  alignas(64) std::atomic<uint32_t> futex;
+  std::atomic<uint32_t> waiting;
+  alignas(64) tf_shm_slot slots[TF_SHM_RING_SLOTS];
+}tf_shm_ring;
+
+typedef struct tf_shm_region{
+  uint32_t magic;
+  uint32_t version;
+  // Doorbell of scheduler, shared by every request ring.
+  alignas(64) std::atomic<uint32_t> scheduler_futex;
+  std::atomic<uint32_t> scheduler_waiting;
+  alignas(64) std::atomic<uint32_t> attached[TF_SHM_MAX_RUNTIMES];
+  tf_shm_ring request[TF_SHM_MAX_RUNTIMES];
+  tf_shm_ring reply[TF_SHM_MAX_RUNTIMES];
+}tf_shm_region;
+
+class TfShmChannel{
+  public:
+    // Creates a new region with given name. (scheduler side)
+    // Returns nullptr on failure.
+    static TfShmChannel* Create(const char* name);
+
+    // Attaches to an existing region with given name as 'runtime_id'.
+    // (runtime side) Returns nullptr on failure.
+    static TfShmChannel* Attach(const char* name, int runtime_id);
+
+    ~TfShmChannel();
+
+    const char* GetName() { return name_; }
+
+    //// Runtime side
+    // Sends a request to scheduler. Returns false if the ring is full or the
+    // message does not fit in a slot.
+    bool SendRequest(const void* msg, size_t size);
+
+    // Blocks until a reply from scheduler arrives.
+    // Returns the size of received message, -1 on failure.
+    int ReceiveReply(void* msg, size_t size);
+
+    // Returns the size of a pending reply, -1 if there is none.
+    int TryReceiveReply(void* msg, size_t size);
+    ////
+
+    //// Scheduler side
+    // Pops a pending request of any attached runtime.
+    // Returns the id of runtime, -1 if there is no request.
+    int PollRequest(void* msg, size_t size, size_t* received);
+
+    // Sends a reply to the runtime of given id.
+    bool SendReply(int runtime_id, const void* msg, size_t size);
+
+    // Parks until a runtime sends a request or 'timeout_us' passes.
+    void WaitRequest(int timeout_us);
+
+    // Returns true if the runtime of given id can use this channel.
+    bool IsAttached(int runtime_id);
+    ////
+
+  private:
+    TfShmChannel(tf_shm_region* region, const char* name, bool owner,
+                 int runtime_id);
+
+    tf_shm_region* region_;
+    char name_[TF_SHM_NAME_LENGTH];
+    bool owner_;
+    int runtime_id_;
+
+    // Round robin start index of PollRequest.
+    int poll_start_ = 0;
+};
+
+} // namespace tflite
@@ -0,0 +1,120 @@
+#include "tensorflow/lite/tf_coexecutor.h"
+
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <iostream>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "tensorflow/lite/tf_affinity.h"
+
+namespace tflite{
+
+namespace {
+
+// Counters are checked against the clock once per this many polls.
+constexpr int kPollsPerClockCheck = 64;
+
+// Spinning only steals the time slice of the peer on a single core.
+bool CanSpin(){
+  static const bool can_spin = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+  return can_spin;
+}
+
+inline void CpuRelax(){
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+double NowUs(){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+int FutexWait(std::atomic<uint32_t>* addr, uint32_t expected){
+  return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr),
+                 FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+int FutexWake(std::atomic<uint32_t>* addr){
+  return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr),
+                 FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+} // namespace
+
+TfCoExecutor::TfCoExecutor(const std::vector<int>& cpus, int spin_us)
+    : spin_us_(spin_us) {
+  worker_ = std::thread(&TfCoExecutor::WorkerLoop, this);
+  if(!cpus.empty() && !SetThreadAffinity(worker_.native_handle(), cpus))
+    std::cout << "Co-execution worker is not pinned" << "\n";
+}
+
+TfCoExecutor::~TfCoExecutor(){
+  stop_ = true;
+  Notify(post_seq_, worker_waiting_);
+  worker_.join();
+}
+
+void TfCoExecutor::Post(std::function<void()> task){
+  task_ = std::move(task);
+  Notify(post_seq_, worker_waiting_);
+}
+
+void TfCoExecutor::Wait(){
+  WaitForChange(done_seq_, post_seq_.load() - 1, caller_waiting_);
+}
+
+void TfCoExecutor::WorkerLoop(){
+  uint32_t seq = 0;
+  while(1){
+    WaitForChange(post_seq_, seq, worker_waiting_);
+    seq = post_seq_.load(std::memory_order_acquire);
+    if(stop_)
+      return;
+    task_();
+    Notify(done_seq_, caller_waiting_);
+  }
+}
+
+void TfCoExecutor::WaitForChange(std::atomic<uint32_t>& seq, uint32_t old,
+                                 std::atomic<uint32_t>& waiting){
+  if(CanSpin()){
+    const double deadline = NowUs() + spin_us_;
+    for(int i=1; ; ++i){
+      if(seq.load(std::memory_order_acquire) != old)
+        return;
+      CpuRelax();
+      if(i % kPollsPerClockCheck == 0 && NowUs() > deadline)
+        break;
+    }
+  }
+  // Park. Check the counter again after announcing, so a notify in between
+  // is not missed.
+  while(1){
+    waiting.store(1);
+    if(seq.load() != old){
+      waiting.store(0);
+      return;
+    }
+    if(FutexWait(&seq, old) == -1 && errno != EAGAIN && errno != EINTR){
+      std::cout << "Co-execution futex wait failed, errno " << errno << "\n";
+    }
+    waiting.store(0);
+  }
+}
+
+void TfCoExecutor::Notify(std::atomic<uint32_t>& seq,
+                          std::atomic<uint32_t>& waiting){
+  seq.fetch_add(1);
+  if(waiting.load())
+    FutexWake(&seq);
+}
+
+} // namespace tflite
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace tflite{
+
+// Long-lived worker thread which runs the minimal precision side of
+// co-execution while the caller runs the max precision side.
+//
+// Handoff is a pair of sequence counters. The waiting side spins on the
+// counter for a bounded time and parks on futex only after that, so a
+// fine-grained co-executed subgraph doesn't pay a thread wakeup.
+// Only one task is in flight. Call Wait() before the next Post().
+class TfCoExecutor{
+  public:
+    // Pins worker to 'cpus' if not empty.
+    // A waiting side spins for 'spin_us' before parking.
+    explicit TfCoExecutor(const std::vector<int>& cpus, int spin_us = 200);
+    ~TfCoExecutor();
+
+    // Runs 'task' on worker and returns immediately.
+    void Post(std::function<void()> task);
+
+    // Returns when the posted task is done.
+    void Wait();
+
+  private:
+    void WorkerLoop();
+
+    // Returns when 'seq' moves from 'old'.
+    void WaitForChange(std::atomic<uint32_t>& seq, uint32_t old,
+                       std::atomic<uint32_t>& waiting);
+    void Notify(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiting);
+
+    std::function<void()> task_;
+    bool stop_ = false;
+    std::atomic<uint32_t> post_seq_{0};
+    std::atomic<uint32_t> done_seq_{0};
+    std::atomic<uint32_t> worker_waiting_{0};
+    std::atomic<uint32_t> caller_waiting_{0};
+    int spin_us_;
+    std::thread worker_;
+};
+
+} // namespace tflite
@@ -0,0 +1,121 @@
+#include "tensorflow/lite/tf_dequantize.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include "tensorflow/lite/kernels/internal/optimized/neon_check.h"
+#define DEQUANTIZE_ROW(...) NEON_OR_PORTABLE(DequantizeRow, __VA_ARGS__)
+#else
+#include "tensorflow/lite/kernels/internal/optimized/sse_check.h"
+#define DEQUANTIZE_ROW(...) SSE_OR_PORTABLE(DequantizeRow, __VA_ARGS__)
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+#endif
+
+namespace tflite{
+
+namespace {
+
+// Rows are dequantized in uint8 domain. int8 values are flipped to uint8 by
+// 'flip'(0x80) with zero point moved by 128, so one kernel serves both.
+
+void PortableDequantizeRow(const uint8_t* source, float* dest, int size,
+                           float scale, int zero_point, uint8_t flip){
+  for(int i=0; i<size; ++i){
+    dest[i] = (static_cast<int>(source[i] ^ flip) - zero_point) * scale;
+  }
+}
+
+#if defined(USE_NEON) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+void NeonDequantizeRow(const uint8_t* source, float* dest, int size,
+                       float scale, int zero_point, uint8_t flip){
+  const uint8x8_t flip_v = vdup_n_u8(flip);
+  const int32x4_t zero_point_v = vdupq_n_s32(zero_point);
+  int i = 0;
+  for(; i + 8 <= size; i += 8){
+    const uint16x8_t values = vmovl_u8(veor_u8(vld1_u8(source + i), flip_v));
+    const int32x4_t lo = vsubq_s32(
+        vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(values))), zero_point_v);
+    const int32x4_t hi = vsubq_s32(
+        vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(values))), zero_point_v);
+    vst1q_f32(dest + i, vmulq_n_f32(vcvtq_f32_s32(lo), scale));
+    vst1q_f32(dest + i + 4, vmulq_n_f32(vcvtq_f32_s32(hi), scale));
+  }
+  PortableDequantizeRow(source + i, dest + i, size - i, scale, zero_point,
+                        flip);
+}
+#endif
+
+#if defined(__SSSE3__)
+void SseDequantizeRow(const uint8_t* source, float* dest, int size,
+                      float scale, int zero_point, uint8_t flip){
+  int i = 0;
+#if defined(__AVX2__)
+  const __m128i flip_8 = _mm_set1_epi8(static_cast<char>(flip));
+  const __m256i zero_point_8 = _mm256_set1_epi32(zero_point);
+  const __m256 scale_8 = _mm256_set1_ps(scale);
+  for(; i + 8 <= size; i += 8){
+    const __m128i bytes = _mm_xor_si128(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i)), flip_8);
+    const __m256i values =
+        _mm256_sub_epi32(_mm256_cvtepu8_epi32(bytes), zero_point_8);
+    _mm256_storeu_ps(dest + i,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale_8));
+  }
+#else
+  const __m128i flip_16 = _mm_set1_epi8(static_cast<char>(flip));
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i zero_point_4 = _mm_set1_epi32(zero_point);
+  const __m128 scale_4 = _mm_set1_ps(scale);
+  auto store = [&](__m128i values, float* out){
+    values = _mm_sub_epi32(values, zero_point_4);
+    _mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(values), scale_4));
+  };
+  for(; i + 16 <= size; i += 16){
+    const __m128i bytes = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)), flip_16);
+    const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+    const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+    store(_mm_unpacklo_epi16(lo, zero), dest + i);
+    store(_mm_unpackhi_epi16(lo, zero), dest + i + 4);
+    store(_mm_unpacklo_epi16(hi, zero), dest + i + 8);
+    store(_mm_unpackhi_epi16(hi, zero), dest + i + 12);
+  }
+#endif
+  PortableDequantizeRow(source + i, dest + i, size - i, scale, zero_point,
+                        flip);
+}
+#endif
+
+void DequantizeInterleaveImpl(const uint8_t* source, float* dest, int pixels,
+                              int channels, int dest_stride, float scale,
+                              int zero_point, uint8_t flip){
+  if(pixels <= 0 || channels <= 0)
+    return;
+  if(channels == dest_stride){ // contiguous rows
+    DEQUANTIZE_ROW(source, dest, pixels * channels, scale, zero_point, flip);
+    return;
+  }
+  for(int i=0; i<pixels; ++i){
+    DEQUANTIZE_ROW(source + i * channels, dest + i * dest_stride, channels,
+                   scale, zero_point, flip);
+  }
+}
+
+} // namespace
+
+void DequantizeInterleave(const uint8_t* source, float* dest, int pixels,
+                          int channels, int dest_stride, float scale,
+                          int zero_point){
+  DequantizeInterleaveImpl(source, dest, pixels, channels, dest_stride, scale,
+                           zero_point, 0);
+}
+
+void DequantizeInterleave(const int8_t* source, float* dest, int pixels,
+                          int channels, int dest_stride, float scale,
+                          int zero_point){
+  DequantizeInterleaveImpl(reinterpret_cast<const uint8_t*>(source), dest,
+                           pixels, channels, dest_stride, scale,
+                           zero_point + 128, 0x80);
+}
+
+} // namespace tflite
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+namespace tflite{
+
+// Dequantizes 'pixels' x 'channels' values of NHWC 'source' to 'dest' whose
+// pixel stride is 'dest_stride' floats.
+//   dest[p * dest_stride + c] = (source[p * channels + c] - zero_point) * scale
+// Writes co-execution output straight into its channel slice
+// ('dest_stride' > 'channels') or row range ('dest_stride' == 'channels') of
+// the merged tensor, without a temporary float buffer.
+// Vectorized with NEON, SSE or AVX2 if the target supports it.
+void DequantizeInterleave(const uint8_t* source, float* dest, int pixels,
+                          int channels, int dest_stride, float scale,
+                          int zero_point);
+
+void DequantizeInterleave(const int8_t* source, float* dest, int pixels,
+                          int channels, int dest_stride, float scale,
+                          int zero_point);
+
+} // namespace tflite
@@ -0,0 +1,94 @@
+#include "tensorflow/lite/tf_dequantize.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace tflite {
+namespace {
+
+constexpr float kGuard = -12345.0f;
+
+// The formula of the header, one value at a time.
+template <typename T>
+std::vector<float> ReferenceDequantize(const std::vector<T>& source,
+                                       int pixels, int channels,
+                                       int dest_stride, float scale,
+                                       int zero_point) {
+  std::vector<float> dest(pixels * dest_stride + 16, kGuard);
+  for (int p = 0; p < pixels; ++p) {
+    for (int c = 0; c < channels; ++c) {
+      dest[p * dest_stride + c] =
+          (source[p * channels + c] - zero_point) * scale;
+    }
+  }
+  return dest;
+}
+
+template <typename T>
+void ExpectMatchesReference(int pixels, int channels, int dest_stride,
+                            float scale, int zero_point) {
+  srand(pixels * 131 + channels);
+  std::vector<T> source(pixels * channels);
+  for (T& value : source) value = static_cast<T>(rand());
+  // Channels outside the slice and bytes after the end keep the guard.
+  std::vector<float> dest(pixels * dest_stride + 16, kGuard);
+  DequantizeInterleave(source.data(), dest.data(), pixels, channels,
+                       dest_stride, scale, zero_point);
+  const std::vector<float> expected = ReferenceDequantize(
+      source, pixels, channels, dest_stride, scale, zero_point);
+  for (size_t i = 0; i < dest.size(); ++i) {
+    ASSERT_FLOAT_EQ(dest[i], expected[i])
+        << pixels << "x" << channels << " stride " << dest_stride
+        << " index " << i;
+  }
+}
+
+TEST(TfDequantizeTest, ContiguousRowsUint8) {
+  // Covers the 16 wide loop and the scalar tail.
+  for (int pixels = 0; pixels <= 40; ++pixels)
+    ExpectMatchesReference<uint8_t>(pixels, 1, 1, 0.05f, 128);
+  ExpectMatchesReference<uint8_t>(37, 3, 3, 0.1f, 10);
+}
+
+TEST(TfDequantizeTest, ContiguousRowsInt8) {
+  for (int pixels = 0; pixels <= 40; ++pixels)
+    ExpectMatchesReference<int8_t>(pixels, 1, 1, 0.05f, -3);
+  ExpectMatchesReference<int8_t>(37, 3, 3, 0.1f, 0);
+}
+
+TEST(TfDequantizeTest, ChannelSliceUint8) {
+  for (int channels : {1, 5, 16, 17, 33})
+    ExpectMatchesReference<uint8_t>(9, channels, channels + 7, 0.25f, 3);
+}
+
+TEST(TfDequantizeTest, ChannelSliceInt8) {
+  for (int channels : {1, 5, 16, 17, 33})
+    ExpectMatchesReference<int8_t>(9, channels, channels * 2, 0.25f, -128);
+}
+
+TEST(TfDequantizeTest, ExtremeValues) {
+  const std::vector<uint8_t> source = {0, 255, 128, 1};
+  std::vector<float> dest(4);
+  DequantizeInterleave(source.data(), dest.data(), 4, 1, 1, 2.0f, 128);
+  EXPECT_FLOAT_EQ(dest[0], -256);
+  EXPECT_FLOAT_EQ(dest[1], 254);
+  EXPECT_FLOAT_EQ(dest[2], 0);
+  EXPECT_FLOAT_EQ(dest[3], -254);
+  const std::vector<int8_t> signed_source = {-128, 127, 0, -1};
+  DequantizeInterleave(signed_source.data(), dest.data(), 4, 1, 1, 1.0f, 0);
+  EXPECT_FLOAT_EQ(dest[0], -128);
+  EXPECT_FLOAT_EQ(dest[1], 127);
+  EXPECT_FLOAT_EQ(dest[2], 0);
+  EXPECT_FLOAT_EQ(dest[3], -1);
+}
+
+}  // namespace
+}  // namespace tflite
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,100 @@
+#include "tensorflow/lite/tf_log.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace tflite{
+
+namespace {
+
+// The writer wakes up this often, or when the ring is half full.
+constexpr int kWriterIntervalMs = 100;
+
+} // namespace
+
+void TfLog(const char* format, ...){
+  va_list args;
+  va_start(args, format);
+  TfAsyncLog::Get().Append(format, args);
+  va_end(args);
+}
+
+void TfLogFlush(){
+  TfAsyncLog::Get().Flush();
+}
+
+TfAsyncLog& TfAsyncLog::Get(){
+  static TfAsyncLog log;
+  return log;
+}
+
+TfAsyncLog::TfAsyncLog(){
+  writer_ = std::thread(&TfAsyncLog::WriterLoop, this);
+}
+
+TfAsyncLog::~TfAsyncLog(){
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  writer_.join();
+  Flush();
+}
+
+void TfAsyncLog::Append(const char* format, va_list args){
+  bool half_full;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(head_ - tail_ == TF_LOG_RECORDS){
+      dropped_++;
+      return;
+    }
+    vsnprintf(records_[head_ % TF_LOG_RECORDS], TF_LOG_RECORD_SIZE, format,
+              args);
+    head_++;
+    half_full = head_ - tail_ == TF_LOG_RECORDS / 2;
+  }
+  if(half_full)
+    wake_.notify_one();
+}
+
+void TfAsyncLog::Flush(){
+  std::lock_guard<std::mutex> write_lock(write_mutex_);
+  uint64_t begin, end, dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    begin = tail_;
+    end = head_;
+    dropped = dropped_;
+    dropped_ = 0;
+  }
+  // Records in [begin, end) are not reused until tail moves.
+  Write(begin, end);
+  if(dropped > 0)
+    fprintf(stdout, "(%llu log lines dropped)\n", (unsigned long long)dropped);
+  fflush(stdout);
+  std::lock_guard<std::mutex> lock(mutex_);
+  tail_ = end;
+}
+
+void TfAsyncLog::WriterLoop(){
+  std::unique_lock<std::mutex> lock(mutex_);
+  while(!stop_){
+    wake_.wait_for(lock, std::chrono::milliseconds(kWriterIntervalMs));
+    if(head_ == tail_ && dropped_ == 0)
+      continue;
+    lock.unlock();
+    Flush();
+    lock.lock();
+  }
+}
+
+void TfAsyncLog::Write(uint64_t begin, uint64_t end){
+  for(uint64_t i=begin; i<end; ++i){
+    fputs(records_[i % TF_LOG_RECORDS], stdout);
+    fputc('\n', stdout);
+  }
+}
+
+} // namespace tflite
@@ -0,0 +1,57 @@
+#pragma once
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+/*
+Asynchronous log of the scheduling hot path.
+
+TfLog formats a line into a ring of fixed-size records and returns, a
+background thread writes the records to stdout. The caller never blocks on
+the terminal, and a full ring drops lines and counts them instead.
+Use it where a line is printed per request, std::cout elsewhere.
+*/
+
+#define TF_LOG_RECORDS        1024 // must be power of 2
+#define TF_LOG_RECORD_SIZE    128
+
+namespace tflite{
+
+// printf-style line, a newline is added.
+void TfLog(const char* format, ...)
+    __attribute__((format(printf, 1, 2)));
+
+// Writes the pending lines now. Call before exit.
+void TfLogFlush();
+
+class TfAsyncLog{
+  public:
+    static TfAsyncLog& Get();
+
+    void Append(const char* format, va_list args);
+    void Flush();
+
+  private:
+    TfAsyncLog();
+    ~TfAsyncLog();
+
+    void WriterLoop();
+    // Writes records in [begin, end).
+    void Write(uint64_t begin, uint64_t end);
+
+    char records_[TF_LOG_RECORDS][TF_LOG_RECORD_SIZE];
+    // Index of next record to fill, and of next one to write.
+    uint64_t head_ = 0;
+    uint64_t tail_ = 0;
+    uint64_t dropped_ = 0;
+
+    std::mutex mutex_;
+    std::mutex write_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    std::thread writer_;
+};
+
+} // namespace tflite
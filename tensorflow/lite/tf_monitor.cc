@@ -1,104 +1,413 @@
 #include "tensorflow/lite/tf_monitor.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 namespace tflite{
 
-LiteSysMonitor::LiteSysMonitor(){
-  std::cout << "Init system monitoring" << "\n";
+namespace {
+
+const char* kCpuFreqDir = "/sys/devices/system/cpu/cpufreq";
+const char* kThermalDir = "/sys/class/thermal";
+const char* kPressureFiles[] = {"/proc/pressure/cpu", "/proc/pressure/memory",
+                                "/proc/pressure/io"};
+// GPU load of Jetson, in per mille.
+const char* kJetsonGpuLoad = "/sys/devices/gpu.0/load";
+const float kJetsonGpuLoadScale = 1000;
+
+int64_t MonotonicUs(){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
 }
 
-LiteSysMonitor::LiteSysMonitor(float* cpu_util, float* gpu_util){
-  cpu_util_ = cpu_util;
-  gpu_util_ = gpu_util;
-  std::cout << "System monitoring started" << "\n";
-  CPU_daemon = std::thread(&LiteSysMonitor::GetCPUUtilization, this);
-  GPU_daemon = std::thread(&LiteSysMonitor::GetGPUUtilization, this);
-  CPU_daemon.detach();
-  GPU_daemon.detach();
+int OpenReadOnly(const std::string& path){
+  return open(path.c_str(), O_RDONLY | O_CLOEXEC);
 }
 
-LiteSysMonitor::~LiteSysMonitor(){
-  // must terminate CPU_daemon & GPU_daemon here.
-  std::cout << "System monitoring terminated" << "\n";
+// Reads the whole(up to 'size' - 1) file from the start in one call.
+// procfs and sysfs make a fresh value for a read at offset 0.
+ssize_t ReadFromStart(int fd, char* buffer, size_t size){
+  const ssize_t read_size = pread(fd, buffer, size - 1, 0);
+  if(read_size < 0)
+    return -1;
+  buffer[read_size] = '\0';
+  return read_size;
 }
 
-struct cpuusage LiteSysMonitor::GetCPUusageFromCpustat(struct cpustat s) {
-  struct cpuusage r;
-  strncpy(r.name, s.name, sizeof(r.name));
-  r.name[sizeof(r.name) - 1] = '\0';
-  r.idletime = s.idle + s.iowait;
-  r.workingtime = s.user + s.nice + s.system + s.irq + s.softirq;
-  return r;
-}
-
-float LiteSysMonitor::CpuUsageGetDiff(struct cpuusage now, struct cpuusage prev) {
-  // the number of ticks that passed by since the last measurement.
-  const unsigned long long workingtime = now.workingtime - prev.workingtime;
-  const unsigned long long alltime = workingtime + (now.idletime - prev.idletime);
-  // they are divided by themselves - so the unit does not matter.
-  // printf("CPU Usage: %.0Lf%%\n", (long double)workingtime / alltime * 100.0L);
-  return (float)(workingtime / alltime * 100.0L);
-}
-
-// Simply parses /proc/stat.
-void LiteSysMonitor::GetCPUUtilization() {
-  struct cpuusage prev = {0};
-  const int stat = open("/proc/stat", O_RDONLY);
-  assert(stat != -1);
-  fcntl(stat, F_SETFL, O_NONBLOCK);
-  while (1) {
-    // let's read everything in one call so it's nicely synced.
-    int r = lseek(stat, SEEK_SET, 0);
-    assert(r != -1);
-    char buffer[10001];
-    const ssize_t readed = read(stat, buffer, sizeof(buffer) - 1);
-    assert(readed != -1);
-    buffer[readed] = '\0';
-    // Read the values from the readed buffer/
-    FILE* f = fmemopen(buffer, readed, "r");
-    // Uch, so much borign typing.
-    struct cpustat c = {0};
-    while (fscanf(f, "%19s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu", c.name, &c.user, &c.nice,
-      &c.system, &c.idle, &c.iowait, &c.irq, &c.softirq, &c.steal, &c.guest,
-      &c.guest_nice) == 11) {
-      // Just an example for first cpu core.
-      if (strcmp(c.name, "cpu") == 0) {
-        struct cpuusage now = GetCPUusageFromCpustat(c);
-        *cpu_util_ = CpuUsageGetDiff(now, prev);
-        prev = now;
-        break;
-      }
+bool ReadLong(int fd, long& value){
+  char buffer[32];
+  if(ReadFromStart(fd, buffer, sizeof(buffer)) <= 0)
+    return false;
+  char* end;
+  value = strtol(buffer, &end, 10);
+  return end != buffer;
+}
+
+// "0-3,6" or "0 1 2 3" to a bit mask.
+uint64_t ParseCpuList(const char* list){
+  uint64_t cpus = 0;
+  const char* p = list;
+  while(*p != '\0'){
+    char* end;
+    const long first = strtol(p, &end, 10);
+    if(end == p){
+      p++;
+      continue;
+    }
+    long last = first;
+    if(*end == '-')
+      last = strtol(end + 1, &end, 10);
+    for(long cpu = first; cpu <= last && cpu < 64; ++cpu)
+      cpus |= 1ULL << cpu;
+    p = end;
+  }
+  return cpus;
+}
+
+// Numbers N of entries named 'prefix'N in 'dir', in order.
+std::vector<int> ListNumbered(const char* dir, const char* prefix){
+  std::vector<int> numbers;
+  DIR* entries = opendir(dir);
+  if(entries == nullptr)
+    return numbers;
+  const size_t prefix_length = strlen(prefix);
+  while(struct dirent* entry = readdir(entries)){
+    if(strncmp(entry->d_name, prefix, prefix_length) == 0)
+      numbers.push_back(atoi(entry->d_name + prefix_length));
+  }
+  closedir(entries);
+  std::sort(numbers.begin(), numbers.end());
+  return numbers;
+}
+
+float Utilization(uint64_t busy, uint64_t all){
+  if(all == 0) // sampled within a tick.
+    return 0;
+  return 100.0f * busy / all;
+}
+
+} // namespace
+
+ProcStatSampler* ProcStatSampler::Create(){
+  int fd = OpenReadOnly("/proc/stat");
+  if(fd == -1)
+    return nullptr;
+  return new ProcStatSampler(fd);
+}
+
+ProcStatSampler::~ProcStatSampler(){
+  close(fd_);
+}
+
+bool ProcStatSampler::Sample(tf_system_snapshot& snapshot){
+  // Lines of cpus come first, the buffer needs not hold the rest.
+  if(ReadFromStart(fd_, buffer_, sizeof(buffer_)) <= 0)
+    return false;
+  int cpus = 0;
+  char* line = buffer_;
+  while(strncmp(line, "cpu", 3) == 0){
+    char* p = line + 3;
+    int index = 0; // "cpu" line
+    if(*p != ' '){
+      index = strtol(p, &p, 10) + 1;
+      cpus = std::max(cpus, index);
     }
-    fclose(f);
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-  }
-}
-
-// For jetson platforms only.
-// Uses tegrastats
-void LiteSysMonitor::GetGPUUtilization(){
-  std::string data, cmd;
-  cmd = "tegrastats --interval 10";
-  FILE* stream;
-  const int max_buffer = 512;
-  char buffer[max_buffer];
-  stream = popen(cmd.c_str(), "r");
-  if (stream) {
-    while (!feof(stream)) {
-      if (fgets(buffer, max_buffer, stream) != NULL) {
-        data.append(buffer);
+    // user nice system idle iowait irq softirq ...
+    uint64_t ticks[7] = {0};
+    for(int i=0; i<7; ++i)
+      ticks[i] = strtoull(p, &p, 10);
+    const uint64_t busy = ticks[0] + ticks[1] + ticks[2] + ticks[5] + ticks[6];
+    const uint64_t all = busy + ticks[3] + ticks[4];
+    if(index <= TF_MONITOR_MAX_CPUS){
+      const float util = Utilization(busy - prev_busy_[index],
+                                     all - prev_all_[index]);
+      if(index == 0)
+        snapshot.cpu_util = util;
+      else
+        snapshot.core_util[index - 1] = util;
+      prev_busy_[index] = busy;
+      prev_all_[index] = all;
+    }
+    line = strchr(line, '\n');
+    if(line == nullptr)
+      break;
+    line++;
+  }
+  snapshot.cpus = std::min(cpus, TF_MONITOR_MAX_CPUS);
+  return true;
+}
+
+CpuFreqSampler* CpuFreqSampler::Create(){
+  CpuFreqSampler* sampler = new CpuFreqSampler;
+  for(int policy : ListNumbered(kCpuFreqDir, "policy")){
+    if(sampler->clusters_.size() == TF_MONITOR_MAX_CLUSTERS)
+      break;
+    const std::string dir =
+        std::string(kCpuFreqDir) + "/policy" + std::to_string(policy) + "/";
+    char cpu_list[256] = "";
+    long max_khz = 0;
+    int related_fd = OpenReadOnly(dir + "related_cpus");
+    int max_fd = OpenReadOnly(dir + "cpuinfo_max_freq");
+    const bool known = related_fd != -1 && max_fd != -1 &&
+                       ReadFromStart(related_fd, cpu_list, sizeof(cpu_list)) > 0 &&
+                       ReadLong(max_fd, max_khz);
+    for(int fd : {related_fd, max_fd}){
+      if(fd != -1)
+        close(fd);
+    }
+    cluster c = {ParseCpuList(cpu_list), static_cast<int>(max_khz),
+                 OpenReadOnly(dir + "scaling_cur_freq"),
+                 OpenReadOnly(dir + "scaling_max_freq")};
+    if(!known || c.cur_fd == -1 || c.limit_fd == -1){
+      for(int fd : {c.cur_fd, c.limit_fd}){
+        if(fd != -1)
+          close(fd);
       }
-      int delimiter = data.find("GR3D_FREQ");
-      std::string front = data.substr(delimiter+5);
-      delimiter = front.find('%');
-      front = front.substr(0, delimiter);
-      delimiter = front.find(' ');
-      front = front.substr(delimiter+1);
-      // std::cout << "GPU : " << front << "\n";
-      *gpu_util_ = std::stoi(front);
-      // std::cout << "GPU Usage: "<< *gpu_util_ << "% \n"; 
-      data.clear();
+      continue;
     }
-    pclose(stream);
+    sampler->clusters_.push_back(c);
+  }
+  if(sampler->clusters_.empty()){
+    delete sampler;
+    return nullptr;
+  }
+  return sampler;
+}
+
+CpuFreqSampler::~CpuFreqSampler(){
+  for(const cluster& c : clusters_){
+    close(c.cur_fd);
+    close(c.limit_fd);
+  }
+}
+
+bool CpuFreqSampler::Sample(tf_system_snapshot& snapshot){
+  for(size_t i=0; i<clusters_.size(); ++i){
+    long cur_khz, limit_khz;
+    if(!ReadLong(clusters_[i].cur_fd, cur_khz) ||
+        !ReadLong(clusters_[i].limit_fd, limit_khz))
+      return false;
+    tf_cluster_state& state = snapshot.cluster[i];
+    state.cpus = clusters_[i].cpus;
+    state.cur_khz = cur_khz;
+    state.max_khz = clusters_[i].max_khz;
+    state.limit_khz = limit_khz;
+    state.throttled = limit_khz < clusters_[i].max_khz;
+  }
+  snapshot.clusters = clusters_.size();
+  return true;
+}
+
+ThermalSampler* ThermalSampler::Create(){
+  ThermalSampler* sampler = new ThermalSampler;
+  for(int zone : ListNumbered(kThermalDir, "thermal_zone")){
+    int fd = OpenReadOnly(std::string(kThermalDir) + "/thermal_zone" +
+                          std::to_string(zone) + "/temp");
+    if(fd != -1)
+      sampler->zone_fds_.push_back(fd);
+  }
+  if(sampler->zone_fds_.empty()){
+    delete sampler;
+    return nullptr;
+  }
+  return sampler;
+}
+
+ThermalSampler::~ThermalSampler(){
+  for(int fd : zone_fds_)
+    close(fd);
+}
+
+bool ThermalSampler::Sample(tf_system_snapshot& snapshot){
+  long hottest = -1;
+  for(int fd : zone_fds_){
+    long temperature;
+    // A zone of a powered-off device fails to read, skip it.
+    if(ReadLong(fd, temperature))
+      hottest = std::max(hottest, temperature);
+  }
+  if(hottest == -1)
+    return false;
+  snapshot.temperature_mc = hottest;
+  return true;
+}
+
+PressureSampler* PressureSampler::Create(){
+  PressureSampler* sampler = new PressureSampler;
+  bool any = false;
+  for(int i=0; i<3; ++i){
+    sampler->fds_[i] = OpenReadOnly(kPressureFiles[i]);
+    any |= sampler->fds_[i] != -1;
+  }
+  if(!any){
+    delete sampler;
+    return nullptr;
+  }
+  return sampler;
+}
+
+PressureSampler::~PressureSampler(){
+  for(int fd : fds_){
+    if(fd != -1)
+      close(fd);
+  }
+}
+
+bool PressureSampler::Sample(tf_system_snapshot& snapshot){
+  float* pressures[3] = {&snapshot.cpu_pressure, &snapshot.memory_pressure,
+                         &snapshot.io_pressure};
+  bool sampled = true;
+  for(int i=0; i<3; ++i){
+    if(fds_[i] == -1)
+      continue;
+    // "some avg10=1.23 avg60=..."
+    char buffer[256];
+    const char* avg10 = nullptr;
+    if(ReadFromStart(fds_[i], buffer, sizeof(buffer)) > 0)
+      avg10 = strstr(buffer, "avg10=");
+    if(avg10 == nullptr){
+      sampled = false;
+      continue;
+    }
+    *pressures[i] = strtof(avg10 + 6, nullptr);
+  }
+  return sampled;
+}
+
+bool TfAcceleratorSampler::Sample(tf_system_snapshot& snapshot){
+  float util;
+  if(!ReadUtilization(util))
+    return false;
+  snapshot.accelerator_util = util;
+  return true;
+}
+
+FileAcceleratorSampler* FileAcceleratorSampler::Create(const char* path,
+                                                       float full_scale){
+  int fd = OpenReadOnly(path);
+  if(fd == -1 || full_scale <= 0){
+    if(fd != -1)
+      close(fd);
+    return nullptr;
+  }
+  return new FileAcceleratorSampler(fd, full_scale);
+}
+
+FileAcceleratorSampler::~FileAcceleratorSampler(){
+  close(fd_);
+}
+
+bool FileAcceleratorSampler::ReadUtilization(float& util){
+  char buffer[32];
+  if(ReadFromStart(fd_, buffer, sizeof(buffer)) <= 0)
+    return false;
+  char* end;
+  const float value = strtof(buffer, &end);
+  if(end == buffer)
+    return false;
+  util = std::min(100.0f, 100.0f * value / full_scale_);
+  return true;
+}
+
+LiteSysMonitor::LiteSysMonitor(){
+  std::cout << "Init system monitoring" << "\n";
+}
+
+LiteSysMonitor::~LiteSysMonitor(){
+  Stop();
+  for(TfSampler* sampler : samplers_)
+    delete sampler;
+  std::cout << "System monitoring terminated" << "\n";
+}
+
+void LiteSysMonitor::AddDefaultSamplers(){
+  AddSampler(ProcStatSampler::Create());
+  AddSampler(CpuFreqSampler::Create());
+  AddSampler(ThermalSampler::Create());
+  AddSampler(PressureSampler::Create());
+  const char* load_file = getenv(TF_ACCELERATOR_LOAD_ENV);
+  const char* load_scale = getenv(TF_ACCELERATOR_LOAD_SCALE_ENV);
+  if(load_file != nullptr){
+    const float scale = load_scale != nullptr ? atof(load_scale) : 100;
+    TfSampler* sampler = FileAcceleratorSampler::Create(load_file, scale);
+    if(sampler == nullptr)
+      std::cout << "Cannot read accelerator load from " << load_file << "\n";
+    AddSampler(sampler);
+  }else{
+    AddSampler(FileAcceleratorSampler::Create(kJetsonGpuLoad,
+                                              kJetsonGpuLoadScale));
+  }
+  std::cout << "System monitoring with";
+  for(TfSampler* sampler : samplers_)
+    std::cout << " " << sampler->Name();
+  std::cout << "\n";
+}
+
+void LiteSysMonitor::AddSampler(TfSampler* sampler){
+  if(sampler != nullptr)
+    samplers_.push_back(sampler);
+}
+
+void LiteSysMonitor::Start(int period_us){
+  if(sampling_thread_.joinable())
+    return;
+  stop_ = false;
+  sampling_thread_ = std::thread(&LiteSysMonitor::SamplingLoop, this,
+                                 period_us);
+}
+
+void LiteSysMonitor::Stop(){
+  {
+    std::lock_guard<std::mutex> lock(stop_mutex_);
+    stop_ = true;
+  }
+  stop_cv_.notify_all();
+  if(sampling_thread_.joinable())
+    sampling_thread_.join();
+}
+
+void LiteSysMonitor::SamplingLoop(int period_us){
+  std::unique_lock<std::mutex> lock(stop_mutex_);
+  while(!stop_){
+    lock.unlock();
+    Sample();
+    lock.lock();
+    stop_cv_.wait_for(lock, std::chrono::microseconds(period_us),
+                      [this]{ return stop_; });
+  }
+}
+
+void LiteSysMonitor::Sample(){
+  for(TfSampler* sampler : samplers_)
+    sampler->Sample(working_);
+  working_.sampled_us = MonotonicUs();
+  Publish(working_);
+}
+
+void LiteSysMonitor::Publish(const tf_system_snapshot& snapshot){
+  const uint64_t seq = seq_.load(std::memory_order_relaxed);
+  seq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  published_ = snapshot;
+  seq_.store(seq + 2, std::memory_order_release);
+}
+
+void LiteSysMonitor::GetSnapshot(tf_system_snapshot& snapshot) const{
+  while(1){
+    const uint64_t begin = seq_.load(std::memory_order_acquire);
+    if(begin & 1)
+      continue;
+    snapshot = published_;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(seq_.load(std::memory_order_relaxed) == begin)
+      return;
   }
 }
 
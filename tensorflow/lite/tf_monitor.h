@@ -1,49 +1,216 @@
-#include <assert.h>
-#include <stdio.h>
-#include <string.h>
-#include <sys/stat.h>
-#include <unistd.h>
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
 #include <thread>
-#include <iostream>
-#include <fcntl.h>
 #include <vector>
 
+/*
+System monitor of TfScheduler.
+
+LiteSysMonitor runs samplers(TfSampler) in turn, each fills its part of a
+tf_system_snapshot. Samplers keep their files open and read each one with
+a single pread per sample. The snapshot is published with a sequence
+number, GetSnapshot never blocks the sampling and sampling never waits for
+readers.
+
+Samplers
+ ProcStatSampler     : utilization of every core and in average. (/proc/stat)
+ CpuFreqSampler      : frequency and its cap per cluster. (cpufreq policies)
+ ThermalSampler      : temperature of the hottest thermal zone.
+ PressureSampler     : cpu, memory and io stall. (PSI, /proc/pressure)
+ FileAcceleratorSampler : accelerator utilization from a file which holds
+                       a number, like /sys/devices/gpu.0/load of Jetson.
+                       Point it to a plain file to feed a value in tests.
+Other accelerators plug in by implementing TfAcceleratorSampler.
+
+Set TF_ACCELERATOR_LOAD to the file of accelerator utilization, and
+TF_ACCELERATOR_LOAD_SCALE to its value at 100%. Jetson's GPU load is used
+if it is not set.
+*/
+
+#define TF_MONITOR_MAX_CPUS       32
+#define TF_MONITOR_MAX_CLUSTERS   8
+
+#define TF_ACCELERATOR_LOAD_ENV        "TF_ACCELERATOR_LOAD"
+#define TF_ACCELERATOR_LOAD_SCALE_ENV  "TF_ACCELERATOR_LOAD_SCALE"
+
 namespace tflite{
 
-struct cpuusage {
-  char name[20];
-  // Absolute values since last reboot.
-  unsigned long long idletime;
-  unsigned long long workingtime;
+typedef struct tf_cluster_state{
+  uint64_t cpus = 0;        // bit mask of cores in the cluster.
+  int cur_khz = 0;
+  int max_khz = 0;          // hardware max.
+  int limit_khz = 0;        // current cap, below max_khz if throttled.
+  bool throttled = false;
+}tf_cluster_state;
+
+// Fields are -1 or 0 clusters/cpus if nothing samples them.
+typedef struct tf_system_snapshot{
+  int64_t sampled_us = 0;   // CLOCK_MONOTONIC, 0 if never sampled.
+  float cpu_util = -1;      // % of every core in average.
+  int cpus = 0;
+  float core_util[TF_MONITOR_MAX_CPUS] = {0};
+  int clusters = 0;
+  tf_cluster_state cluster[TF_MONITOR_MAX_CLUSTERS];
+  int temperature_mc = -1;  // millidegree Celsius.
+  // % of time some tasks stalled on the resource, average of 10s.
+  float cpu_pressure = -1;
+  float memory_pressure = -1;
+  float io_pressure = -1;
+  float accelerator_util = -1; // %
+}tf_system_snapshot;
+
+class TfSampler{
+  public:
+    virtual ~TfSampler() = default;
+    virtual const char* Name() const = 0;
+    // Fills its part of 'snapshot', false if reading failed. The part keeps
+    // the last value then.
+    virtual bool Sample(tf_system_snapshot& snapshot) = 0;
+};
+
+class ProcStatSampler : public TfSampler{
+  public:
+    // Returns nullptr if /proc/stat can't be opened.
+    static ProcStatSampler* Create();
+    ~ProcStatSampler() override;
+
+    const char* Name() const override { return "procstat"; }
+    bool Sample(tf_system_snapshot& snapshot) override;
+
+  private:
+    explicit ProcStatSampler(int fd) : fd_(fd) {}
+
+    int fd_;
+    // Ticks of the last sample, [0] is the "cpu" line, [i+1] is core i.
+    uint64_t prev_busy_[TF_MONITOR_MAX_CPUS + 1] = {0};
+    uint64_t prev_all_[TF_MONITOR_MAX_CPUS + 1] = {0};
+    char buffer_[8192];
 };
 
-struct cpustat {
-  char name[20];
-  unsigned long long user, nice, system, idle, iowait, irq, softirq, steal, guest, guest_nice;
+class CpuFreqSampler : public TfSampler{
+  public:
+    // Returns nullptr if there are no cpufreq policies.
+    static CpuFreqSampler* Create();
+    ~CpuFreqSampler() override;
+
+    const char* Name() const override { return "cpufreq"; }
+    bool Sample(tf_system_snapshot& snapshot) override;
+
+  private:
+    struct cluster{
+      uint64_t cpus;
+      int max_khz;
+      int cur_fd;
+      int limit_fd;
+    };
+    CpuFreqSampler() = default;
+
+    std::vector<cluster> clusters_;
+};
+
+class ThermalSampler : public TfSampler{
+  public:
+    // Returns nullptr if there are no thermal zones.
+    static ThermalSampler* Create();
+    ~ThermalSampler() override;
+
+    const char* Name() const override { return "thermal"; }
+    bool Sample(tf_system_snapshot& snapshot) override;
+
+  private:
+    ThermalSampler() = default;
+
+    std::vector<int> zone_fds_;
+};
+
+class PressureSampler : public TfSampler{
+  public:
+    // Returns nullptr if the kernel has no PSI.
+    static PressureSampler* Create();
+    ~PressureSampler() override;
+
+    const char* Name() const override { return "pressure"; }
+    bool Sample(tf_system_snapshot& snapshot) override;
+
+  private:
+    PressureSampler() = default;
+
+    // cpu, memory, io. -1 if missing.
+    int fds_[3] = {-1, -1, -1};
+};
+
+// Interface of accelerator utilization plugins.
+class TfAcceleratorSampler : public TfSampler{
+  public:
+    bool Sample(tf_system_snapshot& snapshot) override;
+
+  protected:
+    // Utilization in %.
+    virtual bool ReadUtilization(float& util) = 0;
+};
+
+class FileAcceleratorSampler : public TfAcceleratorSampler{
+  public:
+    // 'full_scale' is the value of the file at 100% utilization.
+    // Returns nullptr if the file can't be opened.
+    static FileAcceleratorSampler* Create(const char* path, float full_scale);
+    ~FileAcceleratorSampler() override;
+
+    const char* Name() const override { return "accelerator"; }
+
+  protected:
+    bool ReadUtilization(float& util) override;
+
+  private:
+    FileAcceleratorSampler(int fd, float full_scale)
+        : fd_(fd), full_scale_(full_scale) {}
+
+    int fd_;
+    float full_scale_;
 };
 
 class LiteSysMonitor{
   public:
+    // Monitor without samplers, see AddDefaultSamplers.
     LiteSysMonitor();
-    LiteSysMonitor(float* cpu_util, float* gpu_util);
+    // Stops sampling.
     ~LiteSysMonitor();
 
-    void GetCPUUtilization();
-    void GetGPUUtilization();
+    // Adds every sampler the system supports.
+    void AddDefaultSamplers();
+    // Takes the ownership of 'sampler'. Add before Start.
+    void AddSampler(TfSampler* sampler);
+
+    // Samples every 'period_us' on a thread until Stop.
+    void Start(int period_us);
+    void Stop();
 
-    struct cpuusage GetCPUusageFromCpustat(struct cpustat s);
-    float CpuUsageGetDiff(struct cpuusage now, struct cpuusage prev);
+    // Samples once and publishes, for an owner which samples on its own
+    // timer instead of Start.
+    void Sample();
+
+    // Latest published snapshot.
+    void GetSnapshot(tf_system_snapshot& snapshot) const;
 
   private:
-    std::thread CPU_daemon;
-    std::thread GPU_daemon;
-  // FILE gpu_stream;
-  // FILE cpu_stream;
+    void SamplingLoop(int period_us);
+    void Publish(const tf_system_snapshot& snapshot);
+
+    std::vector<TfSampler*> samplers_;
+    // Being filled by samplers, only touched by the sampling side.
+    tf_system_snapshot working_;
 
-  float* cpu_util_;
-  float* gpu_util_;
+    mutable std::atomic<uint64_t> seq_{0}; // odd while publishing.
+    tf_system_snapshot published_;
 
+    std::thread sampling_thread_;
+    std::mutex stop_mutex_;
+    std::condition_variable stop_cv_;
+    bool stop_ = false;
 };
 
 } // namespace tflite
-
@@ -0,0 +1,109 @@
+#include "tensorflow/lite/tf_pipeline.h"
+
+#include <iostream>
+
+#include "tensorflow/lite/tf_affinity.h"
+
+namespace tflite{
+
+TfPipeline::TfPipeline(int stages, int depth, StageFunction run,
+                       const std::vector<std::vector<int>>& cpus)
+    : depth_(depth > 0 ? depth : 1), run_(std::move(run)), done_(stages, 0),
+      failed_(depth_, false) {
+  for(int i=0; i<stages; ++i){
+    workers_.emplace_back(&TfPipeline::WorkerLoop, this, i);
+    if(i < static_cast<int>(cpus.size()) && !cpus[i].empty() &&
+        !SetThreadAffinity(workers_.back().native_handle(), cpus[i]))
+      std::cout << "Pipeline stage " << i << " is not pinned" << "\n";
+  }
+}
+
+TfPipeline::~TfPipeline(){
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Workers see 'stop_' only when idle, so in-flight frames are finished.
+    progress_cv_.wait(lock, [this]{
+      return done_.empty() || done_.back() == submitted_;
+    });
+    stop_ = true;
+  }
+  progress_cv_.notify_all();
+  for(std::thread& worker : workers_)
+    worker.join();
+}
+
+int TfPipeline::BeginFrame(){
+  std::unique_lock<std::mutex> lock(mutex_);
+  progress_cv_.wait(lock, [this]{
+    return submitted_ - released_ < static_cast<uint64_t>(depth_);
+  });
+  return submitted_ % depth_;
+}
+
+void TfPipeline::SubmitFrame(){
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_[submitted_ % depth_] = false;
+    submitted_++;
+  }
+  progress_cv_.notify_all();
+}
+
+int TfPipeline::WaitFrame(bool& ok){
+  std::unique_lock<std::mutex> lock(mutex_);
+  if(submitted_ == released_)
+    return -1;
+  // No stages, a frame is done as submitted.
+  progress_cv_.wait(lock, [this]{
+    return done_.empty() || done_.back() > released_;
+  });
+  const int slot = released_ % depth_;
+  ok = !failed_[slot];
+  return slot;
+}
+
+void TfPipeline::ReleaseFrame(){
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(released_ < submitted_)
+      released_++;
+  }
+  progress_cv_.notify_all();
+}
+
+int TfPipeline::InFlight(){
+  std::lock_guard<std::mutex> lock(mutex_);
+  return submitted_ - released_;
+}
+
+void TfPipeline::WorkerLoop(int stage){
+  while(1){
+    uint64_t frame;
+    bool skip;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      // Frames done by the previous stage and not by this one.
+      auto ready = [&]{
+        const uint64_t input = stage == 0 ? submitted_ : done_[stage - 1];
+        return done_[stage] < input;
+      };
+      progress_cv_.wait(lock, [&]{ return stop_ || ready(); });
+      if(!ready())
+        return;
+      frame = done_[stage];
+      skip = failed_[frame % depth_];
+    }
+    bool ok = true;
+    if(!skip)
+      ok = run_(stage, frame % depth_);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if(!ok)
+        failed_[frame % depth_] = true;
+      done_[stage]++;
+    }
+    progress_cv_.notify_all();
+  }
+}
+
+} // namespace tflite
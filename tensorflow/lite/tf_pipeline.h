@@ -0,0 +1,72 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tflite{
+
+// Runs frames through a chain of stages, each stage on its own worker, so
+// that frame n+1 runs stage 0 while frame n runs stage 1. Throughput is
+// bound by the slowest stage instead of the sum of stages.
+//
+// Up to 'depth' frames are in flight. Frames take slots 0 ~ depth - 1 in
+// turn, and a stage is given the slot of its frame to pick the buffers of
+// that frame. A stage runs one frame at a time and frames pass every stage
+// in submission order, so the buffers of a slot between two stages are
+// written by one and read by the other, never at once.
+//
+// The caller is a single thread :
+//   slot = BeginFrame(); fill inputs of slot; SubmitFrame();
+//   slot = WaitFrame(ok); read outputs of slot; ReleaseFrame();
+class TfPipeline{
+  public:
+    // Runs stage 'stage' on the frame in 'slot', false if it failed.
+    // Later stages skip a failed frame.
+    typedef std::function<bool(int stage, int slot)> StageFunction;
+
+    // Worker of stage i is pinned to cpus[i] if given and not empty.
+    TfPipeline(int stages, int depth, StageFunction run,
+               const std::vector<std::vector<int>>& cpus = {});
+    // Frames in flight are finished before the workers stop.
+    ~TfPipeline();
+
+    int depth() const { return depth_; }
+
+    // Blocks until a slot is free and returns it. Fill the inputs of the
+    // slot then submit it.
+    int BeginFrame();
+    // Starts the frame of the slot from BeginFrame.
+    void SubmitFrame();
+
+    // Blocks until the oldest submitted frame leaves the last stage and
+    // returns its slot, -1 if no frame is in flight. 'ok' is false if a
+    // stage failed on it. The slot is not reused until ReleaseFrame, call
+    // it before the next WaitFrame.
+    int WaitFrame(bool& ok);
+    void ReleaseFrame();
+
+    // Frames submitted and not released yet.
+    int InFlight();
+
+  private:
+    void WorkerLoop(int stage);
+
+    const int depth_;
+    StageFunction run_;
+    std::mutex mutex_;
+    // Signaled when a stage finishes a frame or on stop.
+    std::condition_variable progress_cv_;
+    // Frames submitted, and frames done by each stage, in total.
+    uint64_t submitted_ = 0;
+    std::vector<uint64_t> done_;
+    uint64_t released_ = 0;
+    // Frames of a slot failed in a stage.
+    std::vector<bool> failed_;
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace tflite
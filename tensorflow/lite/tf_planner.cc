@@ -0,0 +1,288 @@
+#include "tensorflow/lite/tf_planner.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace tflite{
+
+namespace {
+
+// Kinds of subgraph in planner.
+// 0 : CPU, 1 : GPU, 2 ~ : co-execution with options.ratios[kind - 2]
+constexpr int kPlanKindCPU = 0;
+constexpr int kPlanKindGPU = 1;
+constexpr int kPlanKindCoBase = 2;
+
+constexpr float kInfeasible = std::numeric_limits<float>::max();
+
+// Returns the GPU side share of given partitioning ratio.
+float GpuShareOfRatio(int ratio){
+  if(ratio > 10)
+    return (ratio - 10) / 10.0f;
+  return ratio / 10.0f;
+}
+
+} // namespace
+
+TfPlanner::TfPlanner() {};
+
+TfPlanner::TfPlanner(const PlannerOptions& options) : options_(options) {};
+
+void TfPlanner::BuildPrefixSums(const std::vector<LayerCost>& costs){
+  const int nodes = costs.size();
+  const int ratios = options_.ratios.size();
+  cpu_sum.assign(nodes + 1, 0);
+  gpu_sum.assign(nodes + 1, 0);
+  cpu_infeasible.assign(nodes + 1, 0);
+  gpu_infeasible.assign(nodes + 1, 0);
+  not_partitionable.assign(nodes + 1, 0);
+  co_gpu_sum.assign(ratios, std::vector<float>(nodes + 1, 0));
+  co_cpu_sum.assign(ratios, std::vector<float>(nodes + 1, 0));
+  transfer.assign(nodes, 0);
+  quantize.assign(nodes, 0);
+  for(int i=0; i<nodes; ++i){
+    const LayerCost& cost = costs[i];
+    const float cpu = std::max(cost.cpu, 0.0f);
+    const float gpu = std::max(cost.gpu, 0.0f);
+    const float co_cpu_full = cost.co_cpu >= 0 ? cost.co_cpu : cpu;
+    cpu_sum[i+1] = cpu_sum[i] + cpu;
+    gpu_sum[i+1] = gpu_sum[i] + gpu;
+    cpu_infeasible[i+1] = cpu_infeasible[i] + (cost.cpu < 0);
+    gpu_infeasible[i+1] = gpu_infeasible[i] + (cost.gpu < 0);
+    not_partitionable[i+1] = not_partitionable[i] + !cost.partitionable;
+    transfer[i] = std::max(cost.transfer, 0.0f);
+    quantize[i] = std::max(cost.quantize, 0.0f);
+    // Max precision side of a split, cluster A if between CPU clusters.
+    float max_side = options_.cpu_clusters ? cpu : gpu;
+    if(cost.co_max >= 0)
+      max_side = cost.co_max;
+    for(int r=0; r<ratios; ++r){
+      const int ratio = options_.ratios[r];
+      float co_gpu = max_side * GpuShareOfRatio(ratio);
+      float co_cpu = co_cpu_full * (1.0f - GpuShareOfRatio(ratio));
+      if(ratio > 10) // height partitioning recomputes the overlapped rows.
+        co_cpu *= (1.0f + options_.height_halo_ratio);
+      for(auto& measured : cost.co_latency){
+        if(measured.first == ratio && measured.second >= 0){
+          co_gpu = measured.second;
+          co_cpu = measured.second;
+          break;
+        }
+      }
+      co_gpu_sum[r][i+1] = co_gpu_sum[r][i] + co_gpu;
+      co_cpu_sum[r][i+1] = co_cpu_sum[r][i] + co_cpu;
+    }
+  }
+}
+
+float TfPlanner::SegmentCost(int begin, int end, int kind, int ratio_idx){
+  switch (kind)
+  {
+  case kPlanKindCPU:
+    if(!options_.allow_cpu ||
+        cpu_infeasible[end] - cpu_infeasible[begin] > 0)
+      return -1;
+    return cpu_sum[end] - cpu_sum[begin];
+  case kPlanKindGPU:
+    if(!options_.allow_gpu ||
+        gpu_infeasible[end] - gpu_infeasible[begin] > 0)
+      return -1;
+    return gpu_sum[end] - gpu_sum[begin];
+  default:{
+    if(!options_.allow_co_execution ||
+        cpu_infeasible[end] - cpu_infeasible[begin] > 0 ||
+        gpu_infeasible[end] - gpu_infeasible[begin] > 0 ||
+        not_partitionable[end] - not_partitionable[begin] > 0)
+      return -1;
+    // Both sides run in parallel and sync at the end of subgraph.
+    float gpu_side = co_gpu_sum[ratio_idx][end] - co_gpu_sum[ratio_idx][begin];
+    float cpu_side = co_cpu_sum[ratio_idx][end] - co_cpu_sum[ratio_idx][begin];
+    float cost = std::max(gpu_side, cpu_side);
+    // Minimal precision side quantizes its input and the output is
+    // dequantized and merged into the next subgraph's input. Hand over of
+    // the output is added at the boundary, as with other kinds.
+    if(begin > 0)
+      cost += quantize[begin - 1];
+    cost += quantize[end - 1];
+    return cost;
+  }
+  }
+}
+
+TfLiteStatus TfPlanner::CreatePlan(const std::vector<LayerCost>& costs,
+                                   int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE]){
+  const int nodes = costs.size();
+  if(nodes < 1){
+    std::cout << "Planner : cannot create plan for " << nodes << " nodes" << "\n";
+    return kTfLiteError;
+  }
+  BuildPrefixSums(costs);
+  const int kinds = kPlanKindCoBase + options_.ratios.size();
+
+  // dp[i][k] : minimum latency of nodes [0, i) when the last subgraph
+  //            ends at node i with kind k.
+  std::vector<std::vector<float>> dp(nodes + 1,
+                                     std::vector<float>(kinds, kInfeasible));
+  std::vector<std::vector<std::pair<int, int>>> parent(nodes + 1,
+                  std::vector<std::pair<int, int>>(kinds, {-1, -1}));
+  // Whether the last subgraph continues the channel partitioned subgraph
+  // before it with another ratio, as layer ratio rows.
+  std::vector<std::vector<bool>> continued(nodes + 1,
+                                           std::vector<bool>(kinds, false));
+
+  // Best latency of nodes [0, j) followed by a boundary to any other kind.
+  // A CPU to CPU boundary needs no transfer(shares the buffer), so it is
+  // handled separately with dp[j][kPlanKindCPU].
+  std::vector<float> best_with_transfer(nodes + 1, kInfeasible);
+  std::vector<int> best_kind(nodes + 1, -1);
+  best_with_transfer[0] = 0;
+
+  // Best two channel partitioned kinds ending at node j, a subgraph can
+  // continue with a different ratio from either. Both sides sync only at
+  // the end of subgraph, so the sum of each ratio's latency is an upper
+  // bound of the continued subgraph.
+  std::vector<std::pair<int, int>> best_channel_kinds(nodes + 1, {-1, -1});
+  auto is_channel_kind = [&](int k){
+    return k >= kPlanKindCoBase && options_.ratios[k - kPlanKindCoBase] <= 10;
+  };
+
+  for(int i=1; i<=nodes; ++i){
+    for(int j=0; j<i; ++j){
+      if(best_with_transfer[j] == kInfeasible &&
+          dp[j][kPlanKindCPU] == kInfeasible &&
+          best_channel_kinds[j].first == -1)
+        continue;
+      for(int k=0; k<kinds; ++k){
+        float segment = SegmentCost(j, i, k, k - kPlanKindCoBase);
+        if(segment < 0)
+          continue;
+        float base = best_with_transfer[j];
+        int base_kind = best_kind[j];
+        if(k == kPlanKindCPU && dp[j][kPlanKindCPU] < base){
+          base = dp[j][kPlanKindCPU];
+          base_kind = kPlanKindCPU;
+        }
+        if(base != kInfeasible &&
+            base + segment + options_.subgraph_overhead < dp[i][k]){
+          dp[i][k] = base + segment + options_.subgraph_overhead;
+          parent[i][k] = {j, base_kind};
+          continued[i][k] = false;
+        }
+        if(!is_channel_kind(k) || j == 0)
+          continue;
+        // Same subgraph, the output of node j - 1 is neither dequantized
+        // by the previous ratio nor quantized again.
+        const int previous = best_channel_kinds[j].first != k ?
+            best_channel_kinds[j].first : best_channel_kinds[j].second;
+        if(previous == -1)
+          continue;
+        const float fused = dp[j][previous] + segment - 2 * quantize[j - 1];
+        if(fused < dp[i][k]){
+          dp[i][k] = fused;
+          parent[i][k] = {j, previous};
+          continued[i][k] = true;
+        }
+      }
+    }
+    for(int k=0; k<kinds; ++k){
+      if(dp[i][k] == kInfeasible)
+        continue;
+      float with_transfer = dp[i][k] + (i < nodes ? transfer[i - 1] : 0);
+      if(with_transfer < best_with_transfer[i]){
+        best_with_transfer[i] = with_transfer;
+        best_kind[i] = k;
+      }
+      if(!is_channel_kind(k))
+        continue;
+      std::pair<int, int>& best = best_channel_kinds[i];
+      if(best.first == -1 || dp[i][k] < dp[i][best.first]){
+        best.second = best.first;
+        best.first = k;
+      }else if(best.second == -1 || dp[i][k] < dp[i][best.second]){
+        best.second = k;
+      }
+    }
+  }
+
+  int last_kind = -1;
+  for(int k=0; k<kinds; ++k){
+    if(dp[nodes][k] == kInfeasible)
+      continue;
+    if(last_kind == -1 || dp[nodes][k] < dp[nodes][last_kind])
+      last_kind = k;
+  }
+  if(last_kind == -1){
+    std::cout << "Planner : no feasible plan" << "\n";
+    return kTfLiteError;
+  }
+  estimated_latency = dp[nodes][last_kind];
+
+  // Backtrack the subgraph boundaries.
+  struct Segment{
+    int begin;
+    int end;
+    int kind;
+    bool continued;
+  };
+  std::vector<Segment> segments;
+  int end = nodes;
+  int kind = last_kind;
+  while(end > 0){
+    std::pair<int, int> prev = parent[end][kind];
+    segments.push_back({prev.first, end, kind, continued[end][kind]});
+    end = prev.first;
+    kind = prev.second;
+  }
+  std::reverse(segments.begin(), segments.end());
+  if(segments.size() >= TF_P_PLAN_LENGTH){
+    std::cout << "Planner : too many subgraphs in plan" << "\n";
+    return kTfLiteError;
+  }
+  // A continued segment widens the subgraph row before it and overrides the
+  // ratio of its layers.
+  int rows = 0;
+  int subgraph_row = -1;
+  for(const Segment& segment : segments){
+    const int k = segment.kind;
+    if(segment.continued){
+      plan[subgraph_row][TF_P_IDX_END] = segment.end;
+      plan[rows][TF_P_IDX_START]    = segment.begin;
+      plan[rows][TF_P_IDX_END]      = segment.end;
+      plan[rows][TF_P_IDX_RESOURCE] = TF_P_PLAN_LAYER_RATIO;
+      plan[rows][TF_P_IDX_RATIO]    = options_.ratios[k - kPlanKindCoBase];
+      rows++;
+      continue;
+    }
+    subgraph_row = rows;
+    plan[rows][TF_P_IDX_START] = segment.begin;
+    plan[rows][TF_P_IDX_END]   = segment.end;
+    if(k == kPlanKindCPU){
+      plan[rows][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+      plan[rows][TF_P_IDX_RATIO]    = 0;
+    }else if(k == kPlanKindGPU){
+      plan[rows][TF_P_IDX_RESOURCE] =
+          options_.cpu_clusters ? TF_P_PLAN_CPU_B : TF_P_PLAN_GPU;
+      plan[rows][TF_P_IDX_RATIO]    = 0;
+    }else{
+      plan[rows][TF_P_IDX_RESOURCE] =
+          options_.cpu_clusters ? TF_P_PLAN_CO_CPU : TF_P_PLAN_CO_E;
+      plan[rows][TF_P_IDX_RATIO]    = options_.ratios[k - kPlanKindCoBase];
+    }
+    rows++;
+  }
+  plan[rows][TF_P_IDX_START] = TF_P_END_PLAN;
+  return kTfLiteOk;
+}
+
+void TfPlanner::PrintPlan(int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE]){
+  std::cout << "Planner : estimated latency " << estimated_latency << "ms" << "\n";
+  for(int i=0; i<TF_P_PLAN_LENGTH; ++i){
+    if(plan[i][TF_P_IDX_START] == TF_P_END_PLAN)
+      break;
+    std::cout << "[" << plan[i][TF_P_IDX_START] << " ~ " << plan[i][TF_P_IDX_END]
+              << ") resource " << plan[i][TF_P_IDX_RESOURCE]
+              << " ratio " << plan[i][TF_P_IDX_RATIO] << "\n";
+  }
+}
+
+} // namespace tflite
@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <utility>
+#include "tensorflow/lite/util.h"
+#include "tensorflow/lite/c/common.h"
+
+/*
+Profile-driven partitioning planner for TfScheduler.
+
+Finds subgraph boundaries, resource types and partitioning ratios for a model
+with dynamic programming over the execution plan of the original subgraph.
+The result is written in the TF_P_* plan row format, so the runtime side
+(CopyRawPartitioningPlan, CreateSubgraphsFromProfiling) does not change.
+Channel partitioned layers may change their ratio inside a co-execution
+subgraph, written as TF_P_PLAN_LAYER_RATIO rows after the subgraph row.
+*/
+
+namespace tflite{
+
+// Measured cost of a single node in the original execution plan.
+// Every latency is in milliseconds.
+// A negative cpu or gpu latency means the node can't run on that resource.
+// (ex. an op not supported by the GPU delegate)
+// With PlannerOptions::cpu_clusters, cpu is the latency on CPU cluster A and
+// gpu is the one on CPU cluster B.
+typedef struct LayerCost{
+  float cpu = 0;
+  float gpu = 0;
+
+  // Latency of the minimal precision node on CPU, which is the CPU side of
+  // co-execution. Negative if not profiled. (cpu is used instead)
+  float co_cpu = -1;
+
+  // Latency of the node on the max precision side of co-execution. Negative
+  // if it is the same as gpu. (cpu with PlannerOptions::cpu_clusters)
+  float co_max = -1;
+
+  // Cost to hand over the output of this node to another resource.
+  // (synchronization and copy of intermediate tensor)
+  float transfer = 0;
+
+  // Cost to quantize or dequantize the output of this node for the
+  // minimal precision side of co-execution.
+  float quantize = 0;
+
+  // Whether this node can be split between two resources.
+  bool partitionable = true;
+
+  // Measured co-execution latency of this node.
+  // <partitioning ratio, latency>
+  std::vector<std::pair<int, float>> co_latency;
+}LayerCost;
+
+typedef struct PlannerOptions{
+  bool allow_cpu = true;
+  bool allow_gpu = true;
+  bool allow_co_execution = true;
+
+  // CPU-cluster co-execution. The second resource is CPU cluster B, plans
+  // use TF_P_PLAN_CPU_B and TF_P_PLAN_CO_CPU instead of TF_P_PLAN_GPU and
+  // TF_P_PLAN_CO_E. The max precision side of a split is cluster A.
+  bool cpu_clusters = false;
+
+  // Candidate partitioning ratios for co-execution.
+  // 1 ~ 9   : channel-wise. (GPU : ratio, CPU : 10 - ratio)
+  // 11 ~ 19 : height-wise. (GPU : ratio - 10, CPU : 20 - ratio)
+  std::vector<int> ratios = {1, 2, 3, 4, 5, 6, 7, 8, 9,
+                             11, 12, 13, 14, 15, 16, 17, 18, 19};
+
+  // Fixed cost of invoking a single subgraph. (scheduler round trip, etc.)
+  float subgraph_overhead = 0.05;
+
+  // Rows recomputed by the CPU side of height partitioning, in proportion
+  // of its own share. (receptive field overlap)
+  float height_halo_ratio = 0.1;
+}PlannerOptions;
+
+class TfPlanner{
+  public:
+    TfPlanner();
+    TfPlanner(const PlannerOptions& options);
+
+    // Creates a partitioning plan from given per-node costs.
+    // Fills 'plan' in TF_P_* row format terminated with TF_P_END_PLAN.
+    // Returns kTfLiteError if no feasible plan exists.
+    TfLiteStatus CreatePlan(const std::vector<LayerCost>& costs,
+                            int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE]);
+
+    // Returns the estimated end-to-end latency of the last created plan.
+    float GetEstimatedLatency() { return estimated_latency; }
+
+    void PrintPlan(int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE]);
+
+  private:
+    // Cost of executing nodes [begin, end) as a single subgraph on 'resource'
+    // with 'ratio'. Returns a negative value if infeasible.
+    float SegmentCost(int begin, int end, int resource, int ratio);
+
+    // Builds prefix sums of the given costs.
+    void BuildPrefixSums(const std::vector<LayerCost>& costs);
+
+    PlannerOptions options_;
+    float estimated_latency = 0;
+
+    // Prefix sums over nodes. (size = number of nodes + 1)
+    std::vector<float> cpu_sum;
+    std::vector<float> gpu_sum;
+
+    // Number of nodes which cannot run on the resource in [0, i).
+    std::vector<int> cpu_infeasible;
+    std::vector<int> gpu_infeasible;
+    std::vector<int> not_partitionable;
+
+    // Prefix sums of the GPU and CPU side of co-execution for each
+    // candidate ratio. (measured latency if exists)
+    std::vector<std::vector<float>> co_gpu_sum;
+    std::vector<std::vector<float>> co_cpu_sum;
+
+    std::vector<float> transfer;
+    std::vector<float> quantize;
+};
+
+} // namespace tflite
@@ -0,0 +1,223 @@
+#include "tensorflow/lite/tf_planner.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace tflite {
+namespace {
+
+typedef int Plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE];
+
+LayerCost Cost(float cpu, float gpu, float transfer = 0) {
+  LayerCost cost;
+  cost.cpu = cpu;
+  cost.gpu = gpu;
+  cost.transfer = transfer;
+  return cost;
+}
+
+PlannerOptions NoOverhead() {
+  PlannerOptions options;
+  options.subgraph_overhead = 0;
+  return options;
+}
+
+int Rows(const Plan& plan) {
+  int count = 0;
+  while (plan[count][TF_P_IDX_START] != TF_P_END_PLAN) count++;
+  return count;
+}
+
+void ExpectRow(const Plan& plan, int i, int start, int end, int resource,
+               int ratio) {
+  EXPECT_EQ(plan[i][TF_P_IDX_START], start) << "row " << i;
+  EXPECT_EQ(plan[i][TF_P_IDX_END], end) << "row " << i;
+  EXPECT_EQ(plan[i][TF_P_IDX_RESOURCE], resource) << "row " << i;
+  EXPECT_EQ(plan[i][TF_P_IDX_RATIO], ratio) << "row " << i;
+}
+
+TEST(TfPlannerTest, NoNodes) {
+  TfPlanner planner;
+  static Plan plan;
+  EXPECT_EQ(planner.CreatePlan({}, plan), kTfLiteError);
+}
+
+TEST(TfPlannerTest, SingleResourceIsOneSubgraph) {
+  PlannerOptions options = NoOverhead();
+  options.allow_gpu = false;
+  options.allow_co_execution = false;
+  TfPlanner planner(options);
+  static Plan plan;
+  std::vector<LayerCost> costs = {Cost(1, 0.5, 1), Cost(2, 0.5, 1),
+                                  Cost(3, 0.5, 1)};
+  ASSERT_EQ(planner.CreatePlan(costs, plan), kTfLiteOk);
+  ASSERT_EQ(Rows(plan), 1);
+  ExpectRow(plan, 0, 0, 3, TF_P_PLAN_CPU, 0);
+  EXPECT_FLOAT_EQ(planner.GetEstimatedLatency(), 6);
+}
+
+TEST(TfPlannerTest, CpuBoundariesNeedNoTransfer) {
+  // Splitting CPU nodes costs only the subgraph overhead, so a single
+  // subgraph wins.
+  PlannerOptions options;
+  options.allow_gpu = false;
+  options.allow_co_execution = false;
+  options.subgraph_overhead = 0.5;
+  TfPlanner planner(options);
+  static Plan plan;
+  ASSERT_EQ(planner.CreatePlan({Cost(1, -1, 10), Cost(1, -1, 10)}, plan),
+            kTfLiteOk);
+  ASSERT_EQ(Rows(plan), 1);
+  EXPECT_FLOAT_EQ(planner.GetEstimatedLatency(), 2.5);
+}
+
+TEST(TfPlannerTest, UnsupportedNodeFallsBackToCpu) {
+  PlannerOptions options = NoOverhead();
+  options.allow_co_execution = false;
+  TfPlanner planner(options);
+  static Plan plan;
+  std::vector<LayerCost> costs = {Cost(10, 1, 0.5), Cost(10, -1, 0.5),
+                                  Cost(10, 1, 0.5)};
+  ASSERT_EQ(planner.CreatePlan(costs, plan), kTfLiteOk);
+  ASSERT_EQ(Rows(plan), 3);
+  ExpectRow(plan, 0, 0, 1, TF_P_PLAN_GPU, 0);
+  ExpectRow(plan, 1, 1, 2, TF_P_PLAN_CPU, 0);
+  ExpectRow(plan, 2, 2, 3, TF_P_PLAN_GPU, 0);
+  // 1 + 0.5 + 10 + 0.5 + 1, no transfer after the last subgraph.
+  EXPECT_FLOAT_EQ(planner.GetEstimatedLatency(), 13);
+}
+
+TEST(TfPlannerTest, TransferOutweighsFasterResource) {
+  PlannerOptions options = NoOverhead();
+  options.allow_co_execution = false;
+  TfPlanner planner(options);
+  static Plan plan;
+  std::vector<LayerCost> costs = {Cost(2, -1, 5), Cost(2, 1, 5)};
+  ASSERT_EQ(planner.CreatePlan(costs, plan), kTfLiteOk);
+  ASSERT_EQ(Rows(plan), 1);
+  ExpectRow(plan, 0, 0, 2, TF_P_PLAN_CPU, 0);
+}
+
+TEST(TfPlannerTest, NoFeasiblePlan) {
+  PlannerOptions options = NoOverhead();
+  options.allow_cpu = false;
+  TfPlanner planner(options);
+  static Plan plan;
+  EXPECT_EQ(planner.CreatePlan({Cost(1, 1), Cost(1, -1)}, plan),
+            kTfLiteError);
+}
+
+TEST(TfPlannerTest, CoExecutionTransferCountedOnce) {
+  PlannerOptions options = NoOverhead();
+  options.allow_gpu = false;
+  options.ratios = {5};
+  TfPlanner planner(options);
+  static Plan plan;
+  // Co-execution of node 0 on both sides, then a node only CPU runs.
+  std::vector<LayerCost> costs = {Cost(10, 10, 1), Cost(10, -1, 1)};
+  ASSERT_EQ(planner.CreatePlan(costs, plan), kTfLiteOk);
+  ASSERT_EQ(Rows(plan), 2);
+  ExpectRow(plan, 0, 0, 1, TF_P_PLAN_CO_E, 5);
+  ExpectRow(plan, 1, 1, 2, TF_P_PLAN_CPU, 0);
+  // max(5, 5) + transfer 1 at the boundary + 10.
+  EXPECT_FLOAT_EQ(planner.GetEstimatedLatency(), 16);
+}
+
+TEST(TfPlannerTest, CoExecutionPicksBalancedRatio) {
+  PlannerOptions options = NoOverhead();
+  options.allow_cpu = false;
+  options.allow_gpu = false;
+  options.ratios = {2, 5, 8};
+  TfPlanner planner(options);
+  static Plan plan;
+  // GPU side is 4 times faster, a ratio of 8 balances both sides.
+  LayerCost cost = Cost(20, 5);
+  ASSERT_EQ(planner.CreatePlan({cost}, plan), kTfLiteOk);
+  ASSERT_EQ(Rows(plan), 1);
+  ExpectRow(plan, 0, 0, 1, TF_P_PLAN_CO_E, 8);
+  EXPECT_FLOAT_EQ(planner.GetEstimatedLatency(), 4);
+}
+
+TEST(TfPlannerTest, MeasuredCoLatencyOverridesEstimate) {
+  PlannerOptions options = NoOverhead();
+  options.allow_cpu = false;
+  options.allow_gpu = false;
+  options.ratios = {5, 8};
+  TfPlanner planner(options);
+  static Plan plan;
+  LayerCost cost = Cost(20, 5);
+  cost.co_latency = {{5, 1}};
+  ASSERT_EQ(planner.CreatePlan({cost}, plan), kTfLiteOk);
+  ExpectRow(plan, 0, 0, 1, TF_P_PLAN_CO_E, 5);
+  EXPECT_FLOAT_EQ(planner.GetEstimatedLatency(), 1);
+}
+
+TEST(TfPlannerTest, ChannelRatioChangesWithinSubgraph) {
+  PlannerOptions options;
+  options.allow_cpu = false;
+  options.allow_gpu = false;
+  options.ratios = {2, 8};
+  options.subgraph_overhead = 0.5;
+  TfPlanner planner(options);
+  static Plan plan;
+  // Node 0 is balanced with ratio 8 and node 1 with ratio 2.
+  LayerCost first = Cost(20, 5, 1);
+  first.quantize = 0.25;
+  LayerCost second = Cost(5, 20, 1);
+  ASSERT_EQ(planner.CreatePlan({first, second}, plan), kTfLiteOk);
+  ASSERT_EQ(Rows(plan), 2);
+  ExpectRow(plan, 0, 0, 2, TF_P_PLAN_CO_E, 8);
+  ExpectRow(plan, 1, 1, 2, TF_P_PLAN_LAYER_RATIO, 2);
+  // 4 + 4 and a single subgraph overhead, node 0 is neither transferred
+  // nor quantized.
+  EXPECT_FLOAT_EQ(planner.GetEstimatedLatency(), 8.5);
+}
+
+TEST(TfPlannerTest, HeightRatioChangeSplitsSubgraph) {
+  PlannerOptions options = NoOverhead();
+  options.allow_cpu = false;
+  options.allow_gpu = false;
+  options.ratios = {12, 18};
+  options.height_halo_ratio = 0;
+  TfPlanner planner(options);
+  static Plan plan;
+  ASSERT_EQ(planner.CreatePlan({Cost(20, 5), Cost(5, 20)}, plan), kTfLiteOk);
+  ASSERT_EQ(Rows(plan), 2);
+  ExpectRow(plan, 0, 0, 1, TF_P_PLAN_CO_E, 18);
+  ExpectRow(plan, 1, 1, 2, TF_P_PLAN_CO_E, 12);
+}
+
+TEST(TfPlannerTest, NotPartitionableNodeIsNotSplit) {
+  PlannerOptions options = NoOverhead();
+  options.allow_gpu = false;
+  options.ratios = {5};
+  TfPlanner planner(options);
+  static Plan plan;
+  LayerCost cost = Cost(10, 10);
+  cost.partitionable = false;
+  ASSERT_EQ(planner.CreatePlan({cost}, plan), kTfLiteOk);
+  ExpectRow(plan, 0, 0, 1, TF_P_PLAN_CPU, 0);
+}
+
+TEST(TfPlannerTest, CpuClustersUseClusterResources) {
+  PlannerOptions options = NoOverhead();
+  options.cpu_clusters = true;
+  options.ratios = {5};
+  TfPlanner planner(options);
+  static Plan plan;
+  // Cluster B only, then a split between clusters.
+  std::vector<LayerCost> costs = {Cost(-1, 2), Cost(10, 10)};
+  ASSERT_EQ(planner.CreatePlan(costs, plan), kTfLiteOk);
+  ASSERT_EQ(Rows(plan), 2);
+  ExpectRow(plan, 0, 0, 1, TF_P_PLAN_CPU_B, 0);
+  ExpectRow(plan, 1, 1, 2, TF_P_PLAN_CO_CPU, 5);
+}
+
+}  // namespace
+}  // namespace tflite
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,99 @@
+#include "tensorflow/lite/tf_policy.h"
+
+#include <cstring>
+#include <ctime>
+
+namespace tflite{
+
+namespace {
+
+// Returns the index of the first best request, 'before(a, b)' is true if
+// 'a' goes before 'b'. Earlier arrival breaks ties.
+template <typename Before>
+int PickFirst(const std::vector<tf_request>& waiting, Before before){
+  int best = 0;
+  for(int i=1; i<static_cast<int>(waiting.size()); ++i){
+    if(before(waiting[i], waiting[best]) ||
+        (!before(waiting[best], waiting[i]) &&
+         waiting[i].arrival_us < waiting[best].arrival_us))
+      best = i;
+  }
+  return best;
+}
+
+// Earlier deadline first, no deadline last.
+bool EarlierDeadline(const tf_request& a, const tf_request& b){
+  if(a.deadline_us == 0 || b.deadline_us == 0)
+    return a.deadline_us != 0 && b.deadline_us == 0;
+  return a.deadline_us < b.deadline_us;
+}
+
+} // namespace
+
+int FixedPriorityPolicy::PickNext(const std::vector<tf_request>& waiting){
+  return PickFirst(waiting, [](const tf_request& a, const tf_request& b){
+    return a.priority > b.priority;
+  });
+}
+
+bool FixedPriorityPolicy::ShouldPreempt(const tf_request& waiter,
+                                        const tf_request& holder){
+  return waiter.priority > holder.priority;
+}
+
+int EdfPolicy::PickNext(const std::vector<tf_request>& waiting){
+  return PickFirst(waiting, EarlierDeadline);
+}
+
+bool EdfPolicy::ShouldPreempt(const tf_request& waiter,
+                              const tf_request& holder){
+  return EarlierDeadline(waiter, holder);
+}
+
+int FairSharePolicy::PickNext(const std::vector<tf_request>& waiting){
+  return PickFirst(waiting, [this](const tf_request& a, const tf_request& b){
+    return VirtualTime(a.runtime_id) < VirtualTime(b.runtime_id);
+  });
+}
+
+void FairSharePolicy::OnRelease(const tf_request& request, int64_t used_us){
+  const int weight = request.weight > 0 ? request.weight : 1;
+  virtual_time[request.runtime_id] =
+      VirtualTime(request.runtime_id) + static_cast<double>(used_us) / weight;
+}
+
+void FairSharePolicy::OnLeave(int runtime_id){
+  // Ids are reused, a new runtime of the same id starts from the least.
+  virtual_time.erase(runtime_id);
+}
+
+double FairSharePolicy::VirtualTime(int runtime_id){
+  auto found = virtual_time.find(runtime_id);
+  if(found != virtual_time.end())
+    return found->second;
+  double least = 0;
+  for(auto it = virtual_time.begin(); it != virtual_time.end(); ++it){
+    if(it == virtual_time.begin() || it->second < least)
+      least = it->second;
+  }
+  virtual_time[runtime_id] = least;
+  return least;
+}
+
+int64_t PolicyNowUs(){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+TfSchedulingPolicy* CreateSchedulingPolicy(const char* name){
+  if(strcmp(name, "priority") == 0)
+    return new FixedPriorityPolicy;
+  if(strcmp(name, "edf") == 0)
+    return new EdfPolicy;
+  if(strcmp(name, "fair") == 0)
+    return new FairSharePolicy;
+  return nullptr;
+}
+
+} // namespace tflite
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/*
+Scheduling policies of TfScheduler.
+
+A policy decides which of the requests waiting for a resource is granted
+next, and whether a waiting request preempts the lease of the runtime holding
+the resource. A preempted lease is revoked and given back at the next
+subgraph boundary of its holder, a subgraph is never interrupted.
+
+The scheduler keeps the owner and the waiting requests of each resource and
+a policy keeps only its own accounting, so that the same policy runs in the
+scheduler and in the simulator(examples/policy_simulator).
+*/
+
+// Environment variable of the policy name of TfScheduler, "priority" if not
+// set.
+#define TF_POLICY_ENV         "TF_SCHEDULING_POLICY"
+
+namespace tflite{
+
+// An invoke request waiting for a resource, or the one holding it.
+typedef struct tf_request{
+  int runtime_id = -1;
+  int priority = 0;         // higher first.
+  int weight = 1;           // share in weighted fair share.
+  int64_t arrival_us = 0;   // CLOCK_MONOTONIC
+  int64_t deadline_us = 0;  // absolute deadline of the frame, 0 if none.
+  int64_t granted_us = 0;   // when the resource was granted, 0 if waiting.
+  int subgraph = -1;        // subgraph to run, for telemetry.
+  int request_id = -1;      // echoed by the grant.
+}tf_request;
+
+class TfSchedulingPolicy{
+  public:
+    virtual ~TfSchedulingPolicy() = default;
+
+    virtual const char* Name() const = 0;
+
+    // Returns the index of the request in 'waiting'(not empty) to grant.
+    virtual int PickNext(const std::vector<tf_request>& waiting) = 0;
+
+    // Returns true if 'waiter' revokes the lease of 'holder'.
+    virtual bool ShouldPreempt(const tf_request& waiter,
+                               const tf_request& holder) = 0;
+
+    // A resource granted by 'request' is released after 'used_us'.
+    virtual void OnRelease(const tf_request& /*request*/,
+                           int64_t /*used_us*/) {}
+
+    // Runtime left the scheduler, after releasing all of its resources.
+    virtual void OnLeave(int /*runtime_id*/) {}
+};
+
+// Highest priority first, FIFO among the same priority.
+// A waiter of higher priority preempts.
+// Same as FIFO round robin if every runtime has the same priority.
+class FixedPriorityPolicy : public TfSchedulingPolicy{
+  public:
+    const char* Name() const override { return "priority"; }
+    int PickNext(const std::vector<tf_request>& waiting) override;
+    bool ShouldPreempt(const tf_request& waiter,
+                       const tf_request& holder) override;
+};
+
+// Earliest deadline first. Requests without a deadline go after the ones
+// with, in FIFO order. A waiter of earlier deadline preempts.
+class EdfPolicy : public TfSchedulingPolicy{
+  public:
+    const char* Name() const override { return "edf"; }
+    int PickNext(const std::vector<tf_request>& waiting) override;
+    bool ShouldPreempt(const tf_request& waiter,
+                       const tf_request& holder) override;
+};
+
+// Least used time per weight first. Never preempts, the shares are kept at
+// subgraph granularity.
+class FairSharePolicy : public TfSchedulingPolicy{
+  public:
+    const char* Name() const override { return "fair"; }
+    int PickNext(const std::vector<tf_request>& waiting) override;
+    bool ShouldPreempt(const tf_request& /*waiter*/,
+                       const tf_request& /*holder*/) override { return false; }
+    void OnRelease(const tf_request& request, int64_t used_us) override;
+    void OnLeave(int runtime_id) override;
+
+  private:
+    // Returns the virtual time of runtime. A new runtime starts from the
+    // least one, so it doesn't starve the others with its zero usage.
+    double VirtualTime(int runtime_id);
+
+    // <runtime id, used us / weight>
+    std::map<int, double> virtual_time;
+};
+
+// Current CLOCK_MONOTONIC time in us, the clock of tf_request.
+int64_t PolicyNowUs();
+
+// Returns a new policy of given name(priority, edf, fair), nullptr if
+// unknown.
+TfSchedulingPolicy* CreateSchedulingPolicy(const char* name);
+
+} // namespace tflite
@@ -0,0 +1,133 @@
+#include "tensorflow/lite/tf_policy.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace tflite {
+namespace {
+
+tf_request Request(int runtime_id, int64_t arrival_us, int priority = 0,
+                   int64_t deadline_us = 0) {
+  tf_request request;
+  request.runtime_id = runtime_id;
+  request.arrival_us = arrival_us;
+  request.priority = priority;
+  request.deadline_us = deadline_us;
+  return request;
+}
+
+TEST(TfPolicyTest, CreateByName) {
+  for (const char* name : {"priority", "edf", "fair"}) {
+    std::unique_ptr<TfSchedulingPolicy> policy(CreateSchedulingPolicy(name));
+    ASSERT_NE(policy, nullptr) << name;
+    EXPECT_STREQ(policy->Name(), name);
+  }
+  EXPECT_EQ(CreateSchedulingPolicy("lottery"), nullptr);
+}
+
+TEST(TfPolicyTest, FixedPriorityHighestFirst) {
+  FixedPriorityPolicy policy;
+  std::vector<tf_request> waiting = {Request(0, 10, 1), Request(1, 20, 3),
+                                     Request(2, 30, 2)};
+  EXPECT_EQ(policy.PickNext(waiting), 1);
+}
+
+TEST(TfPolicyTest, FixedPriorityFifoAmongSamePriority) {
+  FixedPriorityPolicy policy;
+  std::vector<tf_request> waiting = {Request(0, 30, 1), Request(1, 10, 1),
+                                     Request(2, 20, 1)};
+  EXPECT_EQ(policy.PickNext(waiting), 1);
+}
+
+TEST(TfPolicyTest, FixedPriorityPreemptsLowerOnly) {
+  FixedPriorityPolicy policy;
+  EXPECT_TRUE(policy.ShouldPreempt(Request(0, 0, 2), Request(1, 0, 1)));
+  EXPECT_FALSE(policy.ShouldPreempt(Request(0, 0, 1), Request(1, 0, 1)));
+  EXPECT_FALSE(policy.ShouldPreempt(Request(0, 0, 0), Request(1, 0, 1)));
+}
+
+TEST(TfPolicyTest, EdfEarliestDeadlineFirst) {
+  EdfPolicy policy;
+  std::vector<tf_request> waiting = {
+      Request(0, 10, 0, 0), Request(1, 20, 0, 500), Request(2, 30, 0, 300)};
+  EXPECT_EQ(policy.PickNext(waiting), 2);
+}
+
+TEST(TfPolicyTest, EdfNoDeadlineLastInFifo) {
+  EdfPolicy policy;
+  std::vector<tf_request> waiting = {Request(0, 20, 0, 0),
+                                     Request(1, 10, 0, 0)};
+  EXPECT_EQ(policy.PickNext(waiting), 1);
+  waiting.push_back(Request(2, 30, 0, 1000));
+  EXPECT_EQ(policy.PickNext(waiting), 2);
+}
+
+TEST(TfPolicyTest, EdfPreemptsLaterDeadline) {
+  EdfPolicy policy;
+  EXPECT_TRUE(policy.ShouldPreempt(Request(0, 0, 0, 100),
+                                   Request(1, 0, 0, 200)));
+  EXPECT_TRUE(policy.ShouldPreempt(Request(0, 0, 0, 100),
+                                   Request(1, 0, 0, 0)));
+  EXPECT_FALSE(policy.ShouldPreempt(Request(0, 0, 0, 0),
+                                    Request(1, 0, 0, 100)));
+  EXPECT_FALSE(policy.ShouldPreempt(Request(0, 0, 0, 200),
+                                    Request(1, 0, 0, 100)));
+}
+
+// Runtimes 0 ~ 'runtimes' - 1 start from zero usage.
+void Join(FairSharePolicy& policy, int runtimes) {
+  for (int i = 0; i < runtimes; ++i) policy.OnRelease(Request(i, 0), 0);
+}
+
+TEST(TfPolicyTest, FairShareLeastUsedFirst) {
+  FairSharePolicy policy;
+  Join(policy, 2);
+  policy.OnRelease(Request(0, 0), 100);
+  policy.OnRelease(Request(1, 0), 50);
+  std::vector<tf_request> waiting = {Request(0, 10), Request(1, 20)};
+  EXPECT_EQ(policy.PickNext(waiting), 1);
+  EXPECT_FALSE(policy.ShouldPreempt(waiting[1], waiting[0]));
+}
+
+TEST(TfPolicyTest, FairShareUsageDividedByWeight) {
+  FairSharePolicy policy;
+  Join(policy, 2);
+  tf_request heavy = Request(0, 0);
+  heavy.weight = 4;
+  policy.OnRelease(heavy, 100);           // 25 per weight
+  policy.OnRelease(Request(1, 0), 50);    // 50 per weight
+  std::vector<tf_request> waiting = {Request(1, 10), Request(0, 20)};
+  EXPECT_EQ(policy.PickNext(waiting), 1);
+}
+
+TEST(TfPolicyTest, FairShareNewRuntimeStartsFromLeast) {
+  FairSharePolicy policy;
+  policy.OnRelease(Request(0, 0), 100);
+  policy.OnRelease(Request(1, 0), 200);
+  // Runtime 2 starts at 100, ties with runtime 0 and arrived earlier.
+  std::vector<tf_request> waiting = {Request(0, 20), Request(1, 5),
+                                     Request(2, 10)};
+  EXPECT_EQ(policy.PickNext(waiting), 2);
+}
+
+TEST(TfPolicyTest, FairShareForgetsRuntimeOnLeave) {
+  FairSharePolicy policy;
+  Join(policy, 2);
+  policy.OnRelease(Request(0, 0), 100);
+  policy.OnRelease(Request(1, 0), 50);
+  policy.OnLeave(0);
+  // A new runtime of id 0 starts from 50, not from 100, and arrived
+  // earlier.
+  std::vector<tf_request> waiting = {Request(1, 20), Request(0, 10)};
+  EXPECT_EQ(policy.PickNext(waiting), 1);
+}
+
+}  // namespace
+}  // namespace tflite
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
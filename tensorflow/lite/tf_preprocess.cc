@@ -0,0 +1,614 @@
+#include "tensorflow/lite/tf_preprocess.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "tensorflow/lite/tf_quantize_simd.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include "tensorflow/lite/kernels/internal/optimized/neon_check.h"
+#define SIMD_OR_PORTABLE(...) NEON_OR_PORTABLE(__VA_ARGS__)
+#else
+#include "tensorflow/lite/kernels/internal/optimized/sse_check.h"
+#define SIMD_OR_PORTABLE(...) SSE_OR_PORTABLE(__VA_ARGS__)
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+#endif
+
+namespace tflite{
+
+namespace {
+
+// A gather of the horizontal resample reads a 32bit word from the offset of
+// a single byte.
+constexpr int kSourcePadding = 4;
+
+// Destination of a row, a float row and/or a quantized row.
+struct RowOutput{
+  float* values = nullptr;
+  uint8_t* quantized = nullptr;
+  float scale = 1;     // 1 / scale of the tensor.
+  int zero_point = 0;  // moved by 128 for int8.
+  uint8_t flip = 0;    // 0x80 for int8, which is uint8 with the sign flipped.
+};
+
+inline int Clamp255(int value){
+  return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+// BT.601 limited range, in 8bit fixed point as camera pipelines convert.
+// Clamped in integers, which compiles without branches unlike float clamps.
+// The vector forms below compute the same bits.
+inline void YuvToRgb(int y, int u, int v, uint8_t* r, uint8_t* g,
+                     uint8_t* b){
+  const int c = 298 * (y - 16) + 128;
+  const int d = u - 128;
+  const int e = v - 128;
+  *r = Clamp255((c + 409 * e) >> 8);
+  *g = Clamp255((c - 100 * d - 208 * e) >> 8);
+  *b = Clamp255((c + 516 * d) >> 8);
+}
+
+// Pixels 'begin' ~ 'width' - 1 of a source row to planes of R, G and B,
+// each of 'width' bytes.
+void PortableNv12ToPlanes(const uint8_t* row, const uint8_t* uv_row,
+                          int begin, int width, uint8_t* planes){
+  for(int x=begin; x<width; ++x)
+    YuvToRgb(row[x], uv_row[(x >> 1) * 2], uv_row[(x >> 1) * 2 + 1],
+             planes + x, planes + width + x, planes + width * 2 + x);
+}
+
+void PortableYuyvToPlanes(const uint8_t* row, int begin, int width,
+                          uint8_t* planes){
+  for(int x=begin; x<width; ++x)
+    YuvToRgb(row[x * 2], row[(x >> 1) * 4 + 1], row[(x >> 1) * 4 + 3],
+             planes + x, planes + width + x, planes + width * 2 + x);
+}
+
+// out[i] = source[tap0[i]] + (source[tap1[i]] - source[tap0[i]]) * weight[i]
+void PortableResampleRow(const uint8_t* source, const int* tap0,
+                         const int* tap1, const float* weight, int size,
+                         float* out){
+  for(int i=0; i<size; ++i){
+    const float left = source[tap0[i]];
+    out[i] = left + (source[tap1[i]] - left) * weight[i];
+  }
+}
+
+// value = (a[i] + (b[i] - a[i]) * fy) * mul[i] + add[i], stored and/or
+// quantized as QuantizeFloatsToUint8 for i of 'begin' ~ 'size' - 1.
+void PortableBlendNormalizeStore(const float* a, const float* b, float fy,
+                                 const float* mul, const float* add,
+                                 int begin, int size,
+                                 const RowOutput& output){
+  for(int i=begin; i<size; ++i){
+    const float value = (a[i] + (b[i] - a[i]) * fy) * mul[i] + add[i];
+    if(output.values != nullptr)
+      output.values[i] = value;
+    if(output.quantized == nullptr)
+      continue;
+    const float scaled = std::min(
+        std::max(value * output.scale, -kQuantizeClampLimit),
+        kQuantizeClampLimit);
+    const int quantized =
+        static_cast<int>(std::round(scaled)) + output.zero_point;
+    output.quantized[i] = static_cast<uint8_t>(Clamp255(quantized)) ^
+                          output.flip;
+  }
+}
+
+#if defined(USE_NEON) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+inline uint8x8_t NeonNarrowPlane(int32x4_t lo, int32x4_t hi){
+  // >> 8, then saturated to [0, 255] as Clamp255.
+  return vqmovn_u16(vcombine_u16(vqshrun_n_s32(lo, 8),
+                                 vqshrun_n_s32(hi, 8)));
+}
+
+// R, G, B of 8 pixels from y - 16, u - 128 and v - 128.
+inline void NeonYuvToRgb(int16x8_t y, int16x8_t d, int16x8_t e, uint8_t* r,
+                         uint8_t* g, uint8_t* b){
+  const int16x4_t d_lo = vget_low_s16(d), d_hi = vget_high_s16(d);
+  const int16x4_t e_lo = vget_low_s16(e), e_hi = vget_high_s16(e);
+  const int32x4_t c_lo = vmlal_n_s16(vdupq_n_s32(128), vget_low_s16(y), 298);
+  const int32x4_t c_hi = vmlal_n_s16(vdupq_n_s32(128), vget_high_s16(y), 298);
+  vst1_u8(r, NeonNarrowPlane(vmlal_n_s16(c_lo, e_lo, 409),
+                             vmlal_n_s16(c_hi, e_hi, 409)));
+  vst1_u8(g, NeonNarrowPlane(
+      vmlal_n_s16(vmlal_n_s16(c_lo, d_lo, -100), e_lo, -208),
+      vmlal_n_s16(vmlal_n_s16(c_hi, d_hi, -100), e_hi, -208)));
+  vst1_u8(b, NeonNarrowPlane(vmlal_n_s16(c_lo, d_lo, 516),
+                             vmlal_n_s16(c_hi, d_hi, 516)));
+}
+
+inline int16x8_t NeonWiden(uint8x8_t bytes, int offset){
+  return vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(bytes)),
+                   vdupq_n_s16(offset));
+}
+
+void NeonNv12ToPlanes(const uint8_t* row, const uint8_t* uv_row, int begin,
+                      int width, uint8_t* planes){
+  int x = begin;
+  for(; x + 8 <= width; x += 8){
+    // U0 V0 .. U3 V3 of 8 pixels, each chroma for two pixels.
+    const uint8x8x2_t uv = vuzp_u8(vld1_u8(uv_row + x), vdup_n_u8(0));
+    NeonYuvToRgb(NeonWiden(vld1_u8(row + x), 16),
+                 NeonWiden(vzip_u8(uv.val[0], uv.val[0]).val[0], 128),
+                 NeonWiden(vzip_u8(uv.val[1], uv.val[1]).val[0], 128),
+                 planes + x, planes + width + x, planes + width * 2 + x);
+  }
+  PortableNv12ToPlanes(row, uv_row, x, width, planes);
+}
+
+void NeonYuyvToPlanes(const uint8_t* row, int begin, int width,
+                      uint8_t* planes){
+  int x = begin;
+  for(; x + 16 <= width; x += 16){
+    // Y of even pixels, U, Y of odd pixels and V of 16 pixels.
+    const uint8x8x4_t yuyv = vld4_u8(row + x * 2);
+    const uint8x8x2_t y = vzip_u8(yuyv.val[0], yuyv.val[2]);
+    const uint8x8x2_t u = vzip_u8(yuyv.val[1], yuyv.val[1]);
+    const uint8x8x2_t v = vzip_u8(yuyv.val[3], yuyv.val[3]);
+    for(int half=0; half<2; ++half){
+      const int offset = x + half * 8;
+      NeonYuvToRgb(NeonWiden(y.val[half], 16), NeonWiden(u.val[half], 128),
+                   NeonWiden(v.val[half], 128), planes + offset,
+                   planes + width + offset, planes + width * 2 + offset);
+    }
+  }
+  PortableYuyvToPlanes(row, x, width, planes);
+}
+
+// NEON has no gather, taps are loaded one by one and blended in vectors.
+void NeonResampleRow(const uint8_t* source, const int* tap0, const int* tap1,
+                     const float* weight, int size, float* out){
+  int i = 0;
+  for(; i + 8 <= size; i += 8){
+    uint8_t left[8], right[8];
+    for(int k=0; k<8; ++k){
+      left[k] = source[tap0[i + k]];
+      right[k] = source[tap1[i + k]];
+    }
+    const uint16x8_t left_16 = vmovl_u8(vld1_u8(left));
+    const uint16x8_t right_16 = vmovl_u8(vld1_u8(right));
+    for(int half=0; half<2; ++half){
+      const uint16x4_t l = half == 0 ? vget_low_u16(left_16) :
+                                       vget_high_u16(left_16);
+      const uint16x4_t r = half == 0 ? vget_low_u16(right_16) :
+                                       vget_high_u16(right_16);
+      const float32x4_t l_f = vcvtq_f32_u32(vmovl_u16(l));
+      const float32x4_t r_f = vcvtq_f32_u32(vmovl_u16(r));
+      vst1q_f32(out + i + half * 4,
+                vmlaq_f32(l_f, vsubq_f32(r_f, l_f),
+                          vld1q_f32(weight + i + half * 4)));
+    }
+  }
+  PortableResampleRow(source, tap0 + i, tap1 + i, weight + i, size - i,
+                      out + i);
+}
+
+void NeonBlendNormalizeStore(const float* a, const float* b, float fy,
+                             const float* mul, const float* add, int begin,
+                             int size, const RowOutput& output){
+  const float32x4_t lo = vdupq_n_f32(-kQuantizeClampLimit);
+  const float32x4_t hi = vdupq_n_f32(kQuantizeClampLimit);
+  const int32x4_t zero_point = vdupq_n_s32(output.zero_point);
+  const uint8x8_t flip = vdup_n_u8(output.flip);
+  auto normalize4 = [&](int i){
+    const float32x4_t a_v = vld1q_f32(a + i);
+    const float32x4_t blended =
+        vmlaq_n_f32(a_v, vsubq_f32(vld1q_f32(b + i), a_v), fy);
+    const float32x4_t value = vmlaq_f32(vld1q_f32(add + i), blended,
+                                        vld1q_f32(mul + i));
+    if(output.values != nullptr)
+      vst1q_f32(output.values + i, value);
+    return value;
+  };
+  auto quantize4 = [&](float32x4_t value){
+    float32x4_t x = vmulq_n_f32(value, output.scale);
+    x = vminq_f32(vmaxq_f32(x, lo), hi);
+    return vqmovn_s32(vaddq_s32(NeonRound(x), zero_point));
+  };
+  int i = begin;
+  for(; i + 8 <= size; i += 8){
+    const float32x4_t first = normalize4(i);
+    const float32x4_t second = normalize4(i + 4);
+    if(output.quantized == nullptr)
+      continue;
+    const int16x8_t q = vcombine_s16(quantize4(first), quantize4(second));
+    vst1_u8(output.quantized + i, veor_u8(vqmovun_s16(q), flip));
+  }
+  PortableBlendNormalizeStore(a, b, fy, mul, add, i, size, output);
+}
+#endif
+
+#if defined(__SSSE3__)
+inline __m128i SseNarrowPlane(__m128i lo, __m128i hi){
+  // >> 8, then saturated to [0, 255] as Clamp255.
+  const __m128i words = _mm_packs_epi32(_mm_srai_epi32(lo, 8),
+                                        _mm_srai_epi32(hi, 8));
+  return _mm_packus_epi16(words, words);
+}
+
+// R, G, B of 8 pixels from y - 16, u - 128 and v - 128.
+inline void SseYuvToRgb(__m128i y, __m128i d, __m128i e, uint8_t* r,
+                        uint8_t* g, uint8_t* b){
+  // 298 * y + 128 and the chroma terms as sums of int16 pairs.
+  const __m128i y_coeff = _mm_unpacklo_epi16(_mm_set1_epi16(298),
+                                             _mm_set1_epi16(128));
+  const __m128i one = _mm_set1_epi16(1);
+  const __m128i c_lo = _mm_madd_epi16(_mm_unpacklo_epi16(y, one), y_coeff);
+  const __m128i c_hi = _mm_madd_epi16(_mm_unpackhi_epi16(y, one), y_coeff);
+  const __m128i de_lo = _mm_unpacklo_epi16(d, e);
+  const __m128i de_hi = _mm_unpackhi_epi16(d, e);
+  auto plane = [&](int16_t d_coeff, int16_t e_coeff, uint8_t* out){
+    const __m128i coeff = _mm_unpacklo_epi16(_mm_set1_epi16(d_coeff),
+                                             _mm_set1_epi16(e_coeff));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), SseNarrowPlane(
+        _mm_add_epi32(c_lo, _mm_madd_epi16(de_lo, coeff)),
+        _mm_add_epi32(c_hi, _mm_madd_epi16(de_hi, coeff))));
+  };
+  plane(0, 409, r);
+  plane(-100, -208, g);
+  plane(516, 0, b);
+}
+
+void SseNv12ToPlanes(const uint8_t* row, const uint8_t* uv_row, int begin,
+                     int width, uint8_t* planes){
+  // U0 V0 .. U3 V3 of 8 pixels to int16 lanes, each chroma for two pixels.
+  const __m128i u_order = _mm_setr_epi8(0, -1, 0, -1, 2, -1, 2, -1,
+                                        4, -1, 4, -1, 6, -1, 6, -1);
+  const __m128i v_order = _mm_setr_epi8(1, -1, 1, -1, 3, -1, 3, -1,
+                                        5, -1, 5, -1, 7, -1, 7, -1);
+  const __m128i zero = _mm_setzero_si128();
+  int x = begin;
+  for(; x + 8 <= width; x += 8){
+    const __m128i y = _mm_unpacklo_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + x)), zero);
+    const __m128i uv =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(uv_row + x));
+    SseYuvToRgb(_mm_sub_epi16(y, _mm_set1_epi16(16)),
+                _mm_sub_epi16(_mm_shuffle_epi8(uv, u_order),
+                              _mm_set1_epi16(128)),
+                _mm_sub_epi16(_mm_shuffle_epi8(uv, v_order),
+                              _mm_set1_epi16(128)),
+                planes + x, planes + width + x, planes + width * 2 + x);
+  }
+  PortableNv12ToPlanes(row, uv_row, x, width, planes);
+}
+
+void SseYuyvToPlanes(const uint8_t* row, int begin, int width,
+                     uint8_t* planes){
+  // Y0 U0 Y1 V0 .. of 8 pixels to int16 lanes.
+  const __m128i y_order = _mm_setr_epi8(0, -1, 2, -1, 4, -1, 6, -1,
+                                        8, -1, 10, -1, 12, -1, 14, -1);
+  const __m128i u_order = _mm_setr_epi8(1, -1, 1, -1, 5, -1, 5, -1,
+                                        9, -1, 9, -1, 13, -1, 13, -1);
+  const __m128i v_order = _mm_setr_epi8(3, -1, 3, -1, 7, -1, 7, -1,
+                                        11, -1, 11, -1, 15, -1, 15, -1);
+  int x = begin;
+  for(; x + 8 <= width; x += 8){
+    const __m128i yuyv =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 2));
+    SseYuvToRgb(_mm_sub_epi16(_mm_shuffle_epi8(yuyv, y_order),
+                              _mm_set1_epi16(16)),
+                _mm_sub_epi16(_mm_shuffle_epi8(yuyv, u_order),
+                              _mm_set1_epi16(128)),
+                _mm_sub_epi16(_mm_shuffle_epi8(yuyv, v_order),
+                              _mm_set1_epi16(128)),
+                planes + x, planes + width + x, planes + width * 2 + x);
+  }
+  PortableYuyvToPlanes(row, x, width, planes);
+}
+
+// Taps are gathered with AVX2, SSE has no gather.
+void SseResampleRow(const uint8_t* source, const int* tap0, const int* tap1,
+                    const float* weight, int size, float* out){
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256i byte_mask = _mm256_set1_epi32(0xff);
+  auto gather8 = [&](const int* taps){
+    const __m256i words = _mm256_i32gather_epi32(
+        reinterpret_cast<const int*>(source),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(taps)), 1);
+    return _mm256_cvtepi32_ps(_mm256_and_si256(words, byte_mask));
+  };
+  for(; i + 8 <= size; i += 8){
+    const __m256 left = gather8(tap0 + i);
+    const __m256 right = gather8(tap1 + i);
+    _mm256_storeu_ps(out + i, _mm256_add_ps(left, _mm256_mul_ps(
+        _mm256_sub_ps(right, left), _mm256_loadu_ps(weight + i))));
+  }
+#endif
+  PortableResampleRow(source, tap0 + i, tap1 + i, weight + i, size - i,
+                      out + i);
+}
+
+void SseBlendNormalizeStore(const float* a, const float* b, float fy,
+                            const float* mul, const float* add, int begin,
+                            int size, const RowOutput& output){
+  int i = begin;
+#if defined(__AVX2__)
+  const __m256 fy_8 = _mm256_set1_ps(fy);
+  const __m256 scale_8 = _mm256_set1_ps(output.scale);
+  const __m256 lo_8 = _mm256_set1_ps(-kQuantizeClampLimit);
+  const __m256 hi_8 = _mm256_set1_ps(kQuantizeClampLimit);
+  const __m256i zero_point_8 = _mm256_set1_epi32(output.zero_point);
+  const __m256i flip_32 = _mm256_set1_epi8(static_cast<char>(output.flip));
+  // packs work per 128bit lane, this puts the 32bit groups back in order.
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  auto normalize8 = [&](int j){
+    const __m256 a_v = _mm256_loadu_ps(a + j);
+    const __m256 blended = _mm256_add_ps(a_v, _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_loadu_ps(b + j), a_v), fy_8));
+    const __m256 value = _mm256_add_ps(
+        _mm256_mul_ps(blended, _mm256_loadu_ps(mul + j)),
+        _mm256_loadu_ps(add + j));
+    if(output.values != nullptr)
+      _mm256_storeu_ps(output.values + j, value);
+    return value;
+  };
+  auto quantize8 = [&](__m256 value){
+    const __m256 x = _mm256_min_ps(
+        _mm256_max_ps(_mm256_mul_ps(value, scale_8), lo_8), hi_8);
+    return _mm256_add_epi32(Avx2Round(x), zero_point_8);
+  };
+  for(; i + 32 <= size; i += 32){
+    const __m256 v0 = normalize8(i);
+    const __m256 v1 = normalize8(i + 8);
+    const __m256 v2 = normalize8(i + 16);
+    const __m256 v3 = normalize8(i + 24);
+    if(output.quantized == nullptr)
+      continue;
+    const __m256i ab = _mm256_packs_epi32(quantize8(v0), quantize8(v1));
+    const __m256i cd = _mm256_packs_epi32(quantize8(v2), quantize8(v3));
+    const __m256i bytes = _mm256_permutevar8x32_epi32(
+        _mm256_packus_epi16(ab, cd), order);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output.quantized + i),
+                        _mm256_xor_si256(bytes, flip_32));
+  }
+#endif
+  const __m128 fy_4 = _mm_set1_ps(fy);
+  const __m128 scale_4 = _mm_set1_ps(output.scale);
+  const __m128 lo = _mm_set1_ps(-kQuantizeClampLimit);
+  const __m128 hi = _mm_set1_ps(kQuantizeClampLimit);
+  const __m128i zero_point_4 = _mm_set1_epi32(output.zero_point);
+  const __m128i flip_16 = _mm_set1_epi8(static_cast<char>(output.flip));
+  auto normalize4 = [&](int j){
+    const __m128 a_v = _mm_loadu_ps(a + j);
+    const __m128 blended = _mm_add_ps(a_v, _mm_mul_ps(
+        _mm_sub_ps(_mm_loadu_ps(b + j), a_v), fy_4));
+    const __m128 value = _mm_add_ps(_mm_mul_ps(blended, _mm_loadu_ps(mul + j)),
+                                    _mm_loadu_ps(add + j));
+    if(output.values != nullptr)
+      _mm_storeu_ps(output.values + j, value);
+    return value;
+  };
+  auto quantize4 = [&](__m128 value){
+    const __m128 x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(value, scale_4), lo),
+                                hi);
+    return _mm_add_epi32(SseRound(x), zero_point_4);
+  };
+  for(; i + 16 <= size; i += 16){
+    const __m128 v0 = normalize4(i);
+    const __m128 v1 = normalize4(i + 4);
+    const __m128 v2 = normalize4(i + 8);
+    const __m128 v3 = normalize4(i + 12);
+    if(output.quantized == nullptr)
+      continue;
+    const __m128i ab = _mm_packs_epi32(quantize4(v0), quantize4(v1));
+    const __m128i cd = _mm_packs_epi32(quantize4(v2), quantize4(v3));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output.quantized + i),
+                     _mm_xor_si128(_mm_packus_epi16(ab, cd), flip_16));
+  }
+  PortableBlendNormalizeStore(a, b, fy, mul, add, i, size, output);
+}
+#endif
+
+// Offset of 'channel'(0 R, 1 G, 2 B) of pixel 'x' in a source row converted
+// by ConvertSourceRow.
+int SourceOffset(TfPixelFormat format, int width, int x, int channel){
+  if(format == TF_PIXEL_BGR8)
+    return x * 3 + 2 - channel;
+  return channel * width + x;
+}
+
+// Source coordinate of output 'i' with half pixel centers, as the lower
+// source index, the upper one and the weight of the upper.
+void SourceCoordinate(int i, int out_size, int in_size, int& lower,
+                      int& upper, float& weight){
+  float source = (i + 0.5f) * in_size / out_size - 0.5f;
+  if(source < 0)
+    source = 0;
+  lower = std::min(static_cast<int>(source), in_size - 1);
+  upper = std::min(lower + 1, in_size - 1);
+  weight = source - lower;
+}
+
+bool IsValidFrame(const TfFrame& frame){
+  if(frame.data == nullptr || frame.width <= 0 || frame.height <= 0)
+    return false;
+  switch(frame.format){
+    case TF_PIXEL_BGR8:
+      return frame.stride >= frame.width * 3;
+    case TF_PIXEL_NV12:
+      return frame.stride >= frame.width && frame.uv != nullptr &&
+             frame.uv_stride >= ((frame.width + 1) & ~1);
+    case TF_PIXEL_YUYV:
+      return frame.width % 2 == 0 && frame.stride >= frame.width * 2;
+  }
+  return false;
+}
+
+} // namespace
+
+TfPreprocessor::TfPreprocessor(int threads)
+    : threads_(threads > 0 ? threads : 1), scratches_(threads_) {
+  for(int i=1; i<threads_; ++i)
+    workers_.emplace_back(&TfPreprocessor::WorkerLoop, this, i);
+}
+
+TfPreprocessor::~TfPreprocessor(){
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+  for(std::thread& worker : workers_)
+    worker.join();
+}
+
+bool TfPreprocessor::Run(const TfFrame& frame,
+                         const TfNormalization& normalization,
+                         int width, int height,
+                         const std::vector<TfPreprocessTarget>& targets){
+  if(!IsValidFrame(frame) || width <= 0 || height <= 0)
+    return false;
+  for(const TfPreprocessTarget& target : targets){
+    if(target.data == nullptr ||
+        (target.type != TF_PREPROCESS_FLOAT32 && target.scale <= 0))
+      return false;
+  }
+  for(int i=0; i<3; ++i){
+    if(normalization.std[i] == 0)
+      return false;
+  }
+  // Both taps of every output value, with the channel order of the output.
+  const int row_size = width * 3;
+  tap0_.resize(row_size);
+  tap1_.resize(row_size);
+  weight_.resize(row_size);
+  for(int x=0; x<width; ++x){
+    int x0, x1;
+    float fx;
+    SourceCoordinate(x, width, frame.width, x0, x1, fx);
+    for(int c=0; c<3; ++c){
+      const int channel = normalization.bgr ? 2 - c : c;
+      tap0_[x * 3 + c] = SourceOffset(frame.format, frame.width, x0, channel);
+      tap1_[x * 3 + c] = SourceOffset(frame.format, frame.width, x1, channel);
+      weight_[x * 3 + c] = fx;
+    }
+  }
+  mul_.resize(row_size);
+  add_.resize(row_size);
+  for(int i=0; i<row_size; ++i){
+    mul_[i] = 1.0f / normalization.std[i % 3];
+    add_[i] = -normalization.mean[i % 3] * mul_[i];
+  }
+  // A float target and a quantized one are written in the same pass.
+  passes_.clear();
+  for(int i=0; i<static_cast<int>(targets.size()); ++i){
+    const bool is_float = targets[i].type == TF_PREPROCESS_FLOAT32;
+    auto pass = std::find_if(passes_.begin(), passes_.end(),
+                             [&](const Pass& candidate){
+      return (is_float ? candidate.values : candidate.quantized) == -1;
+    });
+    if(pass == passes_.end())
+      pass = passes_.insert(passes_.end(), Pass());
+    (is_float ? pass->values : pass->quantized) = i;
+  }
+  frame_ = &frame;
+  targets_ = &targets;
+  width_ = width;
+  height_ = height;
+  for(Scratch& scratch : scratches_){
+    scratch.rows[0] = scratch.rows[1] = -1; // rows of the last frame.
+    scratch.source.resize(frame.width * 3 + kSourcePadding);
+    for(std::vector<float>& row : scratch.resampled)
+      row.resize(row_size);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = threads_ - 1;
+    generation_++;
+  }
+  start_cv_.notify_all();
+  RunRows(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this]{ return pending_ == 0; });
+  return true;
+}
+
+void TfPreprocessor::RunRows(int index){
+  const int begin = height_ * index / threads_;
+  const int end = height_ * (index + 1) / threads_;
+  if(begin < end)
+    ConvertRows(begin, end, scratches_[index]);
+}
+
+const float* TfPreprocessor::ResampledRow(int y, int keep, Scratch& scratch){
+  for(int i=0; i<2; ++i){
+    if(scratch.rows[i] == y)
+      return scratch.resampled[i].data();
+  }
+  const int slot = scratch.rows[0] == keep ? 1 : 0;
+  const TfFrame& frame = *frame_;
+  const uint8_t* row = frame.data + static_cast<size_t>(y) * frame.stride;
+  uint8_t* source = scratch.source.data();
+  switch(frame.format){
+    case TF_PIXEL_BGR8:
+      std::copy(row, row + frame.width * 3, source);
+      break;
+    case TF_PIXEL_NV12:
+      SIMD_OR_PORTABLE(Nv12ToPlanes, row,
+                       frame.uv + static_cast<size_t>(y >> 1) * frame.uv_stride,
+                       0, frame.width, source);
+      break;
+    case TF_PIXEL_YUYV:
+      SIMD_OR_PORTABLE(YuyvToPlanes, row, 0, frame.width, source);
+      break;
+  }
+  float* out = scratch.resampled[slot].data();
+  SIMD_OR_PORTABLE(ResampleRow, source, tap0_.data(), tap1_.data(),
+                   weight_.data(), width_ * 3, out);
+  scratch.rows[slot] = y;
+  return out;
+}
+
+void TfPreprocessor::ConvertRows(int begin, int end, Scratch& scratch){
+  const int row_size = width_ * 3;
+  const std::vector<TfPreprocessTarget>& targets = *targets_;
+  for(int y=begin; y<end; ++y){
+    int y0, y1;
+    float fy;
+    SourceCoordinate(y, height_, frame_->height, y0, y1, fy);
+    const float* upper = ResampledRow(y0, -1, scratch);
+    const float* lower = ResampledRow(y1, y0, scratch);
+    const size_t offset = static_cast<size_t>(y) * row_size;
+    for(const Pass& pass : passes_){
+      RowOutput output;
+      if(pass.values != -1)
+        output.values = static_cast<float*>(targets[pass.values].data) +
+                        offset;
+      if(pass.quantized != -1){
+        const TfPreprocessTarget& target = targets[pass.quantized];
+        const bool is_int8 = target.type == TF_PREPROCESS_INT8;
+        output.quantized = static_cast<uint8_t*>(target.data) + offset;
+        output.scale = 1.0f / target.scale;
+        output.zero_point = target.zero_point + (is_int8 ? 128 : 0);
+        output.flip = is_int8 ? 0x80 : 0;
+      }
+      SIMD_OR_PORTABLE(BlendNormalizeStore, upper, lower, fy, mul_.data(),
+                       add_.data(), 0, row_size, output);
+    }
+  }
+}
+
+void TfPreprocessor::WorkerLoop(int index){
+  int generation = 0;
+  while(1){
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cv_.wait(lock, [&]{ return stop_ || generation_ != generation; });
+      if(stop_)
+        return;
+      generation = generation_;
+    }
+    RunRows(index);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(--pending_ == 0)
+      done_cv_.notify_one();
+  }
+}
+
+} // namespace tflite
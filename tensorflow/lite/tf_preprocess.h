@@ -0,0 +1,128 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tflite{
+
+// Layouts of camera frames.
+typedef enum TfPixelFormat{
+  TF_PIXEL_BGR8,  // packed B, G, R bytes.
+  TF_PIXEL_NV12,  // Y plane, then a plane of interleaved U, V at half
+                  // resolution.
+  TF_PIXEL_YUYV,  // packed Y0, U, Y1, V of two pixels.
+}TfPixelFormat;
+
+typedef struct TfFrame{
+  TfPixelFormat format = TF_PIXEL_BGR8;
+  int width = 0;
+  int height = 0;
+  // Packed pixels or the Y plane, and its bytes per row.
+  const uint8_t* data = nullptr;
+  int stride = 0;
+  // UV plane of NV12 and its bytes per row.
+  const uint8_t* uv = nullptr;
+  int uv_stride = 0;
+}TfFrame;
+
+// normalized = (pixel - mean[c]) / std[c] on pixels of 0 ~ 255, in the
+// channel order of the output.
+typedef struct TfNormalization{
+  float mean[3] = {0, 0, 0};
+  float std[3] = {1, 1, 1};
+  // Channels are R, G, B unless set.
+  bool bgr = false;
+}TfNormalization;
+
+typedef enum TfPreprocessType{
+  TF_PREPROCESS_FLOAT32,
+  TF_PREPROCESS_UINT8,
+  TF_PREPROCESS_INT8,
+}TfPreprocessType;
+
+// NHWC 3 channel output. Quantized types store
+//   clamp(round(normalized / scale) + zero_point)
+// with the scale and zero point of their tensor.
+typedef struct TfPreprocessTarget{
+  TfPreprocessType type = TF_PREPROCESS_FLOAT32;
+  void* data = nullptr;
+  float scale = 1;
+  int zero_point = 0;
+}TfPreprocessTarget;
+
+// Converts a camera frame into input tensors in a single pass over the
+// output rows. Each row is resized bilinearly(half pixel centers, as
+// cv::resize INTER_LINEAR) while converted to RGB, normalized, and written
+// to every target, so that the float tensor of co-execution and its
+// quantized pair are filled from one conversion. YUV is BT.601 limited
+// range. A source row is converted to RGB and resampled to the output
+// width once, then each output row is blended, normalized, stored and
+// quantized in one pass. Vectorized with NEON, SSE or AVX2 if the target
+// supports it(the horizontal resample gathers with AVX2 only).
+// Rows are split between 'threads'(the caller is one of them).
+// Run is called from one thread at a time.
+class TfPreprocessor{
+  public:
+    explicit TfPreprocessor(int threads = 1);
+    ~TfPreprocessor();
+
+    // Writes 'frame' resized to 'width' x 'height' into 'targets'.
+    // Returns false if the frame or a target is invalid.
+    bool Run(const TfFrame& frame, const TfNormalization& normalization,
+             int width, int height,
+             const std::vector<TfPreprocessTarget>& targets);
+
+  private:
+    // Source rows resampled horizontally, kept while the next output row
+    // reads them.
+    struct Scratch{
+      int rows[2] = {-1, -1};
+      std::vector<float> resampled[2];
+      // Source row being resampled, packed BGR or planes of R, G and B.
+      std::vector<uint8_t> source;
+    };
+
+    // Targets written together in one pass over a row, a float one and a
+    // quantized one. Indices of targets, -1 if none.
+    struct Pass{
+      int values = -1;
+      int quantized = -1;
+    };
+
+    void RunRows(int index);
+    void ConvertRows(int begin, int end, Scratch& scratch);
+    // Source row 'y' resampled to the output width, in 'scratch'. Row
+    // 'keep' stays in it.
+    const float* ResampledRow(int y, int keep, Scratch& scratch);
+    void WorkerLoop(int index);
+
+    const int threads_;
+    std::vector<Scratch> scratches_;
+
+    // Job of Run, shared with workers.
+    const TfFrame* frame_ = nullptr;
+    const std::vector<TfPreprocessTarget>* targets_ = nullptr;
+    int width_ = 0;
+    int height_ = 0;
+    // Offsets in the converted source row of both taps and the weight of
+    // the second, for each value of an output row.
+    std::vector<int> tap0_;
+    std::vector<int> tap1_;
+    std::vector<float> weight_;
+    // normalized[i] = value[i] * mul_[i] + add_[i] over a row.
+    std::vector<float> mul_;
+    std::vector<float> add_;
+    std::vector<Pass> passes_;
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    int generation_ = 0;
+    int pending_ = 0;
+    bool stop_ = false;
+};
+
+} // namespace tflite
@@ -0,0 +1,172 @@
+#include "tensorflow/lite/tf_protocol.h"
+
+#include <cstring>
+
+namespace tflite{
+
+namespace {
+
+// Per-node arrays of tf_profile in payload order.
+float (tf_profile::* const kProfileFields[TF_MSG_PROFILE_FIELDS])
+    [TF_P_PLAN_LENGTH] = {
+  &tf_profile::latency,
+  &tf_profile::latency_p90,
+  &tf_profile::xnn_latency,
+  &tf_profile::gpu_latency,
+  &tf_profile::gpu_latency_p90,
+  &tf_profile::co_cpu_latency,
+  &tf_profile::transfer_latency,
+  &tf_profile::quantize_latency
+};
+
+} // namespace
+
+void SetMsgHeader(tf_msg_header& header, TF_MSG_TYPE type, int runtime_id,
+                  int current_state, int next_state){
+  header.magic = TF_MSG_MAGIC;
+  header.version = TF_MSG_VERSION;
+  header.type = type;
+  header.runtime_id = runtime_id;
+  header.runtime_current_state = current_state;
+  header.runtime_next_state = next_state;
+  header.reserved = 0;
+  // Hot path messages have a fixed payload, others are sized on encoding.
+  switch (type)
+  {
+  case TF_MSG_INVOKE:
+  case TF_MSG_RELEASE:
+    header.payload_size = sizeof(tf_invoke_msg) - sizeof(tf_msg_header);
+    break;
+  case TF_MSG_GRANT:
+  case TF_MSG_REVOKE:
+    header.payload_size = sizeof(tf_lease_msg) - sizeof(tf_msg_header);
+    break;
+  default:
+    header.payload_size = 0;
+    break;
+  }
+}
+
+bool IsValidMsg(const tf_msg_header& header, size_t size){
+  if(size < sizeof(tf_msg_header))
+    return false;
+  if(header.magic != TF_MSG_MAGIC || header.version != TF_MSG_VERSION)
+    return false;
+  return header.payload_size == size - sizeof(tf_msg_header);
+}
+
+size_t EncodeProfileMsg(const tf_profile& profile, tf_msg& msg){
+  // A dummy profile sends layers with no payload arrays.
+  const int32_t layers = profile.layers;
+  const int32_t encoded_layers = profile.is_dummy ? -layers : layers;
+  char* payload = msg.payload;
+  memcpy(payload, &profile.model, sizeof(tf_model_id));
+  payload += sizeof(tf_model_id);
+  memcpy(payload, &encoded_layers, sizeof(int32_t));
+  payload += sizeof(int32_t);
+  memcpy(payload, &profile.co_resource, sizeof(int32_t));
+  payload += sizeof(int32_t);
+  if(!profile.is_dummy){
+    for(int field=0; field<TF_MSG_PROFILE_FIELDS; ++field){
+      memcpy(payload, profile.*kProfileFields[field], sizeof(float) * layers);
+      payload += sizeof(float) * layers;
+    }
+  }
+  msg.header.type = TF_MSG_PROFILE;
+  msg.header.payload_size = payload - msg.payload;
+  return sizeof(tf_msg_header) + msg.header.payload_size;
+}
+
+bool DecodeProfileMsg(const tf_msg& msg, tf_profile& profile){
+  const size_t header_size = sizeof(tf_model_id) + 2 * sizeof(int32_t);
+  if(msg.header.type != TF_MSG_PROFILE ||
+      msg.header.payload_size < header_size)
+    return false;
+  memcpy(&profile.model, msg.payload, sizeof(tf_model_id));
+  int32_t layers;
+  memcpy(&layers, msg.payload + sizeof(tf_model_id), sizeof(int32_t));
+  profile.is_dummy = layers < 0;
+  profile.layers = profile.is_dummy ? -layers : layers;
+  memcpy(&profile.co_resource,
+         msg.payload + sizeof(tf_model_id) + sizeof(int32_t), sizeof(int32_t));
+  if(profile.layers > TF_P_PLAN_LENGTH)
+    return false;
+  if(profile.is_dummy){
+    for(int i=0; i<profile.layers; ++i)
+      profile.latency[i] = -1;
+    return msg.header.payload_size == header_size;
+  }
+  const size_t array_size = sizeof(float) * profile.layers;
+  if(msg.header.payload_size != header_size + TF_MSG_PROFILE_FIELDS * array_size)
+    return false;
+  const char* payload = msg.payload + header_size;
+  for(int field=0; field<TF_MSG_PROFILE_FIELDS; ++field){
+    memcpy(profile.*kProfileFields[field], payload, array_size);
+    payload += array_size;
+  }
+  return true;
+}
+
+size_t EncodePlanMsg(int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE], tf_msg& msg){
+  msg.header.type = TF_MSG_PLAN;
+  msg.header.payload_size = 0;
+  return AppendPlanToMsg(plan, msg);
+}
+
+size_t AppendPlanToMsg(int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE], tf_msg& msg){
+  int32_t rows = 0;
+  while(rows < TF_P_PLAN_LENGTH){
+    if(plan[rows++][TF_P_IDX_START] == TF_P_END_MASTER)
+      break;
+  }
+  // Each plan is its number of rows followed by the rows.
+  const size_t plan_size = sizeof(int32_t) + sizeof(int) * TF_P_PLAN_SIZE * rows;
+  if(msg.header.payload_size + plan_size > TF_MSG_MAX_PAYLOAD)
+    return 0;
+  char* payload = msg.payload + msg.header.payload_size;
+  memcpy(payload, &rows, sizeof(int32_t));
+  memcpy(payload + sizeof(int32_t), plan, sizeof(int) * TF_P_PLAN_SIZE * rows);
+  msg.header.payload_size += plan_size;
+  return sizeof(tf_msg_header) + msg.header.payload_size;
+}
+
+int CountPlansInMsg(const tf_msg& msg){
+  if(msg.header.type != TF_MSG_PLAN)
+    return -1;
+  int plans = 0;
+  size_t offset = 0;
+  while(offset < msg.header.payload_size){
+    int32_t rows;
+    if(msg.header.payload_size - offset < sizeof(int32_t))
+      return -1;
+    memcpy(&rows, msg.payload + offset, sizeof(int32_t));
+    if(rows < 0 || rows > TF_P_PLAN_LENGTH)
+      return -1;
+    offset += sizeof(int32_t) + sizeof(int) * TF_P_PLAN_SIZE * rows;
+    plans++;
+  }
+  return offset == msg.header.payload_size ? plans : -1;
+}
+
+bool DecodePlanMsg(const tf_msg& msg,
+                   int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE], int index){
+  if(index < 0 || index >= CountPlansInMsg(msg))
+    return false;
+  size_t offset = 0;
+  int32_t rows;
+  for(int i=0; ; ++i){
+    memcpy(&rows, msg.payload + offset, sizeof(int32_t));
+    if(i == index)
+      break;
+    offset += sizeof(int32_t) + sizeof(int) * TF_P_PLAN_SIZE * rows;
+  }
+  memcpy(plan, msg.payload + offset + sizeof(int32_t),
+         sizeof(int) * TF_P_PLAN_SIZE * rows);
+  for(int i=rows; i<TF_P_PLAN_LENGTH; ++i){
+    for(int j=0; j<TF_P_PLAN_SIZE; ++j)
+      plan[i][j] = TF_P_END_MASTER;
+  }
+  return true;
+}
+
+} // namespace tflite
@@ -0,0 +1,184 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "tensorflow/lite/util.h"
+
+/*
+Message format for IPC between TfLiteRuntime and TfScheduler.
+
+Every message starts with a fixed 16 byte header(tf_msg_header).
+The invoke request on the hot path(INVOKE_, BLOCKED_) is a header with two
+words(tf_invoke_msg) and its reply is a grant(tf_lease_msg). A blocked request
+gets no reply until the resource is released by a TF_MSG_RELEASE of its owner.
+A runtime may have several requests in flight(one per pipeline stage), so
+each carries a request id which its grant echoes.
+
+A runtime may ask for a lease on the resources of its remaining subgraphs.
+If each of them has a free slot and nobody waits for it, the grant carries a
+time-bounded lease and the runtime invokes the covered subgraphs without
+asking again, until the lease expires, the inference completes or the
+scheduler revokes it for a waiter its policy prefers. Revokes are checked at
+subgraph boundaries. Only the profile and the partitioning plan carry a
+variable length payload, sized to the number of layers and plan rows in use.
+
+A runtime sends TF_MSG_LEAVE over UDS when it is destroyed, and the
+scheduler gives its id to the next runtime which registers.
+
+A profile starts with the identity of the model(tf_model_id), which the
+scheduler keys cached profiles and plans on. A dummy profile carries it too,
+and the resource which pairs with the CPU: GPU, or CPU cluster B for a
+runtime in CPU-cluster co-execution. (see CpuClusterOptions)
+
+The plan message carries the primary plan and, optionally, alternative plans
+(partition variants) which the runtime builds ahead of time. Every grant
+names the variant the runtime should run from its next inference.
+
+If the scheduler offers a shared-memory channel(see tf_channel.h), it replies
+to INITIALIZE with TF_MSG_CHANNEL carrying the name of the region, and the
+invoke requests and replies go through it instead of UDS.
+
+Bump TF_MSG_VERSION whenever the layout of any message changes.
+*/
+
+#define TF_MSG_MAGIC         0x5446  // "TF"
+#define TF_MSG_VERSION       9
+
+// Number of per-node arrays in a profile payload.
+#define TF_MSG_PROFILE_FIELDS 8
+
+namespace tflite{
+
+typedef enum TF_MSG_TYPE{
+  TF_MSG_STATE,         // State change only, no payload.
+  TF_MSG_INVOKE,        // Invoke permission request of a subgraph.
+  TF_MSG_PROFILE,       // Per-node profile. (runtime -> scheduler)
+  TF_MSG_PLAN,          // Partitioning plan. (scheduler -> runtime)
+  TF_MSG_CHANNEL,       // Name of shared-memory channel. (scheduler -> runtime)
+  TF_MSG_RELEASE,       // Invoke of a subgraph is done. (runtime -> scheduler)
+  TF_MSG_GRANT,         // Invoke permission, maybe with a lease. (scheduler -> runtime)
+  TF_MSG_REVOKE,        // Revoke of a lease. (scheduler -> runtime)
+  TF_MSG_LEAVE          // Runtime is destroyed, no payload. (runtime -> scheduler)
+}TF_MSG_TYPE;
+
+typedef struct tf_msg_header{
+  uint16_t magic;
+  uint8_t version;
+  uint8_t type;
+  int16_t runtime_id;
+  int16_t runtime_current_state;
+  int16_t runtime_next_state;
+  uint16_t reserved;
+  uint32_t payload_size; // bytes after the header.
+}tf_msg_header;
+
+// Bit of a resource in lease_resources.
+#define TF_LEASE_BIT(resource) (1 << (resource))
+
+// Invoke permission request and release. (hot path)
+typedef struct tf_invoke_msg{
+  tf_msg_header header;
+  int32_t cur_subgraph;
+  int32_t cur_graph_resource; // ResourceType, CPU, GPU or CPU_B.
+  // Request : resources to lease(TF_LEASE_BIT), 0 for no lease.
+  // Release : resources of the lease to release, 0 for cur_graph_resource.
+  int32_t lease_resources;
+  // Timing of runtime, used by the scheduling policy(see tf_policy.h).
+  int32_t priority;    // higher first.
+  int32_t period_us;   // of frames, 0 if aperiodic.
+  int32_t weight;      // share in weighted fair share.
+  int32_t request_id;  // echoed by the grant, unique among requests in flight.
+  int64_t deadline_us; // absolute(CLOCK_MONOTONIC) deadline of frame, 0 if none.
+}tf_invoke_msg;
+
+// Grant of an invoke request, or revoke of a lease. (hot path)
+typedef struct tf_lease_msg{
+  tf_msg_header header;
+  int32_t lease_id;        // -1 if the grant has no lease.
+  int32_t lease_resources; // resources covered by the lease.
+  int32_t lease_us;        // lease expires after this from the grant.
+  int32_t variant;         // partition variant of next inference, -1 for any.
+  int32_t request_id;      // of the request granted, -1 for a revoke.
+}tf_lease_msg;
+
+// Identity of a model. Models are the same if both hashes are.
+typedef struct tf_model_id{
+  uint64_t content_hash;  // of the flatbuffer(s), float then quantized one.
+  // of op codes and tensor types/shapes in node order, the co-execution
+  // resource and the delegate options of the runtime.
+  uint64_t op_signature;
+  int32_t nodes;          // of original subgraph, may exceed TF_P_PLAN_LENGTH.
+  int32_t tensors;
+  int64_t tensor_bytes;   // sum of every tensor of original subgraph.
+}tf_model_id;
+
+// Per-node profile of the original subgraph (ms, median of measured runs).
+// latency is the CPU latency, -1 for a dummy profile.
+// A negative gpu_latency means the node is not supported by GPU delegate.
+// co_cpu_latency is the latency of minimal precision (quantized) node on
+// CPU which runs with GPU in co-execution, -1 if not profiled.
+// Only the first 'layers' entries are sent.
+typedef struct tf_profile{
+  tf_model_id model;
+  int layers;
+  bool is_dummy; // true if latency is not measured.
+  // TF_P_PLAN_GPU, or TF_P_PLAN_CPU_B if the second resource is CPU cluster
+  // B. gpu_latency is the latency on cluster B then.
+  int32_t co_resource = TF_P_PLAN_GPU;
+  float latency[TF_P_PLAN_LENGTH];
+  float latency_p90[TF_P_PLAN_LENGTH];
+  float xnn_latency[TF_P_PLAN_LENGTH];
+  float gpu_latency[TF_P_PLAN_LENGTH];
+  float gpu_latency_p90[TF_P_PLAN_LENGTH];
+  float co_cpu_latency[TF_P_PLAN_LENGTH];
+  float transfer_latency[TF_P_PLAN_LENGTH];
+  float quantize_latency[TF_P_PLAN_LENGTH];
+}tf_profile;
+
+// Largest payload. (a full profile)
+#define TF_MSG_MAX_PAYLOAD \
+  (sizeof(tf_model_id) + 2 * sizeof(int32_t) + \
+   TF_MSG_PROFILE_FIELDS * TF_P_PLAN_LENGTH * sizeof(float))
+
+// Receive buffer large enough for any message.
+typedef struct tf_msg{
+  tf_msg_header header;
+  char payload[TF_MSG_MAX_PAYLOAD];
+}tf_msg;
+
+// Fills the header of a message without payload, or of a fixed size hot
+// path message. (tf_invoke_msg, tf_lease_msg)
+void SetMsgHeader(tf_msg_header& header, TF_MSG_TYPE type, int runtime_id,
+                  int current_state, int next_state);
+
+// Checks the magic, version and payload size of a received message of
+// 'size' bytes.
+bool IsValidMsg(const tf_msg_header& header, size_t size);
+
+// Encodes given profile to the payload of 'msg' and sets its type and size.
+// The rest of the header must be set by the caller.
+// Returns the size of whole message to send.
+size_t EncodeProfileMsg(const tf_profile& profile, tf_msg& msg);
+
+// Decodes the profile payload of a validated 'msg'.
+bool DecodeProfileMsg(const tf_msg& msg, tf_profile& profile);
+
+// Encodes rows of given plan until the first TF_P_END_MASTER row(inclusive)
+// to the payload of 'msg' and sets its type and size.
+// Returns the size of whole message to send.
+size_t EncodePlanMsg(int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE], tf_msg& msg);
+
+// Appends a partition variant to a plan message made by EncodePlanMsg.
+// Returns the size of whole message to send, 0 if it doesn't fit.
+// (the message is not changed then)
+size_t AppendPlanToMsg(int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE], tf_msg& msg);
+
+// Returns the number of plans in a validated plan message including the
+// primary one, -1 if the payload is broken.
+int CountPlansInMsg(const tf_msg& msg);
+
+// Decodes the 'index'-th plan(0 for the primary one) of a validated 'msg'.
+// Rows after the received plan are filled with TF_P_END_MASTER.
+bool DecodePlanMsg(const tf_msg& msg,
+                   int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE], int index = 0);
+
+} // namespace tflite
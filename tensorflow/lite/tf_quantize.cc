@@ -0,0 +1,194 @@
+#include "tensorflow/lite/tf_quantize.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "tensorflow/lite/tf_quantize_simd.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include "tensorflow/lite/kernels/internal/optimized/neon_check.h"
+#define SIMD_OR_PORTABLE(...) NEON_OR_PORTABLE(__VA_ARGS__)
+#else
+#include "tensorflow/lite/kernels/internal/optimized/sse_check.h"
+#define SIMD_OR_PORTABLE(...) SSE_OR_PORTABLE(__VA_ARGS__)
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+#endif
+
+namespace tflite{
+
+namespace {
+
+void PortableMinMax(const float* values, int size, float* min_value,
+                    float* max_value){
+  auto minmax = std::minmax_element(values, values + size);
+  *min_value = *minmax.first;
+  *max_value = *minmax.second;
+}
+
+void PortableQuantize(const float* values, int size, float scale,
+                      int zero_point, uint8_t* quantized){
+  for(int i=0; i<size; ++i){
+    const float value = std::min(
+        std::max(values[i] * scale, -kQuantizeClampLimit), kQuantizeClampLimit);
+    const int32_t quantized_value =
+        static_cast<int32_t>(std::round(value)) + zero_point;
+    quantized[i] = static_cast<uint8_t>(
+        std::min(255, std::max(0, quantized_value)));
+  }
+}
+
+#if defined(USE_NEON) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+void NeonMinMax(const float* values, int size, float* min_value,
+                float* max_value){
+  if(size < 4){
+    PortableMinMax(values, size, min_value, max_value);
+    return;
+  }
+  float32x4_t min_v = vld1q_f32(values);
+  float32x4_t max_v = min_v;
+  int i = 4;
+  for(; i + 4 <= size; i += 4){
+    const float32x4_t v = vld1q_f32(values + i);
+    min_v = vminq_f32(min_v, v);
+    max_v = vmaxq_f32(max_v, v);
+  }
+  float min_lanes[4], max_lanes[4];
+  vst1q_f32(min_lanes, min_v);
+  vst1q_f32(max_lanes, max_v);
+  *min_value = *std::min_element(min_lanes, min_lanes + 4);
+  *max_value = *std::max_element(max_lanes, max_lanes + 4);
+  for(; i<size; ++i){
+    *min_value = std::min(*min_value, values[i]);
+    *max_value = std::max(*max_value, values[i]);
+  }
+}
+
+void NeonQuantize(const float* values, int size, float scale, int zero_point,
+                  uint8_t* quantized){
+  const float32x4_t lo = vdupq_n_f32(-kQuantizeClampLimit);
+  const float32x4_t hi = vdupq_n_f32(kQuantizeClampLimit);
+  const int32x4_t zero_point_v = vdupq_n_s32(zero_point);
+  auto quantize4 = [&](const float* in){
+    float32x4_t x = vmulq_n_f32(vld1q_f32(in), scale);
+    x = vminq_f32(vmaxq_f32(x, lo), hi);
+    return vqmovn_s32(vaddq_s32(NeonRound(x), zero_point_v));
+  };
+  int i = 0;
+  for(; i + 8 <= size; i += 8){
+    const int16x8_t q = vcombine_s16(quantize4(values + i),
+                                     quantize4(values + i + 4));
+    vst1_u8(quantized + i, vqmovun_s16(q));
+  }
+  PortableQuantize(values + i, size - i, scale, zero_point, quantized + i);
+}
+#endif
+
+#if defined(__SSSE3__)
+void SseMinMax(const float* values, int size, float* min_value,
+               float* max_value){
+  if(size < 4){
+    PortableMinMax(values, size, min_value, max_value);
+    return;
+  }
+  __m128 min_v = _mm_loadu_ps(values);
+  __m128 max_v = min_v;
+  int i = 4;
+#if defined(__AVX2__)
+  if(size >= 8){
+    __m256 min_8 = _mm256_loadu_ps(values);
+    __m256 max_8 = min_8;
+    for(i = 8; i + 8 <= size; i += 8){
+      const __m256 v = _mm256_loadu_ps(values + i);
+      min_8 = _mm256_min_ps(min_8, v);
+      max_8 = _mm256_max_ps(max_8, v);
+    }
+    min_v = _mm_min_ps(_mm256_castps256_ps128(min_8),
+                       _mm256_extractf128_ps(min_8, 1));
+    max_v = _mm_max_ps(_mm256_castps256_ps128(max_8),
+                       _mm256_extractf128_ps(max_8, 1));
+  }
+#endif
+  for(; i + 4 <= size; i += 4){
+    const __m128 v = _mm_loadu_ps(values + i);
+    min_v = _mm_min_ps(min_v, v);
+    max_v = _mm_max_ps(max_v, v);
+  }
+  float min_lanes[4], max_lanes[4];
+  _mm_storeu_ps(min_lanes, min_v);
+  _mm_storeu_ps(max_lanes, max_v);
+  *min_value = *std::min_element(min_lanes, min_lanes + 4);
+  *max_value = *std::max_element(max_lanes, max_lanes + 4);
+  for(; i<size; ++i){
+    *min_value = std::min(*min_value, values[i]);
+    *max_value = std::max(*max_value, values[i]);
+  }
+}
+
+void SseQuantize(const float* values, int size, float scale, int zero_point,
+                 uint8_t* quantized){
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256 scale_8 = _mm256_set1_ps(scale);
+  const __m256 lo_8 = _mm256_set1_ps(-kQuantizeClampLimit);
+  const __m256 hi_8 = _mm256_set1_ps(kQuantizeClampLimit);
+  const __m256i zero_point_8 = _mm256_set1_epi32(zero_point);
+  // packs work per 128bit lane, this puts the 32bit groups back in order.
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  auto quantize8 = [&](const float* in){
+    __m256 x = _mm256_mul_ps(_mm256_loadu_ps(in), scale_8);
+    x = _mm256_min_ps(_mm256_max_ps(x, lo_8), hi_8);
+    return _mm256_add_epi32(Avx2Round(x), zero_point_8);
+  };
+  for(; i + 32 <= size; i += 32){
+    const __m256i ab = _mm256_packs_epi32(quantize8(values + i),
+                                          quantize8(values + i + 8));
+    const __m256i cd = _mm256_packs_epi32(quantize8(values + i + 16),
+                                          quantize8(values + i + 24));
+    const __m256i bytes = _mm256_permutevar8x32_epi32(
+        _mm256_packus_epi16(ab, cd), order);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(quantized + i), bytes);
+  }
+#endif
+  const __m128 scale_4 = _mm_set1_ps(scale);
+  const __m128 lo = _mm_set1_ps(-kQuantizeClampLimit);
+  const __m128 hi = _mm_set1_ps(kQuantizeClampLimit);
+  const __m128i zero_point_4 = _mm_set1_epi32(zero_point);
+  auto quantize4 = [&](const float* in){
+    __m128 x = _mm_mul_ps(_mm_loadu_ps(in), scale_4);
+    x = _mm_min_ps(_mm_max_ps(x, lo), hi);
+    return _mm_add_epi32(SseRound(x), zero_point_4);
+  };
+  for(; i + 16 <= size; i += 16){
+    const __m128i ab = _mm_packs_epi32(quantize4(values + i),
+                                       quantize4(values + i + 4));
+    const __m128i cd = _mm_packs_epi32(quantize4(values + i + 8),
+                                       quantize4(values + i + 12));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(quantized + i),
+                     _mm_packus_epi16(ab, cd));
+  }
+  PortableQuantize(values + i, size - i, scale, zero_point, quantized + i);
+}
+#endif
+
+} // namespace
+
+void MinMaxFloats(const float* values, int size, float* min_value,
+                  float* max_value){
+  if(size <= 0){
+    *min_value = 0;
+    *max_value = 0;
+    return;
+  }
+  SIMD_OR_PORTABLE(MinMax, values, size, min_value, max_value);
+}
+
+void QuantizeFloatsToUint8(const float* values, int size, float scale,
+                           int zero_point, uint8_t* quantized){
+  if(size <= 0)
+    return;
+  SIMD_OR_PORTABLE(Quantize, values, size, scale, zero_point, quantized);
+}
+
+} // namespace tflite
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+namespace tflite{
+
+// Min and max of 'size' floats. Both 0 if 'size' is 0.
+void MinMaxFloats(const float* values, int size, float* min_value,
+                  float* max_value);
+
+// quantized[i] = clamp(round(values[i] * scale) + zero_point, 0, 255)
+// Same rounding(half away from zero) as TfLiteRound.
+// Used to quantize co-execution input straight into the destination tensor.
+// Vectorized with NEON, SSE or AVX2 if the target supports it.
+void QuantizeFloatsToUint8(const float* values, int size, float scale,
+                           int zero_point, uint8_t* quantized);
+
+} // namespace tflite
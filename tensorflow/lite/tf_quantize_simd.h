@@ -0,0 +1,52 @@
+#pragma once
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+// Vector pieces of QuantizeFloatsToUint8(see tf_quantize.h), shared with
+// kernels that quantize their output on the fly.
+
+namespace tflite{
+
+// Values are clamped to this before conversion to int32, so the conversion
+// can't overflow. Saturating packs clamp them to [0, 255] afterwards.
+constexpr float kQuantizeClampLimit = 32767.0f;
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+// Rounds half away from zero like std::round.
+inline int32x4_t NeonRound(float32x4_t x){
+  int32x4_t t = vcvtq_s32_f32(x); // toward zero
+  const float32x4_t d = vsubq_f32(x, vcvtq_f32_s32(t));
+  t = vsubq_s32(t, vreinterpretq_s32_u32(vcgeq_f32(d, vdupq_n_f32(0.5f))));
+  t = vaddq_s32(t, vreinterpretq_s32_u32(vcleq_f32(d, vdupq_n_f32(-0.5f))));
+  return t;
+}
+#endif
+
+#if defined(__SSSE3__)
+// Rounds half away from zero like std::round.
+inline __m128i SseRound(__m128 x){
+  __m128i t = _mm_cvttps_epi32(x); // toward zero
+  const __m128 d = _mm_sub_ps(x, _mm_cvtepi32_ps(t));
+  t = _mm_sub_epi32(t, _mm_castps_si128(_mm_cmpge_ps(d, _mm_set1_ps(0.5f))));
+  t = _mm_add_epi32(t, _mm_castps_si128(_mm_cmple_ps(d, _mm_set1_ps(-0.5f))));
+  return t;
+}
+
+#if defined(__AVX2__)
+inline __m256i Avx2Round(__m256 x){
+  __m256i t = _mm256_cvttps_epi32(x);
+  const __m256 d = _mm256_sub_ps(x, _mm256_cvtepi32_ps(t));
+  t = _mm256_sub_epi32(t, _mm256_castps_si256(
+          _mm256_cmp_ps(d, _mm256_set1_ps(0.5f), _CMP_GE_OQ)));
+  t = _mm256_add_epi32(t, _mm256_castps_si256(
+          _mm256_cmp_ps(d, _mm256_set1_ps(-0.5f), _CMP_LE_OQ)));
+  return t;
+}
+#endif
+#endif
+
+} // namespace tflite
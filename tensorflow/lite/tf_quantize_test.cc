@@ -0,0 +1,85 @@
+#include "tensorflow/lite/tf_quantize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace tflite {
+namespace {
+
+// The formula of the header, one value at a time.
+uint8_t ReferenceQuantize(float value, float scale, int zero_point) {
+  const double rounded = std::round(value * scale) + zero_point;
+  return static_cast<uint8_t>(std::min(255.0, std::max(0.0, rounded)));
+}
+
+std::vector<float> RandomValues(int size, float range, unsigned seed) {
+  srand(seed);
+  std::vector<float> values(size);
+  for (float& value : values)
+    value = (rand() / static_cast<float>(RAND_MAX) * 2 - 1) * range;
+  return values;
+}
+
+void ExpectMatchesReference(const std::vector<float>& values, float scale,
+                            int zero_point) {
+  // Guard bytes after the end catch a vector store past 'size'.
+  std::vector<uint8_t> quantized(values.size() + 32, 0xA5);
+  QuantizeFloatsToUint8(values.data(), values.size(), scale, zero_point,
+                        quantized.data());
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(quantized[i], ReferenceQuantize(values[i], scale, zero_point))
+        << "size " << values.size() << " index " << i << " value "
+        << values[i];
+  }
+  for (size_t i = values.size(); i < quantized.size(); ++i)
+    ASSERT_EQ(quantized[i], 0xA5) << "size " << values.size();
+}
+
+TEST(TfQuantizeTest, MatchesReferenceForEveryTail) {
+  // Covers the 32, 16, 8 and 4 wide loops and the scalar tail.
+  for (int size = 0; size <= 70; ++size)
+    ExpectMatchesReference(RandomValues(size, 3, size), 40, 128);
+  ExpectMatchesReference(RandomValues(1000, 3, 1000), 40, 128);
+}
+
+TEST(TfQuantizeTest, RoundsHalfAwayFromZero) {
+  std::vector<float> values;
+  for (int i = -40; i <= 40; ++i) values.push_back(i + 0.5f);
+  ExpectMatchesReference(values, 1, 100);
+  EXPECT_EQ(ReferenceQuantize(2.5f, 1, 0), 3);
+  EXPECT_EQ(ReferenceQuantize(-2.5f, 1, 10), 7);
+}
+
+TEST(TfQuantizeTest, SaturatesOutOfRange) {
+  std::vector<float> values = {-1e9f, -300, -1, 0, 1, 300, 1e9f, 70000,
+                               -70000, 255, 256, -0.5f, 0.49f, 1e30f,
+                               -1e30f, 128};
+  ExpectMatchesReference(values, 1, 0);
+  ExpectMatchesReference(values, 1000, 128);
+}
+
+TEST(TfQuantizeTest, MinMax) {
+  for (int size : {1, 3, 4, 5, 8, 17, 33, 1000}) {
+    std::vector<float> values = RandomValues(size, 100, size);
+    float min_value, max_value;
+    MinMaxFloats(values.data(), size, &min_value, &max_value);
+    EXPECT_EQ(min_value, *std::min_element(values.begin(), values.end()));
+    EXPECT_EQ(max_value, *std::max_element(values.begin(), values.end()));
+  }
+  float min_value = 1, max_value = 1;
+  MinMaxFloats(nullptr, 0, &min_value, &max_value);
+  EXPECT_EQ(min_value, 0);
+  EXPECT_EQ(max_value, 0);
+}
+
+}  // namespace
+}  // namespace tflite
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,10 +1,34 @@
 #include "tensorflow/lite/tf_scheduler.h"
 
+#include <algorithm>
+
 namespace tflite{
 
+namespace {
+
+// Max time to park on shared-memory channel before polling UDS again.
+// Bounds the latency of registration messages which come over UDS.
+constexpr int kShmIdleWaitUs = 5000;
+
+constexpr int kMaxEvents = 16;
+// UDS messages handled per readiness, so timers and shared memory are not
+// starved by a flood.
+constexpr int kMaxMsgBatch = 32;
+// A runtime which doesn't receive this many messages is dropped.
+constexpr int kMaxPendingMsgs = 16;
+// Resources held longer than lease_us plus this are checked.
+constexpr int kHoldGraceUs = 10000;
+constexpr int kMonitorIntervalUs = 10000;
+
+// Resources with slots. (see ResourcePool)
+constexpr ResourceType kArbitratedResources[] = {
+  ResourceType::CPU, ResourceType::GPU, ResourceType::CPU_B};
+
+} // namespace
+
 TfScheduler::TfScheduler() {};
 
-TfScheduler::TfScheduler(const char* uds_file_name) {
+TfScheduler::TfScheduler(const char* uds_file_name, bool use_shm_channel) {
   // delete if sock file already exists.
   if(access(uds_file_name, F_OK) == 0)
     unlink(uds_file_name);
@@ -25,21 +49,54 @@ TfScheduler::TfScheduler(const char* uds_file_name) {
     std::cout << "Socket bind ERROR" << "\n";
     exit(-1);
   }
+  if(use_shm_channel){
+    const char* base_name = strrchr(uds_file_name, '/');
+    base_name = base_name == nullptr ? uds_file_name : base_name + 1;
+    std::string shm_name = std::string("/tf_shm_") + base_name;
+    shm_channel = TfShmChannel::Create(shm_name.c_str());
+    if(shm_channel == nullptr)
+      std::cout << "Shared-memory channel unavailable, use UDS only" << "\n";
+    else
+      std::cout << "Shared-memory channel " << shm_name << " created" << "\n";
+  }
+  const char* policy_name = getenv(TF_POLICY_ENV);
+  if(policy_name != nullptr){
+    TfSchedulingPolicy* named_policy = CreateSchedulingPolicy(policy_name);
+    if(named_policy == nullptr)
+      std::cout << "Unknown scheduling policy " << policy_name << "\n";
+    SetSchedulingPolicy(named_policy);
+  }
+  const char* stats_file = getenv(TF_STATS_FILE_ENV);
+  if(stats_file != nullptr){
+    delete stats;
+    stats = new TfSchedulerStats(stats_file);
+  }
+  const char* cpu_slots = getenv(TF_CPU_SLOTS_ENV);
+  if(cpu_slots != nullptr)
+    SetResourceCapacity(ResourceType::CPU, atoi(cpu_slots));
+  const char* cpu_b_slots = getenv(TF_CPU_B_SLOTS_ENV);
+  if(cpu_b_slots != nullptr)
+    SetResourceCapacity(ResourceType::CPU_B, atoi(cpu_b_slots));
+  PlannerOptions cluster_options;
+  cluster_options.cpu_clusters = true;
+  cluster_planner = TfPlanner(cluster_options);
   std::cout << "Scheduler initializaing done" << "\n";
 };
 
-int TfScheduler::SendPacketToRuntime(tf_packet& tx_p,
-                                      struct sockaddr_un& runtime_addr){
+int TfScheduler::SendMsgToRuntime(const void* msg, size_t size,
+                                  struct sockaddr_un& runtime_addr){
   int v;
-  v = sendto(scheduler_fd, (void*)&tx_p, sizeof(tf_packet), 0,
+  v = sendto(scheduler_fd, msg, size, 0,
                (struct sockaddr*)&runtime_addr, sizeof(runtime_addr));
   return v;
 }
 
-int TfScheduler::ReceivePacketFromRuntime(tf_packet& rx_p,
-                                      struct sockaddr_un& runtime_addr){
-   int v;
-   v = recvfrom(scheduler_fd, &rx_p, sizeof(tf_packet), 0,
+int TfScheduler::ReceiveMsgFromRuntime(tf_msg& rx_msg,
+                                      struct sockaddr_un& runtime_addr,
+                                      int flags){
+  int v;
+  addr_size = sizeof(runtime_addr);
+  v = recvfrom(scheduler_fd, &rx_msg, sizeof(tf_msg), flags,
                 (struct sockaddr*)&runtime_addr, (socklen_t*)&addr_size);
   return v;
 }
@@ -54,283 +111,936 @@ void TfScheduler::SysMonitor(){
 }
 
 void TfScheduler::Work(){
-  monitor = new LiteSysMonitor(&cpu_util, &gpu_util);
+  // The system is sampled on a timer of the loop, not on a thread.
+  monitor = new LiteSysMonitor();
+  monitor->AddDefaultSamplers();
+  if(!InitializeEventLoop()){
+    std::cout << "Event loop initialization failed, errno " << errno << "\n";
+    return;
+  }
+  struct epoll_event events[kMaxEvents];
   while(1){
-    tf_packet rx_packet;
+    // Epoll can't watch the doorbell of shared-memory channel. Poll both
+    // and park on the doorbell only if both are idle.
+    const int served = shm_channel != nullptr ? ServeShmChannel() : 0;
+    int ready = epoll_wait(epoll_fd, events, kMaxEvents,
+                           shm_channel != nullptr ? 0 : -1);
+    if(ready == -1){
+      if(errno != EINTR)
+        TfLog("epoll_wait failed, errno %d", errno);
+      ready = 0;
+    }
+    for(int i=0; i<ready; ++i)
+      HandleEvent(events[i]);
+    RemoveDeadRuntimes();
+    if(shm_channel != nullptr && served == 0 && ready == 0)
+      shm_channel->WaitRequest(kShmIdleWaitUs);
+  }
+}
+
+bool TfScheduler::InitializeEventLoop(){
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if(epoll_fd == -1)
+    return false;
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = scheduler_fd;
+  if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, scheduler_fd, &event) == -1)
+    return false;
+  watchdog_timer_fd = CreateTimer(lease_us);
+  monitor_timer_fd = CreateTimer(kMonitorIntervalUs);
+  return watchdog_timer_fd != -1 && monitor_timer_fd != -1;
+}
+
+int TfScheduler::CreateTimer(int interval_us){
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if(fd == -1)
+    return -1;
+  struct itimerspec spec;
+  spec.it_interval.tv_sec = interval_us / 1000000;
+  spec.it_interval.tv_nsec = (interval_us % 1000000) * 1000;
+  spec.it_value = spec.it_interval;
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  if(timerfd_settime(fd, 0, &spec, nullptr) == -1 ||
+      epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1){
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void TfScheduler::SampleSystem(){
+  monitor->Sample();
+  monitor->GetSnapshot(system_state);
+  cpu_util = std::max(system_state.cpu_util, 0.0f);
+  // Taken as idle if the accelerator is not monitored.
+  gpu_util = std::max(system_state.accelerator_util, 0.0f);
+}
+
+void TfScheduler::HandleEvent(const struct epoll_event& event){
+  const int fd = event.data.fd;
+  if(fd == scheduler_fd){
+    ReceiveMsgs();
+    return;
+  }
+  if(fd == watchdog_timer_fd || fd == monitor_timer_fd){
+    uint64_t expirations;
+    if(read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+      return;
+    if(fd == watchdog_timer_fd)
+      CheckResourceOwners();
+    else
+      SampleSystem();
+    return;
+  }
+  runtime_* runtime = FindRuntimeByFd(fd);
+  if(runtime != nullptr && (event.events & EPOLLOUT))
+    FlushPendingMsgs(runtime);
+}
+
+void TfScheduler::ReceiveMsgs(){
+  for(int i=0; i<kMaxMsgBatch; ++i){
     struct sockaddr_un runtime_addr;
-    memset(&rx_packet, 0, sizeof(tf_packet));
-    if(ReceivePacketFromRuntime(rx_packet, runtime_addr) == -1){
-      std::cout << "Receive failed" << "\n";
+    int received = ReceiveMsgFromRuntime(rx_msg, runtime_addr, MSG_DONTWAIT);
+    if(received == -1){
+      if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        TfLog("Receive failed, errno %d", errno);
       return;
     }
-    //std::cout << "Recieved packet from runtime " << rx_packet.runtime_id << "\n";
-
-    // do next work by received runtime state.
-    switch (rx_packet.runtime_current_state)
-    {
-    case RuntimeState::INITIALIZE :{ 
-      for(auto runtime : runtimes){
-        if(runtime->id == rx_packet.runtime_id){
-          std::cout << "Runtime " << runtime->id << " already registered." << "\n"; 
-          break;
-        }
-      }
-      // initializing new_runtime
-      runtime_* new_runtime = new runtime_;
-      new_runtime->id = runtimes_created;
-      runtimes_created++;
-      
-      new_runtime->addr.sun_family = runtime_addr.sun_family;
-      strcpy(new_runtime->addr.sun_path, runtime_addr.sun_path);
-      
-      tf_packet tx_packet;
-      memset(&tx_packet, 0, sizeof(tf_packet));
-      tx_packet.runtime_id = new_runtime->id;
-      tx_packet.runtime_next_state = RuntimeState::NEED_PROFILE;
-
-      if(SendPacketToRuntime(tx_packet, runtime_addr) == -1){
-        std::cout << "Sending packet to " << new_runtime->id << " Failed" << "\n";
-        std::cout << "sock : " << runtime_addr.sun_path  << " " << runtime_addr.sun_family << "\n";
-        printf("errno : %d \n", errno);
-        return;
+    HandleMsg(received, runtime_addr);
+  }
+}
+
+void TfScheduler::HandleMsg(int received, struct sockaddr_un& runtime_addr){
+  tf_msg_header& rx_header = rx_msg.header;
+  if(!IsValidMsg(rx_header, received)){
+    TfLog("Dropped an invalid message of %d bytes", received);
+    return;
+  }
+  if(rx_header.type == TF_MSG_LEAVE){
+    RemoveRuntime(rx_header.runtime_id);
+    return;
+  }
+  //std::cout << "Recieved packet from runtime " << rx_header.runtime_id << "\n";
+
+  // do next work by received runtime state.
+  switch (rx_header.runtime_current_state)
+  {
+  case RuntimeState::INITIALIZE :{ 
+    for(auto runtime : runtimes){
+      if(runtime->id == rx_header.runtime_id){
+        std::cout << "Runtime " << runtime->id << " already registered." << "\n"; 
+        break;
       }
-      runtimes.push_back(new_runtime);
-      std::cout << "Registered new runtime " << new_runtime->id << " \n";
+    }
+    // initializing new_runtime
+    runtime_* new_runtime = new runtime_;
+    new_runtime->id = NextRuntimeId();
+    
+    new_runtime->addr.sun_family = runtime_addr.sun_family;
+    strcpy(new_runtime->addr.sun_path, runtime_addr.sun_path);
+    new_runtime->fd = ConnectRuntime(runtime_addr);
+    if(new_runtime->fd == -1){
+      std::cout << "Cannot connect to runtime at " << runtime_addr.sun_path
+                << ", errno " << errno << "\n";
+      delete new_runtime;
       break;
     }
-    case RuntimeState::NEED_PROFILE :{
-      tf_packet tx_packet;
-      RefreshRuntimeState(rx_packet);
-      CreatePartitioningPlan(rx_packet, tx_packet);
-      
-      tx_packet.runtime_id = rx_packet.runtime_id;
-      tx_packet.runtime_next_state = RuntimeState::SUBGRAPH_CREATE;
-      
-      if(SendPacketToRuntime(tx_packet, runtime_addr) == -1){
-        std::cout << "sock : " << runtime_addr.sun_path  << " " << runtime_addr.sun_family << "\n";
-        printf("errno : %d \n", errno);
-        return;
-      }
+    
+    SetMsgHeader(tx_msg.header, TF_MSG_STATE, new_runtime->id,
+                 RuntimeState::INITIALIZE, RuntimeState::NEED_PROFILE);
+    // Offer the shared-memory channel if the runtime fits in it.
+    if(shm_channel != nullptr && new_runtime->id < TF_SHM_MAX_RUNTIMES){
+      const char* shm_name = shm_channel->GetName();
+      tx_msg.header.type = TF_MSG_CHANNEL;
+      tx_msg.header.payload_size = strlen(shm_name) + 1;
+      memcpy(tx_msg.payload, shm_name, tx_msg.header.payload_size);
+    }
+    size_t tx_size = sizeof(tf_msg_header) + tx_msg.header.payload_size;
+
+    runtimes.push_back(new_runtime);
+    stats->OnRegister(new_runtime->id);
+    if(SendToRuntime(new_runtime, &tx_msg, tx_size))
+      std::cout << "Registered new runtime " << new_runtime->id << " \n";
+    break;
+  }
+  case RuntimeState::NEED_PROFILE :{
+    RefreshRuntimeState(rx_header);
+    if(!DecodeProfileMsg(rx_msg, rx_profile)){
+      std::cout << "Broken profile from runtime " << rx_header.runtime_id
+                << "\n";
       break;
     }
-    case RuntimeState::SUBGRAPH_CREATE :{
-      RefreshRuntimeState(rx_packet);
-      // What to do here???
-      // maybe schedulability check?
-      tf_packet tx_packet;
-      tx_packet.runtime_id = rx_packet.runtime_id;
-      tx_packet.runtime_next_state = RuntimeState::INVOKE_;
-      
-      if(SendPacketToRuntime(tx_packet, runtime_addr) == -1){
-        std::cout << "sock : " << runtime_addr.sun_path  << " " << runtime_addr.sun_family << "\n";
-        printf("errno : %d \n", errno);
-        return;
-      }
+    runtime_* runtime = FindRuntime(rx_header.runtime_id);
+    if(runtime == nullptr)
       break;
+    runtime->model = rx_profile.model;
+    SetMsgHeader(tx_msg.header, TF_MSG_PLAN, rx_header.runtime_id,
+                 RuntimeState::NEED_PROFILE, RuntimeState::SUBGRAPH_CREATE);
+    size_t tx_size = CreatePlanMsg(runtime, rx_profile);
+    SendToRuntime(runtime, &tx_msg, tx_size);
+    break;
+  }
+  case RuntimeState::SUBGRAPH_CREATE :{
+    RefreshRuntimeState(rx_header);
+    runtime_* runtime = FindRuntime(rx_header.runtime_id);
+    if(runtime == nullptr)
+      break;
+    // What to do here???
+    // maybe schedulability check?
+    tf_msg_header tx_header;
+    SetMsgHeader(tx_header, TF_MSG_STATE, rx_header.runtime_id,
+                 RuntimeState::SUBGRAPH_CREATE, RuntimeState::INVOKE_);
+    SendToRuntime(runtime, &tx_header, sizeof(tx_header));
+    break;
+  }
+  case RuntimeState::INVOKE_ :{
+    if(received != sizeof(tf_invoke_msg))
+      break;
+    const tf_invoke_msg& rx_invoke =
+                *reinterpret_cast<const tf_invoke_msg*>(&rx_msg);
+    if(rx_header.type == TF_MSG_INVOKE)
+      ArbitrateInvoke(rx_invoke);
+    else if(rx_header.type == TF_MSG_RELEASE)
+      HandleRelease(rx_invoke);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+int TfScheduler::ConnectRuntime(struct sockaddr_un& runtime_addr){
+  int fd = socket(PF_FILE, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if(fd == -1)
+    return -1;
+  struct epoll_event event;
+  event.events = 0; // EPOLLOUT only while messages are pending.
+  event.data.fd = fd;
+  if(connect(fd, (struct sockaddr*)&runtime_addr, sizeof(runtime_addr)) == -1 ||
+      epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1){
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool TfScheduler::SendToRuntime(runtime_* runtime, const void* msg,
+                                size_t size){
+  if(runtime->tx_pending.empty()){
+    if(send(runtime->fd, msg, size, MSG_DONTWAIT) == static_cast<ssize_t>(size))
+      return true;
+    if(errno != EAGAIN && errno != EWOULDBLOCK){
+      TfLog("Runtime %d is unreachable, errno %d", runtime->id, errno);
+      MarkDead(runtime->id);
+      return false;
     }
-    case RuntimeState::INVOKE_ :{
-      RefreshRuntimeState(rx_packet);
-      tf_packet tx_packet;
-      tx_packet.runtime_id = rx_packet.runtime_id;
-      if(RoundRobin(static_cast<ResourceType>(rx_packet.cur_graph_resource), rx_packet.runtime_id)){
-        // resource available
-        tx_packet.runtime_next_state = RuntimeState::INVOKE_;
-        std::cout << "Give resource to runtime " << rx_packet.runtime_id << "\n";
-      }else{ // resource not available
-        tx_packet.runtime_next_state = RuntimeState::BLOCKED_;
-        std::cout << "Block runtime " << rx_packet.runtime_id << "\n";
-      }
-      if(SendPacketToRuntime(tx_packet, runtime_addr) == -1){
-        std::cout << "sock : " << runtime_addr.sun_path  << " " << runtime_addr.sun_family << "\n";
-        printf("errno : %d \n", errno);
+    WatchWritable(runtime, true);
+  }
+  if(runtime->tx_pending.size() >= kMaxPendingMsgs){
+    TfLog("Runtime %d doesn't receive messages", runtime->id);
+    MarkDead(runtime->id);
+    return false;
+  }
+  const char* bytes = static_cast<const char*>(msg);
+  runtime->tx_pending.emplace_back(bytes, bytes + size);
+  return true;
+}
+
+void TfScheduler::FlushPendingMsgs(runtime_* runtime){
+  while(!runtime->tx_pending.empty()){
+    const std::vector<char>& msg = runtime->tx_pending.front();
+    if(send(runtime->fd, msg.data(), msg.size(), MSG_DONTWAIT) == -1){
+      if(errno == EAGAIN || errno == EWOULDBLOCK)
         return;
-      }
-      break;
+      TfLog("Runtime %d is unreachable, errno %d", runtime->id, errno);
+      MarkDead(runtime->id);
+      return;
     }
-    default:
-      break;
+    runtime->tx_pending.pop_front();
+  }
+  WatchWritable(runtime, false);
+}
+
+void TfScheduler::WatchWritable(runtime_* runtime, bool writable){
+  struct epoll_event event;
+  event.events = writable ? static_cast<uint32_t>(EPOLLOUT) : 0;
+  event.data.fd = runtime->fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_MOD, runtime->fd, &event);
+}
+
+runtime_* TfScheduler::FindRuntimeByFd(int fd){
+  for(auto runtime : runtimes){
+    if(runtime->fd == fd)
+      return runtime;
+  }
+  return nullptr;
+}
+
+bool TfScheduler::IsRuntimeAlive(runtime_* runtime){
+  // Connecting again fails once the socket of runtime is closed.
+  if(connect(runtime->fd, (struct sockaddr*)&runtime->addr,
+             sizeof(runtime->addr)) == 0)
+    return true;
+  return errno != ECONNREFUSED && errno != ENOENT;
+}
+
+void TfScheduler::MarkDead(int runtime_id){
+  if(std::find(dead_runtimes.begin(), dead_runtimes.end(), runtime_id) ==
+      dead_runtimes.end())
+    dead_runtimes.push_back(runtime_id);
+}
+
+void TfScheduler::RemoveDeadRuntimes(){
+  while(!dead_runtimes.empty()){
+    const int runtime_id = dead_runtimes.back();
+    dead_runtimes.pop_back();
+    RemoveRuntime(runtime_id);
+  }
+}
+
+void TfScheduler::CheckResourceOwners(){
+  const int64_t now = PolicyNowUs();
+  for(ResourceType type : kArbitratedResources){
+    resource_pool* pool = ResourcePool(type);
+    for(const tf_request& owner : pool->owners){
+      if(now - owner.granted_us < lease_us + kHoldGraceUs)
+        continue;
+      runtime_* holder = FindRuntime(owner.runtime_id);
+      if(holder == nullptr)
+        continue;
+      if(!IsRuntimeAlive(holder)){
+        TfLog("Runtime %d died holding resource %d", holder->id, type);
+        MarkDead(holder->id);
+      }else if(!pool->waiting.empty() && holder->lease_id != -1 &&
+               !holder->lease_revoked){
+        // The holder gives it back at its next subgraph boundary anyway,
+        // unless its clock runs behind ours.
+        RevokeLease(holder);
+      }
     }
   }
-  monitoring_thread.join();
+}
+
+size_t TfScheduler::CreatePlanMsg(runtime_* runtime, tf_profile& profile){
+  model_entry*& entry = models[std::make_pair(profile.model.content_hash,
+                                              profile.model.op_signature)];
+  if(entry == nullptr){
+    entry = new model_entry;
+    entry->profile.is_dummy = true;
+    entry->profile.layers = 0;
+  }
+  if(!profile.is_dummy){ // New measurement, plan again.
+    entry->profile = profile;
+    entry->plan_payload.clear();
+  }else if(!entry->profile.is_dummy){
+    std::cout << "Runtime [" << runtime->id << "] sent a dummy profile, "
+              << "use the cached one of its model" << "\n";
+  }
+  if(!entry->plan_payload.empty()){
+    std::cout << "Runtime [" << runtime->id << "] reuses the plan of its model"
+              << "\n";
+    tx_msg.header.type = TF_MSG_PLAN;
+    tx_msg.header.payload_size = entry->plan_payload.size();
+    memcpy(tx_msg.payload, entry->plan_payload.data(),
+           entry->plan_payload.size());
+    memcpy(runtime->variant_index, entry->variant_index,
+           sizeof(runtime->variant_index));
+    runtime->variant_type = VARIANT_BALANCED;
+    return sizeof(tf_msg_header) + tx_msg.header.payload_size;
+  }
+  tf_profile& plan_profile = entry->profile.is_dummy ? profile : entry->profile;
+  CreatePartitioningPlan(runtime->id, plan_profile, tx_plan);
+  size_t tx_size = EncodePlanMsg(tx_plan, tx_msg);
+  tx_size = AppendPartitionVariants(runtime, plan_profile, tx_msg, tx_size);
+  // Plans of a dummy profile are looked up by node count, not cached.
+  if(!plan_profile.is_dummy){
+    entry->plan_payload.assign(tx_msg.payload,
+                               tx_msg.payload + tx_msg.header.payload_size);
+    memcpy(entry->variant_index, runtime->variant_index,
+           sizeof(entry->variant_index));
+  }
+  return tx_size;
 }
 
 bool TfScheduler::CheckAllRuntimesReady(){
-  if(runtimes.size() != 2){
+  if(runtimes.empty()){
     return false;
   }
-  for(int i=0; i<runtimes.size(); ++i){
+  for(size_t i=0; i<runtimes.size(); ++i){
     if(runtimes[i]->state != RuntimeState::INVOKE_)
       return false;
   }
   return true;
 }
 
-void TfScheduler::RefreshRuntimeState(tf_packet& rx_p){
-  for(int i=0; i<runtimes.size(); ++i){
-    if(rx_p.runtime_id == runtimes[i]->id){
-      runtimes[i]->state = static_cast<RuntimeState>(rx_p.runtime_current_state);
+void TfScheduler::ArbitrateInvoke(const tf_invoke_msg& rx_invoke){
+  const int runtime_id = rx_invoke.header.runtime_id;
+  runtime_* runtime = FindRuntime(runtime_id);
+  if(runtime == nullptr)
+    return;
+  RefreshRuntimeState(rx_invoke.header);
+  runtime->priority = rx_invoke.priority;
+  runtime->period_us = rx_invoke.period_us;
+  runtime->weight = rx_invoke.weight;
+  tf_request request;
+  request.runtime_id = runtime_id;
+  request.priority = rx_invoke.priority;
+  request.weight = rx_invoke.weight;
+  request.arrival_us = PolicyNowUs();
+  request.deadline_us = rx_invoke.deadline_us;
+  request.subgraph = rx_invoke.cur_subgraph;
+  request.request_id = rx_invoke.request_id;
+  stats->OnRequest(runtime_id);
+  const ResourceType type = static_cast<ResourceType>(rx_invoke.cur_graph_resource);
+  if(use_lease && rx_invoke.lease_resources != 0 &&
+      TryGrantLease(runtime, rx_invoke.lease_resources | TF_LEASE_BIT(type),
+                    request)){
+    // uncontended, no more requests until the lease ends.
+    TfLog("Give lease %d to runtime %d", runtime->lease_id, runtime_id);
+    SendGrant(runtime_id, request.request_id, runtime->lease_id,
+              runtime->lease_resources);
+  }else if(RoundRobin(type, request)){
+    // resource available
+    TfLog("Give resource to runtime %d", runtime_id);
+    SendGrant(runtime_id, request.request_id);
+  }else{ // resource not available, granted on release.
+    TfLog("Block runtime %d", runtime_id);
+    RevokeLeaseIfPreempted(type, request);
+  }
+  // A state change may have made every runtime ready.
+  GrantWaitingRuntimes();
+}
+
+void TfScheduler::HandleRelease(const tf_invoke_msg& rx_release){
+  const int runtime_id = rx_release.header.runtime_id;
+  runtime_* runtime = FindRuntime(runtime_id);
+  if(runtime == nullptr)
+    return;
+  if(rx_release.lease_resources != 0){ // end of lease
+    if(runtime->lease_id == -1 ||
+        runtime->lease_resources != rx_release.lease_resources){
+      TfLog("Runtime %d released a lease it does not hold", runtime_id);
+      return;
+    }
+    for(ResourceType type : kArbitratedResources){
+      if(runtime->lease_resources & TF_LEASE_BIT(type))
+        ReleaseResource(type, runtime_id);
+    }
+    runtime->lease_id = -1;
+    runtime->lease_resources = 0;
+    runtime->lease_revoked = false;
+  }else if(!ReleaseResource(static_cast<ResourceType>(rx_release.cur_graph_resource),
+                            runtime_id)){
+    TfLog("Runtime %d released a resource it does not own", runtime_id);
+    return;
+  }
+  GrantWaitingRuntimes();
+}
+
+void TfScheduler::GrantWaitingRuntimes(){
+  if(!CheckAllRuntimesReady())
+    return;
+  for(ResourceType type : kArbitratedResources){
+    resource_pool* pool = ResourcePool(type);
+    while(static_cast<int>(pool->owners.size()) < pool->capacity &&
+          !pool->waiting.empty()){
+      const int next = policy->PickNext(pool->waiting);
+      const tf_request request = pool->waiting[next];
+      TakeSlot(type, request);
+      pool->waiting.erase(pool->waiting.begin() + next);
+      TfLog("Give resource to runtime %d", request.runtime_id);
+      SendGrant(request.runtime_id, request.request_id);
     }
   }
 }
 
-bool TfScheduler::RoundRobin(ResourceType type, int runtime_id){
-  // if(runtimes.size() < 2){
-  //   return true;
-  // }
-  if(!CheckAllRuntimesReady()){ // Every runtime should be in invoke state to start RR scheduling.
+bool TfScheduler::TryGrantLease(runtime_* runtime, int lease_resources,
+                                const tf_request& request){
+  int leasable = 0;
+  for(ResourceType type : kArbitratedResources)
+    leasable |= TF_LEASE_BIT(type);
+  if(!CheckAllRuntimesReady() || runtime->lease_id != -1 ||
+      (lease_resources & ~leasable) != 0)
     return false;
+  for(ResourceType type : kArbitratedResources){
+    if(!(lease_resources & TF_LEASE_BIT(type)))
+      continue;
+    resource_pool* pool = ResourcePool(type);
+    if(static_cast<int>(pool->owners.size()) >= pool->capacity ||
+        !pool->waiting.empty())
+      return false;
+  }
+  for(ResourceType type : kArbitratedResources){
+    if(!(lease_resources & TF_LEASE_BIT(type)))
+      continue;
+    TakeSlot(type, request);
+  }
+  stats->OnLease(runtime->id);
+  runtime->lease_id = leases_created++;
+  runtime->lease_resources = lease_resources;
+  runtime->lease_revoked = false;
+  return true;
+}
+
+void TfScheduler::RevokeLeaseIfPreempted(ResourceType type,
+                                         const tf_request& waiter){
+  resource_pool* pool = ResourcePool(type);
+  if(pool == nullptr)
+    return;
+  // Revoke one lease on the pool. If none can be, the waiter waits until
+  // a slot is released or a lease expires.
+  runtime_* holder = nullptr;
+  for(const tf_request& owner : pool->owners){
+    runtime_* candidate = FindRuntime(owner.runtime_id);
+    if(candidate != nullptr && candidate->lease_id != -1 &&
+        !candidate->lease_revoked &&
+        (candidate->lease_resources & TF_LEASE_BIT(type)) &&
+        policy->ShouldPreempt(waiter, owner)){
+      holder = candidate;
+      break;
+    }
+  }
+  if(holder != nullptr)
+    RevokeLease(holder);
+}
+
+void TfScheduler::RevokeLease(runtime_* holder){
+  holder->lease_revoked = true;
+  stats->OnRevoke(holder->id);
+  TfLog("Revoke lease %d of runtime %d", holder->lease_id, holder->id);
+  tf_lease_msg tx_revoke;
+  SetMsgHeader(tx_revoke.header, TF_MSG_REVOKE, holder->id,
+               RuntimeState::INVOKE_, RuntimeState::INVOKE_);
+  tx_revoke.lease_id = holder->lease_id;
+  tx_revoke.lease_resources = holder->lease_resources;
+  tx_revoke.lease_us = 0;
+  tx_revoke.variant = -1;
+  tx_revoke.request_id = -1;
+  SendLeaseMsg(holder, tx_revoke);
+}
+
+void TfScheduler::SendLeaseMsg(runtime_* runtime, const tf_lease_msg& msg){
+  if(shm_channel != nullptr && shm_channel->IsAttached(runtime->id)){
+    if(!shm_channel->SendReply(runtime->id, &msg, sizeof(msg)))
+      TfLog("Sending reply to runtime %d Failed", runtime->id);
+    return;
   }
+  SendToRuntime(runtime, &msg, sizeof(msg));
+}
+
+void TfScheduler::SetSchedulingPolicy(TfSchedulingPolicy* policy){
+  if(policy == nullptr)
+    return;
+  delete this->policy;
+  this->policy = policy;
+  std::cout << "Scheduling policy " << policy->Name() << "\n";
+}
+
+int TfScheduler::NextRuntimeId(){
+  int id = 0;
+  while(FindRuntime(id) != nullptr)
+    id++;
+  return id;
+}
+
+void TfScheduler::RemoveRuntime(int runtime_id){
+  runtime_* runtime = FindRuntime(runtime_id);
+  if(runtime == nullptr)
+    return;
+  for(ResourceType type : kArbitratedResources){
+    resource_pool* pool = ResourcePool(type);
+    while(ReleaseResource(type, runtime_id)) {}
+    for(auto it = pool->waiting.begin(); it != pool->waiting.end(); ){
+      if(it->runtime_id == runtime_id)
+        it = pool->waiting.erase(it);
+      else
+        ++it;
+    }
+  }
+  runtimes.erase(std::find(runtimes.begin(), runtimes.end(), runtime));
+  policy->OnLeave(runtime_id);
+  stats->OnLeave(runtime_id);
+  if(runtime->fd != -1)
+    close(runtime->fd); // also leaves epoll.
+  delete runtime;
+  std::cout << "Runtime " << runtime_id << " left, " << runtimes.size()
+            << " runtimes remain" << "\n";
+  // The leaving runtime may have been the one the others waited for.
+  GrantWaitingRuntimes();
+}
+
+runtime_* TfScheduler::FindRuntime(int runtime_id){
+  for(auto runtime : runtimes){
+    if(runtime->id == runtime_id)
+      return runtime;
+  }
+  return nullptr;
+}
+
+void TfScheduler::SendGrant(int runtime_id, int request_id, int lease_id,
+                            int lease_resources){
+  runtime_* runtime = FindRuntime(runtime_id);
+  if(runtime == nullptr)
+    return;
+  tf_lease_msg tx_grant;
+  SetMsgHeader(tx_grant.header, TF_MSG_GRANT, runtime_id, RuntimeState::INVOKE_,
+               RuntimeState::INVOKE_);
+  tx_grant.lease_id = lease_id;
+  tx_grant.lease_resources = lease_resources;
+  tx_grant.lease_us = lease_id == -1 ? 0 : lease_us;
+  tx_grant.variant = SelectPartitionVariant(runtime);
+  tx_grant.request_id = request_id;
+  SendLeaseMsg(runtime, tx_grant);
+}
+
+int TfScheduler::ServeShmChannel(){
+  int served = 0;
+  tf_invoke_msg rx_invoke;
+  size_t received;
+  int runtime_id;
+  while((runtime_id = shm_channel->PollRequest(&rx_invoke, sizeof(rx_invoke),
+                                                &received)) != -1){
+    if(received != sizeof(rx_invoke) ||
+        !IsValidMsg(rx_invoke.header, received) ||
+        rx_invoke.header.runtime_id != runtime_id){
+      TfLog("Dropped an invalid request from runtime %d", runtime_id);
+      continue;
+    }
+    if(rx_invoke.header.type == TF_MSG_INVOKE)
+      ArbitrateInvoke(rx_invoke);
+    else if(rx_invoke.header.type == TF_MSG_RELEASE)
+      HandleRelease(rx_invoke);
+    served++;
+  }
+  return served;
+}
+
+void TfScheduler::RefreshRuntimeState(const tf_msg_header& rx_header){
+  for(size_t i=0; i<runtimes.size(); ++i){
+    if(rx_header.runtime_id == runtimes[i]->id){
+      runtimes[i]->state = static_cast<RuntimeState>(rx_header.runtime_current_state);
+    }
+  }
+}
+
+resource_pool* TfScheduler::ResourcePool(ResourceType type){
   switch (type)
   {
   case ResourceType::CPU:
-    if(rr_cpu_queue.empty()){ // initial state. any runtime can take ownership
-      rr_cpu_queue.push(runtime_id);
-      return true;      
-    }
-    else if(rr_cpu_queue.front() != runtime_id){ // if last owner was other runtime
-      if(cpu_usage_flag) // Resource busy.
-        return false;
-      else{ // Resource available
-        rr_cpu_queue.pop();
-        rr_cpu_queue.push(runtime_id);
-        cpu_usage_flag = true;
-        return true;
-      }
-    }else
-      return false; // if last owner was this runtime
+    return &cpu_pool;
   case ResourceType::GPU:
-    if(rr_gpu_queue.empty()){ // initial state. any runtime can take ownership
-      rr_gpu_queue.push(runtime_id);
-      return true;      
-    }
-    else if(rr_gpu_queue.front() != runtime_id){ // if last owner was other runtime
-      if(gpu_usage_flag) // Resource busy.
-        return false;
-      else{ // Resource available
-        rr_gpu_queue.pop();
-        rr_gpu_queue.push(runtime_id);
-        cpu_usage_flag = true;
-        return true;
-      }
-    }else
-      return false; // if last owner was this runtime
+    return &gpu_pool;
+  case ResourceType::CPU_B:
+    return &cpu_b_pool;
   // case ResourceType::CPUGPU:
   //   /* Not implemented */
   //   break;
   default:
-    break;
+    return nullptr;
   }
 }
 
-void TfScheduler::ReleaseResource(ResourceType type){
-  switch (type)
-  {
-  case ResourceType::CPU :
-    cpu_usage_flag = false;
-    break;
-  
-  case ResourceType::GPU :
-    gpu_usage_flag = false;
-    break;
+void TfScheduler::SetResourceCapacity(ResourceType type, int slots){
+  resource_pool* pool = ResourcePool(type);
+  if(pool == nullptr || slots < 1){
+    std::cout << "Invalid capacity " << slots << " of resource " << type
+              << "\n";
+    return;
+  }
+  pool->capacity = slots;
+  stats->OnCapacity(type, slots);
+  std::cout << "Resource " << type << " has " << slots << " slots" << "\n";
+}
 
-  // case ResourceType::CPUGPU :
-  //   cpgpu_usage_flag = false;
-  //   break;
+bool TfScheduler::RoundRobin(ResourceType type, const tf_request& request){
+  resource_pool* pool = ResourcePool(type);
+  if(pool == nullptr)
+    return false;
+  // Every runtime should be in invoke state to start RR scheduling.
+  // Waiting requests are granted in the order of policy on release.
+  if(CheckAllRuntimesReady() &&
+      static_cast<int>(pool->owners.size()) < pool->capacity &&
+      pool->waiting.empty()){
+    TakeSlot(type, request);
+    return true;
+  }
+  pool->waiting.push_back(request);
+  stats->OnBlocked(type, request.runtime_id, pool->waiting.size());
+  return false;
+}
 
-  default:
-    break;
+void TfScheduler::TakeSlot(ResourceType type, const tf_request& request){
+  resource_pool* pool = ResourcePool(type);
+  pool->owners.push_back(request);
+  tf_request& owner = pool->owners.back();
+  owner.granted_us = PolicyNowUs();
+  stats->OnGrant(type, owner.runtime_id, owner.granted_us - owner.arrival_us);
+}
+
+bool TfScheduler::ReleaseResource(ResourceType type, int runtime_id){
+  resource_pool* pool = ResourcePool(type);
+  if(pool == nullptr)
+    return false;
+  for(auto it = pool->owners.begin(); it != pool->owners.end(); ++it){
+    if(it->runtime_id != runtime_id)
+      continue;
+    const int64_t now = PolicyNowUs();
+    policy->OnRelease(*it, now - it->granted_us);
+    runtime_* runtime = FindRuntime(runtime_id);
+    const bool leased = runtime != nullptr && runtime->lease_id != -1;
+    stats->OnRelease(type, runtime_id, leased ? -1 : it->subgraph,
+                     now - it->granted_us, it->deadline_us, now);
+    pool->owners.erase(it);
+    return true;
   }
-  return;
+  return false;
 }
 
 void TfScheduler::PrintRuntimeStates(){
   std::cout << "===================================";
   std::cout << "TfScheduler has " << runtimes.size() << " runtimes" << "\n";
-  for(int i=0; i<runtimes.size(); ++i){
+  for(size_t i=0; i<runtimes.size(); ++i){
   std::cout << "===================================";
     std::cout << "Runtime ID : " << runtimes[i]->id << "\n";
     std::cout << "Runtime State : " << runtimes[i]->state << "\n";
     std::cout << "Socket path :" << runtimes[i]->addr.sun_path << "\n";
+    const tf_stats_region* region = stats->Region();
+    if(region == nullptr || runtimes[i]->id >= TF_STATS_MAX_RUNTIMES)
+      continue;
+    const tf_runtime_stats& counters = region->runtimes[runtimes[i]->id];
+    std::cout << "Grants : " << counters.grants << ", blocked : "
+              << counters.blocked << ", deadline misses : "
+              << counters.deadline_misses << "\n";
+    std::cout << "Grant wait p50/p99 : "
+              << LatencyPercentile(counters.grant_wait, 0.5) << "/"
+              << LatencyPercentile(counters.grant_wait, 0.99) << " us" << "\n";
   }
 }
 
 
-// STUB METHOD
-// STUB METHOD
-void TfScheduler::CreatePartitioningPlan(tf_packet& rx_p, tf_packet& tx_p){
-  int layers = 0;
-  for(int i=0; i<1000; ++i){
-    if(rx_p.latency[i] == -1)
-      layers++;
-    else
+bool TfScheduler::CreatePartitioningPlanFromProfile(int runtime_id,
+                        tf_profile& profile,
+                        int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE],
+                        float cpu_contention, float gpu_contention){
+  std::vector<LayerCost> costs;
+  if(profile.is_dummy || profile.layers <= 0 ||
+      profile.layers > TF_P_PLAN_LENGTH)
+    return false;
+  const bool cpu_clusters = profile.co_resource == TF_P_PLAN_CPU_B;
+  // Cluster B contends with the other CPU work.
+  if(cpu_clusters)
+    gpu_contention = cpu_contention;
+  for(int i=0; i<profile.layers; ++i){
+    LayerCost cost;
+    // CPU subgraphs run on the runtime's CPU delegate(XNNPACK), the
+    // profile holds the builtin latency of a runtime without one.
+    cost.cpu = profile.xnn_latency[i];
+    if(plan_with_tail_latency){
+      // Only the builtin kernels have a tail profile, scale by their tail.
+      if(profile.latency[i] > 0)
+        cost.cpu *= profile.latency_p90[i] / profile.latency[i];
+      cost.gpu = profile.gpu_latency_p90[i];
+    }else{
+      cost.gpu = profile.gpu_latency[i];
+    }
+    cost.co_cpu = profile.co_cpu_latency[i];
+    cost.transfer = profile.transfer_latency[i];
+    cost.quantize = profile.quantize_latency[i];
+    if(cpu_clusters){
+      // Both clusters run the float model with their XNNPACK delegates,
+      // whole subgraphs or a split. Nothing is quantized.
+      cost.gpu = cost.co_cpu;
+      cost.co_max = profile.xnn_latency[i];
+      cost.quantize = 0;
+    }
+    // Negative latency means infeasible, keep it as is.
+    if(cost.cpu > 0)
+      cost.cpu *= cpu_contention;
+    if(cost.co_cpu > 0)
+      cost.co_cpu *= cpu_contention;
+    if(cost.co_max > 0)
+      cost.co_max *= cpu_contention;
+    if(cost.gpu > 0)
+      cost.gpu *= gpu_contention;
+    costs.push_back(cost);
+  }
+  std::cout << "Runtime [" << runtime_id << "] has " << costs.size() << 
+    " profiled layers in model" << "\n";
+  TfPlanner& runtime_planner = cpu_clusters ? cluster_planner : planner;
+  if(runtime_planner.CreatePlan(costs, plan) != kTfLiteOk)
+    return false;
+  runtime_planner.PrintPlan(plan);
+  return true;
+}
+
+size_t TfScheduler::AppendPartitionVariants(runtime_* runtime,
+                                            tf_profile& profile, tf_msg& msg,
+                                            size_t msg_size){
+  for(int type=0; type<VARIANT_TYPES; ++type)
+    runtime->variant_index[type] = 0;
+  runtime->variant_type = VARIANT_BALANCED;
+  if(!use_partition_variants || profile.is_dummy)
+    return msg_size;
+  memcpy(tx_variant_plans[0], tx_plan, sizeof(tx_plan));
+  int variants = 1;
+  for(int type=VARIANT_GPU_HEAVY; type<VARIANT_TYPES; ++type){
+    if(variants == TF_P_MAX_VARIANTS)
+      break;
+    int (*plan)[TF_P_PLAN_SIZE] = tx_variant_plans[variants];
+    for(int i=0; i<TF_P_PLAN_LENGTH; ++i){
+      for(int j=0; j<TF_P_PLAN_SIZE; ++j)
+        plan[i][j] = TF_P_END_MASTER;
+    }
+    const float cpu_contention =
+        type == VARIANT_GPU_HEAVY ? variant_contention : 1;
+    const float gpu_contention =
+        type == VARIANT_CPU_HEAVY ? variant_contention : 1;
+    if(!CreatePartitioningPlanFromProfile(runtime->id, profile, plan,
+                                          cpu_contention, gpu_contention))
+      continue;
+    // A variant same as one before is not built twice.
+    int same = -1;
+    for(int i=0; i<variants && same == -1; ++i){
+      if(memcmp(tx_variant_plans[i], plan, sizeof(tx_plan)) == 0)
+        same = i;
+    }
+    if(same != -1){
+      runtime->variant_index[type] = same;
+      continue;
+    }
+    size_t size = AppendPlanToMsg(plan, msg);
+    if(size == 0){
+      std::cout << "Partition variant doesn't fit in plan message" << "\n";
       break;
+    }
+    msg_size = size;
+    runtime->variant_index[type] = variants++;
+  }
+  std::cout << "Runtime [" << runtime->id << "] has " << variants
+            << " partition variants" << "\n";
+  return msg_size;
+}
+
+int TfScheduler::SelectPartitionVariant(runtime_* runtime){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  const double dwell_ms =
+      (now.tv_sec - runtime->variant_switched.tv_sec) * 1000.0 +
+      (now.tv_nsec - runtime->variant_switched.tv_nsec) / 1000000.0;
+  PartitionVariantType type = runtime->variant_type;
+  if(dwell_ms >= variant_dwell_ms){
+    // Go back once the contention is over.
+    if((type == VARIANT_GPU_HEAVY && cpu_util < variant_idle_util) ||
+        (type == VARIANT_CPU_HEAVY && gpu_util < variant_idle_util))
+      type = VARIANT_BALANCED;
+    if(type == VARIANT_BALANCED){
+      if(cpu_util >= variant_busy_util && gpu_util < variant_busy_util)
+        type = VARIANT_GPU_HEAVY;
+      else if(gpu_util >= variant_busy_util && cpu_util < variant_busy_util)
+        type = VARIANT_CPU_HEAVY;
+    }
+  }
+  if(type != runtime->variant_type){
+    TfLog("Runtime [%d] partition variant %d (cpu %.0f%%, gpu %.0f%%)",
+          runtime->id, runtime->variant_index[type], cpu_util, gpu_util);
+    runtime->variant_type = type;
+    runtime->variant_switched = now;
+  }
+  return runtime->variant_index[type];
+}
+
+// Falls back to the hand-tuned plans below if the runtime sent a dummy
+// profile.
+void TfScheduler::CreatePartitioningPlan(int runtime_id, tf_profile& profile,
+                        int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE]){
+  // Unused rows are marked as the end of master plan, so that only the rows
+  // in use are sent to runtime.
+  for(int i=0; i<TF_P_PLAN_LENGTH; ++i){
+    for(int j=0; j<TF_P_PLAN_SIZE; ++j)
+      plan[i][j] = TF_P_END_MASTER;
+  }
+  if(CreatePartitioningPlanFromProfile(runtime_id, profile, plan))
+    return;
+  // Hand-tuned plans are for GPU, a CPU cluster runtime runs on cluster A.
+  if(profile.co_resource == TF_P_PLAN_CPU_B){
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = profile.model.nodes;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[0][TF_P_IDX_RATIO]    = 0;
+    plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
+    return;
   }
-  std::cout << "Runtime [" << rx_p.runtime_id << "] has " << layers << 
+  // Known models by node count.
+  const int layers = profile.model.nodes;
+  std::cout << "Runtime [" << runtime_id << "] has " << layers << 
     " layers in model" << "\n";
   if(layers == 9){ // MNIST
 
-    // tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[0][TF_P_IDX_END]      = 9;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
+    // plan[0][TF_P_IDX_START]    = 0;
+    // plan[0][TF_P_IDX_END]      = 9;
+    // plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
     
     // if want two subgraph
-    tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_END]      = 1;
-    tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 2; // partitioning ratio
-    tx_p.partitioning_plan[1][TF_P_IDX_START]    = 1;
-    tx_p.partitioning_plan[1][TF_P_IDX_END]      = 9;
-    tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = 1;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    plan[0][TF_P_IDX_RATIO]    = 2; // partitioning ratio
+    plan[1][TF_P_IDX_START]    = 1;
+    plan[1][TF_P_IDX_END]      = 9;
+    plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;
   } // MNIST
   else if(layers == 124){ // MOBILENET_V3 224 
   //(old, from TF model hub)
-    tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_END]      = 124;
-    tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = 124;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
   }else if(layers == 123){ // MOBILENET_V3 224 
   //(from https://github.com/tensorflow/models/tree/master/research/slim/nets/mobilenet)
-    tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_END]      = 123;
-    tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = 123;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
   }else if(layers == 31){ // MOBILENET_V1 224 
   //(from https://tfhub.dev/tensorflow/lite-model/mobilenet_v1_1.0_224/1/default/1)
     // TEST PLAN  -- HW & CH
-    // tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[0][TF_P_IDX_END]      = 27;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 18; // partitioning ratio
-    // tx_p.partitioning_plan[1][TF_P_IDX_START]    = 27;
-    // tx_p.partitioning_plan[1][TF_P_IDX_END]      = 29;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 8; // partitioning ratio
-    // tx_p.partitioning_plan[2][TF_P_IDX_START]    = 29;
-    // tx_p.partitioning_plan[2][TF_P_IDX_END]      = 31;
-    // tx_p.partitioning_plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[2][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[3][TF_P_IDX_START]    = TF_P_END_PLAN;
+    // plan[0][TF_P_IDX_START]    = 0;
+    // plan[0][TF_P_IDX_END]      = 27;
+    // plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    // plan[0][TF_P_IDX_RATIO]    = 18; // partitioning ratio
+    // plan[1][TF_P_IDX_START]    = 27;
+    // plan[1][TF_P_IDX_END]      = 29;
+    // plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    // plan[1][TF_P_IDX_RATIO]    = 8; // partitioning ratio
+    // plan[2][TF_P_IDX_START]    = 29;
+    // plan[2][TF_P_IDX_END]      = 31;
+    // plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[2][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[3][TF_P_IDX_START]    = TF_P_END_PLAN;
 
     // TEST PLAN  -- HW & CH (Dynamic delegate)
-    tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_END]      = 27;
-    tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 18; // partitioning ratio
-    tx_p.partitioning_plan[1][TF_P_IDX_START]    = 27;
-    tx_p.partitioning_plan[1][TF_P_IDX_END]      = 29;
-    tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 8; // partitioning ratio
-    tx_p.partitioning_plan[2][TF_P_IDX_START]    = 29;
-    tx_p.partitioning_plan[2][TF_P_IDX_END]      = 31;
-    tx_p.partitioning_plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[2][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[3][TF_P_IDX_START]    = TF_P_END_PLAN;
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = 27;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    plan[0][TF_P_IDX_RATIO]    = 18; // partitioning ratio
+    plan[1][TF_P_IDX_START]    = 27;
+    plan[1][TF_P_IDX_END]      = 29;
+    plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    plan[1][TF_P_IDX_RATIO]    = 8; // partitioning ratio
+    plan[2][TF_P_IDX_START]    = 29;
+    plan[2][TF_P_IDX_END]      = 31;
+    plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[2][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[3][TF_P_IDX_START]    = TF_P_END_PLAN;
     // accuracy : (orange, banana) = (93%, 80%) <= gpu delegation
     // accuracy : (orange, banana) = (93%, 80%) <= xnnpack delegation
     // accuracy : (orange, banana) = (Nan, Nan) <= multi delegation
@@ -341,149 +1051,149 @@ void TfScheduler::CreatePartitioningPlan(tf_packet& rx_p, tf_packet& tx_p){
     //////////////////////////////////////////////////////////////////////////////////////////////
 
     // BASELINE for CPU
-    // tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[0][TF_P_IDX_END]      = 31;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
+    // plan[0][TF_P_IDX_START]    = 0;
+    // plan[0][TF_P_IDX_END]      = 31;
+    // plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
     // accuracy : (orange, banana) = (99%, 88%)
     
     // BASELINE for GPU
-    // tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[0][TF_P_IDX_END]      = 29;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[1][TF_P_IDX_START]    = 29;
-    // tx_p.partitioning_plan[1][TF_P_IDX_END]      = 31;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;
+    // plan[0][TF_P_IDX_START]    = 0;
+    // plan[0][TF_P_IDX_END]      = 29;
+    // plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    // plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[1][TF_P_IDX_START]    = 29;
+    // plan[1][TF_P_IDX_END]      = 31;
+    // plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;
     // accuracy : (orange, banana) = (99%, 88%)
 
     // TEST PLAN (Xavier) 7.2
-    // tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[0][TF_P_IDX_END]      = 29;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 18; // partitioning ratio
-    // tx_p.partitioning_plan[1][TF_P_IDX_START]    = 29;
-    // tx_p.partitioning_plan[1][TF_P_IDX_END]      = 31;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;
+    // plan[0][TF_P_IDX_START]    = 0;
+    // plan[0][TF_P_IDX_END]      = 29;
+    // plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    // plan[0][TF_P_IDX_RATIO]    = 18; // partitioning ratio
+    // plan[1][TF_P_IDX_START]    = 29;
+    // plan[1][TF_P_IDX_END]      = 31;
+    // plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;
 
   }else if(layers == 118){ // efficientnet lite 4
   // layers == 118 for GPU FP32
   // layers == 120 for CPU UINT8
-    tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_END]      = 114;
-    tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 18; // partitioning ratio
-    tx_p.partitioning_plan[1][TF_P_IDX_START]    = 114;
-    tx_p.partitioning_plan[1][TF_P_IDX_END]      = 118;
-    tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;
-
-    // tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[0][TF_P_IDX_END]      = 118;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = 114;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    plan[0][TF_P_IDX_RATIO]    = 18; // partitioning ratio
+    plan[1][TF_P_IDX_START]    = 114;
+    plan[1][TF_P_IDX_END]      = 118;
+    plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;
+
+    // plan[0][TF_P_IDX_START]    = 0;
+    // plan[0][TF_P_IDX_END]      = 118;
+    // plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
   }else if(layers == 152){ // yolo_v4_tiny-ieie
     // baselines
-    // tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[0][TF_P_IDX_END]      = 152;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
+    // plan[0][TF_P_IDX_START]    = 0;
+    // plan[0][TF_P_IDX_END]      = 152;
+    // plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    // plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
 
     // sj
     // TEST HW/CW Multi Delegate
-    tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_END]      = 8;
-    tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 15; // partitioning ratio
-    tx_p.partitioning_plan[1][TF_P_IDX_START]    = 8;
-    tx_p.partitioning_plan[1][TF_P_IDX_END]      = 9;
-    tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[2][TF_P_IDX_START]    = 9;
-    tx_p.partitioning_plan[2][TF_P_IDX_END]      = 20;
-    tx_p.partitioning_plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    tx_p.partitioning_plan[2][TF_P_IDX_RATIO]    = 15; // partitioning ratio
-    tx_p.partitioning_plan[3][TF_P_IDX_START]    = 20;
-    tx_p.partitioning_plan[3][TF_P_IDX_END]      = 21;
-    tx_p.partitioning_plan[3][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[3][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[4][TF_P_IDX_START]    = 21;
-    tx_p.partitioning_plan[4][TF_P_IDX_END]      = 32;
-    tx_p.partitioning_plan[4][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    tx_p.partitioning_plan[4][TF_P_IDX_RATIO]    = 15; // partitioning ratio
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = 8;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    plan[0][TF_P_IDX_RATIO]    = 15; // partitioning ratio
+    plan[1][TF_P_IDX_START]    = 8;
+    plan[1][TF_P_IDX_END]      = 9;
+    plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[2][TF_P_IDX_START]    = 9;
+    plan[2][TF_P_IDX_END]      = 20;
+    plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    plan[2][TF_P_IDX_RATIO]    = 15; // partitioning ratio
+    plan[3][TF_P_IDX_START]    = 20;
+    plan[3][TF_P_IDX_END]      = 21;
+    plan[3][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[3][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[4][TF_P_IDX_START]    = 21;
+    plan[4][TF_P_IDX_END]      = 32;
+    plan[4][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    plan[4][TF_P_IDX_RATIO]    = 15; // partitioning ratio
 
     // for Co-C-Co-C-Co-C-G-C
-    tx_p.partitioning_plan[5][TF_P_IDX_START]    = 32;
-    tx_p.partitioning_plan[5][TF_P_IDX_END]      = 33;
-    tx_p.partitioning_plan[5][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[5][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[6][TF_P_IDX_START]    = 33; // problem on node 52
-    tx_p.partitioning_plan[6][TF_P_IDX_END]      = 55; // 102?
-    tx_p.partitioning_plan[6][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    tx_p.partitioning_plan[6][TF_P_IDX_RATIO]    = 0; // partitioning ratio 17
-    tx_p.partitioning_plan[7][TF_P_IDX_START]    = 55;
-    tx_p.partitioning_plan[7][TF_P_IDX_END]      = 152;
-    tx_p.partitioning_plan[7][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[7][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[8][TF_P_IDX_START]    = TF_P_END_PLAN;
+    plan[5][TF_P_IDX_START]    = 32;
+    plan[5][TF_P_IDX_END]      = 33;
+    plan[5][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[5][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[6][TF_P_IDX_START]    = 33; // problem on node 52
+    plan[6][TF_P_IDX_END]      = 55; // 102?
+    plan[6][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    plan[6][TF_P_IDX_RATIO]    = 0; // partitioning ratio 17
+    plan[7][TF_P_IDX_START]    = 55;
+    plan[7][TF_P_IDX_END]      = 152;
+    plan[7][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[7][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[8][TF_P_IDX_START]    = TF_P_END_PLAN;
 
     // for Co-C-Co-C-Co-C
-    // tx_p.partitioning_plan[5][TF_P_IDX_START]    = 32;
-    // tx_p.partitioning_plan[5][TF_P_IDX_END]      = 152;
-    // tx_p.partitioning_plan[5][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[5][TF_P_IDX_RATIO]    = 0;
-    // tx_p.partitioning_plan[6][TF_P_IDX_START]    = TF_P_END_PLAN;
+    // plan[5][TF_P_IDX_START]    = 32;
+    // plan[5][TF_P_IDX_END]      = 152;
+    // plan[5][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[5][TF_P_IDX_RATIO]    = 0;
+    // plan[6][TF_P_IDX_START]    = TF_P_END_PLAN;
 
     // Minsung
-    // tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[0][TF_P_IDX_END]      = 8;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[1][TF_P_IDX_START]    = 8;
-    // tx_p.partitioning_plan[1][TF_P_IDX_END]      = 9;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[2][TF_P_IDX_START]    = 9;
-    // tx_p.partitioning_plan[2][TF_P_IDX_END]      = 20;
-    // tx_p.partitioning_plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    // tx_p.partitioning_plan[2][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[3][TF_P_IDX_START]    = 20;
-    // tx_p.partitioning_plan[3][TF_P_IDX_END]      = 21;
-    // tx_p.partitioning_plan[3][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[3][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[4][TF_P_IDX_START]    = 21;
-    // tx_p.partitioning_plan[4][TF_P_IDX_END]      = 32;
-    // tx_p.partitioning_plan[4][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    // tx_p.partitioning_plan[4][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[5][TF_P_IDX_START]    = 32;
-    // tx_p.partitioning_plan[5][TF_P_IDX_END]      = 33;
-    // tx_p.partitioning_plan[5][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[5][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[6][TF_P_IDX_START]    = 33; // problem on node 52
-    // tx_p.partitioning_plan[6][TF_P_IDX_END]      = 55; // 102?
-    // tx_p.partitioning_plan[6][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    // tx_p.partitioning_plan[6][TF_P_IDX_RATIO]    = 0; // partitioning ratio 17
-    // tx_p.partitioning_plan[7][TF_P_IDX_START]    = 55;
-    // tx_p.partitioning_plan[7][TF_P_IDX_END]      = 152;
-    // tx_p.partitioning_plan[7][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[7][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[8][TF_P_IDX_START]    = TF_P_END_PLAN;
+    // plan[0][TF_P_IDX_START]    = 0;
+    // plan[0][TF_P_IDX_END]      = 8;
+    // plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    // plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[1][TF_P_IDX_START]    = 8;
+    // plan[1][TF_P_IDX_END]      = 9;
+    // plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[2][TF_P_IDX_START]    = 9;
+    // plan[2][TF_P_IDX_END]      = 20;
+    // plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    // plan[2][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[3][TF_P_IDX_START]    = 20;
+    // plan[3][TF_P_IDX_END]      = 21;
+    // plan[3][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[3][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[4][TF_P_IDX_START]    = 21;
+    // plan[4][TF_P_IDX_END]      = 32;
+    // plan[4][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    // plan[4][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[5][TF_P_IDX_START]    = 32;
+    // plan[5][TF_P_IDX_END]      = 33;
+    // plan[5][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[5][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[6][TF_P_IDX_START]    = 33; // problem on node 52
+    // plan[6][TF_P_IDX_END]      = 55; // 102?
+    // plan[6][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    // plan[6][TF_P_IDX_RATIO]    = 0; // partitioning ratio 17
+    // plan[7][TF_P_IDX_START]    = 55;
+    // plan[7][TF_P_IDX_END]      = 152;
+    // plan[7][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[7][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[8][TF_P_IDX_START]    = TF_P_END_PLAN;
     
-    // tx_p.partitioning_plan[9][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[9][TF_P_IDX_END]      = 8;
-    // tx_p.partitioning_plan[9][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    // tx_p.partitioning_plan[9][TF_P_IDX_RATIO]    = 15; // partitioning ratio
-    // tx_p.partitioning_plan[10][TF_P_IDX_START]    = TF_P_END_PLAN;
+    // plan[9][TF_P_IDX_START]    = 0;
+    // plan[9][TF_P_IDX_END]      = 8;
+    // plan[9][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    // plan[9][TF_P_IDX_RATIO]    = 15; // partitioning ratio
+    // plan[10][TF_P_IDX_START]    = TF_P_END_PLAN;
     
-    // tx_p.partitioning_plan[11][TF_P_IDX_START]    = TF_P_END_MASTER;
+    // plan[11][TF_P_IDX_START]    = TF_P_END_MASTER;
 
     //
   }
@@ -498,142 +1208,159 @@ void TfScheduler::CreatePartitioningPlan(tf_packet& rx_p, tf_packet& tx_p){
   //
   // 55 ~ 58
 
-    // tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[0][TF_P_IDX_END]      = 8;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[1][TF_P_IDX_START]    = 8;
-    // tx_p.partitioning_plan[1][TF_P_IDX_END]      = 9;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[2][TF_P_IDX_START]    = 9;
-    // tx_p.partitioning_plan[2][TF_P_IDX_END]      = 19;
-    // tx_p.partitioning_plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    // tx_p.partitioning_plan[2][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[3][TF_P_IDX_START]    = 19;
-    // tx_p.partitioning_plan[3][TF_P_IDX_END]      = 21;
-    // tx_p.partitioning_plan[3][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[3][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[4][TF_P_IDX_START]    = 21;
-    // tx_p.partitioning_plan[4][TF_P_IDX_END]      = 31;
-    // tx_p.partitioning_plan[4][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    // tx_p.partitioning_plan[4][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[5][TF_P_IDX_START]    = 31;
-    // tx_p.partitioning_plan[5][TF_P_IDX_END]      = 33;
-    // tx_p.partitioning_plan[5][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[5][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    // tx_p.partitioning_plan[6][TF_P_IDX_START]    = 33; 
-    // tx_p.partitioning_plan[6][TF_P_IDX_END]      = 50;
-    // tx_p.partitioning_plan[6][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    // tx_p.partitioning_plan[6][TF_P_IDX_RATIO]    = 15; // partitioning ratio
-    // tx_p.partitioning_plan[7][TF_P_IDX_START]    = 50;
-    // tx_p.partitioning_plan[7][TF_P_IDX_END]      = 56;
-    // tx_p.partitioning_plan[7][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[7][TF_P_IDX_RATIO]    = 0;
-    // tx_p.partitioning_plan[8][TF_P_IDX_START]    = 56;
-    // tx_p.partitioning_plan[8][TF_P_IDX_END]      = 59;
-    // tx_p.partitioning_plan[8][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    // tx_p.partitioning_plan[8][TF_P_IDX_RATIO]    = 0;
-    // tx_p.partitioning_plan[9][TF_P_IDX_START]    = TF_P_END_PLAN;
+    // plan[0][TF_P_IDX_START]    = 0;
+    // plan[0][TF_P_IDX_END]      = 8;
+    // plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    // plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[1][TF_P_IDX_START]    = 8;
+    // plan[1][TF_P_IDX_END]      = 9;
+    // plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[2][TF_P_IDX_START]    = 9;
+    // plan[2][TF_P_IDX_END]      = 19;
+    // plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    // plan[2][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[3][TF_P_IDX_START]    = 19;
+    // plan[3][TF_P_IDX_END]      = 21;
+    // plan[3][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[3][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[4][TF_P_IDX_START]    = 21;
+    // plan[4][TF_P_IDX_END]      = 31;
+    // plan[4][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    // plan[4][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[5][TF_P_IDX_START]    = 31;
+    // plan[5][TF_P_IDX_END]      = 33;
+    // plan[5][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[5][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    // plan[6][TF_P_IDX_START]    = 33; 
+    // plan[6][TF_P_IDX_END]      = 50;
+    // plan[6][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    // plan[6][TF_P_IDX_RATIO]    = 15; // partitioning ratio
+    // plan[7][TF_P_IDX_START]    = 50;
+    // plan[7][TF_P_IDX_END]      = 56;
+    // plan[7][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[7][TF_P_IDX_RATIO]    = 0;
+    // plan[8][TF_P_IDX_START]    = 56;
+    // plan[8][TF_P_IDX_END]      = 59;
+    // plan[8][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    // plan[8][TF_P_IDX_RATIO]    = 0;
+    // plan[9][TF_P_IDX_START]    = TF_P_END_PLAN;
 
 
     // CPU execution for debugging
-    tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_END]      = 59;
-    tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0;
-    tx_p.partitioning_plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = 59;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[0][TF_P_IDX_RATIO]    = 0;
+    plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
 
   }
   else if(layers == 68){ // case of yolo v4 tiny cpu (including quantize layer)
-    tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_END]      = 8;
-    tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[1][TF_P_IDX_START]    = 8;
-    tx_p.partitioning_plan[1][TF_P_IDX_END]      = 9;
-    tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[2][TF_P_IDX_START]    = 9;
-    tx_p.partitioning_plan[2][TF_P_IDX_END]      = 21;
-    tx_p.partitioning_plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[2][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[3][TF_P_IDX_START]    = 21;
-    tx_p.partitioning_plan[3][TF_P_IDX_END]      = 23;
-    tx_p.partitioning_plan[3][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[3][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[4][TF_P_IDX_START]    = 23;
-    tx_p.partitioning_plan[4][TF_P_IDX_END]      = 36;
-    tx_p.partitioning_plan[4][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[4][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[5][TF_P_IDX_START]    = 36;
-    tx_p.partitioning_plan[5][TF_P_IDX_END]      = 38;
-    tx_p.partitioning_plan[5][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[5][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[6][TF_P_IDX_START]    = 38; 
-    tx_p.partitioning_plan[6][TF_P_IDX_END]      = 58;
-    tx_p.partitioning_plan[6][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[6][TF_P_IDX_RATIO]    = 0; // partitioning ratio
-    tx_p.partitioning_plan[7][TF_P_IDX_START]    = 58;
-    tx_p.partitioning_plan[7][TF_P_IDX_END]      = 65;
-    tx_p.partitioning_plan[7][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[7][TF_P_IDX_RATIO]    = 0;
-    tx_p.partitioning_plan[8][TF_P_IDX_START]    = 65;
-    tx_p.partitioning_plan[8][TF_P_IDX_END]      = 68;
-    tx_p.partitioning_plan[8][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[8][TF_P_IDX_RATIO]    = 0;
-    tx_p.partitioning_plan[9][TF_P_IDX_START]    = TF_P_END_PLAN;
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = 8;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[0][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[1][TF_P_IDX_START]    = 8;
+    plan[1][TF_P_IDX_END]      = 9;
+    plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[1][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[2][TF_P_IDX_START]    = 9;
+    plan[2][TF_P_IDX_END]      = 21;
+    plan[2][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[2][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[3][TF_P_IDX_START]    = 21;
+    plan[3][TF_P_IDX_END]      = 23;
+    plan[3][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[3][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[4][TF_P_IDX_START]    = 23;
+    plan[4][TF_P_IDX_END]      = 36;
+    plan[4][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[4][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[5][TF_P_IDX_START]    = 36;
+    plan[5][TF_P_IDX_END]      = 38;
+    plan[5][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[5][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[6][TF_P_IDX_START]    = 38; 
+    plan[6][TF_P_IDX_END]      = 58;
+    plan[6][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[6][TF_P_IDX_RATIO]    = 0; // partitioning ratio
+    plan[7][TF_P_IDX_START]    = 58;
+    plan[7][TF_P_IDX_END]      = 65;
+    plan[7][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[7][TF_P_IDX_RATIO]    = 0;
+    plan[8][TF_P_IDX_START]    = 65;
+    plan[8][TF_P_IDX_END]      = 68;
+    plan[8][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[8][TF_P_IDX_RATIO]    = 0;
+    plan[9][TF_P_IDX_START]    = TF_P_END_PLAN;
   }else if(layers == 52){ // ultra fast lanenet
   // 52 for FP32. 54 for int8
-    tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_END]      = 47;
-    tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 15;
-    tx_p.partitioning_plan[1][TF_P_IDX_START]    = 47;
-    tx_p.partitioning_plan[1][TF_P_IDX_END]      = 52;
-    tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 0;
-    tx_p.partitioning_plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;     
-
-
-    // tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[0][TF_P_IDX_END]      = 47;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0;
-    // tx_p.partitioning_plan[1][TF_P_IDX_START]    = 47;
-    // tx_p.partitioning_plan[1][TF_P_IDX_END]      = 52;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 0;
-    // tx_p.partitioning_plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;      
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = 47;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    plan[0][TF_P_IDX_RATIO]    = 15;
+    plan[1][TF_P_IDX_START]    = 47;
+    plan[1][TF_P_IDX_END]      = 52;
+    plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[1][TF_P_IDX_RATIO]    = 0;
+    plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;     
+
+
+    // plan[0][TF_P_IDX_START]    = 0;
+    // plan[0][TF_P_IDX_END]      = 47;
+    // plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_GPU;
+    // plan[0][TF_P_IDX_RATIO]    = 0;
+    // plan[1][TF_P_IDX_START]    = 47;
+    // plan[1][TF_P_IDX_END]      = 52;
+    // plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[1][TF_P_IDX_RATIO]    = 0;
+    // plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;      
 
     // FOR INT8 
-    // tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    // tx_p.partitioning_plan[0][TF_P_IDX_END]      = 54;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    // tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0;
-    // tx_p.partitioning_plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
+    // plan[0][TF_P_IDX_START]    = 0;
+    // plan[0][TF_P_IDX_END]      = 54;
+    // plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    // plan[0][TF_P_IDX_RATIO]    = 0;
+    // plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;
     
   }else if(layers == 54){
-    tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_END]      = 47;
-    tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
-    tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 15;
-    tx_p.partitioning_plan[1][TF_P_IDX_START]    = 47;
-    tx_p.partitioning_plan[1][TF_P_IDX_END]      = 52;
-    tx_p.partitioning_plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[1][TF_P_IDX_RATIO]    = 0;
-    tx_p.partitioning_plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;         
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = 47;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CO_E;
+    plan[0][TF_P_IDX_RATIO]    = 15;
+    plan[1][TF_P_IDX_START]    = 47;
+    plan[1][TF_P_IDX_END]      = 52;
+    plan[1][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[1][TF_P_IDX_RATIO]    = 0;
+    plan[2][TF_P_IDX_START]    = TF_P_END_PLAN;         
   }
   else{
-    tx_p.partitioning_plan[0][TF_P_IDX_START]    = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_END]      = 0;
-    tx_p.partitioning_plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
-    tx_p.partitioning_plan[0][TF_P_IDX_RATIO]    = 0;
-    tx_p.partitioning_plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;  
+    plan[0][TF_P_IDX_START]    = 0;
+    plan[0][TF_P_IDX_END]      = 0;
+    plan[0][TF_P_IDX_RESOURCE] = TF_P_PLAN_CPU;
+    plan[0][TF_P_IDX_RATIO]    = 0;
+    plan[1][TF_P_IDX_START]    = TF_P_END_PLAN;  
   }
 }
 
-TfScheduler::~TfScheduler() {};
+TfScheduler::~TfScheduler() {
+  for(int fd : {epoll_fd, watchdog_timer_fd, monitor_timer_fd}){
+    if(fd != -1)
+      close(fd);
+  }
+  for(auto runtime : runtimes){
+    if(runtime->fd != -1)
+      close(runtime->fd);
+  }
+  TfLogFlush();
+  if(shm_channel != nullptr)
+    delete shm_channel;
+  for(auto& model : models)
+    delete model.second;
+  delete policy;
+  delete stats;
+  delete monitor;
+};
 
 }
 
@@ -7,9 +7,13 @@
 #include <vector>
 #include <utility>
 #include <queue>
+#include <map>
+#include <deque>
 #include "condition_variable"
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 #include <unistd.h>
 #include <error.h>
 #include "opencv2/opencv.hpp"
@@ -18,13 +22,59 @@
 #include "future"
 #include "tensorflow/lite/util.h"
 #include "tensorflow/lite/tf_monitor.h"
+#include "tensorflow/lite/tf_planner.h"
+#include "tensorflow/lite/tf_protocol.h"
+#include "tensorflow/lite/tf_channel.h"
+#include "tensorflow/lite/tf_policy.h"
+#include "tensorflow/lite/tf_log.h"
+#include "tensorflow/lite/tf_stats.h"
+
+// Environment variable of the number of CPU subgraphs which run at once,
+// 1 if not set. Set it to the cores of CPU cluster over the threads of a
+// CPU subgraph.
+#define TF_CPU_SLOTS_ENV      "TF_SCHEDULER_CPU_SLOTS"
+// Same for CPU cluster B of CPU-cluster co-execution.
+#define TF_CPU_B_SLOTS_ENV    "TF_SCHEDULER_CPU_B_SLOTS"
 
 namespace tflite{
 
+  // Slots of a resource. A granted subgraph takes a slot, a lease takes a
+  // slot of every leased resource.
+  typedef struct resource_pool{
+    int capacity = 1;
+    // Requests granted a slot.
+    std::vector<tf_request> owners;
+    // Requests waiting for a slot, granted in the order of policy.
+    std::vector<tf_request> waiting;
+  }resource_pool;
+
+  // Partition variants planned for each runtime.
+  typedef enum PartitionVariantType{
+    VARIANT_BALANCED,   // primary plan, profile as is.
+    VARIANT_GPU_HEAVY,  // planned as if CPU is contended.
+    VARIANT_CPU_HEAVY,  // planned as if GPU is contended.
+    VARIANT_TYPES
+  }PartitionVariantType;
+
+  // Profile and plan of a model, shared by runtimes of the model.
+  typedef struct model_entry{
+    // Last measured profile, dummy if never measured.
+    tf_profile profile;
+    // Payload of the plan message created from 'profile', empty if not
+    // planned yet.
+    std::vector<char> plan_payload;
+    int variant_index[VARIANT_TYPES];
+  }model_entry;
+
   typedef struct runtime_{
     int id;
     RuntimeState state;
+    tf_model_id model;
     struct sockaddr_un addr;
+    // Socket connected to runtime, so a slow one only blocks its own sends.
+    int fd = -1;
+    // Messages not sent yet because the queue of runtime was full.
+    std::deque<std::vector<char>> tx_pending;
     float latency[TF_P_PLAN_LENGTH];
     int partitioning_plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE];
     // First idx means first subgraph's idx in partitioning subset.
@@ -34,12 +84,29 @@ namespace tflite{
     // Fourth idx means partitioning ratio(1~19).
     //  3 means, GPU : 3  CPU : 7 (for channel-wise)
     // 13 means, GPU : 3  CPU : 7 (for height-wise)
+
+    // Lease of resources granted to runtime, -1 if none.
+    int lease_id = -1;
+    int lease_resources = 0; // TF_LEASE_BIT of resources
+    bool lease_revoked = false;
+    // Scheduling parameters sent with the last invoke request.
+    int priority = 0;
+    int period_us = 0;
+    int weight = 1;
+
+    // Index of each variant type in the plan message, 0(primary) if the
+    // variant was not sent.
+    int variant_index[VARIANT_TYPES] = {0, };
+    PartitionVariantType variant_type = VARIANT_BALANCED;
+    struct timespec variant_switched = {0, 0};
   }runtime_;
 
   class TfScheduler{
     public:
       TfScheduler();
-      TfScheduler(const char* uds_file_name);
+      // Invoke requests are served over a shared-memory channel if
+      // 'use_shm_channel' is set and the channel can be created.
+      TfScheduler(const char* uds_file_name, bool use_shm_channel = true);
 
       void PrintRuntimeStates();
 
@@ -47,48 +114,226 @@ namespace tflite{
 
       void SysMonitor();
 
-      int SendPacketToRuntime(tf_packet& tx_p, struct sockaddr_un& runtime_addr);
+      int SendMsgToRuntime(const void* msg, size_t size,
+                           struct sockaddr_un& runtime_addr);
       
-      int ReceivePacketFromRuntime(tf_packet& rx_p, struct sockaddr_un& runtime_addr);
+      // Returns the size of received message, -1 on failure.
+      int ReceiveMsgFromRuntime(tf_msg& rx_msg, struct sockaddr_un& runtime_addr,
+                                int flags = 0);
       
       // refresh runtime state in scheduler.
-      void RefreshRuntimeState(tf_packet& rx_p);
+      void RefreshRuntimeState(const tf_msg_header& rx_header);
+
+      // Grants the requested resource or queues the request until the
+      // resource is released. A queued runtime gets no reply until granted.
+      void ArbitrateInvoke(const tf_invoke_msg& rx_invoke);
+
+      // Releases the resource of a done message and grants it to the next
+      // waiting runtime.
+      void HandleRelease(const tf_invoke_msg& rx_release);
+
+      // Grants free resources to the runtimes waiting for them.
+      void GrantWaitingRuntimes();
+
+      // Sends an invoke grant to runtime over the channel it is attached to.
+      // 'lease_id' is -1 for a grant of a single subgraph.
+      void SendGrant(int runtime_id, int request_id, int lease_id = -1,
+                     int lease_resources = 0);
+
+      // Leases a slot of given resources to runtime if each of them has a
+      // free one and nobody waits for it.
+      bool TryGrantLease(runtime_* runtime, int lease_resources,
+                         const tf_request& request);
+
+      // Revokes the lease on 'type' if the policy lets 'waiter' preempt its
+      // holder. The holder gives it back at its next subgraph boundary.
+      void RevokeLeaseIfPreempted(ResourceType type, const tf_request& waiter);
+      void RevokeLease(runtime_* holder);
+
+      // Sends a grant or revoke over the channel runtime is attached to.
+      void SendLeaseMsg(runtime_* runtime, const tf_lease_msg& msg);
+
+      // Replaces the scheduling policy, takes the ownership of 'policy'.
+      void SetSchedulingPolicy(TfSchedulingPolicy* policy);
+
+      runtime_* FindRuntime(int runtime_id);
+
+      // Lowest id no registered runtime has. Ids of left runtimes are
+      // reused, so their slots of shared-memory channel are.
+      int NextRuntimeId();
+
+      // Forgets a runtime which left, and gives its resources to waiting
+      // ones.
+      void RemoveRuntime(int runtime_id);
+
+      // Serves every pending invoke request on shared-memory channel.
+      // Returns the number of served requests.
+      int ServeShmChannel();
 
-      void CreatePartitioningPlan(tf_packet& rx_p, tf_packet& tx_p);
+      void CreatePartitioningPlan(int runtime_id, tf_profile& profile,
+                                  int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE]);
 
+      // Creates a partitioning plan from the per-node profile with TfPlanner.
+      // Returns false if the profile is a dummy one.
+      // CPU(and co-execution CPU side) and GPU costs are scaled by given
+      // contention factors. Both CPU clusters of a CPU-cluster runtime are
+      // scaled by 'cpu_contention'.
+      bool CreatePartitioningPlanFromProfile(int runtime_id, tf_profile& profile,
+                                  int plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE],
+                                  float cpu_contention = 1,
+                                  float gpu_contention = 1);
+
+      // Plans partition variants of contended cases from the profile and
+      // appends the ones which differ from the plans before to the plan
+      // message. Returns the size of whole message to send.
+      size_t AppendPartitionVariants(runtime_* runtime, tf_profile& profile,
+                                     tf_msg& msg, size_t msg_size);
+
+      // Picks the partition variant of runtime's next inference from
+      // system utilization.
+      int SelectPartitionVariant(runtime_* runtime);
+
+      // Creates the plan message of runtime's model from 'profile' in
+      // tx_msg. A dummy profile is replaced by the cached one of the model
+      // and the plan of a cached profile is reused.
+      // Returns the size of whole message to send.
+      size_t CreatePlanMsg(runtime_* runtime, tf_profile& profile);
+
+      // True if at least one runtime is registered and every registered one
+      // is invoking. A joining runtime profiles and partitions its model
+      // without the others running.
       bool CheckAllRuntimesReady();
 
-      bool RoundRobin(ResourceType type, int runtime_id);
-      void ReleaseResource(ResourceType type);
+      // Gives 'type' to the request if it is free and nobody waits for it.
+      // Otherwise adds the request to the waiting ones and returns false.
+      bool RoundRobin(ResourceType type, const tf_request& request);
+      // Makes the request an owner of 'type', the pool must have a free slot.
+      void TakeSlot(ResourceType type, const tf_request& request);
+      // Returns false if the runtime does not own the resource.
+      bool ReleaseResource(ResourceType type, int runtime_id);
+
+      // Slots of a resource, nullptr if not arbitrated.
+      resource_pool* ResourcePool(ResourceType type);
+      // Number of subgraphs which run on 'type' at once.
+      void SetResourceCapacity(ResourceType type, int slots);
 
       ~TfScheduler();
     
     private:
+      //// Event loop
+      // Creates epoll and timers. Returns false on failure.
+      bool InitializeEventLoop();
+      void HandleEvent(const struct epoll_event& event);
+      // Receives and handles ready UDS messages, at most a batch.
+      void ReceiveMsgs();
+      void HandleMsg(int received, struct sockaddr_un& runtime_addr);
+
+      // Returns a socket connected to runtime and watched by epoll, -1 on
+      // failure.
+      int ConnectRuntime(struct sockaddr_un& runtime_addr);
+      // Sends without blocking, a message which doesn't fit in the queue of
+      // runtime is sent when it becomes writable. Returns false and marks
+      // the runtime dead if it can't be reached.
+      bool SendToRuntime(runtime_* runtime, const void* msg, size_t size);
+      void FlushPendingMsgs(runtime_* runtime);
+      void WatchWritable(runtime_* runtime, bool writable);
+      runtime_* FindRuntimeByFd(int fd);
+
+      // False if the socket of runtime is closed. (process exited)
+      bool IsRuntimeAlive(runtime_* runtime);
+      // Removed at the end of current loop iteration.
+      void MarkDead(int runtime_id);
+      void RemoveDeadRuntimes();
+      // Finds dead owners of resources, and revokes overdue leases which
+      // others wait for.
+      void CheckResourceOwners();
+
+      // Refreshes system_state and utilizations from the monitor.
+      void SampleSystem();
+
+      // Periodic timer watched by epoll, -1 on failure.
+      int CreateTimer(int interval_us);
+      ////
 
-    LiteSysMonitor* monitor;
+    LiteSysMonitor* monitor = nullptr;
+    // Latest sample of the system, every kMonitorIntervalUs.
+    tf_system_snapshot system_state;
+    TfPlanner planner;
+    // Plans runtimes which co-execute between CPU clusters.
+    // (tf_profile::co_resource is TF_P_PLAN_CPU_B)
+    TfPlanner cluster_planner;
+
+    // Plan with p90 latency of the profile instead of median.
+    bool plan_with_tail_latency = false;
     std::thread monitoring_thread;
 
     int scheduler_fd;
+    int epoll_fd = -1;
+    // Checks the owners of resources every lease_us.
+    int watchdog_timer_fd = -1;
+    // Samples the system.
+    int monitor_timer_fd = -1;
+    std::vector<int> dead_runtimes;
+
+    // Channel for invoke requests, nullptr if only UDS is used.
+    TfShmChannel* shm_channel = nullptr;
+
+    // IPC buffers, kept as members to avoid zeroing large messages on the
+    // stack for every request.
+    tf_msg rx_msg;
+    tf_msg tx_msg;
+    tf_profile rx_profile;
+    int tx_plan[TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE];
+    int tx_variant_plans[TF_P_MAX_VARIANTS][TF_P_PLAN_LENGTH][TF_P_PLAN_SIZE];
     size_t addr_size;
     struct sockaddr_un scheduler_addr;
 
     std::vector<runtime_*> runtimes;
-    int runtimes_created = 0;
+
+    // Profiles and plans keyed by model identity.
+    // <content_hash, op_signature>
+    std::map<std::pair<uint64_t, uint64_t>, model_entry*> models;
 
     bool reschedule_needed = false;
 
     // For RR scheduler
-    bool cpu_usage_flag = false;
-    bool gpu_usage_flag = false;
+    resource_pool cpu_pool;
+    resource_pool gpu_pool;
+    resource_pool cpu_b_pool;
     bool cpgpu_usage_flag = false;
-    std::queue<int> rr_cpu_queue;
-    std::queue<int> rr_gpu_queue;
+
+    // Picks the next owner of a contended resource. FixedPriorityPolicy by
+    // default, which is FIFO among runtimes of the same priority.
+    TfSchedulingPolicy* policy = new FixedPriorityPolicy;
+
+    // Counters and latency histograms, in the file of TF_SCHEDULER_STATS if
+    // set. Runtime ids from TF_STATS_MAX_RUNTIMES are not recorded.
+    TfSchedulerStats* stats = new TfSchedulerStats(nullptr);
+
+    // Leases
+    // Grant leases to uncontended runtimes which ask for them.
+    bool use_lease = true;
+    // Time bound of a lease. A runtime of same or lower priority waits at
+    // most this long(plus a subgraph) for a leased resource.
+    int lease_us = 50000;
+    int leases_created = 0;
+
+    // Partition variants
+    bool use_partition_variants = true;
+    // Latency factor of contended resource when planning a variant.
+    float variant_contention = 2.0;
+    // Utilization(%) of a resource to leave a variant for, and to come back
+    // from. The band keeps a runtime from toggling on its own load.
+    float variant_busy_util = 90;
+    float variant_idle_util = 60;
+    // Min time on a variant before the next switch.
+    int variant_dwell_ms = 500;
 
     // current GPU utlization ratio.
-    float gpu_util;
+    float gpu_util = 0;
     
     // current CPU utlization ratio(average).
-    float cpu_util;
+    float cpu_util = 0;
   
   };
 
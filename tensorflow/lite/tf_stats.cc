@@ -0,0 +1,305 @@
+#include "tensorflow/lite/tf_stats.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "tensorflow/lite/tf_policy.h"
+#include "tensorflow/lite/util.h"
+
+namespace tflite{
+
+namespace {
+
+int BucketOf(uint64_t value){
+  if(value < TF_HIST_SUB_BUCKETS)
+    return value;
+  const int bits = 63 - __builtin_clzll(value);
+  if(bits >= TF_HIST_MAX_BITS)
+    return TF_HIST_BUCKETS - 1;
+  const int shift = bits - TF_HIST_SUB_BITS;
+  return (shift + 1) * TF_HIST_SUB_BUCKETS +
+         ((value >> shift) - TF_HIST_SUB_BUCKETS);
+}
+
+// Smallest value of the next bucket.
+uint64_t UpperBoundOf(int bucket){
+  if(bucket < TF_HIST_SUB_BUCKETS)
+    return bucket + 1;
+  const int shift = bucket / TF_HIST_SUB_BUCKETS - 1;
+  const uint64_t sub = bucket % TF_HIST_SUB_BUCKETS;
+  return (TF_HIST_SUB_BUCKETS + sub + 1) << shift;
+}
+
+// Marks a record being updated, readers retry until it ends.
+class SeqWriteGuard{
+  public:
+    explicit SeqWriteGuard(std::atomic<uint64_t>& seq) : seq_(seq) {
+      seq_.store(seq_.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+    ~SeqWriteGuard(){
+      seq_.store(seq_.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+    }
+
+  private:
+    std::atomic<uint64_t>& seq_;
+};
+
+template <typename T>
+void ReadConsistent(const T& record, T& copy){
+  while(1){
+    const uint64_t begin = record.seq.load(std::memory_order_acquire);
+    if(begin & 1)
+      continue;
+    memcpy(static_cast<void*>(&copy), &record, sizeof(T));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(record.seq.load(std::memory_order_relaxed) == begin)
+      return;
+  }
+}
+
+} // namespace
+
+void RecordLatency(tf_histogram& histogram, int64_t value_us){
+  const uint64_t value = value_us > 0 ? value_us : 0;
+  histogram.count++;
+  histogram.sum += value;
+  if(value > histogram.max)
+    histogram.max = value;
+  histogram.buckets[BucketOf(value)]++;
+}
+
+uint64_t LatencyPercentile(const tf_histogram& histogram, double quantile){
+  if(histogram.count == 0)
+    return 0;
+  const uint64_t rank = quantile * (histogram.count - 1) + 1;
+  uint64_t seen = 0;
+  for(int i=0; i<TF_HIST_BUCKETS; ++i){
+    seen += histogram.buckets[i];
+    // The last bucket is unbounded, values out of range fall into it.
+    if(seen >= rank && i == TF_HIST_BUCKETS - 1)
+      return histogram.max;
+    if(seen >= rank)
+      return std::min(UpperBoundOf(i), histogram.max);
+  }
+  return histogram.max;
+}
+
+TfSchedulerStats::TfSchedulerStats(const char* path){
+  const size_t size = sizeof(tf_stats_region);
+  void* addr = MAP_FAILED;
+  if(path != nullptr && path[0] != '\0'){
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd != -1 && ftruncate(fd, size) == 0)
+      addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(fd != -1)
+      close(fd);
+    if(addr == MAP_FAILED)
+      std::cout << "Cannot create stats file " << path << ", errno " << errno
+                << "\n";
+    else
+      std::cout << "Scheduler stats in " << path << "\n";
+  }
+  file_backed_ = addr != MAP_FAILED;
+  if(!file_backed_)
+    addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(addr == MAP_FAILED){
+    std::cout << "Cannot allocate scheduler stats" << "\n";
+    return;
+  }
+  // Both mappings start zeroed.
+  region_ = static_cast<tf_stats_region*>(addr);
+  for(int i=0; i<TF_STATS_RESOURCES; ++i)
+    region_->resources[i].capacity = 1;
+  for(int i=0; i<TF_STATS_MAX_RUNTIMES; ++i)
+    region_->runtimes[i].runtime_id = -1;
+  region_->start_us = PolicyNowUs();
+  region_->version = TF_STATS_VERSION;
+  // Readers check the magic last.
+  std::atomic_thread_fence(std::memory_order_release);
+  region_->magic = TF_STATS_MAGIC;
+}
+
+TfSchedulerStats::~TfSchedulerStats(){
+  if(region_ != nullptr)
+    munmap(region_, sizeof(tf_stats_region));
+}
+
+tf_runtime_stats* TfSchedulerStats::Runtime(int runtime_id){
+  if(region_ == nullptr || runtime_id < 0 ||
+      runtime_id >= TF_STATS_MAX_RUNTIMES)
+    return nullptr;
+  return &region_->runtimes[runtime_id];
+}
+
+tf_resource_stats* TfSchedulerStats::Resource(int resource){
+  int index;
+  switch (resource)
+  {
+  case ResourceType::CPU:
+    index = 0;
+    break;
+  case ResourceType::GPU:
+    index = 1;
+    break;
+  case ResourceType::CPU_B:
+    index = 2;
+    break;
+  default:
+    return nullptr;
+  }
+  if(region_ == nullptr)
+    return nullptr;
+  return &region_->resources[index];
+}
+
+void TfSchedulerStats::OnRegister(int runtime_id){
+  tf_runtime_stats* stats = Runtime(runtime_id);
+  if(stats == nullptr)
+    return;
+  SeqWriteGuard guard(stats->seq);
+  // Starts over from the runtime which had the id before.
+  memset(reinterpret_cast<char*>(stats) + sizeof(stats->seq), 0,
+         sizeof(*stats) - sizeof(stats->seq));
+  stats->runtime_id = runtime_id;
+  stats->active = 1;
+}
+
+void TfSchedulerStats::OnLeave(int runtime_id){
+  tf_runtime_stats* stats = Runtime(runtime_id);
+  if(stats == nullptr)
+    return;
+  SeqWriteGuard guard(stats->seq);
+  stats->active = 0;
+}
+
+void TfSchedulerStats::OnCapacity(int resource, int capacity){
+  tf_resource_stats* stats = Resource(resource);
+  if(stats == nullptr)
+    return;
+  SeqWriteGuard guard(stats->seq);
+  stats->capacity = capacity;
+}
+
+void TfSchedulerStats::OnRequest(int runtime_id){
+  tf_runtime_stats* stats = Runtime(runtime_id);
+  if(stats == nullptr)
+    return;
+  SeqWriteGuard guard(stats->seq);
+  stats->requests++;
+}
+
+void TfSchedulerStats::OnBlocked(int resource, int runtime_id, int waiting){
+  if(tf_runtime_stats* stats = Runtime(runtime_id)){
+    SeqWriteGuard guard(stats->seq);
+    stats->blocked++;
+  }
+  if(tf_resource_stats* stats = Resource(resource)){
+    SeqWriteGuard guard(stats->seq);
+    stats->blocked++;
+    if(waiting > stats->max_waiting)
+      stats->max_waiting = waiting;
+  }
+}
+
+void TfSchedulerStats::OnGrant(int resource, int runtime_id, int64_t wait_us){
+  if(tf_runtime_stats* stats = Runtime(runtime_id)){
+    SeqWriteGuard guard(stats->seq);
+    stats->grants++;
+    RecordLatency(stats->grant_wait, wait_us);
+  }
+  if(tf_resource_stats* stats = Resource(resource)){
+    SeqWriteGuard guard(stats->seq);
+    stats->grants++;
+    RecordLatency(stats->grant_wait, wait_us);
+  }
+}
+
+void TfSchedulerStats::OnLease(int runtime_id){
+  tf_runtime_stats* stats = Runtime(runtime_id);
+  if(stats == nullptr)
+    return;
+  SeqWriteGuard guard(stats->seq);
+  stats->leases++;
+}
+
+void TfSchedulerStats::OnRevoke(int runtime_id){
+  tf_runtime_stats* stats = Runtime(runtime_id);
+  if(stats == nullptr)
+    return;
+  SeqWriteGuard guard(stats->seq);
+  stats->revokes++;
+}
+
+void TfSchedulerStats::OnRelease(int resource, int runtime_id, int subgraph,
+                                 int64_t hold_us, int64_t deadline_us,
+                                 int64_t now_us){
+  if(tf_runtime_stats* stats = Runtime(runtime_id)){
+    SeqWriteGuard guard(stats->seq);
+    if(subgraph == -1){
+      RecordLatency(stats->lease_hold, hold_us);
+    }else{
+      RecordLatency(stats->exec, hold_us);
+      if(subgraph < TF_STATS_MAX_SUBGRAPHS)
+        RecordLatency(stats->subgraph_exec[subgraph], hold_us);
+    }
+    // A frame is counted once, however many resources it releases late.
+    if(deadline_us != 0 && now_us > deadline_us &&
+        stats->last_missed_deadline_us != deadline_us){
+      stats->deadline_misses++;
+      stats->last_missed_deadline_us = deadline_us;
+    }
+  }
+  if(tf_resource_stats* stats = Resource(resource)){
+    SeqWriteGuard guard(stats->seq);
+    stats->busy_us += hold_us > 0 ? hold_us : 0;
+    RecordLatency(stats->hold, hold_us);
+  }
+}
+
+TfStatsReader* TfStatsReader::Open(const char* path){
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if(fd == -1){
+    std::cout << "Cannot open stats file " << path << "\n";
+    return nullptr;
+  }
+  // Mapping beyond the end of a file being created faults on read.
+  const off_t size = lseek(fd, 0, SEEK_END);
+  void* addr = MAP_FAILED;
+  if(size >= static_cast<off_t>(sizeof(tf_stats_region)))
+    addr = mmap(nullptr, sizeof(tf_stats_region), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(addr == MAP_FAILED){
+    std::cout << "Stats file " << path << " is not ready" << "\n";
+    return nullptr;
+  }
+  const tf_stats_region* region = static_cast<const tf_stats_region*>(addr);
+  if(region->magic != TF_STATS_MAGIC || region->version != TF_STATS_VERSION){
+    std::cout << "Stats file version mismatch" << "\n";
+    munmap(addr, sizeof(tf_stats_region));
+    return nullptr;
+  }
+  return new TfStatsReader(region);
+}
+
+TfStatsReader::~TfStatsReader(){
+  munmap(const_cast<tf_stats_region*>(region_), sizeof(tf_stats_region));
+}
+
+void TfStatsReader::ReadRuntime(int index, tf_runtime_stats& stats){
+  ReadConsistent(region_->runtimes[index], stats);
+}
+
+void TfStatsReader::ReadResource(int index, tf_resource_stats& stats){
+  ReadConsistent(region_->resources[index], stats);
+}
+
+} // namespace tflite
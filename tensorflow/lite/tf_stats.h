@@ -0,0 +1,149 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+Telemetry of TfScheduler.
+
+The scheduler counts grants, blocks, leases, revokes and deadline misses,
+and records grant wait and execution time in latency histograms, per
+runtime, per subgraph and per resource. The records live in one region
+(tf_stats_region) which is mapped to a file if TF_SCHEDULER_STATS names
+one, so that a sidecar maps it read-only and scrapes it any time without a
+message to the scheduler. (see examples/scheduler_stats)
+
+Each record has a sequence number which is odd while the scheduler updates
+it. A reader copies the record and retries if the number was odd or changed,
+the scheduler never waits for readers.
+
+Histograms are log-linear like HDR histograms: a power of two range is split
+into TF_HIST_SUB_BUCKETS linear buckets, so a bucket is at most 1/8 of its
+value wide. Values are in us.
+
+Bump TF_STATS_VERSION whenever the layout of the region changes.
+*/
+
+#define TF_STATS_MAGIC          0x54465354 // "TFST"
+#define TF_STATS_VERSION        2
+
+// Environment variable of the stats file, kept in memory only if not set.
+#define TF_STATS_FILE_ENV       "TF_SCHEDULER_STATS"
+
+#define TF_STATS_MAX_RUNTIMES   16
+#define TF_STATS_MAX_SUBGRAPHS  16 // subgraphs after this are not recorded.
+#define TF_STATS_RESOURCES      3  // CPU, GPU, CPU_B
+
+#define TF_HIST_SUB_BITS        3
+#define TF_HIST_SUB_BUCKETS     (1 << TF_HIST_SUB_BITS)
+// Values from 2^TF_HIST_MAX_BITS us(134s) fall into the last bucket.
+#define TF_HIST_MAX_BITS        27
+#define TF_HIST_BUCKETS \
+  ((TF_HIST_MAX_BITS - TF_HIST_SUB_BITS + 1) * TF_HIST_SUB_BUCKETS)
+
+namespace tflite{
+
+typedef struct tf_histogram{
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t buckets[TF_HIST_BUCKETS];
+}tf_histogram;
+
+typedef struct tf_runtime_stats{
+  std::atomic<uint64_t> seq;
+  int32_t runtime_id;     // -1 if the slot was never used.
+  int32_t active;         // 0 after the runtime left, until the id is reused.
+  uint64_t requests;
+  uint64_t grants;
+  uint64_t blocked;       // requests which waited for a resource.
+  uint64_t leases;
+  uint64_t revokes;
+  uint64_t deadline_misses; // frames which released a resource late.
+  int64_t last_missed_deadline_us;
+  tf_histogram grant_wait;  // request to grant.
+  tf_histogram exec;        // grant to release of a subgraph.
+  tf_histogram lease_hold;  // grant to release of a lease.
+  tf_histogram subgraph_exec[TF_STATS_MAX_SUBGRAPHS];
+}tf_runtime_stats;
+
+typedef struct tf_resource_stats{
+  std::atomic<uint64_t> seq;
+  int32_t capacity;
+  int32_t max_waiting;
+  uint64_t grants;
+  uint64_t blocked;
+  uint64_t busy_us;         // sum of held time of every slot.
+  tf_histogram grant_wait;
+  tf_histogram hold;
+}tf_resource_stats;
+
+typedef struct tf_stats_region{
+  uint32_t magic;
+  uint32_t version;
+  int64_t start_us;         // CLOCK_MONOTONIC of scheduler start.
+  tf_resource_stats resources[TF_STATS_RESOURCES];
+  tf_runtime_stats runtimes[TF_STATS_MAX_RUNTIMES];
+}tf_stats_region;
+
+void RecordLatency(tf_histogram& histogram, int64_t value_us);
+
+// Value(us) under which 'quantile'(0~1) of the records are, upper bound of
+// its bucket. 0 if empty.
+uint64_t LatencyPercentile(const tf_histogram& histogram, double quantile);
+
+// Writer of the scheduler.
+class TfSchedulerStats{
+  public:
+    // Maps the region to 'path', or to anonymous memory if 'path' is null,
+    // empty or can't be created.
+    explicit TfSchedulerStats(const char* path);
+    ~TfSchedulerStats();
+
+    // 'resource' is a ResourceType, others than CPU, GPU and CPU_B are not
+    // recorded.
+    void OnRegister(int runtime_id);
+    void OnLeave(int runtime_id);
+    void OnCapacity(int resource, int capacity);
+    void OnRequest(int runtime_id);
+    void OnBlocked(int resource, int runtime_id, int waiting);
+    // 'wait_us' from request to grant.
+    void OnGrant(int resource, int runtime_id, int64_t wait_us);
+    void OnLease(int runtime_id);
+    void OnRevoke(int runtime_id);
+    // A slot held for 'hold_us' is released. 'subgraph' is -1 for a lease.
+    // 'deadline_us' is the absolute deadline of the frame, 0 if none.
+    void OnRelease(int resource, int runtime_id, int subgraph, int64_t hold_us,
+                   int64_t deadline_us, int64_t now_us);
+
+    const tf_stats_region* Region() const { return region_; }
+
+  private:
+    // nullptr if the id doesn't fit.
+    tf_runtime_stats* Runtime(int runtime_id);
+    tf_resource_stats* Resource(int resource);
+
+    tf_stats_region* region_ = nullptr;
+    bool file_backed_ = false;
+};
+
+// Reader of a stats file. (sidecar)
+class TfStatsReader{
+  public:
+    // Returns nullptr if the file is missing or of another version.
+    static TfStatsReader* Open(const char* path);
+    ~TfStatsReader();
+
+    // Consistent copies of a record.
+    void ReadRuntime(int index, tf_runtime_stats& stats);
+    void ReadResource(int index, tf_resource_stats& stats);
+
+    int64_t StartUs() const { return region_->start_us; }
+
+  private:
+    explicit TfStatsReader(const tf_stats_region* region) : region_(region) {}
+
+    const tf_stats_region* region_;
+};
+
+} // namespace tflite
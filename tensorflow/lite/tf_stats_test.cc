@@ -0,0 +1,147 @@
+#include "tensorflow/lite/tf_stats.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "tensorflow/lite/util.h"
+
+namespace tflite {
+namespace {
+
+// Stats file in the test temporary directory, removed at the end.
+class StatsFile {
+ public:
+  StatsFile() {
+    const char* dir = getenv("TEST_TMPDIR");
+    path_ = std::string(dir != nullptr ? dir : "/tmp") + "/tf_stats_test." +
+            std::to_string(getpid());
+  }
+  ~StatsFile() { unlink(path_.c_str()); }
+  const char* path() const { return path_.c_str(); }
+
+ private:
+  std::string path_;
+};
+
+TEST(TfStatsTest, EmptyHistogram) {
+  tf_histogram histogram = {};
+  EXPECT_EQ(LatencyPercentile(histogram, 0.5), 0u);
+}
+
+TEST(TfStatsTest, SmallValuesAreExact) {
+  tf_histogram histogram = {};
+  for (int value = 0; value < TF_HIST_SUB_BUCKETS; ++value)
+    RecordLatency(histogram, value);
+  EXPECT_EQ(histogram.count, static_cast<uint64_t>(TF_HIST_SUB_BUCKETS));
+  EXPECT_EQ(LatencyPercentile(histogram, 0), 1u);
+  EXPECT_EQ(LatencyPercentile(histogram, 1), TF_HIST_SUB_BUCKETS - 1u);
+}
+
+TEST(TfStatsTest, NegativeValueIsZero) {
+  tf_histogram histogram = {};
+  RecordLatency(histogram, -5);
+  EXPECT_EQ(histogram.sum, 0u);
+  EXPECT_EQ(histogram.buckets[0], 1u);
+}
+
+TEST(TfStatsTest, PercentileWithinBucketWidth) {
+  tf_histogram histogram = {};
+  for (int value = 1; value <= 10000; ++value) RecordLatency(histogram, value);
+  EXPECT_EQ(histogram.max, 10000u);
+  for (double quantile : {0.5, 0.9, 0.99}) {
+    const double exact = quantile * 9999 + 1;
+    const uint64_t value = LatencyPercentile(histogram, quantile);
+    // Upper bound of the bucket, at most 1/8 above the exact value.
+    EXPECT_GE(value, exact) << quantile;
+    EXPECT_LE(value, exact * 1.125 + 1) << quantile;
+  }
+  EXPECT_EQ(LatencyPercentile(histogram, 1), 10000u);
+}
+
+TEST(TfStatsTest, PercentileClampedToMax) {
+  tf_histogram histogram = {};
+  RecordLatency(histogram, 1001);
+  EXPECT_EQ(LatencyPercentile(histogram, 0.5), 1001u);
+}
+
+TEST(TfStatsTest, OutOfRangeValuesInLastBucket) {
+  tf_histogram histogram = {};
+  const int64_t huge = int64_t{1} << (TF_HIST_MAX_BITS + 4);
+  RecordLatency(histogram, huge);
+  EXPECT_EQ(histogram.buckets[TF_HIST_BUCKETS - 1], 1u);
+  EXPECT_EQ(LatencyPercentile(histogram, 0.5), static_cast<uint64_t>(huge));
+}
+
+TEST(TfStatsTest, ReaderOfMissingFile) {
+  EXPECT_EQ(TfStatsReader::Open("/nonexistent/tf_stats"), nullptr);
+}
+
+TEST(TfStatsTest, RegisterResetsReusedId) {
+  StatsFile file;
+  TfSchedulerStats stats(file.path());
+  std::unique_ptr<TfStatsReader> reader(TfStatsReader::Open(file.path()));
+  ASSERT_NE(reader, nullptr);
+  stats.OnRegister(1);
+  stats.OnGrant(ResourceType::CPU, 1, 100);
+  stats.OnLeave(1);
+  tf_runtime_stats runtime;
+  reader->ReadRuntime(1, runtime);
+  EXPECT_EQ(runtime.active, 0);
+  EXPECT_EQ(runtime.grants, 1u);
+  stats.OnRegister(1);
+  reader->ReadRuntime(1, runtime);
+  EXPECT_EQ(runtime.runtime_id, 1);
+  EXPECT_EQ(runtime.active, 1);
+  EXPECT_EQ(runtime.grants, 0u);
+  EXPECT_EQ(runtime.grant_wait.count, 0u);
+}
+
+TEST(TfStatsTest, ReaderNeverSeesTornRecord) {
+  StatsFile file;
+  TfSchedulerStats stats(file.path());
+  std::unique_ptr<TfStatsReader> reader(TfStatsReader::Open(file.path()));
+  ASSERT_NE(reader, nullptr);
+  stats.OnRegister(0);
+  constexpr int64_t kWaitUs = 7;
+  std::atomic<bool> done(false);
+  std::thread writer([&]() {
+    for (int i = 0; i < 200000; ++i) {
+      stats.OnGrant(ResourceType::GPU, 0, kWaitUs);
+      stats.OnRequest(0);
+    }
+    done = true;
+  });
+  // Counters of a record are updated together, a torn copy breaks them.
+  int reads = 0;
+  while (!done || reads == 0) {
+    tf_runtime_stats runtime;
+    reader->ReadRuntime(0, runtime);
+    ASSERT_EQ(runtime.grant_wait.count, runtime.grants);
+    ASSERT_EQ(runtime.grant_wait.sum, runtime.grants * kWaitUs);
+    ASSERT_LE(runtime.requests, runtime.grants);
+    ASSERT_GE(runtime.requests + 1, runtime.grants);
+    tf_resource_stats resource;
+    reader->ReadResource(1, resource);
+    ASSERT_EQ(resource.grant_wait.count, resource.grants);
+    reads++;
+  }
+  writer.join();
+  tf_runtime_stats runtime;
+  reader->ReadRuntime(0, runtime);
+  EXPECT_EQ(runtime.grants, 200000u);
+  EXPECT_EQ(runtime.requests, 200000u);
+}
+
+}  // namespace
+}  // namespace tflite
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
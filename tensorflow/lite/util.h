@@ -41,6 +41,16 @@ limitations under the License.
 #define TF_P_PLAN_CPU        0
 #define TF_P_PLAN_GPU        1
 #define TF_P_PLAN_CO_E       2
+// Not a subgraph. [start, end, TF_P_PLAN_LAYER_RATIO, ratio] overrides the
+// partitioning ratio of layers [start, end) in the co-execution row above.
+#define TF_P_PLAN_LAYER_RATIO 3
+// CPU-cluster co-execution, the second resource is CPU cluster B instead of
+// GPU. (see CpuClusterOptions)
+// Subgraph on cluster B.
+#define TF_P_PLAN_CPU_B      4
+// Layer split between cluster A(max precision side) and B(minimal precision
+// side), with the ratio of TF_P_PLAN_CO_E.
+#define TF_P_PLAN_CO_CPU     5
 
 // packet partitioning plan end flag
 #define TF_P_END_PLAN       -1
@@ -48,6 +58,10 @@ limitations under the License.
 // packet master partitioning plan end flag
 #define TF_P_END_MASTER        -2
 
+// Max partitioning plans of a runtime including the primary one.
+// The others are partition variants built ahead of time.
+#define TF_P_MAX_VARIANTS    3
+
 // packet predefines
 
 #include <memory>
@@ -192,7 +206,8 @@ typedef enum ResourceType{
   GPU,
   CO_CPU,
   CO_GPU,
-  NONE
+  NONE,
+  CPU_B   // CPU cluster B of CPU-cluster co-execution.
 } ResourceType;
 
 typedef enum RuntimeState{
@@ -235,6 +250,13 @@ typedef struct ProfileData{
   bool is_valid;
 } ProfileData;
 
+// Cores of a CPU cluster in CPU-cluster co-execution. The cluster has its
+// own XNNPACK delegate whose threads stay on 'cpus'.
+typedef struct CpuClusterOptions{
+  std::vector<int> cpus;        // not pinned if empty.
+  int num_threads = DEFAULT_THREADS;
+} CpuClusterOptions;
+
 typedef enum INPUT_TYPE{
   MNIST,
   IMAGENET224,
@@ -244,21 +266,6 @@ typedef enum INPUT_TYPE{
   USER
 }INPUT_TYPE;
 
-
-
-// TODO : Consider including partitioning ratios per layer.
-typedef struct tf_packet{
-  short runtime_id;
-  short runtime_current_state;
-  short runtime_next_state;
-  int cur_subgraph;
-  int cur_graph_resource; // 0 for cpu, 1 for gpu
-  int partitioning_plan[1000][4];
-  float latency[1000];
-  float gpu_utilization;
-  float cpu_utilization;
-}tf_packet;
-
 }  // namespace tflite
 
 #endif  // TENSORFLOW_LITE_UTIL_H_